@@ -98,6 +98,10 @@ struct _DispatchNode {
 
 	GSimpleAsyncResult *simple;
 	GCancellable *cancellable;
+
+	/* For the metrics; queued_time is 0 when they are disabled */
+	const gchar *operation_name;
+	gint64 queued_time;
 };
 
 enum {
@@ -154,6 +158,7 @@ book_backend_push_operation (EBookBackend *backend,
                              GSimpleAsyncResult *simple,
                              GCancellable *cancellable,
                              gboolean blocking_operation,
+                             const gchar *operation_name,
                              GSimpleAsyncThreadFunc dispatch_func)
 {
 	DispatchNode *node;
@@ -167,6 +172,8 @@ book_backend_push_operation (EBookBackend *backend,
 	node->dispatch_func = dispatch_func;
 	node->blocking_operation = blocking_operation;
 	node->simple = g_object_ref (simple);
+	node->operation_name = operation_name;
+	node->queued_time = e_metrics_timer_start ();
 
 	if (G_IS_CANCELLABLE (cancellable))
 		node->cancellable = g_object_ref (cancellable);
@@ -188,11 +195,17 @@ book_backend_dispatch_thread (DispatchNode *node)
 	} else {
 		GAsyncResult *result;
 		GObject *source_object;
+		gint64 start;
+
+		e_metrics_timer_stop ("EBookBackend.queue-wait", node->queued_time);
+		start = e_metrics_timer_start ();
 
 		result = G_ASYNC_RESULT (node->simple);
 		source_object = g_async_result_get_source_object (result);
 		node->dispatch_func (node->simple, source_object, cancellable);
 		g_object_unref (source_object);
+
+		e_metrics_timer_stop (node->operation_name, start);
 	}
 
 	dispatch_node_free (node);
@@ -1186,13 +1199,13 @@ e_book_backend_open (EBookBackend *backend,
 	if (class->open_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, TRUE,
-			book_backend_open_thread);
+			"EBookBackend.open", book_backend_open_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->open != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, TRUE,
-			book_backend_open_thread_old_style);
+			"EBookBackend.open", book_backend_open_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -1402,13 +1415,13 @@ e_book_backend_refresh (EBookBackend *backend,
 	if (class->refresh_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_refresh_thread);
+			"EBookBackend.refresh", book_backend_refresh_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->refresh != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_refresh_thread_old_style);
+			"EBookBackend.refresh", book_backend_refresh_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -1656,13 +1669,13 @@ e_book_backend_create_contacts (EBookBackend *backend,
 	if (class->create_contacts_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_create_contacts_thread);
+			"EBookBackend.create_contacts", book_backend_create_contacts_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->create_contacts != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_create_contacts_thread_old_style);
+			"EBookBackend.create_contacts", book_backend_create_contacts_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -1920,13 +1933,13 @@ e_book_backend_modify_contacts (EBookBackend *backend,
 	if (class->modify_contacts_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_modify_contacts_thread);
+			"EBookBackend.modify_contacts", book_backend_modify_contacts_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->modify_contacts != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_modify_contacts_thread_old_style);
+			"EBookBackend.modify_contacts", book_backend_modify_contacts_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -2177,13 +2190,13 @@ e_book_backend_remove_contacts (EBookBackend *backend,
 	if (class->remove_contacts_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_remove_contacts_thread);
+			"EBookBackend.remove_contacts", book_backend_remove_contacts_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->remove_contacts != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_remove_contacts_thread_old_style);
+			"EBookBackend.remove_contacts", book_backend_remove_contacts_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -2427,13 +2440,13 @@ e_book_backend_get_contact (EBookBackend *backend,
 	if (class->get_contact_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_thread);
+			"EBookBackend.get_contact", book_backend_get_contact_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->get_contact != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_thread_old_style);
+			"EBookBackend.get_contact", book_backend_get_contact_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -2690,13 +2703,13 @@ e_book_backend_get_contact_list (EBookBackend *backend,
 	if (class->get_contact_list_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_list_thread);
+			"EBookBackend.get_contact_list", book_backend_get_contact_list_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->get_contact_list != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_list_thread_old_style);
+			"EBookBackend.get_contact_list", book_backend_get_contact_list_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -2949,13 +2962,13 @@ e_book_backend_get_contact_list_uids (EBookBackend *backend,
 	if (class->get_contact_list_uids_sync != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_list_uids_thread);
+			"EBookBackend.get_contact_list_uids", book_backend_get_contact_list_uids_thread);
 		book_backend_dispatch_next_operation (backend);
 
 	} else if (class->get_contact_list_uids != NULL) {
 		book_backend_push_operation (
 			backend, simple, cancellable, FALSE,
-			book_backend_get_contact_list_uids_thread_old_style);
+			"EBookBackend.get_contact_list_uids", book_backend_get_contact_list_uids_thread_old_style);
 		book_backend_dispatch_next_operation (backend);
 
 	} else {
@@ -3082,6 +3095,9 @@ e_book_backend_add_view (EBookBackend *backend,
 	backend->priv->views = g_list_append (backend->priv->views, view);
 
 	g_mutex_unlock (&backend->priv->views_mutex);
+
+	/* Someone is looking at the data, refresh it first */
+	e_source_refresh_set_prioritized (e_backend_get_source (E_BACKEND (backend)), TRUE);
 }
 
 /**
@@ -3112,6 +3128,8 @@ e_book_backend_remove_view (EBookBackend *backend,
 	backend->priv->views = list;
 
 	g_mutex_unlock (&backend->priv->views_mutex);
+
+	e_source_refresh_set_prioritized (e_backend_get_source (E_BACKEND (backend)), list != NULL);
 }
 
 /**
@@ -108,6 +108,14 @@ static const GDebugKey ebsql_debug_keys[] = {
 
 static EbSqlDebugFlag ebsql_debug_flags = 0;
 
+/* Run EDS with EBSQL_SLOW_QUERY_MS=100 to log the shape of every
+ * statement taking 100 ms or longer, together with its query plan.
+ */
+#define EBSQL_ENV_SLOW_QUERY "EBSQL_SLOW_QUERY_MS"
+
+/* In microseconds, 0 when the slow statements are not logged */
+static gint64 ebsql_slow_query_threshold = 0;
+
 static void
 ebsql_init_debug (void)
 {
@@ -124,6 +132,12 @@ ebsql_init_debug (void)
 					env_string,
 					ebsql_debug_keys,
 					G_N_ELEMENTS (ebsql_debug_keys));
+
+		env_string = g_getenv (EBSQL_ENV_SLOW_QUERY);
+
+		if (env_string != NULL)
+			ebsql_slow_query_threshold =
+				g_ascii_strtoll (env_string, NULL, 10) * 1000;
 	}
 }
 
@@ -800,6 +814,25 @@ ebsql_debug_query_plan_cb (gpointer ref,
 	return 0;
 }
 
+/* For EBSQL_ENV_SLOW_QUERY */
+static gint
+ebsql_slow_query_plan_cb (gpointer ref,
+                          gint n_cols,
+                          gchar **cols,
+                          gchar **name)
+{
+	gint i;
+
+	for (i = 0; i < n_cols; i++) {
+		if (strcmp (name[i], "detail") == 0) {
+			g_message ("  PLAN: %s", cols[i]);
+			break;
+		}
+	}
+
+	return 0;
+}
+
 /* Collect a GList of column names in the main summary table */
 static gint
 get_columns_cb (gpointer ref,
@@ -1100,6 +1133,132 @@ ebsql_exec_maybe_debug (EBookSqlite *ebsql,
 	}
 }
 
+/* Longer statement shapes are cut, they are metric names */
+#define EBSQL_SHAPE_MAX_LEN 200
+
+/* Appends a '?' for a literal, collapsing lists of literals into one */
+static void
+ebsql_shape_append_value (GString *shape)
+{
+	if (g_str_has_suffix (shape->str, "?, "))
+		g_string_truncate (shape, shape->len - 2);
+	else if (g_str_has_suffix (shape->str, "?,"))
+		g_string_truncate (shape, shape->len - 1);
+	else
+		g_string_append_c (shape, '?');
+}
+
+/* Replaces the literals and the parameters of @stmt with '?' and
+ * squeezes the white space, so that the statements which differ only
+ * in their values are counted together.
+ */
+static gchar *
+ebsql_statement_shape (const gchar *stmt)
+{
+	GString *shape;
+	const gchar *ptr;
+
+	shape = g_string_sized_new (EBSQL_SHAPE_MAX_LEN + 4);
+
+	for (ptr = stmt; *ptr && shape->len < EBSQL_SHAPE_MAX_LEN; ptr++) {
+		gchar prev = shape->len > 0 ? shape->str[shape->len - 1] : ' ';
+
+		if (g_ascii_isspace (*ptr)) {
+			if (prev != ' ')
+				g_string_append_c (shape, ' ');
+		} else if (*ptr == '\'') {
+			/* Skip the string literal, '' is an escaped quote */
+			for (ptr++; *ptr; ptr++) {
+				if (*ptr == '\'') {
+					if (ptr[1] != '\'')
+						break;
+					ptr++;
+				}
+			}
+
+			ebsql_shape_append_value (shape);
+
+			if (!*ptr)
+				break;
+		} else if (*ptr == '?' ||
+			   (g_ascii_isdigit (*ptr) && !g_ascii_isalnum (prev) && prev != '_')) {
+			while (g_ascii_isalnum (ptr[1]) || ptr[1] == '.')
+				ptr++;
+
+			ebsql_shape_append_value (shape);
+		} else {
+			g_string_append_c (shape, *ptr);
+		}
+	}
+
+	if (*ptr)
+		g_string_append (shape, "...");
+
+	return g_string_free (shape, FALSE);
+}
+
+/* Returns a start time for ebsql_profile_statement(),
+ * or 0 when neither the metrics nor the slow query log are on */
+static inline gint64
+ebsql_profile_start (void)
+{
+	if (ebsql_slow_query_threshold > 0 || e_metrics_get_enabled ())
+		return g_get_monotonic_time ();
+
+	return 0;
+}
+
+/* Adds the time @stmt took since @start to the @metric and to the
+ * metric of the statement's shape, and logs the shape with the
+ * query plan when it took longer than EBSQL_SLOW_QUERY_MS. */
+static void
+ebsql_profile_statement (EBookSqlite *ebsql,
+                         const gchar *metric,
+                         const gchar *stmt,
+                         gint64 start)
+{
+	gint64 elapsed;
+
+	if (!start || !stmt || g_ascii_strncasecmp (stmt, "EXPLAIN", 7) == 0)
+		return;
+
+	elapsed = MAX (g_get_monotonic_time () - start, 0);
+
+	if (e_metrics_get_enabled ()) {
+		gchar *shape, *name;
+
+		shape = ebsql_statement_shape (stmt);
+		name = g_strconcat ("EBookSqlite.sql ", shape, NULL);
+
+		e_metrics_add_sample (metric, elapsed);
+		e_metrics_add_sample (name, elapsed);
+
+		g_free (shape);
+		g_free (name);
+	}
+
+	if (ebsql_slow_query_threshold > 0 && elapsed >= ebsql_slow_query_threshold) {
+		gchar *shape;
+
+		/* the values can be contact details, keep them out of the log */
+		shape = ebsql_statement_shape (stmt);
+		g_message (
+			"EBookSqlite: %" G_GINT64_FORMAT " ms in '%s': %s",
+			elapsed / 1000, ebsql->priv->path, shape);
+		g_free (shape);
+
+		/* Not for the pragmas and the transaction statements */
+		if (g_ascii_strncasecmp (stmt, "SELECT", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "UPDATE", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "DELETE", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "INSERT", 6) == 0)
+			ebsql_exec_printf (
+				ebsql, "EXPLAIN QUERY PLAN %s",
+				ebsql_slow_query_plan_cb,
+				NULL, NULL, NULL, stmt);
+	}
+}
+
 static gboolean
 ebsql_exec (EBookSqlite *ebsql,
             const gchar *stmt,
@@ -1111,7 +1270,7 @@ ebsql_exec (EBookSqlite *ebsql,
 	gboolean had_cancel;
 	gchar *errmsg = NULL;
 	gint ret = -1, retries = 0;
-	gint64 t1 = 0, t2;
+	gint64 t1 = 0, t2, profile_start;
 
 	/* Debug output for statements and query plans */
 	ebsql_exec_maybe_debug (ebsql, stmt);
@@ -1131,6 +1290,9 @@ ebsql_exec (EBookSqlite *ebsql,
 	    strncmp (stmt, "EXPLAIN QUERY PLAN ", 19) != 0)
 		t1 = g_get_monotonic_time();
 
+	/* Includes the time spent waiting for a locked database */
+	profile_start = ebsql_profile_start ();
+
 	ret = sqlite3_exec (ebsql->priv->db, stmt, callback, data, &errmsg);
 
 	while (ret == SQLITE_BUSY || ret == SQLITE_LOCKED || ret == -1) {
@@ -1155,6 +1317,8 @@ ebsql_exec (EBookSqlite *ebsql,
 	if (!had_cancel)
 		ebsql->priv->cancel = NULL;
 
+	ebsql_profile_statement (ebsql, "EBookSqlite.exec", stmt, profile_start);
+
 	if (t1) {
 		t2 = g_get_monotonic_time();
 		g_printerr ("TIME: %" G_GINT64_FORMAT " ms\n", (t2 - t1) / 1000);
@@ -1323,8 +1487,12 @@ ebsql_complete_statement (EBookSqlite *ebsql,
                           gint ret,
                           GError **error)
 {
-	if (ret == SQLITE_OK)
+	gint64 profile_start = 0;
+
+	if (ret == SQLITE_OK) {
+		profile_start = ebsql_profile_start ();
 		ret = sqlite3_step (stmt);
+	}
 
 	if (ret != SQLITE_OK && ret != SQLITE_DONE) {
 		const gchar *errmsg = sqlite3_errmsg (ebsql->priv->db);
@@ -1335,6 +1503,9 @@ ebsql_complete_statement (EBookSqlite *ebsql,
 	sqlite3_reset (stmt);
 	sqlite3_clear_bindings (stmt);
 
+	/* After the reset, the query plan is taken on the same connection */
+	ebsql_profile_statement (ebsql, "EBookSqlite.step", sqlite3_sql (stmt), profile_start);
+
 	return (ret == SQLITE_OK || ret == SQLITE_DONE);
 }
 
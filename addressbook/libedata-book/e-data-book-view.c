@@ -160,6 +160,8 @@ send_pending_adds (EDataBookView *view)
 	if (view->priv->adds->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataBookView.objects-added", view->priv->adds->len);
+
 	e_gdbus_book_view_emit_objects_added (
 		view->priv->gdbus_object,
 		(const gchar * const *) view->priv->adds->data);
@@ -172,6 +174,8 @@ send_pending_changes (EDataBookView *view)
 	if (view->priv->changes->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataBookView.objects-modified", view->priv->changes->len);
+
 	e_gdbus_book_view_emit_objects_modified (
 		view->priv->gdbus_object,
 		(const gchar * const *) view->priv->changes->data);
@@ -184,6 +188,8 @@ send_pending_removes (EDataBookView *view)
 	if (view->priv->removes->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataBookView.objects-removed", view->priv->removes->len);
+
 	e_gdbus_book_view_emit_objects_removed (
 		view->priv->gdbus_object,
 		(const gchar * const *) view->priv->removes->data);
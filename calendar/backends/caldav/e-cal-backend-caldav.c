@@ -1523,7 +1523,8 @@ caldav_server_list_objects (ECalBackendCalDAV *cbdav,
                             GSList *only_hrefs,
                             time_t start_time,
                             time_t end_time,
-			    GCancellable *cancellable)
+			    GCancellable *cancellable,
+			    GError **error)
 {
 	xmlOutputBufferPtr   buf;
 	SoupMessage         *message;
@@ -1539,8 +1540,10 @@ caldav_server_list_objects (ECalBackendCalDAV *cbdav,
 
 	/* Allocate the soup message */
 	message = soup_message_new ("REPORT", cbdav->priv->uri);
-	if (message == NULL)
+	if (message == NULL) {
+		g_propagate_error (error, EDC_ERROR (OtherError));
 		return FALSE;
+	}
 
 	/* Maybe we should just do a g_strdup_printf here? */
 	/* Prepare request body */
@@ -1651,12 +1654,18 @@ caldav_server_list_objects (ECalBackendCalDAV *cbdav,
 			break;
 		}
 
+		/* A success other than the multi-status is a failure too */
+		if (status_code_to_result (message, cbdav, FALSE, error))
+			g_propagate_error (error, EDC_ERROR (OtherError));
+
 		g_object_unref (message);
 		return FALSE;
 	}
 
 	/* Parse the response body */
 	result = parse_report_response (message, objs, len);
+	if (!result)
+		g_propagate_error (error, EDC_ERROR (InvalidObject));
 
 	g_object_unref (message);
 	return result;
@@ -1667,7 +1676,8 @@ caldav_synchronize_cache (ECalBackendCalDAV *cbdav,
 			  time_t start_time,
 			  time_t end_time,
 			  gboolean can_check_ctag,
-			  GCancellable *cancellable);
+			  GCancellable *cancellable,
+			  GError **error);
 
 static gboolean
 caldav_server_query_google_for_uid (ECalBackendCalDAV *cbdav,
@@ -1678,7 +1688,7 @@ caldav_server_query_google_for_uid (ECalBackendCalDAV *cbdav,
 	if (!check_calendar_changed_on_server (cbdav, FALSE, cancellable))
 		return FALSE;
 
-	caldav_synchronize_cache (cbdav, 0, 0, FALSE, cancellable);
+	caldav_synchronize_cache (cbdav, 0, 0, FALSE, cancellable, NULL);
 
 	return !g_cancellable_is_cancelled (cancellable);
 }
@@ -1712,8 +1722,10 @@ caldav_server_query_for_uid (ECalBackendCalDAV *cbdav,
 
 	/* Allocate the soup message */
 	message = soup_message_new ("REPORT", cbdav->priv->uri);
-	if (message == NULL)
+	if (message == NULL) {
+		g_propagate_error (error, EDC_ERROR (OtherError));
 		return FALSE;
+	}
 
 	/* Maybe we should just do a g_strdup_printf here? */
 	/* Prepare request body */
@@ -2398,7 +2410,8 @@ caldav_synchronize_cache (ECalBackendCalDAV *cbdav,
 			  time_t start_time,
 			  time_t end_time,
 			  gboolean can_check_ctag,
-			  GCancellable *cancellable)
+			  GCancellable *cancellable,
+			  GError **error)
 {
 	CalDAVObject *sobjs, *object;
 	GSList *c_objs, *c_iter; /* list of all items known from our cache */
@@ -2419,7 +2432,7 @@ caldav_synchronize_cache (ECalBackendCalDAV *cbdav,
 	sobjs = NULL;
 
 	/* get list of server objects */
-	if (!caldav_server_list_objects (cbdav, &sobjs, &len, NULL, start_time, end_time, cancellable))
+	if (!caldav_server_list_objects (cbdav, &sobjs, &len, NULL, start_time, end_time, cancellable, error))
 		return;
 
 	c_objs = e_cal_backend_store_get_components (cbdav->priv->store);
@@ -2558,7 +2571,7 @@ caldav_synchronize_cache (ECalBackendCalDAV *cbdav,
 			}
 
 			count = 0;
-			if (!caldav_server_list_objects (cbdav, &up_sobjs, &count, to_fetch, 0, 0, cancellable)) {
+			if (!caldav_server_list_objects (cbdav, &up_sobjs, &count, to_fetch, 0, 0, cancellable, error)) {
 				fprintf (stderr, "CalDAV - failed to retrieve bunch of items\n"); fflush (stderr);
 				break;
 			}
@@ -2668,6 +2681,7 @@ caldav_synch_slave_loop (gpointer data)
 
 	while (cbdav->priv->slave_cmd != SLAVE_SHOULD_DIE) {
 		gboolean can_check_ctag = TRUE;
+		GError *sync_error = NULL;
 
 		if (cbdav->priv->slave_cmd == SLAVE_SHOULD_SLEEP) {
 			/* just sleep until we get woken up again */
@@ -2718,7 +2732,8 @@ caldav_synch_slave_loop (gpointer data)
 				g_clear_error (&local_error2);
 			}
 
-			g_clear_error (&local_error);
+			if (local_error)
+				g_propagate_error (&sync_error, local_error);
 			g_free (certificate_pem);
 		}
 
@@ -2726,11 +2741,11 @@ caldav_synch_slave_loop (gpointer data)
 			time (&now);
 			/* check for events in the month before/after today first,
 			 * to show user actual data as soon as possible */
-			caldav_synchronize_cache (cbdav, time_add_week_with_zone (now, -5, utc), time_add_week_with_zone (now, +5, utc), can_check_ctag, NULL);
+			caldav_synchronize_cache (cbdav, time_add_week_with_zone (now, -5, utc), time_add_week_with_zone (now, +5, utc), can_check_ctag, NULL, &sync_error);
 
 			if (cbdav->priv->slave_cmd != SLAVE_SHOULD_SLEEP) {
 				/* and then check for changes in a whole calendar */
-				caldav_synchronize_cache (cbdav, 0, 0, can_check_ctag, NULL);
+				caldav_synchronize_cache (cbdav, 0, 0, can_check_ctag, NULL, sync_error ? NULL : &sync_error);
 			}
 
 			if (caldav_debug_show (DEBUG_SERVER_ITEMS)) {
@@ -2747,6 +2762,9 @@ caldav_synch_slave_loop (gpointer data)
 
 		cbdav->priv->slave_busy = FALSE;
 
+		e_source_refresh_finished (e_backend_get_source (E_BACKEND (cbdav)), sync_error);
+		g_clear_error (&sync_error);
+
 		/* puhh that was hard, get some rest :) */
 		g_cond_wait (&cbdav->priv->cond, &cbdav->priv->busy_lock);
 	}
@@ -788,8 +788,10 @@ begin_retrieval_cb (GTask *task,
 	GError *error = NULL;
 
 	if (!e_backend_get_online (E_BACKEND (backend)) ||
-	    backend->priv->is_loading)
+	    backend->priv->is_loading) {
+		e_source_refresh_finished (e_backend_get_source (E_BACKEND (backend)), NULL);
 		return;
+	}
 
 	d (g_message ("Starting retrieval...\n"));
 
@@ -825,6 +827,8 @@ begin_retrieval_cb (GTask *task,
 	g_free (certificate_pem);
 	backend->priv->is_loading = FALSE;
 
+	e_source_refresh_finished (e_backend_get_source (E_BACKEND (backend)), error);
+
 	/* Ignore cancellations. */
 	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
 		g_error_free (error);
@@ -1039,8 +1043,10 @@ e_cal_backend_http_notify_online_cb (ECalBackend *backend,
 	online = e_backend_get_online (E_BACKEND (backend));
 	loaded = e_cal_backend_is_opened (backend);
 
+	/* Every calendar goes online at once after a resume,
+	 * thus let the refresh scheduler space the retrievals. */
 	if (online && loaded)
-		http_cal_schedule_begin_retrieval (E_CAL_BACKEND_HTTP (backend));
+		e_source_refresh_schedule_timeout (e_backend_get_source (E_BACKEND (backend)));
 }
 
 /* Get_object_component handler for the http backend */
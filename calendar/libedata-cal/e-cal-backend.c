@@ -102,6 +102,10 @@ struct _DispatchNode {
 
 	GSimpleAsyncResult *simple;
 	GCancellable *cancellable;
+
+	/* For the metrics; queued_time is 0 when they are disabled */
+	const gchar *operation_name;
+	gint64 queued_time;
 };
 
 struct _SignalClosure {
@@ -201,6 +205,7 @@ cal_backend_push_operation (ECalBackend *backend,
                             GSimpleAsyncResult *simple,
                             GCancellable *cancellable,
                             gboolean blocking_operation,
+                            const gchar *operation_name,
                             GSimpleAsyncThreadFunc dispatch_func)
 {
 	DispatchNode *node;
@@ -214,6 +219,8 @@ cal_backend_push_operation (ECalBackend *backend,
 	node->dispatch_func = dispatch_func;
 	node->blocking_operation = blocking_operation;
 	node->simple = g_object_ref (simple);
+	node->operation_name = operation_name;
+	node->queued_time = e_metrics_timer_start ();
 
 	if (G_IS_CANCELLABLE (cancellable))
 		node->cancellable = g_object_ref (cancellable);
@@ -235,11 +242,17 @@ cal_backend_dispatch_thread (DispatchNode *node)
 	} else {
 		GAsyncResult *result;
 		GObject *source_object;
+		gint64 start;
+
+		e_metrics_timer_stop ("ECalBackend.queue-wait", node->queued_time);
+		start = e_metrics_timer_start ();
 
 		result = G_ASYNC_RESULT (node->simple);
 		source_object = g_async_result_get_source_object (result);
 		node->dispatch_func (node->simple, source_object, cancellable);
 		g_object_unref (source_object);
+
+		e_metrics_timer_stop (node->operation_name, start);
 	}
 
 	dispatch_node_free (node);
@@ -1412,6 +1425,9 @@ e_cal_backend_add_view (ECalBackend *backend,
 	backend->priv->views = g_list_append (backend->priv->views, view);
 
 	g_mutex_unlock (&backend->priv->views_mutex);
+
+	/* Someone is looking at the data, refresh it first */
+	e_source_refresh_set_prioritized (e_backend_get_source (E_BACKEND (backend)), TRUE);
 }
 
 /**
@@ -1445,6 +1461,8 @@ e_cal_backend_remove_view (ECalBackend *backend,
 	backend->priv->views = list;
 
 	g_mutex_unlock (&backend->priv->views_mutex);
+
+	e_source_refresh_set_prioritized (e_backend_get_source (E_BACKEND (backend)), list != NULL);
 }
 
 /**
@@ -1598,7 +1616,7 @@ e_cal_backend_open (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, TRUE,
-		cal_backend_open_thread);
+		"ECalBackend.open", cal_backend_open_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -1767,7 +1785,7 @@ e_cal_backend_refresh (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_refresh_thread);
+		"ECalBackend.refresh", cal_backend_refresh_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -1949,7 +1967,7 @@ e_cal_backend_get_object (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_get_object_thread);
+		"ECalBackend.get_object", cal_backend_get_object_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -2139,7 +2157,7 @@ e_cal_backend_get_object_list (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_get_object_list_thread);
+		"ECalBackend.get_object_list", cal_backend_get_object_list_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -2349,7 +2367,7 @@ e_cal_backend_get_free_busy (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_get_free_busy_thread);
+		"ECalBackend.get_free_busy", cal_backend_get_free_busy_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -2562,7 +2580,7 @@ e_cal_backend_create_objects (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_create_objects_thread);
+		"ECalBackend.create_objects", cal_backend_create_objects_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -2788,7 +2806,7 @@ e_cal_backend_modify_objects (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_modify_objects_thread);
+		"ECalBackend.modify_objects", cal_backend_modify_objects_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -3015,7 +3033,7 @@ e_cal_backend_remove_objects (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_remove_objects_thread);
+		"ECalBackend.remove_objects", cal_backend_remove_objects_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -3243,7 +3261,7 @@ e_cal_backend_receive_objects (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_receive_objects_thread);
+		"ECalBackend.receive_objects", cal_backend_receive_objects_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -3420,7 +3438,7 @@ e_cal_backend_send_objects (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_send_objects_thread);
+		"ECalBackend.send_objects", cal_backend_send_objects_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -3623,7 +3641,7 @@ e_cal_backend_get_attachment_uris (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_get_attachment_uris_thread);
+		"ECalBackend.get_attachment_uris", cal_backend_get_attachment_uris_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -3831,7 +3849,7 @@ e_cal_backend_discard_alarm (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_discard_alarm_thread);
+		"ECalBackend.discard_alarm", cal_backend_discard_alarm_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -4002,7 +4020,7 @@ e_cal_backend_get_timezone (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_get_timezone_thread);
+		"ECalBackend.get_timezone", cal_backend_get_timezone_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -4188,7 +4206,7 @@ e_cal_backend_add_timezone (ECalBackend *backend,
 
 	cal_backend_push_operation (
 		backend, simple, cancellable, FALSE,
-		cal_backend_add_timezone_thread);
+		"ECalBackend.add_timezone", cal_backend_add_timezone_thread);
 
 	cal_backend_dispatch_next_operation (backend);
 
@@ -651,6 +651,8 @@ send_pending_adds (EDataCalView *view)
 	if (view->priv->adds->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataCalView.objects-added", view->priv->adds->len);
+
 	e_gdbus_cal_view_emit_objects_added (
 		view->priv->gdbus_object,
 		(const gchar * const *) view->priv->adds->data);
@@ -663,6 +665,8 @@ send_pending_changes (EDataCalView *view)
 	if (view->priv->changes->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataCalView.objects-modified", view->priv->changes->len);
+
 	e_gdbus_cal_view_emit_objects_modified (
 		view->priv->gdbus_object,
 		(const gchar * const *) view->priv->changes->data);
@@ -675,6 +679,8 @@ send_pending_removes (EDataCalView *view)
 	if (view->priv->removes->len == 0)
 		return;
 
+	e_metrics_add_sample ("EDataCalView.objects-removed", view->priv->removes->len);
+
 	/* send ECalComponentIds as <uid>[\n<rid>], as encoded in notify_remove() */
 	e_gdbus_cal_view_emit_objects_removed (
 		view->priv->gdbus_object,
@@ -108,6 +108,12 @@ on_bus_acquired (GDBusConnection *connection,
 {
 	EDBusSubprocessBackend *proxy;
 	EDBusSubprocessObjectSkeleton *object;
+	GError *error = NULL;
+
+	if (!e_metrics_export (connection, &error)) {
+		g_warning ("%s: Failed to export metrics: %s", G_STRFUNC, error->message);
+		g_clear_error (&error);
+	}
 
 	object = e_dbus_subprocess_object_skeleton_new (path);
 
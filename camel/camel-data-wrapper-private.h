@@ -0,0 +1,38 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CAMEL_DATA_WRAPPER_PRIVATE_H
+#define CAMEL_DATA_WRAPPER_PRIVATE_H
+
+#include "camel-data-wrapper.h"
+
+G_BEGIN_DECLS
+
+/* Creates a temporary file for content over CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE
+ * in the user cache directory, readable by the user only.  Returns its file
+ * descriptor and sets @out_filename, or returns -1 and sets @error. */
+gint		_camel_data_wrapper_open_temp_file
+						(gchar **out_filename,
+						 GError **error);
+
+/* Makes the file @filename, as created by _camel_data_wrapper_open_temp_file(),
+ * the content of @data_wrapper, which removes the file when it is done with it */
+void		_camel_data_wrapper_take_temp_file
+						(CamelDataWrapper *data_wrapper,
+						 gchar *filename);
+
+G_END_DECLS
+
+#endif /* CAMEL_DATA_WRAPPER_PRIVATE_H */
@@ -22,14 +22,18 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include "camel-data-wrapper.h"
+#include "camel-data-wrapper-private.h"
 #include "camel-debug.h"
 #include "camel-filter-output-stream.h"
 #include "camel-mime-filter-basic.h"
 #include "camel-mime-filter-crlf.h"
 #include "camel-stream-filter.h"
+#include "camel-stream-fs.h"
 #include "camel-stream-mem.h"
 
 #define d(x)
@@ -43,6 +47,10 @@ typedef struct _AsyncContext AsyncContext;
 struct _CamelDataWrapperPrivate {
 	GMutex stream_lock;
 	GByteArray *byte_array;
+
+	/* When set, the content is in this file, not in the byte_array;
+	 * used for content larger than CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE */
+	gchar *temp_filename;
 };
 
 struct _AsyncContext {
@@ -63,6 +71,145 @@ async_context_free (AsyncContext *async_context)
 	g_slice_free (AsyncContext, async_context);
 }
 
+/* Call with stream_lock held */
+static void
+data_wrapper_clear_content (CamelDataWrapper *data_wrapper)
+{
+	CamelDataWrapperPrivate *priv = data_wrapper->priv;
+
+	g_byte_array_set_size (priv->byte_array, 0);
+
+	if (priv->temp_filename != NULL) {
+		g_unlink (priv->temp_filename);
+		g_free (priv->temp_filename);
+		priv->temp_filename = NULL;
+	}
+}
+
+gint
+_camel_data_wrapper_open_temp_file (gchar **out_filename,
+                                    GError **error)
+{
+	gchar *dirname, *filename;
+	gint fd;
+
+	g_return_val_if_fail (out_filename != NULL, -1);
+
+	/* Not in the shared temporary directory, the content
+	 * can be a private message of the user. */
+	dirname = g_build_filename (g_get_user_cache_dir (), "camel", "tmp", NULL);
+
+	if (g_mkdir_with_parents (dirname, 0700) == -1) {
+		gint errn = errno;
+
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errn),
+			_("Cannot create directory '%s': %s"),
+			dirname, g_strerror (errn));
+		g_free (dirname);
+
+		return -1;
+	}
+
+	filename = g_build_filename (dirname, "camel-data-XXXXXX", NULL);
+	g_free (dirname);
+
+	fd = g_mkstemp_full (filename, O_RDWR, 0600);
+	if (fd == -1) {
+		gint errn = errno;
+
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errn),
+			_("Cannot create temporary file '%s': %s"),
+			filename, g_strerror (errn));
+		g_free (filename);
+
+		return -1;
+	}
+
+	*out_filename = filename;
+
+	return fd;
+}
+
+void
+_camel_data_wrapper_take_temp_file (CamelDataWrapper *data_wrapper,
+                                    gchar *filename)
+{
+	g_return_if_fail (CAMEL_IS_DATA_WRAPPER (data_wrapper));
+	g_return_if_fail (filename != NULL);
+
+	g_mutex_lock (&data_wrapper->priv->stream_lock);
+
+	data_wrapper_clear_content (data_wrapper);
+	data_wrapper->priv->temp_filename = filename;
+
+	g_mutex_unlock (&data_wrapper->priv->stream_lock);
+}
+
+/* Appends to the content, moving it into a temporary file once it grows
+ * over CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE; the *temp_stream is set then.
+ * Call with stream_lock held. */
+static gboolean
+data_wrapper_append_content (CamelDataWrapper *data_wrapper,
+                             CamelStream **temp_stream,
+                             const gchar *buffer,
+                             gsize len,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	CamelDataWrapperPrivate *priv = data_wrapper->priv;
+
+	if (*temp_stream == NULL &&
+	    priv->byte_array->len + len > CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE) {
+		gint fd;
+
+		fd = _camel_data_wrapper_open_temp_file (&priv->temp_filename, error);
+		if (fd == -1)
+			return FALSE;
+
+		*temp_stream = camel_stream_fs_new_with_fd (fd);
+
+		if (camel_stream_write (
+			*temp_stream, (const gchar *) priv->byte_array->data,
+			priv->byte_array->len, cancellable, error) < 0)
+			return FALSE;
+
+		g_byte_array_set_size (priv->byte_array, 0);
+	}
+
+	if (*temp_stream != NULL)
+		return camel_stream_write (*temp_stream, buffer, len, cancellable, error) >= 0;
+
+	g_byte_array_append (priv->byte_array, (const guint8 *) buffer, len);
+
+	return TRUE;
+}
+
+/* Finishes what data_wrapper_append_content() started.
+ * Call with stream_lock held. */
+static gboolean
+data_wrapper_finish_content (CamelDataWrapper *data_wrapper,
+                             CamelStream *temp_stream,
+                             gboolean success,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	if (temp_stream != NULL) {
+		if (success)
+			success = camel_stream_close (temp_stream, cancellable, error) == 0;
+
+		g_object_unref (temp_stream);
+	}
+
+	if (!success)
+		data_wrapper_clear_content (data_wrapper);
+
+	return success;
+}
+
 static void
 data_wrapper_dispose (GObject *object)
 {
@@ -87,6 +234,11 @@ data_wrapper_finalize (GObject *object)
 	g_mutex_clear (&priv->stream_lock);
 	g_byte_array_free (priv->byte_array, TRUE);
 
+	if (priv->temp_filename != NULL) {
+		g_unlink (priv->temp_filename);
+		g_free (priv->temp_filename);
+	}
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_data_wrapper_parent_class)->finalize (object);
 }
@@ -146,12 +298,22 @@ data_wrapper_write_to_stream_sync (CamelDataWrapper *data_wrapper,
 		return -1;
 	}
 
-	memory_stream = camel_stream_mem_new ();
+	if (data_wrapper->priv->temp_filename != NULL) {
+		memory_stream = camel_stream_fs_new_with_name (
+			data_wrapper->priv->temp_filename, O_RDONLY, 0, error);
 
-	/* We retain ownership of the byte array. */
-	camel_stream_mem_set_byte_array (
-		CAMEL_STREAM_MEM (memory_stream),
-		data_wrapper->priv->byte_array);
+		if (memory_stream == NULL) {
+			g_mutex_unlock (&data_wrapper->priv->stream_lock);
+			return -1;
+		}
+	} else {
+		memory_stream = camel_stream_mem_new ();
+
+		/* We retain ownership of the byte array. */
+		camel_stream_mem_set_byte_array (
+			CAMEL_STREAM_MEM (memory_stream),
+			data_wrapper->priv->byte_array);
+	}
 
 	ret = camel_stream_write_to_stream (
 		memory_stream, stream, cancellable, error);
@@ -210,8 +372,9 @@ data_wrapper_construct_from_stream_sync (CamelDataWrapper *data_wrapper,
                                          GCancellable *cancellable,
                                          GError **error)
 {
-	CamelStream *memory_stream;
-	gssize bytes_written;
+	CamelStream *temp_stream = NULL;
+	gchar buffer[4096];
+	gboolean success = TRUE;
 
 	g_mutex_lock (&data_wrapper->priv->stream_lock);
 
@@ -228,25 +391,31 @@ data_wrapper_construct_from_stream_sync (CamelDataWrapper *data_wrapper,
 		}
 	}
 
-	/* Wipe any previous contents from our byte array. */
-	g_byte_array_set_size (data_wrapper->priv->byte_array, 0);
+	/* Wipe any previous contents. */
+	data_wrapper_clear_content (data_wrapper);
 
-	memory_stream = camel_stream_mem_new ();
+	/* Transfer incoming contents to our byte array,
+	 * or to a temporary file when they are too large. */
+	while (success && !camel_stream_eos (stream)) {
+		gssize n_read;
 
-	/* We retain ownership of the byte array. */
-	camel_stream_mem_set_byte_array (
-		CAMEL_STREAM_MEM (memory_stream),
-		data_wrapper->priv->byte_array);
+		n_read = camel_stream_read (
+			stream, buffer, sizeof (buffer), cancellable, error);
 
-	/* Transfer incoming contents to our byte array. */
-	bytes_written = camel_stream_write_to_stream (
-		stream, memory_stream, cancellable, error);
+		if (n_read < 0)
+			success = FALSE;
+		else if (n_read > 0)
+			success = data_wrapper_append_content (
+				data_wrapper, &temp_stream,
+				buffer, n_read, cancellable, error);
+	}
 
-	g_object_unref (memory_stream);
+	success = data_wrapper_finish_content (
+		data_wrapper, temp_stream, success, cancellable, error);
 
 	g_mutex_unlock (&data_wrapper->priv->stream_lock);
 
-	return (bytes_written >= 0);
+	return success;
 }
 
 static gssize
@@ -263,11 +432,24 @@ data_wrapper_write_to_output_stream_sync (CamelDataWrapper *data_wrapper,
 
 	g_mutex_lock (&data_wrapper->priv->stream_lock);
 
-	/* We retain ownership of the byte array content. */
-	input_stream = g_memory_input_stream_new_from_data (
-		data_wrapper->priv->byte_array->data,
-		data_wrapper->priv->byte_array->len,
-		(GDestroyNotify) NULL);
+	if (data_wrapper->priv->temp_filename != NULL) {
+		GFile *file;
+
+		file = g_file_new_for_path (data_wrapper->priv->temp_filename);
+		input_stream = G_INPUT_STREAM (g_file_read (file, cancellable, error));
+		g_object_unref (file);
+
+		if (input_stream == NULL) {
+			g_mutex_unlock (&data_wrapper->priv->stream_lock);
+			return -1;
+		}
+	} else {
+		/* We retain ownership of the byte array content. */
+		input_stream = g_memory_input_stream_new_from_data (
+			data_wrapper->priv->byte_array->data,
+			data_wrapper->priv->byte_array->len,
+			(GDestroyNotify) NULL);
+	}
 
 	bytes_written = g_output_stream_splice (
 		output_stream, input_stream,
@@ -362,9 +544,9 @@ data_wrapper_construct_from_input_stream_sync (CamelDataWrapper *data_wrapper,
                                                GCancellable *cancellable,
                                                GError **error)
 {
-	GOutputStream *output_stream;
-	gssize bytes_written;
-	gboolean success;
+	CamelStream *temp_stream = NULL;
+	gchar buffer[4096];
+	gboolean success = TRUE;
 
 	/* XXX Should keep the internal data as a reference-counted
 	 *     GBytes to avoid locking while reading from the stream. */
@@ -378,35 +560,35 @@ data_wrapper_construct_from_input_stream_sync (CamelDataWrapper *data_wrapper,
 	}
 
 	if (G_IS_SEEKABLE (input_stream)) {
-		success = g_seekable_seek (
-			G_SEEKABLE (input_stream), 0,
-			G_SEEK_SET, cancellable, error);
-		if (!success) {
+		if (!g_seekable_seek (G_SEEKABLE (input_stream), 0, G_SEEK_SET, cancellable, error)) {
 			g_mutex_unlock (&data_wrapper->priv->stream_lock);
 			return FALSE;
 		}
 	}
 
-	output_stream = g_memory_output_stream_new_resizable ();
-
-	bytes_written = g_output_stream_splice (
-		output_stream, input_stream,
-		G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-		cancellable, error);
-
-	success = (bytes_written >= 0);
+	/* Wipe any previous contents. */
+	data_wrapper_clear_content (data_wrapper);
 
-	if (success) {
-		GBytes *bytes;
+	/* Transfer incoming contents to our byte array,
+	 * or to a temporary file when they are too large. */
+	while (success) {
+		gssize n_read;
 
-		bytes = g_memory_output_stream_steal_as_bytes (
-			G_MEMORY_OUTPUT_STREAM (output_stream));
+		n_read = g_input_stream_read (
+			input_stream, buffer, sizeof (buffer), cancellable, error);
 
-		g_byte_array_free (data_wrapper->priv->byte_array, TRUE);
-		data_wrapper->priv->byte_array = g_bytes_unref_to_array (bytes);
+		if (n_read < 0)
+			success = FALSE;
+		else if (n_read == 0)
+			break;
+		else
+			success = data_wrapper_append_content (
+				data_wrapper, &temp_stream,
+				buffer, n_read, cancellable, error);
 	}
 
-	g_object_unref (output_stream);
+	success = data_wrapper_finish_content (
+		data_wrapper, temp_stream, success, cancellable, error);
 
 	g_mutex_unlock (&data_wrapper->priv->stream_lock);
 
@@ -471,6 +653,10 @@ camel_data_wrapper_new (void)
  *
  * Returns the #GByteArray being used to hold the contents of @data_wrapper.
  *
+ * Content larger than %CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE is kept
+ * in a temporary file; this function reads it into memory first, thus
+ * prefer camel_data_wrapper_write_to_stream_sync() and friends.
+ *
  * Note, it's up to the caller to use this in a thread-safe manner.
  *
  * Returns: (transfer none): the #GByteArray for @data_wrapper
@@ -480,9 +666,35 @@ camel_data_wrapper_new (void)
 GByteArray *
 camel_data_wrapper_get_byte_array (CamelDataWrapper *data_wrapper)
 {
+	CamelDataWrapperPrivate *priv;
+
 	g_return_val_if_fail (CAMEL_IS_DATA_WRAPPER (data_wrapper), NULL);
 
-	return data_wrapper->priv->byte_array;
+	priv = data_wrapper->priv;
+
+	g_mutex_lock (&priv->stream_lock);
+
+	if (priv->temp_filename != NULL) {
+		gchar *contents = NULL;
+		gsize length = 0;
+		GError *local_error = NULL;
+
+		if (g_file_get_contents (priv->temp_filename, &contents, &length, &local_error)) {
+			g_byte_array_free (priv->byte_array, TRUE);
+			priv->byte_array = g_byte_array_new_take ((guint8 *) contents, length);
+		} else {
+			g_warning ("%s: Failed to read '%s': %s", G_STRFUNC, priv->temp_filename, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+
+		g_unlink (priv->temp_filename);
+		g_free (priv->temp_filename);
+		priv->temp_filename = NULL;
+	}
+
+	g_mutex_unlock (&priv->stream_lock);
+
+	return priv->byte_array;
 }
 
 /**
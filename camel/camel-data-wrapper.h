@@ -50,6 +50,16 @@
 	(G_TYPE_INSTANCE_GET_CLASS \
 	((obj), CAMEL_TYPE_DATA_WRAPPER, CamelDataWrapperClass))
 
+/**
+ * CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE:
+ *
+ * Content larger than this many bytes is kept by a #CamelDataWrapper
+ * in a temporary file, not in memory.
+ *
+ * Since: 3.20
+ **/
+#define CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE (4 * 1024 * 1024)
+
 G_BEGIN_DECLS
 
 typedef struct _CamelDataWrapper CamelDataWrapper;
@@ -34,6 +34,7 @@
 
 #include "camel-debug.h"
 #include "camel-object.h"
+#include "camel-trace.h"
 
 /* how long to wait before invoking sync on the file */
 #define SYNC_TIMEOUT_SECONDS 5
@@ -480,6 +481,11 @@ init_sqlite_vfs (void)
 			g_timer_elapsed (cdb->priv->timer, NULL)); \
 	}
 
+typedef struct _CamelDBCollation {
+	gchar *name;
+	CamelDBCollate func;
+} CamelDBCollation;
+
 struct _CamelDBPrivate {
 	GTimer *timer;
 	GRWLock rwlock;
@@ -487,8 +493,242 @@ struct _CamelDBPrivate {
 	GMutex transaction_lock;
 	GThread *transaction_thread;
 	guint32 transaction_level;
+	CamelTraceSpan transaction_span; /* of the outermost transaction */
+
+	/* Read-only connections, used by camel_db_select() and alike
+	 * when the database runs in WAL mode, so that reads do not wait
+	 * for writes done on cdb->db; see camel_db_enable_readers(). */
+	GMutex readers_lock;
+	GCond readers_cond;
+	GSList *free_readers;	/* sqlite3 * */
+	guint max_readers;
+	guint n_readers;	/* how many are open */
+	GSList *collations;	/* CamelDBCollation *, to set on new readers */
+
+	/* Full-text index of summary header columns, one per folder;
+	 * see camel_db_enable_header_index(). */
+	gboolean header_index;
+	GMutex header_index_lock;
+	GHashTable *header_index_folders; /* gchar *folder_name ~> HEADER_INDEX_... */
+
+	/* Folders known to be at CDB_FOLDER_VERSION, for the
+	 * camel_db_has_message_tags() and alike checks. */
+	GMutex folder_versions_lock;
+	GHashTable *current_folders; /* gchar *folder_name */
 };
 
+/* The version written by camel_db_prepare_message_info_table() */
+#define CDB_FOLDER_VERSION 4
+
+#define HEADER_INDEX_EXISTS  GINT_TO_POINTER (1)
+#define HEADER_INDEX_MISSING GINT_TO_POINTER (2)
+
+/* Summary columns covered by the header index, in the table column order */
+#define HEADER_INDEX_COLUMNS "subject, mail_from, mail_to, mail_cc, mlist"
+
+static void
+cdb_header_index_forget (CamelDB *cdb,
+                         const gchar *folder_name)
+{
+	g_mutex_lock (&cdb->priv->header_index_lock);
+	if (folder_name)
+		g_hash_table_remove (cdb->priv->header_index_folders, folder_name);
+	else
+		g_hash_table_remove_all (cdb->priv->header_index_folders);
+	g_mutex_unlock (&cdb->priv->header_index_lock);
+}
+
+static void
+cdb_folder_version_forget (CamelDB *cdb,
+                           const gchar *folder_name)
+{
+	g_mutex_lock (&cdb->priv->folder_versions_lock);
+	if (folder_name)
+		g_hash_table_remove (cdb->priv->current_folders, folder_name);
+	else
+		g_hash_table_remove_all (cdb->priv->current_folders);
+	g_mutex_unlock (&cdb->priv->folder_versions_lock);
+}
+
+/* The statement profiler, on when CAMEL_SQLITE_PROFILE is set;
+ * see camel_db_dump_profile(). */
+typedef struct _CDBProfileEntry {
+	guint64 count;
+	guint64 total;	/* microseconds */
+	guint64 max;	/* microseconds */
+} CDBProfileEntry;
+
+static GMutex cdb_profile_lock;
+static GHashTable *cdb_profile_table; /* gchar *shape ~> CDBProfileEntry * */
+
+/* In microseconds, 0 when the slow statements are not logged */
+static gint64 cdb_slow_query_threshold;
+static gboolean cdb_profile_enabled;
+
+static void
+cdb_profile_init (void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter (&initialized)) {
+		const gchar *env_string;
+
+		cdb_profile_enabled = g_getenv ("CAMEL_SQLITE_PROFILE") != NULL;
+
+		env_string = g_getenv ("CAMEL_SQLITE_SLOW_QUERY_MS");
+		if (env_string != NULL)
+			cdb_slow_query_threshold = g_ascii_strtoll (env_string, NULL, 10) * 1000;
+
+		g_once_init_leave (&initialized, 1);
+	}
+}
+
+/* Longer statement shapes are cut */
+#define CDB_SHAPE_MAX_LEN 200
+
+/* Appends a '?' for a literal, collapsing lists of literals into one */
+static void
+cdb_shape_append_value (GString *shape)
+{
+	if (g_str_has_suffix (shape->str, "?, "))
+		g_string_truncate (shape, shape->len - 2);
+	else if (g_str_has_suffix (shape->str, "?,"))
+		g_string_truncate (shape, shape->len - 1);
+	else
+		g_string_append_c (shape, '?');
+}
+
+/* Replaces the literals of @stmt with '?' and squeezes the white space,
+ * so that the statements which differ only in their values, or in
+ * the folder table they use, are counted together. */
+static gchar *
+cdb_statement_shape (const gchar *stmt)
+{
+	GString *shape;
+	const gchar *ptr;
+
+	shape = g_string_sized_new (CDB_SHAPE_MAX_LEN + 4);
+
+	for (ptr = stmt; *ptr && shape->len < CDB_SHAPE_MAX_LEN; ptr++) {
+		gchar prev = shape->len > 0 ? shape->str[shape->len - 1] : ' ';
+
+		if (g_ascii_isspace (*ptr)) {
+			if (prev != ' ')
+				g_string_append_c (shape, ' ');
+		} else if (*ptr == '\'') {
+			/* Skip the string literal, '' is an escaped quote */
+			for (ptr++; *ptr; ptr++) {
+				if (*ptr == '\'') {
+					if (ptr[1] != '\'')
+						break;
+					ptr++;
+				}
+			}
+
+			cdb_shape_append_value (shape);
+
+			if (!*ptr)
+				break;
+		} else if (*ptr == '?' ||
+			   (g_ascii_isdigit (*ptr) && !g_ascii_isalnum (prev) && prev != '_')) {
+			while (g_ascii_isalnum (ptr[1]) || ptr[1] == '.')
+				ptr++;
+
+			cdb_shape_append_value (shape);
+		} else {
+			g_string_append_c (shape, *ptr);
+		}
+	}
+
+	if (*ptr)
+		g_string_append (shape, "...");
+
+	return g_string_free (shape, FALSE);
+}
+
+static gint
+cdb_slow_query_plan_cb (gpointer data,
+                        gint ncol,
+                        gchar **cols,
+                        gchar **names)
+{
+	gint ii;
+
+	for (ii = 0; ii < ncol; ii++) {
+		if (g_strcmp0 (names[ii], "detail") == 0) {
+			g_message ("  PLAN: %s", cols[ii]);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Counts the time @stmt took since @start to its shape and logs it
+ * with its query plan when it was slow.  The caller holds the lock,
+ * thus @db can be used for the EXPLAIN. */
+static void
+cdb_profile_statement (sqlite3 *db,
+                       const gchar *stmt,
+                       gint64 start)
+{
+	gint64 elapsed;
+
+	if (!start)
+		return;
+
+	elapsed = MAX (g_get_monotonic_time () - start, 0);
+
+	if (cdb_profile_enabled) {
+		CDBProfileEntry *entry;
+		gchar *shape;
+
+		shape = cdb_statement_shape (stmt);
+
+		g_mutex_lock (&cdb_profile_lock);
+
+		if (!cdb_profile_table)
+			cdb_profile_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+		entry = g_hash_table_lookup (cdb_profile_table, shape);
+		if (!entry) {
+			entry = g_new0 (CDBProfileEntry, 1);
+			g_hash_table_insert (cdb_profile_table, shape, entry);
+		} else {
+			g_free (shape);
+		}
+
+		entry->count++;
+		entry->total += elapsed;
+		entry->max = MAX (entry->max, elapsed);
+
+		g_mutex_unlock (&cdb_profile_lock);
+	}
+
+	if (cdb_slow_query_threshold > 0 && elapsed >= cdb_slow_query_threshold) {
+		gchar *shape;
+
+		/* the values can be message headers, keep them out of the log */
+		shape = cdb_statement_shape (stmt);
+		g_message (
+			"CamelDB: %" G_GINT64_FORMAT " ms in '%s': %s",
+			elapsed / 1000, sqlite3_db_filename (db, "main"), shape);
+		g_free (shape);
+
+		/* Not for the pragmas and the transaction statements */
+		if (g_ascii_strncasecmp (stmt, "SELECT", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "UPDATE", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "DELETE", 6) == 0 ||
+		    g_ascii_strncasecmp (stmt, "INSERT", 6) == 0) {
+			gchar *explain;
+
+			explain = g_strconcat ("EXPLAIN QUERY PLAN ", stmt, NULL);
+			sqlite3_exec (db, explain, cdb_slow_query_plan_cb, NULL, NULL);
+			g_free (explain);
+		}
+	}
+}
+
 /**
  * cdb_sql_exec 
  * @db: 
@@ -507,9 +747,16 @@ cdb_sql_exec (sqlite3 *db,
 {
 	gchar *errmsg = NULL;
 	gint   ret = -1, retries = 0;
+	gint64 profile_start = 0;
 
 	d (g_print ("Camel SQL Exec:\n%s\n", stmt));
 
+	cdb_profile_init ();
+
+	/* Includes the time spent waiting for a locked database */
+	if (cdb_profile_enabled || cdb_slow_query_threshold > 0)
+		profile_start = g_get_monotonic_time ();
+
 	ret = sqlite3_exec (db, stmt, callback, data, &errmsg);
 	while (ret == SQLITE_BUSY || ret == SQLITE_LOCKED || ret == -1) {
 		/* try for ~15 seconds, then give up */
@@ -527,6 +774,8 @@ cdb_sql_exec (sqlite3 *db,
 		ret = sqlite3_exec (db, stmt, NULL, NULL, &errmsg);
 	}
 
+	cdb_profile_statement (db, stmt, profile_start);
+
 	if (out_sqlite_error_code)
 		*out_sqlite_error_code = ret;
 
@@ -669,6 +918,125 @@ cdb_reader_unlock (CamelDB *cdb)
 	}
 }
 
+static sqlite3 *
+cdb_open_reader (CamelDB *cdb)
+{
+	sqlite3 *db = NULL;
+	GSList *link;
+
+	if (sqlite3_open_v2 (cdb->priv->file_name, &db,
+		SQLITE_OPEN_READWRITE | SQLITE_OPEN_PRIVATECACHE, NULL) != SQLITE_OK) {
+		d (g_print ("Can't open reader for %s: %s\n", cdb->priv->file_name, db ? sqlite3_errmsg (db) : "no memory"));
+		if (db)
+			sqlite3_close (db);
+		return NULL;
+	}
+
+	sqlite3_create_function (db, "MATCH", 2, SQLITE_UTF8, NULL, cdb_match_func, NULL, NULL);
+
+	for (link = cdb->priv->collations; link; link = g_slist_next (link)) {
+		CamelDBCollation *collation = link->data;
+
+		sqlite3_create_collation (db, collation->name, SQLITE_UTF8, NULL, collation->func);
+	}
+
+	/* the same as the writer has, for statements which refer to it */
+	sqlite3_exec (db, "ATTACH DATABASE ':memory:' AS mem", NULL, NULL, NULL);
+	sqlite3_exec (db, "PRAGMA query_only = 1", NULL, NULL, NULL);
+
+	sqlite3_busy_timeout (db, CAMEL_DB_SLEEP_INTERVAL);
+
+	return db;
+}
+
+/* Returns a reader connection, or NULL, when the caller should use
+ * cdb->db under cdb_reader_lock(), which is when there are no readers
+ * or when the calling thread is in a transaction, thus it should see
+ * its own not yet committed changes. */
+static sqlite3 *
+cdb_reader_acquire (CamelDB *cdb)
+{
+	sqlite3 *db = NULL;
+	gboolean in_transaction;
+
+	g_return_val_if_fail (cdb != NULL, NULL);
+
+	if (!cdb->priv->max_readers)
+		return NULL;
+
+	g_mutex_lock (&cdb->priv->transaction_lock);
+	in_transaction = cdb->priv->transaction_thread == g_thread_self ();
+	g_mutex_unlock (&cdb->priv->transaction_lock);
+
+	if (in_transaction)
+		return NULL;
+
+	g_mutex_lock (&cdb->priv->readers_lock);
+
+	while (!cdb->priv->free_readers &&
+	       cdb->priv->n_readers >= cdb->priv->max_readers) {
+		g_cond_wait (&cdb->priv->readers_cond, &cdb->priv->readers_lock);
+	}
+
+	if (cdb->priv->free_readers) {
+		db = cdb->priv->free_readers->data;
+		cdb->priv->free_readers = g_slist_remove (cdb->priv->free_readers, db);
+	} else {
+		db = cdb_open_reader (cdb);
+		if (db)
+			cdb->priv->n_readers++;
+	}
+
+	g_mutex_unlock (&cdb->priv->readers_lock);
+
+	return db;
+}
+
+static void
+cdb_reader_release (CamelDB *cdb,
+                    sqlite3 *db)
+{
+	g_return_if_fail (cdb != NULL);
+	g_return_if_fail (db != NULL);
+
+	g_mutex_lock (&cdb->priv->readers_lock);
+	cdb->priv->free_readers = g_slist_prepend (cdb->priv->free_readers, db);
+	g_cond_signal (&cdb->priv->readers_cond);
+	g_mutex_unlock (&cdb->priv->readers_lock);
+}
+
+/* Runs a read-only statement, on a reader connection when possible. */
+static gint
+cdb_sql_exec_read (CamelDB *cdb,
+                   const gchar *stmt,
+                   gint (*callback)(gpointer ,gint,gchar **,gchar **),
+                   gpointer data,
+                   GError **error)
+{
+	sqlite3 *reader;
+	gint ret;
+
+	reader = cdb_reader_acquire (cdb);
+
+	if (reader) {
+		START (stmt);
+		ret = cdb_sql_exec (reader, stmt, callback, data, NULL, error);
+		END;
+
+		cdb_reader_release (cdb, reader);
+	} else {
+		cdb_reader_lock (cdb);
+
+		START (stmt);
+		ret = cdb_sql_exec (cdb->db, stmt, callback, data, NULL, error);
+		END;
+
+		cdb_reader_unlock (cdb);
+	}
+
+	return ret;
+}
+
 static gboolean
 cdb_is_in_transaction (CamelDB *cdb)
 {
@@ -767,6 +1135,12 @@ camel_db_open (const gchar *path,
 	cdb->priv->file_name = g_strdup (path);
 	g_rw_lock_init (&cdb->priv->rwlock);
 	g_mutex_init (&cdb->priv->transaction_lock);
+	g_mutex_init (&cdb->priv->readers_lock);
+	g_cond_init (&cdb->priv->readers_cond);
+	g_mutex_init (&cdb->priv->header_index_lock);
+	cdb->priv->header_index_folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init (&cdb->priv->folder_versions_lock);
+	cdb->priv->current_folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	cdb->priv->transaction_thread = NULL;
 	cdb->priv->transaction_level = 0;
 	cdb->priv->timer = NULL;
@@ -854,6 +1228,133 @@ camel_db_clone (CamelDB *cdb,
 	return camel_db_open (cdb->priv->file_name, error);
 }
 
+static void
+cdb_collation_free (gpointer ptr)
+{
+	CamelDBCollation *collation = ptr;
+
+	if (collation) {
+		g_free (collation->name);
+		g_free (collation);
+	}
+}
+
+/* Remembers the collation for new readers and sets it on the open ones. */
+static void
+cdb_set_reader_collation (CamelDB *cdb,
+                          const gchar *name,
+                          CamelDBCollate func)
+{
+	CamelDBCollation *collation = NULL;
+	GSList *link;
+
+	g_mutex_lock (&cdb->priv->readers_lock);
+
+	for (link = cdb->priv->collations; link; link = g_slist_next (link)) {
+		collation = link->data;
+
+		if (g_strcmp0 (collation->name, name) == 0)
+			break;
+
+		collation = NULL;
+	}
+
+	if (!collation) {
+		collation = g_new0 (CamelDBCollation, 1);
+		collation->name = g_strdup (name);
+		cdb->priv->collations = g_slist_prepend (cdb->priv->collations, collation);
+	}
+
+	collation->func = func;
+
+	/* readers currently in use get it when the application sets
+	 * collations before searching, which is the case in practice */
+	for (link = cdb->priv->free_readers; link; link = g_slist_next (link)) {
+		sqlite3_create_collation (link->data, name, SQLITE_UTF8, NULL, func);
+	}
+
+	g_mutex_unlock (&cdb->priv->readers_lock);
+}
+
+static gint
+cdb_journal_mode_cb (gpointer user_data,
+                     gint ncol,
+                     gchar **cols,
+                     gchar **names)
+{
+	gchar **pjournal_mode = user_data;
+
+	if (ncol > 0 && cols[0] && !*pjournal_mode)
+		*pjournal_mode = g_strdup (cols[0]);
+
+	return 0;
+}
+
+/**
+ * camel_db_enable_readers:
+ * @cdb: a #CamelDB
+ * @max_readers: the most read-only connections to open
+ * @error: return location for a #GError, or %NULL
+ *
+ * Switches @cdb to the write-ahead log journal mode and lets it open up
+ * to @max_readers additional read-only connections to the same file, on
+ * demand.  camel_db_select() and camel_db_count_message_info() use them,
+ * thus reads are not blocked by a long transaction of another thread.
+ * Writes stay on the single writer connection.  Reads done by a thread
+ * inside its own transaction keep using the writer connection, to see
+ * the changes not committed yet.  When SQLite cannot switch the database
+ * to the write-ahead log, the readers stay disabled.
+ *
+ * The environment variable CAMEL_SQLITE_READERS overrides @max_readers;
+ * zero disables the readers.  They are also not used with
+ * CAMEL_SQLITE_IN_MEMORY, which turns the journal off.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
+ **/
+gint
+camel_db_enable_readers (CamelDB *cdb,
+                         guint max_readers,
+                         GError **error)
+{
+	gchar *journal_mode = NULL;
+	gint ret;
+
+	if (!cdb)
+		return -1;
+
+	if (g_getenv ("CAMEL_SQLITE_READERS") != NULL)
+		max_readers = strtoul (g_getenv ("CAMEL_SQLITE_READERS"), NULL, 10);
+
+	if (!max_readers || g_getenv ("CAMEL_SQLITE_IN_MEMORY") != NULL)
+		return 0;
+
+	cdb_writer_lock (cdb);
+	ret = cdb_sql_exec (cdb->db, "PRAGMA main.journal_mode = WAL", cdb_journal_mode_cb, &journal_mode, NULL, error);
+	cdb_writer_unlock (cdb);
+
+	if (ret != 0) {
+		g_free (journal_mode);
+		return ret;
+	}
+
+	/* SQLite keeps the old mode when it cannot switch, like for
+	 * databases in memory or on file systems without shared memory;
+	 * readers would not see the writer's changes without the log */
+	if (g_ascii_strcasecmp (journal_mode ? journal_mode : "", "wal") == 0) {
+		g_mutex_lock (&cdb->priv->readers_lock);
+		cdb->priv->max_readers = max_readers;
+		g_mutex_unlock (&cdb->priv->readers_lock);
+	} else {
+		d (g_print ("%s: journal mode is '%s', readers not enabled\n", G_STRFUNC, journal_mode ? journal_mode : ""));
+	}
+
+	g_free (journal_mode);
+
+	return 0;
+}
+
 /**
  * camel_db_close:
  *
@@ -863,9 +1364,21 @@ void
 camel_db_close (CamelDB *cdb)
 {
 	if (cdb) {
+		/* close readers first, the last connection to close
+		 * checkpoints the write-ahead log */
+		g_warn_if_fail (g_slist_length (cdb->priv->free_readers) == cdb->priv->n_readers);
+		g_slist_free_full (cdb->priv->free_readers, (GDestroyNotify) sqlite3_close);
+		g_slist_free_full (cdb->priv->collations, cdb_collation_free);
+
 		sqlite3_close (cdb->db);
 		g_rw_lock_clear (&cdb->priv->rwlock);
 		g_mutex_clear (&cdb->priv->transaction_lock);
+		g_mutex_clear (&cdb->priv->readers_lock);
+		g_cond_clear (&cdb->priv->readers_cond);
+		g_mutex_clear (&cdb->priv->header_index_lock);
+		g_hash_table_destroy (cdb->priv->header_index_folders);
+		g_mutex_clear (&cdb->priv->folder_versions_lock);
+		g_hash_table_destroy (cdb->priv->current_folders);
 		g_free (cdb->priv->file_name);
 		g_free (cdb->priv);
 		g_free (cdb);
@@ -892,8 +1405,10 @@ camel_db_set_collate (CamelDB *cdb,
 
 		cdb_writer_lock (cdb);
 		d (g_print ("Creating Collation %s on %s with %p\n", collate, col, (gpointer) func));
-		if (collate && func)
+		if (collate && func) {
 			ret = sqlite3_create_collation (cdb->db, collate, SQLITE_UTF8,  NULL, func);
+			cdb_set_reader_collation (cdb, collate, func);
+		}
 		cdb_writer_unlock (cdb);
 
 		return ret;
@@ -921,14 +1436,24 @@ gint
 camel_db_begin_transaction (CamelDB *cdb,
                             GError **error)
 {
+	CamelTraceSpan span;
 	gchar *stmt;
 	gint res;
 
 	if (!cdb)
 		return -1;
 
+	/* Begun before locking, to see also the wait for other writers */
+	camel_trace_span_begin (&span, "db", "transaction", cdb->priv->file_name);
+
 	cdb_writer_lock (cdb);
 
+	/* This thread holds the writer lock, thus can read the level */
+	if (cdb->priv->transaction_level == 1)
+		cdb->priv->transaction_span = span;
+	else
+		camel_trace_span_clear (&span);
+
 	stmt = cdb_construct_transaction_stmt (cdb, "SAVEPOINT ");
 
 	STARTTS (stmt);
@@ -958,6 +1483,8 @@ camel_db_end_transaction (CamelDB *cdb,
 	g_free (stmt);
 
 	ENDTS;
+	if (cdb->priv->transaction_level == 1)
+		camel_trace_span_end (&cdb->priv->transaction_span, -1, error ? *error : NULL);
 	cdb_writer_unlock (cdb);
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 
@@ -980,6 +1507,14 @@ camel_db_abort_transaction (CamelDB *cdb,
 	ret = cdb_sql_exec (cdb->db, stmt, NULL, NULL, NULL, error);
 	g_free (stmt);
 
+	if (cdb->priv->transaction_level == 1)
+		camel_trace_span_end (&cdb->priv->transaction_span, -1, error ? *error : NULL);
+
+	/* the transaction could create, drop or rename header indexes
+	 * and folder tables */
+	cdb_header_index_forget (cdb, NULL);
+	cdb_folder_version_forget (cdb, NULL);
+
 	cdb_writer_unlock (cdb);
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 
@@ -1076,13 +1611,7 @@ camel_db_count_message_info (CamelDB *cdb,
 {
 	gint ret = -1;
 
-	cdb_reader_lock (cdb);
-
-	START (query);
-	ret = cdb_sql_exec (cdb->db, query, count_cb, count, NULL, error);
-	END;
-
-	cdb_reader_unlock (cdb);
+	ret = cdb_sql_exec_read (cdb, query, count_cb, count, error);
 
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 
@@ -1284,13 +1813,9 @@ camel_db_select (CamelDB *cdb,
 		return ret;
 
 	d (g_print ("\n%s:\n%s \n", G_STRFUNC, stmt));
-	cdb_reader_lock (cdb);
 
-	START (stmt);
-	ret = cdb_sql_exec (cdb->db, stmt, callback, user_data, NULL, error);
-	END;
+	ret = cdb_sql_exec_read (cdb, stmt, callback, user_data, error);
 
-	cdb_reader_unlock (cdb);
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 
 	return ret;
@@ -1452,66 +1977,823 @@ read_preview_callback (gpointer ref,
 		}
 	}
 
-	g_hash_table_insert (rpd->hash, (gchar *) uid, msg);
+	g_hash_table_insert (rpd->hash, (gchar *) uid, msg);
+
+	return 0;
+}
+
+/**
+ * camel_db_get_folder_preview:
+ *
+ * Returns: (element-type utf8 utf8) (transfer full):
+ *
+ * Since: 2.28
+ **/
+GHashTable *
+camel_db_get_folder_preview (CamelDB *db,
+                             const gchar *folder_name,
+                             GError **error)
+{
+	gchar *sel_query;
+	gint ret;
+	struct ReadPreviewData rpd;
+	GHashTable *hash = g_hash_table_new (g_str_hash, g_str_equal);
+
+	sel_query = sqlite3_mprintf ("SELECT uid, preview FROM '%q_preview'", folder_name);
+
+	rpd.columns_hash = NULL;
+	rpd.hash = hash;
+
+	ret = camel_db_select (db, sel_query, read_preview_callback, &rpd, error);
+	sqlite3_free (sel_query);
+
+	if (rpd.columns_hash)
+		g_hash_table_destroy (rpd.columns_hash);
+
+	if (!g_hash_table_size (hash) || ret != 0) {
+		g_hash_table_destroy (hash);
+		hash = NULL;
+	}
+
+	return hash;
+}
+
+/**
+ * camel_db_write_preview_record:
+ *
+ * Since: 2.28
+ **/
+gint
+camel_db_write_preview_record (CamelDB *db,
+                               const gchar *folder_name,
+                               const gchar *uid,
+                               const gchar *msg,
+                               GError **error)
+{
+	gchar *query;
+	gint ret;
+
+	query = sqlite3_mprintf ("INSERT OR REPLACE INTO '%q_preview' VALUES(%Q,%Q)", folder_name, uid, msg);
+
+	ret = camel_db_add_to_transaction (db, query, error);
+	sqlite3_free (query);
+
+	return ret;
+}
+
+/* Reads one "<length>-<string>" item of the usertags column,
+ * the same encoding bdata_extract_string() understands. */
+static gchar *
+cdb_usertags_extract_string (const gchar **pstr)
+{
+	const gchar *str = *pstr;
+	gchar *endptr = NULL;
+	gsize len, avail;
+
+	while (*str == ' ')
+		str++;
+
+	len = strtoul (str, &endptr, 10);
+	if (!endptr || endptr == str || *endptr != '-')
+		return NULL;
+
+	str = endptr + 1;
+	avail = strlen (str);
+	if (len > avail)
+		len = avail;
+
+	*pstr = str + len;
+
+	return g_strndup (str, len);
+}
+
+/* Must be called inside a transaction.  Deletes label and user tag rows
+ * of one message, or of the whole folder when @uid is %NULL. */
+static gint
+cdb_delete_message_tags (CamelDB *cdb,
+                         const gchar *folder_name,
+                         const gchar *uid,
+                         GError **error)
+{
+	gchar *cmd;
+	gint ret;
+
+	if (uid)
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q AND uid = %Q", CAMEL_DB_LABELS_TABLE, folder_name, uid);
+	else
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q", CAMEL_DB_LABELS_TABLE, folder_name);
+	ret = camel_db_add_to_transaction (cdb, cmd, error);
+	sqlite3_free (cmd);
+
+	if (ret != 0)
+		return ret;
+
+	if (uid)
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q AND uid = %Q", CAMEL_DB_USERTAGS_TABLE, folder_name, uid);
+	else
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q", CAMEL_DB_USERTAGS_TABLE, folder_name);
+	ret = camel_db_add_to_transaction (cdb, cmd, error);
+	sqlite3_free (cmd);
+
+	return ret;
+}
+
+/* Must be called inside a transaction.  Writes label rows of one message
+ * from the encoded @labels column, replacing its old rows with @replace. */
+static gint
+cdb_write_message_labels (CamelDB *cdb,
+                          const gchar *folder_name,
+                          const gchar *uid,
+                          const gchar *labels,
+                          gboolean replace,
+                          GError **error)
+{
+	gchar *cmd;
+	gint ret = 0;
+
+	if (replace) {
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q AND uid = %Q", CAMEL_DB_LABELS_TABLE, folder_name, uid);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	if (ret == 0 && labels && *labels) {
+		gchar **strv;
+		gint ii;
+
+		strv = g_strsplit (labels, " ", -1);
+		for (ii = 0; ret == 0 && strv[ii]; ii++) {
+			if (!*strv[ii])
+				continue;
+
+			cmd = sqlite3_mprintf (
+				"INSERT OR REPLACE INTO %s (folder_name, uid, label) VALUES (%Q, %Q, %Q)",
+				CAMEL_DB_LABELS_TABLE, folder_name, uid, strv[ii]);
+			ret = camel_db_add_to_transaction (cdb, cmd, error);
+			sqlite3_free (cmd);
+		}
+		g_strfreev (strv);
+	}
+
+	return ret;
+}
+
+/* Must be called inside a transaction.  Writes user tag rows of one message
+ * from the encoded @usertags column, replacing its old rows with @replace. */
+static gint
+cdb_write_message_usertags (CamelDB *cdb,
+                            const gchar *folder_name,
+                            const gchar *uid,
+                            const gchar *usertags,
+                            gboolean replace,
+                            GError **error)
+{
+	gchar *cmd;
+	gint ret = 0;
+
+	if (replace) {
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q AND uid = %Q", CAMEL_DB_USERTAGS_TABLE, folder_name, uid);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	if (ret == 0 && usertags && *usertags) {
+		const gchar *part = usertags;
+		gint count;
+
+		count = strtoul (part, (gchar **) &part, 10);
+		while (ret == 0 && count > 0) {
+			gchar *name, *value;
+
+			name = cdb_usertags_extract_string (&part);
+			value = name ? cdb_usertags_extract_string (&part) : NULL;
+
+			if (!name || !value) {
+				g_free (name);
+				break;
+			}
+
+			if (*name) {
+				cmd = sqlite3_mprintf (
+					"INSERT OR REPLACE INTO %s (folder_name, uid, name, value) VALUES (%Q, %Q, %Q, %Q)",
+					CAMEL_DB_USERTAGS_TABLE, folder_name, uid, name, value);
+				ret = camel_db_add_to_transaction (cdb, cmd, error);
+				sqlite3_free (cmd);
+			}
+
+			g_free (name);
+			g_free (value);
+			count--;
+		}
+	}
+
+	return ret;
+}
+
+typedef struct _MessageTagsData {
+	gchar *uid;
+	gchar *labels;
+	gchar *usertags;
+} MessageTagsData;
+
+static void
+message_tags_data_free (gpointer ptr)
+{
+	MessageTagsData *mtd = ptr;
+
+	if (mtd) {
+		g_free (mtd->uid);
+		g_free (mtd->labels);
+		g_free (mtd->usertags);
+		g_free (mtd);
+	}
+}
+
+static gint
+read_message_tags_callback (gpointer ref,
+                            gint ncol,
+                            gchar **cols,
+                            gchar **name)
+{
+	GPtrArray *array = ref;
+	MessageTagsData *mtd;
+
+	g_return_val_if_fail (ncol == 3, 0);
+
+	if (!cols[0])
+		return 0;
+
+	mtd = g_new0 (MessageTagsData, 1);
+	mtd->uid = g_strdup (cols[0]);
+	mtd->labels = g_strdup (cols[1]);
+	mtd->usertags = g_strdup (cols[2]);
+
+	g_ptr_array_add (array, mtd);
+
+	return 0;
+}
+
+/* Must be called inside a transaction.  Fills label and user tag tables
+ * from the existing content of the folder's message info table. */
+static gint
+cdb_rebuild_message_tags (CamelDB *cdb,
+                          const gchar *folder_name,
+                          GError **error)
+{
+	GPtrArray *array;
+	gchar *query;
+	gint ret;
+	guint ii;
+
+	ret = cdb_delete_message_tags (cdb, folder_name, NULL, error);
+	if (ret != 0)
+		return ret;
+
+	array = g_ptr_array_new_with_free_func (message_tags_data_free);
+
+	query = sqlite3_mprintf (
+		"SELECT uid, labels, usertags FROM %Q "
+		"WHERE (labels IS NOT NULL AND labels <> '') OR "
+		"(usertags IS NOT NULL AND usertags <> '0')",
+		folder_name);
+	ret = camel_db_select (cdb, query, read_message_tags_callback, array, error);
+	sqlite3_free (query);
+
+	for (ii = 0; ret == 0 && ii < array->len; ii++) {
+		MessageTagsData *mtd = g_ptr_array_index (array, ii);
+
+		/* the rows of the whole folder were deleted above */
+		ret = cdb_write_message_labels (cdb, folder_name, mtd->uid, mtd->labels, FALSE, error);
+		if (ret == 0)
+			ret = cdb_write_message_usertags (cdb, folder_name, mtd->uid, mtd->usertags, FALSE, error);
+	}
+
+	g_ptr_array_unref (array);
+
+	return ret;
+}
+
+/* The same value as the id.id member of a CamelSummaryMessageID,
+ * whose two halves are stored in the 'part' column. */
+static gint64
+cdb_message_id_from_parts (guint32 hi,
+                           guint32 lo)
+{
+	union {
+		guint64 id;
+		struct {
+			guint32 hi;
+			guint32 lo;
+		} part;
+	} mid;
+
+	mid.part.hi = hi;
+	mid.part.lo = lo;
+
+	return (gint64) mid.id;
+}
+
+/* Must be called inside a transaction.  Deletes Message-ID and
+ * References rows of one message, or of the whole folder when
+ * @uid is %NULL. */
+static gint
+cdb_delete_message_ids (CamelDB *cdb,
+                        const gchar *folder_name,
+                        const gchar *uid,
+                        GError **error)
+{
+	gchar *cmd;
+	gint ret;
+
+	if (uid)
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q AND uid = %Q", CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uid);
+	else
+		cmd = sqlite3_mprintf ("DELETE FROM %s WHERE folder_name = %Q", CAMEL_DB_MESSAGE_IDS_TABLE, folder_name);
+	ret = camel_db_add_to_transaction (cdb, cmd, error);
+	sqlite3_free (cmd);
+
+	return ret;
+}
+
+/* Must be called inside a transaction.  Writes Message-ID and References
+ * rows of one message from the encoded @part column, which is
+ * "<hi> <lo> <count>" followed by @count "<hi> <lo>" pairs,
+ * replacing its old rows with @replace. */
+static gint
+cdb_write_message_ids (CamelDB *cdb,
+                       const gchar *folder_name,
+                       const gchar *uid,
+                       const gchar *part,
+                       gboolean replace,
+                       GError **error)
+{
+	gchar *cmd, *endptr = NULL;
+	guint32 hi, lo;
+	gint ret = 0, count, ii;
+
+	if (replace)
+		ret = cdb_delete_message_ids (cdb, folder_name, uid, error);
+	if (ret != 0 || !part || !*part)
+		return ret;
+
+	hi = strtoul (part, &endptr, 10);
+	lo = strtoul (endptr, &endptr, 10);
+	count = strtoul (endptr, &endptr, 10);
+
+	/* messages without a Message-ID have a zero hash */
+	if (hi || lo) {
+		cmd = sqlite3_mprintf (
+			"INSERT OR REPLACE INTO %s (folder_name, uid, ref_index, msgid) VALUES (%Q, %Q, 0, %lld)",
+			CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uid, cdb_message_id_from_parts (hi, lo));
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	for (ii = 1; ret == 0 && ii <= count && endptr && *endptr; ii++) {
+		hi = strtoul (endptr, &endptr, 10);
+		lo = strtoul (endptr, &endptr, 10);
+
+		cmd = sqlite3_mprintf (
+			"INSERT OR REPLACE INTO %s (folder_name, uid, ref_index, msgid) VALUES (%Q, %Q, %d, %lld)",
+			CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uid, ii, cdb_message_id_from_parts (hi, lo));
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	return ret;
+}
+
+typedef struct _MessagePartData {
+	gchar *uid;
+	gchar *part;
+} MessagePartData;
+
+static void
+message_part_data_free (gpointer ptr)
+{
+	MessagePartData *mpd = ptr;
+
+	if (mpd) {
+		g_free (mpd->uid);
+		g_free (mpd->part);
+		g_free (mpd);
+	}
+}
+
+static gint
+read_message_part_callback (gpointer ref,
+                            gint ncol,
+                            gchar **cols,
+                            gchar **name)
+{
+	GPtrArray *array = ref;
+	MessagePartData *mpd;
+
+	g_return_val_if_fail (ncol == 2, 0);
+
+	if (!cols[0])
+		return 0;
+
+	mpd = g_new0 (MessagePartData, 1);
+	mpd->uid = g_strdup (cols[0]);
+	mpd->part = g_strdup (cols[1]);
+
+	g_ptr_array_add (array, mpd);
+
+	return 0;
+}
+
+/* Must be called inside a transaction.  Fills the Message-ID table
+ * from the existing content of the folder's message info table. */
+static gint
+cdb_rebuild_message_ids (CamelDB *cdb,
+                         const gchar *folder_name,
+                         GError **error)
+{
+	GPtrArray *array;
+	gchar *query;
+	gint ret;
+	guint ii;
+
+	ret = cdb_delete_message_ids (cdb, folder_name, NULL, error);
+	if (ret != 0)
+		return ret;
+
+	array = g_ptr_array_new_with_free_func (message_part_data_free);
+
+	query = sqlite3_mprintf (
+		"SELECT uid, part FROM %Q WHERE part IS NOT NULL AND part <> '0 0 0'",
+		folder_name);
+	ret = camel_db_select (cdb, query, read_message_part_callback, array, error);
+	sqlite3_free (query);
+
+	for (ii = 0; ret == 0 && ii < array->len; ii++) {
+		MessagePartData *mpd = g_ptr_array_index (array, ii);
+
+		ret = cdb_write_message_ids (cdb, folder_name, mpd->uid, mpd->part, FALSE, error);
+	}
+
+	g_ptr_array_unref (array);
+
+	return ret;
+}
+
+/**
+ * camel_db_enable_header_index:
+ * @cdb: a #CamelDB
+ * @error: return location for a #GError, or %NULL
+ *
+ * Lets camel_db_build_header_index() create a full-text index over
+ * the subject, from, to, cc and mailing list summary columns of a folder,
+ * which is then kept up to date with the message info records.  Folder
+ * searches use it for word and prefix matches on these headers, see
+ * camel_db_has_header_index().
+ *
+ * Nothing is done when the SQLite library does not provide the FTS4
+ * module, or when the environment variable CAMEL_SQLITE_HEADER_INDEX
+ * is set to zero.  Indexes created earlier are maintained regardless.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
+ **/
+gint
+camel_db_enable_header_index (CamelDB *cdb,
+                              GError **error)
+{
+	gint ret;
+
+	if (!cdb)
+		return -1;
+
+	if (cdb->priv->header_index)
+		return 0;
+
+	if (g_getenv ("CAMEL_SQLITE_HEADER_INDEX") != NULL &&
+	    strtoul (g_getenv ("CAMEL_SQLITE_HEADER_INDEX"), NULL, 10) == 0)
+		return 0;
+
+	/* probe for the module and the tokenizer */
+	ret = camel_db_command (cdb, "CREATE VIRTUAL TABLE temp.cdb_fts_probe USING fts4 (x, tokenize=unicode61)", NULL);
+	if (ret != 0) {
+		d (g_print ("FTS4 not available, header index disabled\n"));
+		return 0;
+	}
+
+	ret = camel_db_command (cdb, "DROP TABLE temp.cdb_fts_probe", error);
+	if (ret == 0)
+		cdb->priv->header_index = TRUE;
+
+	return ret;
+}
+
+static gboolean
+cdb_header_index_exists (CamelDB *cdb,
+                         const gchar *folder_name)
+{
+	gpointer state;
+	gchar *query;
+	guint32 count = 0;
+
+	g_mutex_lock (&cdb->priv->header_index_lock);
+	state = g_hash_table_lookup (cdb->priv->header_index_folders, folder_name);
+	g_mutex_unlock (&cdb->priv->header_index_lock);
+
+	if (state)
+		return state == HEADER_INDEX_EXISTS;
+
+	query = sqlite3_mprintf (
+		"SELECT COUNT (*) FROM sqlite_master WHERE type = 'table' AND name = '%q_fts'",
+		folder_name);
+
+	/* Probed on the writer connection under the writer lock, thus it waits
+	 * for a transaction which creates, drops or renames the index, instead
+	 * of reading the state before it and caching that past its commit */
+	cdb_writer_lock (cdb);
+
+	START (query);
+	if (cdb_sql_exec (cdb->db, query, count_cb, &count, NULL, NULL) != SQLITE_OK)
+		count = 0;
+	END;
+
+	g_mutex_lock (&cdb->priv->header_index_lock);
+	g_hash_table_insert (
+		cdb->priv->header_index_folders, g_strdup (folder_name),
+		count > 0 ? HEADER_INDEX_EXISTS : HEADER_INDEX_MISSING);
+	g_mutex_unlock (&cdb->priv->header_index_lock);
+
+	cdb_writer_unlock (cdb);
+
+	sqlite3_free (query);
+
+	return count > 0;
+}
+
+/* Must be called inside a transaction */
+static gint
+cdb_create_header_index (CamelDB *cdb,
+                         const gchar *folder_name,
+                         GError **error)
+{
+	gchar *cmd;
+	gint ret;
+
+	cmd = sqlite3_mprintf (
+		"CREATE VIRTUAL TABLE IF NOT EXISTS '%q_fts' USING fts4 ("
+		HEADER_INDEX_COLUMNS ", tokenize=unicode61)",
+		folder_name);
+	ret = camel_db_add_to_transaction (cdb, cmd, error);
+	sqlite3_free (cmd);
+
+	/* the index rows share the rowid of the message info row */
+	if (ret == 0) {
+		cmd = sqlite3_mprintf (
+			"INSERT INTO '%q_fts' (docid, " HEADER_INDEX_COLUMNS ") "
+			"SELECT rowid, " HEADER_INDEX_COLUMNS " FROM %Q",
+			folder_name, folder_name);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	cdb_header_index_forget (cdb, folder_name);
+
+	return ret;
+}
+
+/**
+ * camel_db_build_header_index:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of a folder
+ * @error: return location for a #GError, or %NULL
+ *
+ * Creates and fills the full-text index of the summary header columns
+ * of the folder @folder_name, in its own transaction.  Nothing is done
+ * when the index was not enabled with camel_db_enable_header_index(),
+ * or when the folder has the index already.
+ *
+ * This can take a while with a large folder, thus it is better called
+ * from a dedicated thread, like from a camel_session_submit_job().
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
+ **/
+gint
+camel_db_build_header_index (CamelDB *cdb,
+                             const gchar *folder_name,
+                             GError **error)
+{
+	gint ret;
+
+	g_return_val_if_fail (cdb != NULL, -1);
+	g_return_val_if_fail (folder_name != NULL, -1);
+
+	if (!cdb->priv->header_index || cdb_header_index_exists (cdb, folder_name))
+		return 0;
+
+	ret = camel_db_begin_transaction (cdb, error);
+	if (ret != 0) {
+		camel_db_abort_transaction (cdb, NULL);
+		return ret;
+	}
+
+	/* checked again, now that no other writer can create it */
+	if (!cdb_header_index_exists (cdb, folder_name)) {
+		gchar *query;
+		guint32 count = 0;
+
+		/* the folder may have no summary table, or not yet */
+		query = sqlite3_mprintf (
+			"SELECT COUNT (*) FROM sqlite_master WHERE type = 'table' AND name = %Q",
+			folder_name);
+		ret = cdb_sql_exec (cdb->db, query, count_cb, &count, NULL, error);
+		sqlite3_free (query);
+
+		if (ret == 0 && count > 0)
+			ret = cdb_create_header_index (cdb, folder_name, error);
+	}
+
+	if (ret == 0)
+		ret = camel_db_end_transaction (cdb, error);
+	else
+		camel_db_abort_transaction (cdb, NULL);
+
+	return ret;
+}
+
+/**
+ * camel_db_has_header_index:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of a folder
+ *
+ * Checks whether the folder @folder_name has a full-text index of its
+ * summary header columns.  It is an FTS4 table named after the folder,
+ * with a "_fts" suffix, with columns subject, mail_from, mail_to, mail_cc
+ * and mlist, whose docid matches the rowid of the message info row.
+ *
+ * Returns: whether the header index exists
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_db_has_header_index (CamelDB *cdb,
+                           const gchar *folder_name)
+{
+	g_return_val_if_fail (cdb != NULL, FALSE);
+	g_return_val_if_fail (folder_name != NULL, FALSE);
+
+	return cdb_header_index_exists (cdb, folder_name);
+}
+
+/**
+ * camel_db_find_message_id:
+ * @cdb: a #CamelDB
+ * @message_id: a Message-ID hash, the id.id member of a #CamelSummaryMessageID
+ * @with_referencing: whether to include messages referencing @message_id
+ * @callback: (scope call): a callback called for each found message
+ * @user_data: user data for the @callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Looks up messages of all folders whose Message-ID hashes to @message_id,
+ * using an index instead of loading folder summaries.  With @with_referencing
+ * also messages which have the @message_id in their References or
+ * In-Reply-To headers are returned, thus the replies in its thread.
+ *
+ * The @callback receives three columns: folder_name, uid and ref_index,
+ * where ref_index is zero for the message with the @message_id and
+ * the position in the References of the message otherwise.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
+ **/
+gint
+camel_db_find_message_id (CamelDB *cdb,
+                          guint64 message_id,
+                          gboolean with_referencing,
+                          CamelDBSelectCB callback,
+                          gpointer user_data,
+                          GError **error)
+{
+	gchar *query;
+	gint ret;
+
+	g_return_val_if_fail (cdb != NULL, -1);
+	g_return_val_if_fail (callback != NULL, -1);
 
-	return 0;
+	query = sqlite3_mprintf (
+		"SELECT folder_name, uid, ref_index FROM %s WHERE msgid = %lld%s",
+		CAMEL_DB_MESSAGE_IDS_TABLE, (gint64) message_id,
+		with_referencing ? "" : " AND ref_index = 0");
+	ret = camel_db_select (cdb, query, callback, user_data, error);
+	sqlite3_free (query);
+
+	return ret;
 }
 
 /**
- * camel_db_get_folder_preview:
+ * camel_db_find_related_messages:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of the folder of the message
+ * @uid: UID of the message
+ * @callback: (scope call): a callback called for each found message
+ * @user_data: user data for the @callback
+ * @error: return location for a #GError, or %NULL
  *
- * Returns: (element-type utf8 utf8) (transfer full):
+ * Looks up messages of all folders related to the message @uid of
+ * the folder @folder_name, which are those with the same Message-ID,
+ * those referencing it and those it references, like the messages
+ * of the same conversation in an Inbox and a Sent folder.  Siblings,
+ * replies to the same message which are not replies to each other,
+ * are not included.  The message itself is not included either.
  *
- * Since: 2.28
+ * The @callback receives two columns: folder_name and uid.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
  **/
-GHashTable *
-camel_db_get_folder_preview (CamelDB *db,
-                             const gchar *folder_name,
-                             GError **error)
+gint
+camel_db_find_related_messages (CamelDB *cdb,
+                                const gchar *folder_name,
+                                const gchar *uid,
+                                CamelDBSelectCB callback,
+                                gpointer user_data,
+                                GError **error)
 {
-	gchar *sel_query;
+	gchar *query;
 	gint ret;
-	struct ReadPreviewData rpd;
-	GHashTable *hash = g_hash_table_new (g_str_hash, g_str_equal);
-
-	sel_query = sqlite3_mprintf ("SELECT uid, preview FROM '%q_preview'", folder_name);
-
-	rpd.columns_hash = NULL;
-	rpd.hash = hash;
 
-	ret = camel_db_select (db, sel_query, read_preview_callback, &rpd, error);
-	sqlite3_free (sel_query);
-
-	if (rpd.columns_hash)
-		g_hash_table_destroy (rpd.columns_hash);
+	g_return_val_if_fail (cdb != NULL, -1);
+	g_return_val_if_fail (folder_name != NULL, -1);
+	g_return_val_if_fail (uid != NULL, -1);
+	g_return_val_if_fail (callback != NULL, -1);
 
-	if (!g_hash_table_size (hash) || ret != 0) {
-		g_hash_table_destroy (hash);
-		hash = NULL;
-	}
+	/* the message's own ID, used as a Message-ID or in References,
+	 * and the IDs it references, used as a Message-ID */
+	query = sqlite3_mprintf (
+		"SELECT folder_name, uid FROM ("
+		"SELECT folder_name, uid FROM %s WHERE msgid IN "
+		"(SELECT msgid FROM %s WHERE folder_name = %Q AND uid = %Q AND ref_index = 0) "
+		"UNION "
+		"SELECT folder_name, uid FROM %s WHERE ref_index = 0 AND msgid IN "
+		"(SELECT msgid FROM %s WHERE folder_name = %Q AND uid = %Q AND ref_index > 0)"
+		") WHERE NOT (folder_name = %Q AND uid = %Q)",
+		CAMEL_DB_MESSAGE_IDS_TABLE, CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uid,
+		CAMEL_DB_MESSAGE_IDS_TABLE, CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uid,
+		folder_name, uid);
+	ret = camel_db_select (cdb, query, callback, user_data, error);
+	sqlite3_free (query);
 
-	return hash;
+	return ret;
 }
 
 /**
- * camel_db_write_preview_record:
+ * camel_db_find_duplicate_message_ids:
+ * @cdb: a #CamelDB
+ * @folder_name: (allow-none): full name of a folder, or %NULL for all folders
+ * @callback: (scope call): a callback called for each found message
+ * @user_data: user data for the @callback
+ * @error: return location for a #GError, or %NULL
  *
- * Since: 2.28
+ * Looks up messages whose Message-ID is used by more than one message,
+ * either within the folder @folder_name, or, when it is %NULL, within
+ * all folders.  Note the Message-ID hash only finds candidates; callers
+ * should compare the messages themselves before treating them as equal.
+ *
+ * The @callback receives three columns: msgid, folder_name and uid,
+ * ordered by msgid, thus the messages of each group come together.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.20
  **/
 gint
-camel_db_write_preview_record (CamelDB *db,
-                               const gchar *folder_name,
-                               const gchar *uid,
-                               const gchar *msg,
-                               GError **error)
+camel_db_find_duplicate_message_ids (CamelDB *cdb,
+                                     const gchar *folder_name,
+                                     CamelDBSelectCB callback,
+                                     gpointer user_data,
+                                     GError **error)
 {
-	gchar *query;
+	gchar *query, *where;
 	gint ret;
 
-	query = sqlite3_mprintf ("INSERT OR REPLACE INTO '%q_preview' VALUES(%Q,%Q)", folder_name, uid, msg);
+	g_return_val_if_fail (cdb != NULL, -1);
+	g_return_val_if_fail (callback != NULL, -1);
 
-	ret = camel_db_add_to_transaction (db, query, error);
+	if (folder_name)
+		where = sqlite3_mprintf ("ref_index = 0 AND folder_name = %Q", folder_name);
+	else
+		where = sqlite3_mprintf ("ref_index = 0");
+
+	query = sqlite3_mprintf (
+		"SELECT msgid, folder_name, uid FROM %s WHERE %s AND msgid IN "
+		"(SELECT msgid FROM %s WHERE %s GROUP BY msgid HAVING COUNT (*) > 1) "
+		"ORDER BY msgid",
+		CAMEL_DB_MESSAGE_IDS_TABLE, where, CAMEL_DB_MESSAGE_IDS_TABLE, where);
+	ret = camel_db_select (cdb, query, callback, user_data, error);
 	sqlite3_free (query);
+	sqlite3_free (where);
 
 	return ret;
 }
@@ -1538,8 +2820,68 @@ camel_db_create_folders_table (CamelDB *cdb,
 		"visible_count INTEGER, "
 		"jnd_count INTEGER, "
 		"bdata TEXT )";
+	gint ret;
+
+	ret = camel_db_command (cdb, query, error);
+
+	/* Labels and user tags are also kept normalized, one row per item,
+	 * so that searches on them can use an index instead of scanning and
+	 * parsing the 'labels' and 'usertags' columns of every message.
+	 * Existing folders are filled on their next version migration. */
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE TABLE IF NOT EXISTS " CAMEL_DB_LABELS_TABLE " ( "
+			"folder_name TEXT, "
+			"uid TEXT, "
+			"label TEXT, "
+			"PRIMARY KEY (folder_name, label, uid) )",
+			error);
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE INDEX IF NOT EXISTS " CAMEL_DB_LABELS_TABLE "_uid ON "
+			CAMEL_DB_LABELS_TABLE " (folder_name, uid)",
+			error);
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE TABLE IF NOT EXISTS " CAMEL_DB_USERTAGS_TABLE " ( "
+			"folder_name TEXT, "
+			"uid TEXT, "
+			"name TEXT, "
+			"value TEXT, "
+			"PRIMARY KEY (folder_name, name, uid) )",
+			error);
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE INDEX IF NOT EXISTS " CAMEL_DB_USERTAGS_TABLE "_uid ON "
+			CAMEL_DB_USERTAGS_TABLE " (folder_name, uid)",
+			error);
+
+	/* Message-ID and References hashes, for threading and duplicate
+	 * lookups across folders; ref_index 0 is the message's own ID */
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE TABLE IF NOT EXISTS " CAMEL_DB_MESSAGE_IDS_TABLE " ( "
+			"folder_name TEXT, "
+			"uid TEXT, "
+			"ref_index INTEGER, "
+			"msgid INTEGER, "
+			"PRIMARY KEY (folder_name, uid, ref_index) )",
+			error);
+	if (ret == 0)
+		ret = camel_db_command (
+			cdb,
+			"CREATE INDEX IF NOT EXISTS " CAMEL_DB_MESSAGE_IDS_TABLE "_msgid ON "
+			CAMEL_DB_MESSAGE_IDS_TABLE " (msgid, ref_index)",
+			error);
+
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
-	return ((camel_db_command (cdb, query, error)));
+
+	return ret;
 }
 
 static gint
@@ -1773,6 +3115,16 @@ camel_db_migrate_folder_recreate (CamelDB *cdb,
 		}
 	}
 
+	if (version < 3 && ret == 0) {
+		/* Between version 2-3 labels and user tags got their own tables */
+		ret = cdb_rebuild_message_tags (cdb, folder_name, error);
+	}
+
+	if (version < 4 && ret == 0) {
+		/* Between version 3-4 Message-ID and References got their own table */
+		ret = cdb_rebuild_message_ids (cdb, folder_name, error);
+	}
+
 	/* Add later version migrations here */
 
 	return ret;
@@ -1803,6 +3155,8 @@ camel_db_reset_folder_version (CamelDB *cdb,
 	ret = camel_db_add_to_transaction (cdb, version_creation_query, error);
 	ret = camel_db_add_to_transaction (cdb, version_insert_query, error);
 
+	cdb_folder_version_forget (cdb, folder_name);
+
 	sqlite3_free (drop_folder_query);
 	sqlite3_free (version_creation_query);
 	sqlite3_free (version_insert_query);
@@ -1823,13 +3177,15 @@ camel_db_write_folder_version (CamelDB *cdb,
 	version_creation_query = sqlite3_mprintf ("CREATE TABLE IF NOT EXISTS '%q_version' ( version TEXT )", folder_name);
 
 	if (old_version == -1)
-		version_insert_query = sqlite3_mprintf ("INSERT INTO '%q_version' VALUES ('2')", folder_name);
+		version_insert_query = sqlite3_mprintf ("INSERT INTO '%q_version' VALUES ('%d')", folder_name, CDB_FOLDER_VERSION);
 	else
-		version_insert_query = sqlite3_mprintf ("UPDATE '%q_version' SET version='2'", folder_name);
+		version_insert_query = sqlite3_mprintf ("UPDATE '%q_version' SET version='%d'", folder_name, CDB_FOLDER_VERSION);
 
 	ret = camel_db_add_to_transaction (cdb, version_creation_query, error);
 	ret = camel_db_add_to_transaction (cdb, version_insert_query, error);
 
+	cdb_folder_version_forget (cdb, folder_name);
+
 	sqlite3_free (version_creation_query);
 	sqlite3_free (version_insert_query);
 
@@ -1865,6 +3221,83 @@ camel_db_get_folder_version (CamelDB *cdb,
 	return version;
 }
 
+/* Reads the folder version once; only the current version is remembered,
+ * an older one can be migrated by another thread at any time. */
+static gint
+cdb_get_cached_folder_version (CamelDB *cdb,
+                               const gchar *folder_name)
+{
+	gboolean is_current;
+	gint version;
+
+	g_mutex_lock (&cdb->priv->folder_versions_lock);
+	is_current = g_hash_table_contains (cdb->priv->current_folders, folder_name);
+	g_mutex_unlock (&cdb->priv->folder_versions_lock);
+
+	if (is_current)
+		return CDB_FOLDER_VERSION;
+
+	version = camel_db_get_folder_version (cdb, folder_name, NULL);
+
+	if (version == CDB_FOLDER_VERSION) {
+		g_mutex_lock (&cdb->priv->folder_versions_lock);
+		g_hash_table_add (cdb->priv->current_folders, g_strdup (folder_name));
+		g_mutex_unlock (&cdb->priv->folder_versions_lock);
+	}
+
+	return version;
+}
+
+/**
+ * camel_db_has_message_tags:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of a folder
+ *
+ * Checks whether labels and user tags of the folder @folder_name are
+ * stored in the #CAMEL_DB_LABELS_TABLE and #CAMEL_DB_USERTAGS_TABLE
+ * tables. Folders written by older versions get them there only after
+ * camel_db_prepare_message_info_table() migrated them.
+ *
+ * Returns: whether the folder's labels and user tags are indexed
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_db_has_message_tags (CamelDB *cdb,
+                           const gchar *folder_name)
+{
+	g_return_val_if_fail (cdb != NULL, FALSE);
+	g_return_val_if_fail (folder_name != NULL, FALSE);
+
+	return cdb_get_cached_folder_version (cdb, folder_name) >= 3;
+}
+
+/**
+ * camel_db_has_message_ids:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of a folder
+ *
+ * Checks whether Message-ID and References hashes of the folder
+ * @folder_name are stored in the #CAMEL_DB_MESSAGE_IDS_TABLE table,
+ * thus whether camel_db_find_message_id(), camel_db_find_related_messages()
+ * and camel_db_find_duplicate_message_ids() know its messages. Folders
+ * written by older versions get them there only after
+ * camel_db_prepare_message_info_table() migrated them.
+ *
+ * Returns: whether the folder's Message-ID and References are indexed
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_db_has_message_ids (CamelDB *cdb,
+                          const gchar *folder_name)
+{
+	g_return_val_if_fail (cdb != NULL, FALSE);
+	g_return_val_if_fail (folder_name != NULL, FALSE);
+
+	return cdb_get_cached_folder_version (cdb, folder_name) >= 4;
+}
+
 /**
  * camel_db_prepare_message_info_table:
  *
@@ -1936,24 +3369,51 @@ write_mir (CamelDB *cdb,
 	gint ret;
 	/*char *del_query;*/
 	gchar *ins_query;
+	gboolean header_index, update_header_index;
 
 	if (!record) {
 		g_warn_if_reached ();
 		return -1;
 	}
 
+	header_index = cdb_header_index_exists (cdb, folder_name);
+
+	/* the index is keyed by the rowid, which the REPLACE below keeps,
+	 * thus only changed headers need their index entry rewritten */
+	update_header_index = header_index &&
+		!(delete_old_record && (record->unchanged & CAMEL_MI_RECORD_COLUMN_HEADERS) != 0);
+
+	if (update_header_index) {
+		ins_query = sqlite3_mprintf (
+			"DELETE FROM '%q_fts' WHERE docid IN (SELECT rowid FROM %Q WHERE uid = %Q)",
+			folder_name, folder_name, record->uid);
+		ret = camel_db_add_to_transaction (cdb, ins_query, error);
+		sqlite3_free (ins_query);
+
+		if (ret != 0)
+			return ret;
+	}
+
 	/* FIXME: We should migrate from this DELETE followed by INSERT model to an INSERT OR REPLACE model as pointed out by pvanhoof */
 
 	/* NB: UGLIEST Hack. We can't modify the schema now. We are using dirty (an unsed one to notify of FLAGGED/Dirty infos */
 
+	/* The rowid of a replaced row is reused, a new row gets a new
+	 * one from the NULL the sub-select returns for it */
 	ins_query = sqlite3_mprintf (
-		"INSERT OR REPLACE INTO %Q VALUES ("
+		"INSERT OR REPLACE INTO %Q (rowid, "
+		"uid, flags, msg_type, read, deleted, replied, important, junk, attachment, dirty, size, "
+		"dsent, dreceived, subject, mail_from, mail_to, mail_cc, mlist, followup_flag, followup_completed_on, followup_due_by, "
+		"part, labels, usertags, cinfo, bdata, created, modified) VALUES ("
+		"(SELECT rowid FROM %Q WHERE uid = %Q), "
 		"%Q, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, "
 		"%lld, %lld, %Q, %Q, %Q, %Q, %Q, %Q, %Q, %Q, "
 		"%Q, %Q, %Q, %Q, %Q, "
 		"strftime(\"%%s\", 'now'), "
 		"strftime(\"%%s\", 'now') )",
 		folder_name,
+		folder_name,
+		record->uid,
 		record->uid,
 		record->flags,
 		record->msg_type,
@@ -1994,6 +3454,30 @@ write_mir (CamelDB *cdb,
 		sqlite3_free (ins_query);
 	}
 
+	if (ret == 0 && update_header_index) {
+		ins_query = sqlite3_mprintf (
+			"INSERT INTO '%q_fts' (docid, " HEADER_INDEX_COLUMNS ") "
+			"SELECT rowid, " HEADER_INDEX_COLUMNS " FROM %Q WHERE uid = %Q",
+			folder_name, folder_name, record->uid);
+		ret = camel_db_add_to_transaction (cdb, ins_query, error);
+		sqlite3_free (ins_query);
+	}
+
+	/* the labels, the user tags and the Message-ID and References
+	 * of a saved message rarely change, most saves are for its flags */
+	if (ret == 0 && !(delete_old_record && (record->unchanged & CAMEL_MI_RECORD_COLUMN_LABELS) != 0))
+		ret = cdb_write_message_labels (
+			cdb, folder_name, record->uid, record->labels,
+			delete_old_record, error);
+
+	if (ret == 0 && !(delete_old_record && (record->unchanged & CAMEL_MI_RECORD_COLUMN_USERTAGS) != 0))
+		ret = cdb_write_message_usertags (
+			cdb, folder_name, record->uid, record->usertags,
+			delete_old_record, error);
+
+	if (ret == 0 && !(delete_old_record && (record->unchanged & CAMEL_MI_RECORD_COLUMN_PART) != 0))
+		ret = cdb_write_message_ids (cdb, folder_name, record->uid, record->part, delete_old_record, error);
+
 	return ret;
 }
 
@@ -2283,11 +3767,28 @@ camel_db_delete_uid (CamelDB *cdb,
 	ret = camel_db_add_to_transaction (cdb, tab, error);
 	sqlite3_free (tab);
 
-	tab = sqlite3_mprintf ("DELETE FROM %Q WHERE uid = %Q", folder, uid);
-	ret = camel_db_add_to_transaction (cdb, tab, error);
-	sqlite3_free (tab);
+	ret = cdb_delete_message_tags (cdb, folder, uid, error);
+	if (ret == 0)
+		ret = cdb_delete_message_ids (cdb, folder, uid, error);
 
-	ret = camel_db_end_transaction (cdb, error);
+	if (ret == 0 && cdb_header_index_exists (cdb, folder)) {
+		tab = sqlite3_mprintf (
+			"DELETE FROM '%q_fts' WHERE docid IN (SELECT rowid FROM %Q WHERE uid = %Q)",
+			folder, folder, uid);
+		ret = camel_db_add_to_transaction (cdb, tab, error);
+		sqlite3_free (tab);
+	}
+
+	if (ret == 0) {
+		tab = sqlite3_mprintf ("DELETE FROM %Q WHERE uid = %Q", folder, uid);
+		ret = camel_db_add_to_transaction (cdb, tab, error);
+		sqlite3_free (tab);
+	}
+
+	if (ret == 0)
+		ret = camel_db_end_transaction (cdb, error);
+	else
+		camel_db_abort_transaction (cdb, NULL);
 
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 	return ret;
@@ -2308,9 +3809,12 @@ cdb_delete_ids (CamelDB *cdb,
 	GString *str = g_string_new ("DELETE FROM ");
 	GList *iterator;
 	GString *ins_str = NULL;
+	GString *uids_str = NULL;
 
-	if (strcmp (field, "vuid") != 0)
+	if (strcmp (field, "vuid") != 0) {
 		ins_str = g_string_new ("INSERT OR REPLACE INTO Deletes (uid, mailbox, time) SELECT uid, ");
+		uids_str = g_string_new (NULL);
+	}
 
 	camel_db_begin_transaction (cdb, error);
 
@@ -2320,6 +3824,7 @@ cdb_delete_ids (CamelDB *cdb,
 			camel_db_abort_transaction (cdb, NULL);
 
 			g_string_free (ins_str, TRUE);
+			g_string_free (uids_str, TRUE);
 			g_string_free (str, TRUE);
 
 			return ret;
@@ -2348,11 +3853,15 @@ cdb_delete_ids (CamelDB *cdb,
 			g_string_append_printf (str, " %s ", tmp);
 			if (ins_str)
 				g_string_append_printf (ins_str, " %s ", tmp);
+			if (uids_str)
+				g_string_append_printf (uids_str, " %s ", tmp);
 			first = FALSE;
 		} else {
 			g_string_append_printf (str, ", %s ", tmp);
 			if (ins_str)
 				g_string_append_printf (ins_str, ", %s ", tmp);
+			if (uids_str)
+				g_string_append_printf (uids_str, ", %s ", tmp);
 		}
 
 		sqlite3_free (tmp);
@@ -2365,8 +3874,40 @@ cdb_delete_ids (CamelDB *cdb,
 		ret = ret == -1 ? ret : camel_db_trim_deleted_table (cdb, error);
 	}
 
+	if (ret != -1 && uids_str && cdb_header_index_exists (cdb, folder_name)) {
+		tmp = sqlite3_mprintf (
+			"DELETE FROM '%q_fts' WHERE docid IN (SELECT rowid FROM %Q WHERE uid IN (%s))",
+			folder_name, folder_name, uids_str->str);
+		ret = camel_db_add_to_transaction (cdb, tmp, error);
+		sqlite3_free (tmp);
+	}
+
 	ret = ret == -1 ? ret : camel_db_add_to_transaction (cdb, str->str, error);
 
+	if (ret != -1 && uids_str) {
+		tmp = sqlite3_mprintf (
+			"DELETE FROM %s WHERE folder_name = %Q AND uid IN (%s)",
+			CAMEL_DB_LABELS_TABLE, folder_name, uids_str->str);
+		ret = camel_db_add_to_transaction (cdb, tmp, error);
+		sqlite3_free (tmp);
+
+		if (ret != -1) {
+			tmp = sqlite3_mprintf (
+				"DELETE FROM %s WHERE folder_name = %Q AND uid IN (%s)",
+				CAMEL_DB_USERTAGS_TABLE, folder_name, uids_str->str);
+			ret = camel_db_add_to_transaction (cdb, tmp, error);
+			sqlite3_free (tmp);
+		}
+
+		if (ret != -1) {
+			tmp = sqlite3_mprintf (
+				"DELETE FROM %s WHERE folder_name = %Q AND uid IN (%s)",
+				CAMEL_DB_MESSAGE_IDS_TABLE, folder_name, uids_str->str);
+			ret = camel_db_add_to_transaction (cdb, tmp, error);
+			sqlite3_free (tmp);
+		}
+	}
+
 	if (ret == -1)
 		camel_db_abort_transaction (cdb, NULL);
 	else
@@ -2376,6 +3917,8 @@ cdb_delete_ids (CamelDB *cdb,
 
 	if (ins_str)
 		g_string_free (ins_str, TRUE);
+	if (uids_str)
+		g_string_free (uids_str, TRUE);
 	g_string_free (str, TRUE);
 
 	return ret;
@@ -2438,7 +3981,20 @@ camel_db_clear_folder_summary (CamelDB *cdb,
 	camel_db_add_to_transaction (cdb, folders_del, error);
 	camel_db_add_to_transaction (cdb, bstruct_del, error);
 
-	ret = camel_db_end_transaction (cdb, error);
+	ret = cdb_delete_message_tags (cdb, folder, NULL, error);
+	if (ret == 0)
+		ret = cdb_delete_message_ids (cdb, folder, NULL, error);
+
+	if (ret == 0 && cdb_header_index_exists (cdb, folder)) {
+		tab = sqlite3_mprintf ("DELETE FROM '%q_fts'", folder);
+		ret = camel_db_add_to_transaction (cdb, tab, error);
+		sqlite3_free (tab);
+	}
+
+	if (ret == 0)
+		ret = camel_db_end_transaction (cdb, error);
+	else
+		camel_db_abort_transaction (cdb, NULL);
 
 	sqlite3_free (folders_del);
 	sqlite3_free (msginfo_del);
@@ -2486,7 +4042,24 @@ camel_db_delete_folder (CamelDB *cdb,
 	ret = camel_db_add_to_transaction (cdb, del, error);
 	sqlite3_free (del);
 
-	ret = camel_db_end_transaction (cdb, error);
+	ret = cdb_delete_message_tags (cdb, folder, NULL, error);
+	if (ret == 0)
+		ret = cdb_delete_message_ids (cdb, folder, NULL, error);
+
+	if (ret == 0 && cdb_header_index_exists (cdb, folder)) {
+		del = sqlite3_mprintf ("DROP TABLE '%q_fts' ", folder);
+		ret = camel_db_add_to_transaction (cdb, del, error);
+		sqlite3_free (del);
+
+		cdb_header_index_forget (cdb, folder);
+	}
+
+	cdb_folder_version_forget (cdb, folder);
+
+	if (ret == 0)
+		ret = camel_db_end_transaction (cdb, error);
+	else
+		camel_db_abort_transaction (cdb, NULL);
 
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 	return ret;
@@ -2527,6 +4100,18 @@ camel_db_rename_folder (CamelDB *cdb,
 	ret = camel_db_add_to_transaction (cdb, cmd, error);
 	sqlite3_free (cmd);
 
+	cdb_folder_version_forget (cdb, old_folder);
+	cdb_folder_version_forget (cdb, new_folder);
+
+	if (cdb_header_index_exists (cdb, old_folder)) {
+		cmd = sqlite3_mprintf ("ALTER TABLE '%q_fts' RENAME TO  '%q_fts'", old_folder, new_folder);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+
+		cdb_header_index_forget (cdb, old_folder);
+		cdb_header_index_forget (cdb, new_folder);
+	}
+
 	cmd = sqlite3_mprintf ("UPDATE %Q SET modified=strftime(\"%%s\", 'now'), created=strftime(\"%%s\", 'now')", new_folder);
 	ret = camel_db_add_to_transaction (cdb, cmd, error);
 	sqlite3_free (cmd);
@@ -2535,7 +4120,26 @@ camel_db_rename_folder (CamelDB *cdb,
 	ret = camel_db_add_to_transaction (cdb, cmd, error);
 	sqlite3_free (cmd);
 
-	ret = camel_db_end_transaction (cdb, error);
+	cmd = sqlite3_mprintf ("UPDATE %s SET folder_name = %Q WHERE folder_name = %Q", CAMEL_DB_LABELS_TABLE, new_folder, old_folder);
+	ret = camel_db_add_to_transaction (cdb, cmd, error);
+	sqlite3_free (cmd);
+
+	if (ret == 0) {
+		cmd = sqlite3_mprintf ("UPDATE %s SET folder_name = %Q WHERE folder_name = %Q", CAMEL_DB_USERTAGS_TABLE, new_folder, old_folder);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	if (ret == 0) {
+		cmd = sqlite3_mprintf ("UPDATE %s SET folder_name = %Q WHERE folder_name = %Q", CAMEL_DB_MESSAGE_IDS_TABLE, new_folder, old_folder);
+		ret = camel_db_add_to_transaction (cdb, cmd, error);
+		sqlite3_free (cmd);
+	}
+
+	if (ret == 0)
+		ret = camel_db_end_transaction (cdb, error);
+	else
+		camel_db_abort_transaction (cdb, NULL);
 
 	CAMEL_DB_RELEASE_SQLITE_MEMORY;
 	return ret;
@@ -2840,6 +4444,74 @@ get_number_cb (gpointer data,
 	return 0;
 }
 
+/* Must be called with the writer lock held.  VACUUM can renumber the rowid-s
+ * of the folder tables, which the header indexes use as their docid-s, thus
+ * the indexes are dropped before it and built again after it.  The readers
+ * do not use them meanwhile, because the index does not exist for them. */
+static gboolean
+cdb_vacuum (CamelDB *cdb,
+            GError **error)
+{
+	GPtrArray *indexes;
+	gboolean dropped = FALSE;
+	gchar *cmd;
+	gint ret;
+	guint ii;
+
+	indexes = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_pstring_free);
+
+	ret = cdb_sql_exec (
+		cdb->db,
+		"SELECT SUBSTR (name, 1, LENGTH (name) - 4) FROM sqlite_master "
+		"WHERE type = 'table' AND sql LIKE 'CREATE VIRTUAL TABLE%' "
+		"AND name LIKE '%\\_fts' ESCAPE '\\'",
+		read_uids_callback, indexes, NULL, error);
+
+	if (ret == SQLITE_OK && indexes->len > 0) {
+		ret = camel_db_begin_transaction (cdb, error);
+		for (ii = 0; ii < indexes->len && ret == 0; ii++) {
+			cmd = sqlite3_mprintf ("DROP TABLE '%q_fts'", (const gchar *) indexes->pdata[ii]);
+			ret = camel_db_add_to_transaction (cdb, cmd, error);
+			sqlite3_free (cmd);
+		}
+		if (ret == 0)
+			ret = camel_db_end_transaction (cdb, error);
+		else
+			camel_db_abort_transaction (cdb, NULL);
+
+		dropped = ret == 0;
+
+		cdb_header_index_forget (cdb, NULL);
+	}
+
+	if (ret == SQLITE_OK)
+		ret = cdb_sql_exec (cdb->db, "vacuum;", NULL, NULL, NULL, error);
+
+	/* rebuilt also after a failed VACUUM, whose error is the one reported */
+	if (dropped) {
+		GError **rebuild_error = ret == SQLITE_OK ? error : NULL;
+		gint res;
+
+		res = camel_db_begin_transaction (cdb, rebuild_error);
+		for (ii = 0; ii < indexes->len && res == 0; ii++) {
+			res = cdb_create_header_index (cdb, indexes->pdata[ii], rebuild_error);
+		}
+		if (res == 0)
+			res = camel_db_end_transaction (cdb, rebuild_error);
+		else
+			camel_db_abort_transaction (cdb, NULL);
+
+		cdb_header_index_forget (cdb, NULL);
+
+		if (ret == SQLITE_OK)
+			ret = res;
+	}
+
+	g_ptr_array_unref (indexes);
+
+	return ret == SQLITE_OK;
+}
+
 /**
  * camel_db_maybe_run_maintenance:
  * @cdb: a #CamelDB instance
@@ -2867,7 +4539,7 @@ camel_db_maybe_run_maintenance (CamelDB *cdb,
 	    cdb_sql_exec (cdb->db, "PRAGMA freelist_count;", get_number_cb, &freelist_count, NULL, &local_error) == SQLITE_OK) {
 		/* Vacuum, if there's more than 5% of the free pages */
 		success = !page_count || !freelist_count || freelist_count * 1000 / page_count <= 50 ||
-		    cdb_sql_exec (cdb->db, "vacuum;", NULL, NULL, NULL, &local_error) == SQLITE_OK;
+		    cdb_vacuum (cdb, &local_error);
 	}
 
 	cdb_writer_unlock (cdb);
@@ -2879,3 +4551,108 @@ camel_db_maybe_run_maintenance (CamelDB *cdb,
 
 	return success;
 }
+
+static gint
+cdb_profile_compare_total (gconstpointer a,
+                           gconstpointer b)
+{
+	const CDBProfileEntry *entry_a, *entry_b;
+
+	entry_a = g_hash_table_lookup (cdb_profile_table, *((const gchar **) a));
+	entry_b = g_hash_table_lookup (cdb_profile_table, *((const gchar **) b));
+
+	if (entry_a->total == entry_b->total)
+		return 0;
+
+	return entry_a->total > entry_b->total ? -1 : 1;
+}
+
+/**
+ * camel_db_dump_profile:
+ * @filename: a file to write the profile to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the statement timings collected by all the #CamelDB instances
+ * into @filename, one line per statement shape, from the one which took
+ * the most time in total.  Each line has the number of executions, the total
+ * and the longest time in milliseconds and the statement, with its values
+ * replaced by '?', separated by tabs.
+ *
+ * The timings are collected only when the CAMEL_SQLITE_PROFILE environment
+ * variable is set.  If it holds a file name, other than "1", then the profile
+ * is also written into that file by camel_shutdown().  Independently of it,
+ * the statements which take longer than CAMEL_SQLITE_SLOW_QUERY_MS
+ * milliseconds are logged, with their values replaced the same way,
+ * together with their query plan.
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_db_dump_profile (const gchar *filename,
+                       GError **error)
+{
+	GString *contents;
+	GPtrArray *shapes;
+	gboolean success;
+	guint ii;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	contents = g_string_new ("# count\ttotal ms\tmax ms\tstatement\n");
+	shapes = g_ptr_array_new ();
+
+	g_mutex_lock (&cdb_profile_lock);
+
+	if (cdb_profile_table) {
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init (&iter, cdb_profile_table);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			g_ptr_array_add (shapes, key);
+		}
+	}
+
+	g_ptr_array_sort (shapes, cdb_profile_compare_total);
+
+	for (ii = 0; ii < shapes->len; ii++) {
+		const gchar *shape = g_ptr_array_index (shapes, ii);
+		const CDBProfileEntry *entry;
+
+		entry = g_hash_table_lookup (cdb_profile_table, shape);
+
+		g_string_append_printf (
+			contents, "%" G_GUINT64_FORMAT "\t%.3f\t%.3f\t%s\n",
+			entry->count, entry->total / 1000.0, entry->max / 1000.0, shape);
+	}
+
+	g_mutex_unlock (&cdb_profile_lock);
+
+	success = g_file_set_contents (filename, contents->str, contents->len, error);
+
+	g_ptr_array_free (shapes, TRUE);
+	g_string_free (contents, TRUE);
+
+	return success;
+}
+
+/**
+ * camel_db_reset_profile:
+ *
+ * Forgets the statement timings collected so far.
+ * See camel_db_dump_profile().
+ *
+ * Since: 3.20
+ **/
+void
+camel_db_reset_profile (void)
+{
+	g_mutex_lock (&cdb_profile_lock);
+
+	if (cdb_profile_table)
+		g_hash_table_remove_all (cdb_profile_table);
+
+	g_mutex_unlock (&cdb_profile_lock);
+}
@@ -59,6 +59,38 @@ G_BEGIN_DECLS
  **/
 #define CAMEL_DB_IN_MEMORY_TABLE_LIMIT 100000
 
+/**
+ * CAMEL_DB_LABELS_TABLE:
+ *
+ * Name of the store-wide table holding one row per user flag (label)
+ * of each message, keyed by folder name and message UID.
+ *
+ * Since: 3.20
+ **/
+#define CAMEL_DB_LABELS_TABLE "message_labels"
+
+/**
+ * CAMEL_DB_USERTAGS_TABLE:
+ *
+ * Name of the store-wide table holding one row per user tag
+ * of each message, keyed by folder name and message UID.
+ *
+ * Since: 3.20
+ **/
+#define CAMEL_DB_USERTAGS_TABLE "message_usertags"
+
+/**
+ * CAMEL_DB_MESSAGE_IDS_TABLE:
+ *
+ * Name of the store-wide table holding the Message-ID hash and
+ * the References hashes of each message, keyed by folder name,
+ * message UID and the index in the References, zero being
+ * the message's own Message-ID.
+ *
+ * Since: 3.20
+ **/
+#define CAMEL_DB_MESSAGE_IDS_TABLE "message_ids"
+
 typedef struct _CamelDBPrivate CamelDBPrivate;
 
 /**
@@ -109,6 +141,30 @@ struct _CamelDB {
  **/
 #define CAMEL_DB_USE_SHARED_CACHE if(g_getenv("CAMEL_SQLITE_SHARED_CACHE")) sqlite3_enable_shared_cache(TRUE);
 
+/**
+ * CamelMIRecordColumns:
+ * @CAMEL_MI_RECORD_COLUMN_PART:
+ *	the @part column, with the Message-ID and References hashes
+ * @CAMEL_MI_RECORD_COLUMN_LABELS:
+ *	the @labels column, copied into the #CAMEL_DB_LABELS_TABLE
+ * @CAMEL_MI_RECORD_COLUMN_USERTAGS:
+ *	the @usertags column, copied into the #CAMEL_DB_USERTAGS_TABLE
+ * @CAMEL_MI_RECORD_COLUMN_HEADERS:
+ *	the @subject, @from, @to, @cc and @mlist columns, copied
+ *	into the folder's header index, see camel_db_has_header_index()
+ *
+ * Columns of a #CamelMIRecord which are copied into side tables,
+ * like the #CAMEL_DB_MESSAGE_IDS_TABLE.
+ *
+ * Since: 3.20
+ **/
+typedef enum {
+	CAMEL_MI_RECORD_COLUMN_PART = 1 << 0,
+	CAMEL_MI_RECORD_COLUMN_LABELS = 1 << 1,
+	CAMEL_MI_RECORD_COLUMN_USERTAGS = 1 << 2,
+	CAMEL_MI_RECORD_COLUMN_HEADERS = 1 << 3
+} CamelMIRecordColumns;
+
 /**
  * CamelMIRecord:
  * @uid:
@@ -162,6 +218,10 @@ struct _CamelDB {
  * @bdata:
  *	provider specific data
  * @bodystructure:
+ * @unchanged:
+ *	#CamelMIRecordColumns known to be unchanged since the record
+ *	was last written, whose side table rows are not rewritten then;
+ *	zero rewrites all of them (Since: 3.20)
  *
  * The extensive DB format, supporting basic searching and sorting.
  *
@@ -195,6 +255,7 @@ typedef struct _CamelMIRecord {
 	gchar *cinfo;
 	gchar *bdata;
 	gchar *bodystructure;
+	CamelMIRecordColumns unchanged;
 } CamelMIRecord;
 
 /**
@@ -277,6 +338,15 @@ typedef gint (*CamelDBSelectCB) (gpointer data, gint ncol, gchar **colvalues, gc
 CamelDB * camel_db_open (const gchar *path, GError **error);
 CamelDB * camel_db_clone (CamelDB *cdb, GError **error);
 void camel_db_close (CamelDB *cdb);
+gint camel_db_enable_readers (CamelDB *cdb, guint max_readers, GError **error);
+gint camel_db_enable_header_index (CamelDB *cdb, GError **error);
+gint camel_db_build_header_index (CamelDB *cdb, const gchar *folder_name, GError **error);
+gboolean camel_db_has_header_index (CamelDB *cdb, const gchar *folder_name);
+gboolean camel_db_has_message_tags (CamelDB *cdb, const gchar *folder_name);
+gboolean camel_db_has_message_ids (CamelDB *cdb, const gchar *folder_name);
+gint camel_db_find_message_id (CamelDB *cdb, guint64 message_id, gboolean with_referencing, CamelDBSelectCB callback, gpointer user_data, GError **error);
+gint camel_db_find_related_messages (CamelDB *cdb, const gchar *folder_name, const gchar *uid, CamelDBSelectCB callback, gpointer user_data, GError **error);
+gint camel_db_find_duplicate_message_ids (CamelDB *cdb, const gchar *folder_name, CamelDBSelectCB callback, gpointer user_data, GError **error);
 gint camel_db_command (CamelDB *cdb, const gchar *stmt, GError **error);
 
 gint camel_db_transaction_command (CamelDB *cdb, GList *qry_list, GError **error);
@@ -341,6 +411,9 @@ camel_db_reset_folder_version (CamelDB *cdb, const gchar *folder_name, gint rese
 
 gboolean camel_db_maybe_run_maintenance (CamelDB *cdb, GError **error);
 
+gboolean camel_db_dump_profile (const gchar *filename, GError **error);
+void camel_db_reset_profile (void);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,58 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CAMEL_FILTER_DRIVER_PRIVATE_H
+#define CAMEL_FILTER_DRIVER_PRIVATE_H
+
+#include "camel-filter-driver.h"
+
+G_BEGIN_DECLS
+
+/* How many messages which reached a "junk-test" rule are handed
+ * to the junk filter at once */
+#define JUNK_CLASSIFY_BATCH 32
+
+/* Filters the message @uid of @source like camel_filter_driver_filter_message()
+ * does, except when a rule with "junk-test" is reached and the message has
+ * not been classified yet.  The message is then added to @deferred, to be
+ * classified and finished with the others in _camel_filter_driver_filter_deferred().
+ * The @uid, @source and @store_uid should stay valid until then. */
+gint		_camel_filter_driver_filter_message_deferred
+						(CamelFilterDriver *driver,
+						 CamelMessageInfo *info,
+						 const gchar *uid,
+						 CamelFolder *source,
+						 const gchar *store_uid,
+						 GQueue *deferred,
+						 GCancellable *cancellable,
+						 GError **error);
+
+/* Classifies the messages in @deferred in one batch and applies the rest
+ * of the rules to them.  The uids of the finished messages are added to
+ * @done_uids, when not %NULL.  Empties @deferred. */
+gint		_camel_filter_driver_filter_deferred
+						(CamelFilterDriver *driver,
+						 GQueue *deferred,
+						 GPtrArray *done_uids,
+						 GCancellable *cancellable,
+						 GError **error);
+
+/* Drops the messages left in @deferred, like when the filtering failed */
+void		_camel_filter_driver_clear_deferred
+						(GQueue *deferred);
+
+G_END_DECLS
+
+#endif /* CAMEL_FILTER_DRIVER_PRIVATE_H */
@@ -39,7 +39,9 @@
 #include "camel-debug.h"
 #include "camel-file-utils.h"
 #include "camel-filter-driver.h"
+#include "camel-filter-driver-private.h"
 #include "camel-filter-search.h"
+#include "camel-junk-filter.h"
 #include "camel-mime-message.h"
 #include "camel-service.h"
 #include "camel-session.h"
@@ -47,6 +49,7 @@
 #include "camel-store.h"
 #include "camel-stream-fs.h"
 #include "camel-stream-mem.h"
+#include "camel-trace.h"
 
 #define d(x)
 
@@ -121,6 +124,25 @@ struct _CamelFilterDriverPrivate {
 	CamelSExp *eval;
 };
 
+/* Filtering state of one message, which is kept while the message
+ * waits in a deferred queue for its junk classification */
+typedef struct _FilterMessageState {
+	CamelMimeMessage *message;
+	CamelMessageInfo *info;
+	const gchar *uid;
+	const gchar *caller_uid;	/* what the caller passed in */
+	CamelFolder *source;
+	const gchar *store_uid;
+	const gchar *original_store_uid;
+	GList *link;			/* the next rule to apply */
+	CamelJunkStatus junk_status;
+	gboolean filtered;
+	gboolean deleted;
+	gboolean copied;
+	gboolean moved;
+	gboolean modified;
+} FilterMessageState;
+
 static void camel_filter_driver_log (CamelFilterDriver *driver, enum filter_log_t status, const gchar *desc, ...);
 
 static CamelFolder *open_folder (CamelFilterDriver *d, const gchar *folder_url);
@@ -1395,6 +1417,9 @@ camel_filter_driver_filter_mbox (CamelFilterDriver *driver,
 	gint status;
 	goffset last = 0;
 	gint ret = -1;
+	CamelTraceSpan span;
+
+	camel_trace_span_begin (&span, "filter", "mbox", mbox);
 
 	fd = g_open (mbox, O_RDONLY | O_BINARY, 0);
 	if (fd == -1) {
@@ -1500,9 +1525,35 @@ fail:
 	if (mp)
 		g_object_unref (mp);
 
+	camel_trace_span_end (&span, last, error ? *error : NULL);
+
 	return ret;
 }
 
+static void
+filter_folder_finish_uids (CamelFolder *folder,
+                           CamelUIDCache *cache,
+                           gboolean remove,
+                           GPtrArray *done_uids)
+{
+	guint ii;
+
+	for (ii = 0; ii < done_uids->len; ii++) {
+		const gchar *uid = done_uids->pdata[ii];
+
+		if (remove)
+			camel_folder_set_message_flags (
+				folder, uid,
+				CAMEL_MESSAGE_DELETED |
+				CAMEL_MESSAGE_SEEN, ~0);
+
+		if (cache)
+			camel_uid_cache_save_uid (cache, uid);
+	}
+
+	g_ptr_array_set_size (done_uids, 0);
+}
+
 /**
  * camel_filter_driver_filter_folder:
  * @driver: CamelFilterDriver
@@ -1515,7 +1566,8 @@ fail:
  * @error: return location for a #GError, or %NULL
  *
  * Filters a folder based on rules defined in the FilterDriver
- * object.
+ * object.  The messages which reach a rule with "junk-test" are
+ * classified by the session's #CamelJunkFilter in batches.
  *
  * Returns: -1 if errors were encountered during filtering,
  * otherwise returns 0.
@@ -1533,9 +1585,17 @@ camel_filter_driver_filter_folder (CamelFilterDriver *driver,
 	gboolean freeuids = FALSE;
 	CamelMessageInfo *info;
 	CamelStore *parent_store;
+	GQueue deferred = G_QUEUE_INIT;
+	GPtrArray *done_uids;
 	const gchar *store_uid;
+	guint n_deferred;
 	gint status = 0;
 	gint i;
+	CamelTraceSpan span;
+
+	camel_trace_span_begin (
+		&span, "filter", "folder",
+		camel_folder_get_full_name (folder));
 
 	parent_store = camel_folder_get_parent_store (folder);
 	store_uid = camel_service_get_uid (CAMEL_SERVICE (parent_store));
@@ -1545,6 +1605,8 @@ camel_filter_driver_filter_folder (CamelFilterDriver *driver,
 		freeuids = TRUE;
 	}
 
+	done_uids = g_ptr_array_new ();
+
 	for (i = 0; i < uids->len; i++) {
 		gint pc = (100 * i) / uids->len;
 		GError *local_error = NULL;
@@ -1561,13 +1623,30 @@ camel_filter_driver_filter_folder (CamelFilterDriver *driver,
 		else
 			info = NULL;
 
-		status = camel_filter_driver_filter_message (
-			driver, NULL, info, uids->pdata[i], folder,
-			store_uid, store_uid, cancellable, &local_error);
+		n_deferred = g_queue_get_length (&deferred);
+
+		status = _camel_filter_driver_filter_message_deferred (
+			driver, info, uids->pdata[i], folder,
+			store_uid, &deferred, cancellable, &local_error);
 
 		if (camel_folder_has_summary_capability (folder))
 			camel_message_info_unref (info);
 
+		if (local_error == NULL && status != -1) {
+			if (g_queue_get_length (&deferred) == n_deferred)
+				g_ptr_array_add (done_uids, uids->pdata[i]);
+
+			if (g_queue_get_length (&deferred) >= JUNK_CLASSIFY_BATCH ||
+			    (i + 1 == uids->len && !g_queue_is_empty (&deferred)))
+				status = _camel_filter_driver_filter_deferred (
+					driver, &deferred, done_uids,
+					cancellable, &local_error);
+		}
+
+		/* The deferred messages are finished in batches, after which
+		 * they can be marked in the folder and the cache like the rest */
+		filter_folder_finish_uids (folder, cache, remove, done_uids);
+
 		if (local_error != NULL || status == -1) {
 			report_status (
 				driver, CAMEL_FILTER_STATUS_END, 100,
@@ -1578,20 +1657,16 @@ camel_filter_driver_filter_folder (CamelFilterDriver *driver,
 			break;
 		}
 
-		if (remove)
-			camel_folder_set_message_flags (
-				folder, uids->pdata[i],
-				CAMEL_MESSAGE_DELETED |
-				CAMEL_MESSAGE_SEEN, ~0);
-
-		if (cache)
-			camel_uid_cache_save_uid (cache, uids->pdata[i]);
 		if (cache && (i % 10) == 0)
 			camel_uid_cache_save (cache);
 	}
 
 	camel_operation_progress (cancellable, 100);
 
+	/* Those left when the filtering stopped early */
+	_camel_filter_driver_clear_deferred (&deferred);
+	g_ptr_array_free (done_uids, TRUE);
+
 	/* Save the cache of any pending mails. */
 	if (cache)
 		camel_uid_cache_save (cache);
@@ -1612,6 +1687,8 @@ camel_filter_driver_filter_folder (CamelFilterDriver *driver,
 	if (freeuids)
 		camel_folder_free_uids (folder, uids);
 
+	camel_trace_span_end (&span, -1, error ? *error : NULL);
+
 	return status;
 }
 
@@ -1638,8 +1715,14 @@ get_message_cb (gpointer data,
 		else
 			uid = camel_message_info_uid (msgdata->priv->info);
 
-		message = camel_folder_get_message_sync (
+		/* Keep it for the following rules and their actions */
+		msgdata->priv->message = camel_folder_get_message_sync (
 			msgdata->priv->source, uid, cancellable, error);
+
+		if (msgdata->priv->message != NULL)
+			message = g_object_ref (msgdata->priv->message);
+		else
+			message = NULL;
 	}
 
 	if (message != NULL && camel_mime_message_get_source (message) == NULL)
@@ -1648,99 +1731,85 @@ get_message_cb (gpointer data,
 	return message;
 }
 
-/**
- * camel_filter_driver_filter_message:
- * @driver: CamelFilterDriver
- * @message: message to filter or NULL
- * @info: message info or NULL
- * @uid: message uid or NULL
- * @source: source folder or NULL
- * @store_uid: UID of source store, or %NULL
- * @original_store_uid: UID of source store (pre-movemail), or %NULL
- * @cancellable: optional #GCancellable object, or %NULL
- * @error: return location for a #GError, or %NULL
- *
- * Filters a message based on rules defined in the FilterDriver
- * object. If the source folder (@source) and the uid (@uid) are
- * provided, the filter will operate on the CamelFolder (which in
- * certain cases is more efficient than using the default
- * camel_folder_append_message() function).
- *
- * Returns: -1 if errors were encountered during filtering,
- * otherwise returns 0.
- *
- **/
-gint
-camel_filter_driver_filter_message (CamelFilterDriver *driver,
-                                    CamelMimeMessage *message,
-                                    CamelMessageInfo *info,
-                                    const gchar *uid,
-                                    CamelFolder *source,
-                                    const gchar *store_uid,
-                                    const gchar *original_store_uid,
-                                    GCancellable *cancellable,
-                                    GError **error)
+static void
+filter_message_state_free (FilterMessageState *state)
 {
-	CamelFilterDriverPrivate *p = driver->priv;
-	gboolean freeinfo = FALSE;
-	gboolean filtered = FALSE;
-	CamelSExpResult *r;
-	GList *list, *link;
-	gint result;
+	if (state->message)
+		g_object_unref (state->message);
+	camel_message_info_unref (state->info);
 
-	g_return_val_if_fail (message != NULL || (source != NULL && uid != NULL), -1);
+	g_slice_free (FilterMessageState, state);
+}
 
-	if (info == NULL) {
-		struct _camel_header_raw *h;
+/* Whether the current message can wait for a batch junk classification
+ * before @rule is applied: the rule uses "junk-test" and the message is
+ * not flagged as junk or not junk already */
+static gboolean
+filter_driver_can_defer_junk_test (CamelFilterDriver *driver,
+                                   struct _filter_rule *rule,
+                                   const gchar *store_uid,
+                                   GCancellable *cancellable)
+{
+	CamelFilterDriverPrivate *p = driver->priv;
 
-		if (message) {
-			g_object_ref (message);
-		} else {
-			message = camel_folder_get_message_sync (
-				source, uid, cancellable, error);
-			if (!message)
-				return -1;
-		}
+	if (!rule->match || !strstr (rule->match, "junk-test"))
+		return FALSE;
 
-		h = CAMEL_MIME_PART (message)->headers;
-		info = camel_message_info_new_from_header (NULL, h);
-		freeinfo = TRUE;
-	} else {
-		if (camel_message_info_flags (info) & CAMEL_MESSAGE_DELETED)
-			return 0;
+	if (!p->session || !camel_session_get_junk_filter (p->session))
+		return FALSE;
 
-		uid = camel_message_info_uid (info);
+	if ((camel_message_info_flags (p->info) & (CAMEL_MESSAGE_JUNK | CAMEL_MESSAGE_NOTJUNK)) != 0)
+		return FALSE;
 
-		if (message)
-			g_object_ref (message);
+	/* The junk filter needs the message itself, which is then
+	 * reused by the rules and their actions */
+	if (p->message == NULL && p->source != NULL && p->uid != NULL) {
+		p->message = camel_folder_get_message_sync (
+			p->source, p->uid, cancellable, NULL);
+
+		if (p->message != NULL && camel_mime_message_get_source (p->message) == NULL)
+			camel_mime_message_set_source (p->message, store_uid);
 	}
 
+	return p->message != NULL;
+}
+
+/* Applies the rules to the message described by @state, starting with
+ * state->link.  When @deferred is not %NULL and a rule needs the junk
+ * classification, the message is queued there instead, to continue with
+ * that rule in _camel_filter_driver_filter_deferred().  Consumes the
+ * message and the info of @state either way. */
+static gint
+filter_driver_apply_rules (CamelFilterDriver *driver,
+                           FilterMessageState *state,
+                           GQueue *deferred,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	CamelFilterDriverPrivate *p = driver->priv;
+	CamelMessageInfo *info = state->info;
+	CamelFolder *source = state->source;
+	const gchar *uid = state->uid;
+	const gchar *store_uid = state->store_uid;
+	const gchar *original_store_uid = state->original_store_uid;
+	gboolean filtered = state->filtered;
+	CamelSExpResult *r;
+	GList *link;
+	gint result;
+
 	driver->priv->terminated = FALSE;
-	driver->priv->deleted = FALSE;
-	driver->priv->copied = FALSE;
-	driver->priv->moved = FALSE;
-	driver->priv->message = message;
+	driver->priv->deleted = state->deleted;
+	driver->priv->copied = state->copied;
+	driver->priv->moved = state->moved;
+	driver->priv->modified = state->modified;
+	driver->priv->message = state->message;
 	driver->priv->info = info;
 	driver->priv->uid = uid;
 	driver->priv->source = source;
 
-	if (message != NULL && camel_mime_message_get_source (message) == NULL)
-		camel_mime_message_set_source (message, original_store_uid);
-
-	if (g_strcmp0 (store_uid, "local") == 0 ||
-	    g_strcmp0 (store_uid, "vfolder") == 0) {
-		store_uid = NULL;
-	}
-
-	if (g_strcmp0 (original_store_uid, "local") == 0 ||
-	    g_strcmp0 (original_store_uid, "vfolder") == 0) {
-		original_store_uid = NULL;
-	}
-
-	list = g_queue_peek_head_link (&driver->priv->rules);
 	result = CAMEL_SEARCH_NOMATCH;
 
-	for (link = list; link != NULL; link = g_list_next (link)) {
+	for (link = state->link; link != NULL; link = g_list_next (link)) {
 		struct _filter_rule *rule = link->data;
 		struct _get_message data;
 
@@ -1750,6 +1819,29 @@ camel_filter_driver_filter_message (CamelFilterDriver *driver,
 		if (g_cancellable_set_error_if_cancelled (cancellable, &driver->priv->error))
 			goto error;
 
+		if (deferred != NULL && state->junk_status == CAMEL_JUNK_STATUS_ERROR &&
+		    filter_driver_can_defer_junk_test (driver, rule, original_store_uid, cancellable)) {
+			FilterMessageState *pending;
+
+			pending = g_slice_dup (FilterMessageState, state);
+			pending->message = driver->priv->message;
+			pending->store_uid = store_uid;
+			pending->original_store_uid = original_store_uid;
+			pending->link = link;
+			pending->filtered = filtered;
+			pending->deleted = driver->priv->deleted;
+			pending->copied = driver->priv->copied;
+			pending->moved = driver->priv->moved;
+			pending->modified = driver->priv->modified;
+
+			g_queue_push_tail (deferred, pending);
+
+			driver->priv->message = NULL;
+			driver->priv->info = NULL;
+
+			return 0;
+		}
+
 		d (printf ("applying rule %s\naction %s\n", rule->match, rule->action));
 
 		data.priv = p;
@@ -1758,9 +1850,10 @@ camel_filter_driver_filter_message (CamelFilterDriver *driver,
 		if (original_store_uid == NULL)
 			original_store_uid = store_uid;
 
-		result = camel_filter_search_match (
+		result = camel_filter_search_match_with_junk_status (
 			driver->priv->session, get_message_cb, &data, driver->priv->info,
-			original_store_uid, source, rule->match, cancellable, &driver->priv->error);
+			original_store_uid, source, rule->match, state->junk_status,
+			cancellable, &driver->priv->error);
 
 		switch (result) {
 		case CAMEL_SEARCH_ERROR:
@@ -1865,8 +1958,7 @@ camel_filter_driver_filter_message (CamelFilterDriver *driver,
 	if (driver->priv->message)
 		g_object_unref (driver->priv->message);
 
-	if (freeinfo)
-		camel_message_info_unref (info);
+	camel_message_info_unref (info);
 
 	return 0;
 
@@ -1877,11 +1969,234 @@ camel_filter_driver_filter_message (CamelFilterDriver *driver,
 	if (driver->priv->message)
 		g_object_unref (driver->priv->message);
 
-	if (freeinfo)
-		camel_message_info_unref (info);
+	camel_message_info_unref (info);
 
 	g_propagate_error (error, driver->priv->error);
 	driver->priv->error = NULL;
 
 	return -1;
 }
+
+static gint
+filter_driver_filter_message (CamelFilterDriver *driver,
+                              CamelMimeMessage *message,
+                              CamelMessageInfo *info,
+                              const gchar *uid,
+                              CamelFolder *source,
+                              const gchar *store_uid,
+                              const gchar *original_store_uid,
+                              GQueue *deferred,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	FilterMessageState state = { 0 };
+
+	state.caller_uid = uid;
+
+	if (info == NULL) {
+		struct _camel_header_raw *h;
+
+		if (message) {
+			g_object_ref (message);
+		} else {
+			message = camel_folder_get_message_sync (
+				source, uid, cancellable, error);
+			if (!message)
+				return -1;
+		}
+
+		h = CAMEL_MIME_PART (message)->headers;
+		info = camel_message_info_new_from_header (NULL, h);
+	} else {
+		if (camel_message_info_flags (info) & CAMEL_MESSAGE_DELETED)
+			return 0;
+
+		uid = camel_message_info_uid (info);
+
+		camel_message_info_ref (info);
+		if (message)
+			g_object_ref (message);
+	}
+
+	if (message != NULL && camel_mime_message_get_source (message) == NULL)
+		camel_mime_message_set_source (message, original_store_uid);
+
+	if (g_strcmp0 (store_uid, "local") == 0 ||
+	    g_strcmp0 (store_uid, "vfolder") == 0) {
+		store_uid = NULL;
+	}
+
+	if (g_strcmp0 (original_store_uid, "local") == 0 ||
+	    g_strcmp0 (original_store_uid, "vfolder") == 0) {
+		original_store_uid = NULL;
+	}
+
+	state.message = message;
+	state.info = info;
+	state.uid = uid;
+	state.source = source;
+	state.store_uid = store_uid;
+	state.original_store_uid = original_store_uid;
+	state.link = g_queue_peek_head_link (&driver->priv->rules);
+	state.junk_status = CAMEL_JUNK_STATUS_ERROR;
+	state.modified = driver->priv->modified;
+
+	return filter_driver_apply_rules (
+		driver, &state, deferred, cancellable, error);
+}
+
+gint
+_camel_filter_driver_filter_message_deferred (CamelFilterDriver *driver,
+                                              CamelMessageInfo *info,
+                                              const gchar *uid,
+                                              CamelFolder *source,
+                                              const gchar *store_uid,
+                                              GQueue *deferred,
+                                              GCancellable *cancellable,
+                                              GError **error)
+{
+	g_return_val_if_fail (CAMEL_IS_FILTER_DRIVER (driver), -1);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (source), -1);
+	g_return_val_if_fail (uid != NULL, -1);
+	g_return_val_if_fail (deferred != NULL, -1);
+
+	return filter_driver_filter_message (
+		driver, NULL, info, uid, source, store_uid,
+		store_uid, deferred, cancellable, error);
+}
+
+gint
+_camel_filter_driver_filter_deferred (CamelFilterDriver *driver,
+                                      GQueue *deferred,
+                                      GPtrArray *done_uids,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	CamelJunkFilter *junk_filter = NULL;
+	CamelJunkStatus *statuses;
+	FilterMessageState *state;
+	GPtrArray *messages;
+	GList *link;
+	GError *local_error = NULL;
+	gint status = 0;
+	guint ii;
+
+	g_return_val_if_fail (CAMEL_IS_FILTER_DRIVER (driver), -1);
+	g_return_val_if_fail (deferred != NULL, -1);
+
+	if (g_queue_is_empty (deferred))
+		return 0;
+
+	messages = g_ptr_array_sized_new (g_queue_get_length (deferred));
+
+	for (link = g_queue_peek_head_link (deferred); link; link = g_list_next (link)) {
+		state = link->data;
+		g_ptr_array_add (messages, state->message);
+	}
+
+	statuses = g_new0 (CamelJunkStatus, messages->len);
+
+	if (driver->priv->session)
+		junk_filter = camel_session_get_junk_filter (driver->priv->session);
+
+	/* Failures are not fatal, the junk-test classifies
+	 * the messages left with an error status on its own */
+	if (junk_filter && !camel_junk_filter_classify_batch (
+		junk_filter, messages, statuses, cancellable, &local_error)) {
+		if (camel_debug ("junk"))
+			printf (
+				"Junk batch classify failed with error: %s\n",
+				local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+
+	for (ii = 0; (state = g_queue_pop_head (deferred)) != NULL; ii++) {
+		if (status == -1) {
+			filter_message_state_free (state);
+			continue;
+		}
+
+		state->junk_status = statuses[ii];
+
+		status = filter_driver_apply_rules (
+			driver, state, NULL, cancellable, error);
+
+		if (status != -1 && done_uids != NULL)
+			g_ptr_array_add (done_uids, (gpointer) state->caller_uid);
+
+		g_slice_free (FilterMessageState, state);
+	}
+
+	g_free (statuses);
+	g_ptr_array_free (messages, TRUE);
+
+	return status;
+}
+
+void
+_camel_filter_driver_clear_deferred (GQueue *deferred)
+{
+	FilterMessageState *state;
+
+	g_return_if_fail (deferred != NULL);
+
+	while ((state = g_queue_pop_head (deferred)) != NULL)
+		filter_message_state_free (state);
+}
+
+/**
+ * camel_filter_driver_filter_message:
+ * @driver: CamelFilterDriver
+ * @message: message to filter or NULL
+ * @info: message info or NULL
+ * @uid: message uid or NULL
+ * @source: source folder or NULL
+ * @store_uid: UID of source store, or %NULL
+ * @original_store_uid: UID of source store (pre-movemail), or %NULL
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Filters a message based on rules defined in the FilterDriver
+ * object. If the source folder (@source) and the uid (@uid) are
+ * provided, the filter will operate on the CamelFolder (which in
+ * certain cases is more efficient than using the default
+ * camel_folder_append_message() function).
+ *
+ * Returns: -1 if errors were encountered during filtering,
+ * otherwise returns 0.
+ *
+ **/
+gint
+camel_filter_driver_filter_message (CamelFilterDriver *driver,
+                                    CamelMimeMessage *message,
+                                    CamelMessageInfo *info,
+                                    const gchar *uid,
+                                    CamelFolder *source,
+                                    const gchar *store_uid,
+                                    const gchar *original_store_uid,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	CamelTraceSpan span;
+	GError *local_error = NULL;
+	gint status;
+
+	g_return_val_if_fail (message != NULL || (source != NULL && uid != NULL), -1);
+
+	camel_trace_span_begin (
+		&span, "filter", "message",
+		source ? camel_folder_get_full_name (source) : NULL);
+
+	status = filter_driver_filter_message (
+		driver, message, info, uid, source, store_uid,
+		original_store_uid, NULL, cancellable, &local_error);
+
+	camel_trace_span_end (
+		&span, info ? (gint64) camel_message_info_size (info) : -1,
+		local_error);
+
+	if (local_error)
+		g_propagate_error (error, local_error);
+
+	return status;
+}
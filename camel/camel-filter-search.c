@@ -63,6 +63,7 @@ typedef struct {
 	CamelMessageInfo *info;
 	CamelFolder *folder;
 	const gchar *source;
+	CamelJunkStatus junk_status;	/* classified in advance, or CAMEL_JUNK_STATUS_ERROR */
 	GCancellable *cancellable;
 	GError **error;
 } FilterMessageSearch;
@@ -973,8 +974,11 @@ junk_test (struct _CamelSExp *f,
 	if (junk_filter == NULL)
 		goto done;
 
-	status = camel_junk_filter_classify (
-		junk_filter, message, fms->cancellable, &error);
+	if (fms->junk_status != CAMEL_JUNK_STATUS_ERROR)
+		status = fms->junk_status;
+	else
+		status = camel_junk_filter_classify (
+			junk_filter, message, fms->cancellable, &error);
 
 	if (error == NULL) {
 		const gchar *status_desc;
@@ -1112,6 +1116,47 @@ camel_filter_search_match (CamelSession *session,
                            const gchar *expression,
 			   GCancellable *cancellable,
                            GError **error)
+{
+	return camel_filter_search_match_with_junk_status (
+		session, get_message, user_data, info, source, folder,
+		expression, CAMEL_JUNK_STATUS_ERROR, cancellable, error);
+}
+
+/**
+ * camel_filter_search_match_with_junk_status:
+ * @session:
+ * @get_message: (scope async): function to retrieve the message if necessary
+ * @user_data: data for above
+ * @info:
+ * @source:
+ * @folder: in which folder the message is stored
+ * @expression:
+ * @junk_status: result of an earlier junk classification of the message,
+ *    or %CAMEL_JUNK_STATUS_ERROR if it was not classified
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Same as camel_filter_search_match(), except that a "junk-test" uses
+ * @junk_status instead of calling the session's #CamelJunkFilter, when
+ * it gets that far.  This lets callers classify many messages with
+ * camel_junk_filter_classify_batch() up front.
+ *
+ * Returns: one of CAMEL_SEARCH_MATCHED, CAMEL_SEARCH_NOMATCH, or
+ * CAMEL_SEARCH_ERROR.
+ *
+ * Since: 3.20
+ **/
+gint
+camel_filter_search_match_with_junk_status (CamelSession *session,
+                                            CamelFilterSearchGetMessageFunc get_message,
+                                            gpointer user_data,
+                                            CamelMessageInfo *info,
+                                            const gchar *source,
+                                            CamelFolder *folder,
+                                            const gchar *expression,
+                                            CamelJunkStatus junk_status,
+                                            GCancellable *cancellable,
+                                            GError **error)
 {
 	FilterMessageSearch fms;
 	CamelSExp *sexp;
@@ -1127,6 +1172,7 @@ camel_filter_search_match (CamelSession *session,
 	fms.info = info;
 	fms.source = source;
 	fms.folder = folder;
+	fms.junk_status = junk_status;
 	fms.cancellable = cancellable;
 	fms.error = &local_error;
 
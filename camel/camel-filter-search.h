@@ -25,6 +25,7 @@
 #ifndef CAMEL_FILTER_SEARCH_H
 #define CAMEL_FILTER_SEARCH_H
 
+#include <camel/camel-enums.h>
 #include <camel/camel-mime-message.h>
 #include <camel/camel-folder-summary.h>
 
@@ -49,6 +50,17 @@ gint camel_filter_search_match (struct _CamelSession *session,
 				const gchar *expression,
 				GCancellable *cancellable,
 				GError **error);
+gint camel_filter_search_match_with_junk_status
+			       (struct _CamelSession *session,
+				CamelFilterSearchGetMessageFunc get_message,
+				gpointer user_data,
+				CamelMessageInfo *info,
+				const gchar *source,
+				struct _CamelFolder *folder,
+				const gchar *expression,
+				CamelJunkStatus junk_status,
+				GCancellable *cancellable,
+				GError **error);
 
 G_END_DECLS
 
@@ -579,6 +579,27 @@ match_words_message (CamelFolder *folder,
 	return truth;
 }
 
+/* The messages not in the body index yet, like those queued to be
+ * indexed in the background, are searched by reading them */
+static void
+match_words_unindexed (CamelFolderSearch *search,
+                       struct _camel_search_words *words,
+                       GPtrArray *matches,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	GPtrArray *v = search->summary_set ? search->summary_set : search->summary;
+	gint i;
+
+	for (i = 0; i < v->len && !g_cancellable_is_cancelled (cancellable); i++) {
+		gchar *uid = g_ptr_array_index (v, i);
+
+		if (!camel_index_has_name (search->body_index, uid) &&
+		    match_words_message (search->folder, uid, words, cancellable, error))
+			g_ptr_array_add (matches, uid);
+	}
+}
+
 static GPtrArray *
 match_words_messages (CamelFolderSearch *search,
                       struct _camel_search_words *words,
@@ -609,6 +630,8 @@ match_words_messages (CamelFolderSearch *search,
 		}
 
 		g_ptr_array_free (indexed, TRUE);
+
+		match_words_unindexed (search, words, matches, cancellable, error);
 	} else {
 		GPtrArray *v = search->summary_set ? search->summary_set : search->summary;
 
@@ -1120,12 +1143,27 @@ folder_search_body_contains (CamelSExp *sexp,
 				if (argv[i]->type == CAMEL_SEXP_RES_STRING) {
 					words = camel_search_words_split ((const guchar *) argv[i]->value.string);
 					truth = TRUE;
-					if ((words->type & CAMEL_SEARCH_WORD_COMPLEX) == 0 && search->body_index) {
-						for (j = 0; j < words->len && truth; j++)
+					if ((words->type & CAMEL_SEARCH_WORD_COMPLEX) == 0 && search->body_index &&
+					    camel_index_has_name (search->body_index, camel_message_info_uid (search->current))) {
+						struct _camel_search_words *simple;
+
+						/* the pieces of n-gram words only tell the message
+						 * may contain them, the message has to confirm it */
+						simple = camel_search_words_simple (words);
+						for (j = 0; j < simple->len && truth; j++)
 							truth = match_message_index (
 								search->body_index,
 								camel_message_info_uid (search->current),
-								words->words[j]->word,
+								simple->words[j]->word,
+								error);
+						camel_search_words_free (simple);
+
+						if (truth && (words->type & CAMEL_SEARCH_WORD_NGRAM) != 0)
+							truth = match_words_message (
+								search->folder,
+								camel_message_info_uid (search->current),
+								words,
+								search->priv->cancellable,
 								error);
 					} else {
 						/* TODO: cache current message incase of multiple body search terms */
@@ -1161,8 +1199,9 @@ folder_search_body_contains (CamelSExp *sexp,
 			for (i = 0; i < argc && !g_cancellable_is_cancelled (search->priv->cancellable); i++) {
 				if (argv[i]->type == CAMEL_SEXP_RES_STRING) {
 					words = camel_search_words_split ((const guchar *) argv[i]->value.string);
-					if ((words->type & CAMEL_SEARCH_WORD_COMPLEX) == 0 && search->body_index) {
+					if ((words->type & (CAMEL_SEARCH_WORD_COMPLEX | CAMEL_SEARCH_WORD_NGRAM)) == 0 && search->body_index) {
 						matches = match_words_index (search, words, search->priv->cancellable, error);
+						match_words_unindexed (search, words, matches, search->priv->cancellable, error);
 					} else {
 						matches = match_words_messages (search, words, search->priv->cancellable, error);
 					}
@@ -1350,8 +1389,10 @@ folder_search_header_regex (CamelSExp *sexp,
 			    g_ascii_strcasecmp (hader_name, "CC") == 0 ||
 			    g_ascii_strcasecmp (hader_name, "BCC") == 0 ||
 			    g_ascii_strcasecmp (hader_name, "Subject") == 0) {
-				decoded = get_header_decoded (contents, get_default_charset (msg));
-				if (decoded)
+				decoded = camel_mime_part_dup_decoded_header (
+					CAMEL_MIME_PART (msg),
+					hader_name, get_default_charset (msg));
+				if (decoded && *decoded)
 					contents = decoded;
 			}
 
@@ -1873,6 +1914,9 @@ do_search_in_memory (CamelFolder *search_in_folder,
 		"header-has-words",
 		"header-ends-with",
 		NULL };
+	const gchar *full_name = NULL;
+	gboolean with_message_tags = FALSE;
+	gboolean with_header_index = FALSE;
 	gint i;
 
 	if (search_in_folder &&
@@ -1883,18 +1927,59 @@ do_search_in_memory (CamelFolder *search_in_folder,
 	if (!expr)
 		return FALSE;
 
+	if (search_in_folder) {
+		CamelStore *parent_store;
+
+		full_name = camel_folder_get_full_name (search_in_folder);
+		parent_store = camel_folder_get_parent_store (search_in_folder);
+
+		if (parent_store && parent_store->cdb_r) {
+			with_message_tags = camel_db_has_message_tags (parent_store->cdb_r, full_name);
+			with_header_index = camel_db_has_header_index (parent_store->cdb_r, full_name);
+		}
+	}
+
 	for (i = 0; in_memory_tokens[i]; i++) {
+		/* the header index answers these without loading the summary */
+		if (with_header_index && (
+		    g_str_equal (in_memory_tokens[i], "header-contains") ||
+		    g_str_equal (in_memory_tokens[i], "header-has-words")))
+			continue;
+
 		if (strstr (expr, in_memory_tokens[i]))
 			return TRUE;
 	}
 
-	*psql_query = camel_sexp_to_sql_sexp (expr);
+	/* labels and user tags of migrated folders are matched through
+	 * their own indexed tables, others compare the summary columns */
+	*psql_query = camel_sexp_to_sql_sexp_with_folder (expr, full_name, with_message_tags, with_header_index);
 
 	/* unknown column can cause NULL sql_query, then an in-memory
 	 * search is required */
 	return !*psql_query;
 }
 
+/* Returns the SQL WHERE clause equivalent to @expr for @folder, or %NULL
+ * when @expr has to be evaluated by the in-memory search. */
+gchar *
+camel_search_folder_expression_to_sql (CamelFolder *folder,
+                                       const gchar *expr)
+{
+	gchar *sql_query = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+
+	if (!expr || !*expr)
+		expr = "(match-all)";
+
+	if (do_search_in_memory (folder, expr, &sql_query)) {
+		g_free (sql_query);
+		return NULL;
+	}
+
+	return sql_query ? sql_query : g_strdup ("1");
+}
+
 /**
  * camel_folder_search_count:
  * @search:
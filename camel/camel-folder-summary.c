@@ -52,6 +52,7 @@
 #include "camel-stream-null.h"
 #include "camel-string-utils.h"
 #include "camel-store.h"
+#include "camel-trace.h"
 #include "camel-vee-folder.h"
 #include "camel-vtrash-folder.h"
 #include "camel-mime-part-utils.h"
@@ -84,6 +85,10 @@ struct _CamelFolderSummaryPrivate {
 	gboolean need_preview;
 	GHashTable *preview_updates;
 
+	GMutex preview_lock;	/* guards preview_paused */
+	GCond preview_cond;
+	gint preview_paused;	/* nesting count of camel_folder_summary_pause_preview() */
+
 	guint32 nextuid;	/* next uid? */
 	guint32 saved_count;	/* how many were saved/loaded */
 	guint32 unread_count;	/* handy totals */
@@ -95,6 +100,8 @@ struct _CamelFolderSummaryPrivate {
 	gboolean build_content;	/* do we try and parse/index the content, or not? */
 
 	GHashTable *uids; /* uids of all known message infos; the 'value' are used flags for the message info */
+	GPtrArray *uids_snapshot; /* shared read-only copy of the 'uids' keys, NULL when not built yet */
+	guint uids_version; /* increments on each change of the 'uids' keys */
 	GHashTable *loaded_infos; /* uid->CamelMessageInfo *, those currently in memory */
 
 	struct _CamelFolder *folder; /* parent folder, for events */
@@ -111,6 +118,13 @@ struct _CamelFolderSummaryPrivate {
 
 #define CAMEL_FOLDER_SUMMARY_VERSION (14)
 
+/* The CamelMIRecordColumns an info is saved with after a load or a save */
+#define MI_RECORD_COLUMNS_SAVED \
+	(CAMEL_MI_RECORD_COLUMN_PART | \
+	 CAMEL_MI_RECORD_COLUMN_LABELS | \
+	 CAMEL_MI_RECORD_COLUMN_USERTAGS | \
+	 CAMEL_MI_RECORD_COLUMN_HEADERS)
+
 /* trivial lists, just because ... */
 struct _node {
 	struct _node *next;
@@ -238,6 +252,8 @@ folder_summary_finalize (GObject *object)
 	CamelFolderSummaryPrivate *priv = summary->priv;
 
 	g_hash_table_destroy (priv->uids);
+	if (priv->uids_snapshot)
+		g_ptr_array_unref (priv->uids_snapshot);
 	remove_all_loaded (summary);
 	g_hash_table_destroy (priv->loaded_infos);
 
@@ -249,6 +265,9 @@ folder_summary_finalize (GObject *object)
 	g_rec_mutex_clear (&priv->summary_lock);
 	g_rec_mutex_clear (&priv->filter_lock);
 
+	g_mutex_clear (&priv->preview_lock);
+	g_cond_clear (&priv->preview_cond);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_folder_summary_parent_class)->finalize (object);
 }
@@ -585,6 +604,7 @@ message_info_from_db (CamelFolderSummary *summary,
 
 	/* Extract Message id & References */
 	mi->content = NULL;
+	mi->saved_columns = MI_RECORD_COLUMNS_SAVED;
 	part = record->part;
 	if (part) {
 		mi->message_id.id.part.hi = bdata_extract_digit (&part);
@@ -684,6 +704,7 @@ message_info_to_db (CamelFolderSummary *summary,
 	}
 	record->part = tmp->str;
 	g_string_free (tmp, FALSE);
+	record->unchanged = mi->saved_columns;
 
 	tmp = g_string_new (NULL);
 	flag = mi->user_flags;
@@ -714,6 +735,20 @@ message_info_to_db (CamelFolderSummary *summary,
 	return record;
 }
 
+static gchar *
+content_info_extract_optional_string (gchar **part)
+{
+	gchar *str;
+
+	str = bdata_extract_string (part);
+	if (str && !*str) {
+		g_free (str);
+		str = NULL;
+	}
+
+	return str;
+}
+
 static CamelMessageContentInfo *
 content_info_from_db (CamelFolderSummary *summary,
                       CamelMIRecord *record)
@@ -751,10 +786,11 @@ content_info_from_db (CamelFolderSummary *summary,
 	}
 	ci->type = ct;
 
-	/* FIXME[disk-summary] move all these to camel pstring */
-	ci->id = bdata_extract_string (&part);
-	ci->description = bdata_extract_string (&part);
-	ci->encoding = bdata_extract_string (&part);
+	/* Most parts have no ID nor description, do not allocate
+	 * an empty string for each */
+	ci->id = content_info_extract_optional_string (&part);
+	ci->description = content_info_extract_optional_string (&part);
+	ci->encoding = content_info_extract_optional_string (&part);
 	ci->size = bdata_extract_digit (&part);
 
 	record->cinfo = part; /* Keep moving the cursor in the record */
@@ -1054,6 +1090,9 @@ info_set_user_flag (CamelMessageInfo *info,
 
 	res = camel_flag_set (&mi->user_flags, name, value);
 
+	if (res)
+		mi->saved_columns &= ~CAMEL_MI_RECORD_COLUMN_LABELS;
+
 	if (mi->summary && res && mi->summary->priv->folder && mi->uid
 	    && camel_folder_summary_check_uid (mi->summary, mi->uid)) {
 		CamelFolderChangeInfo *changes = camel_folder_change_info_new ();
@@ -1079,6 +1118,9 @@ info_set_user_tag (CamelMessageInfo *info,
 
 	res = camel_tag_set (&mi->user_tags, name, value);
 
+	if (res)
+		mi->saved_columns &= ~CAMEL_MI_RECORD_COLUMN_USERTAGS;
+
 	if (mi->summary && res && mi->summary->priv->folder && mi->uid
 	    && camel_folder_summary_check_uid (mi->summary, mi->uid)) {
 		CamelFolderChangeInfo *changes = camel_folder_change_info_new ();
@@ -1340,6 +1382,8 @@ camel_folder_summary_init (CamelFolderSummary *summary)
 
 	summary->priv->need_preview = FALSE;
 	summary->priv->preview_updates = g_hash_table_new (g_str_hash, g_str_equal);
+	g_mutex_init (&summary->priv->preview_lock);
+	g_cond_init (&summary->priv->preview_cond);
 
 	summary->priv->nextuid = 1;
 	summary->priv->uids = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) camel_pstring_free, NULL);
@@ -1478,6 +1522,76 @@ camel_folder_summary_get_visible_count (CamelFolderSummary *summary)
 	return summary->priv->visible_count;
 }
 
+/**
+ * camel_folder_summary_adjust_counts:
+ * @summary: a #CamelFolderSummary object
+ * @saved_count: difference to the saved count
+ * @unread_count: difference to the unread count
+ * @deleted_count: difference to the deleted count
+ * @junk_count: difference to the junk count
+ * @junk_not_deleted_count: difference to the junk-not-deleted count
+ * @visible_count: difference to the visible count
+ *
+ * Adds the given differences to the message counts of @summary,
+ * without any corresponding message info being added or removed.
+ * This is meant for summaries which report counts of messages they
+ * did not load yet, like the virtual folder summaries, which start
+ * with counts remembered from the previous session.
+ *
+ * Since: 3.20
+ **/
+void
+camel_folder_summary_adjust_counts (CamelFolderSummary *summary,
+                                    gint saved_count,
+                                    gint unread_count,
+                                    gint deleted_count,
+                                    gint junk_count,
+                                    gint junk_not_deleted_count,
+                                    gint visible_count)
+{
+	GObject *summary_object;
+
+	g_return_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary));
+
+	summary_object = G_OBJECT (summary);
+
+	camel_folder_summary_lock (summary);
+	g_object_freeze_notify (summary_object);
+
+	if (saved_count) {
+		summary->priv->saved_count += saved_count;
+		g_object_notify (summary_object, "saved-count");
+	}
+
+	if (unread_count) {
+		summary->priv->unread_count += unread_count;
+		g_object_notify (summary_object, "unread-count");
+	}
+
+	if (deleted_count) {
+		summary->priv->deleted_count += deleted_count;
+		g_object_notify (summary_object, "deleted-count");
+	}
+
+	if (junk_count) {
+		summary->priv->junk_count += junk_count;
+		g_object_notify (summary_object, "junk-count");
+	}
+
+	if (junk_not_deleted_count) {
+		summary->priv->junk_not_deleted_count += junk_not_deleted_count;
+		g_object_notify (summary_object, "junk-not-deleted-count");
+	}
+
+	if (visible_count) {
+		summary->priv->visible_count += visible_count;
+		g_object_notify (summary_object, "visible-count");
+	}
+
+	g_object_thaw_notify (summary_object);
+	camel_folder_summary_unlock (summary);
+}
+
 /**
  * camel_folder_summary_set_index:
  * @summary: a #CamelFolderSummary object
@@ -1585,6 +1699,50 @@ camel_folder_summary_get_need_preview (CamelFolderSummary *summary)
 	return summary->priv->need_preview;
 }
 
+/**
+ * camel_folder_summary_pause_preview:
+ * @summary: a #CamelFolderSummary
+ *
+ * Asks the background preview generation of @summary to wait before
+ * it processes the next message, so that it does not compete with
+ * operations the user is waiting for.  Each call should be paired
+ * with camel_folder_summary_resume_preview(); calls can be nested.
+ *
+ * Since: 3.20
+ **/
+void
+camel_folder_summary_pause_preview (CamelFolderSummary *summary)
+{
+	g_return_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary));
+
+	g_mutex_lock (&summary->priv->preview_lock);
+	summary->priv->preview_paused++;
+	g_mutex_unlock (&summary->priv->preview_lock);
+}
+
+/**
+ * camel_folder_summary_resume_preview:
+ * @summary: a #CamelFolderSummary
+ *
+ * Reverts one camel_folder_summary_pause_preview() call.  Preview
+ * generation continues once all pauses have been resumed.
+ *
+ * Since: 3.20
+ **/
+void
+camel_folder_summary_resume_preview (CamelFolderSummary *summary)
+{
+	g_return_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary));
+
+	g_mutex_lock (&summary->priv->preview_lock);
+	g_warn_if_fail (summary->priv->preview_paused > 0);
+	if (summary->priv->preview_paused > 0)
+		summary->priv->preview_paused--;
+	if (summary->priv->preview_paused == 0)
+		g_cond_broadcast (&summary->priv->preview_cond);
+	g_mutex_unlock (&summary->priv->preview_lock);
+}
+
 /**
  * camel_folder_summary_next_uid:
  * @summary: a #CamelFolderSummary object
@@ -1724,6 +1882,18 @@ camel_folder_summary_check_uid (CamelFolderSummary *summary,
 	return ret;
 }
 
+/* Call with the summary lock held, after the set of uids changed */
+static void
+folder_summary_uids_changed (CamelFolderSummary *summary)
+{
+	summary->priv->uids_version++;
+
+	if (summary->priv->uids_snapshot) {
+		g_ptr_array_unref (summary->priv->uids_snapshot);
+		summary->priv->uids_snapshot = NULL;
+	}
+}
+
 static void
 folder_summary_dupe_uids_to_array (gpointer key_uid,
                                    gpointer value_flags,
@@ -1732,6 +1902,75 @@ folder_summary_dupe_uids_to_array (gpointer key_uid,
 	g_ptr_array_add (user_data, (gpointer) camel_pstring_strdup (key_uid));
 }
 
+/**
+ * camel_folder_summary_ref_array:
+ * @summary: a #CamelFolderSummary object
+ *
+ * Obtains a shared snapshot of the uids in the summary.  Unlike
+ * camel_folder_summary_get_array(), which copies all the uids on each
+ * call, the snapshot is built once and then shared by all the callers
+ * until the set of uids in the @summary changes.  Changes done after
+ * the call do not influence the returned array.
+ *
+ * The array must not be modified.  Callers which need to sort or
+ * otherwise change it should use camel_folder_summary_get_array().
+ *
+ * Free with g_ptr_array_unref().
+ *
+ * Returns: (element-type utf8) (transfer full): a read-only #GPtrArray of uids
+ *
+ * Since: 3.20
+ **/
+GPtrArray *
+camel_folder_summary_ref_array (CamelFolderSummary *summary)
+{
+	GPtrArray *res;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary), NULL);
+
+	camel_folder_summary_lock (summary);
+
+	if (!summary->priv->uids_snapshot) {
+		res = g_ptr_array_new_full (g_hash_table_size (summary->priv->uids), (GDestroyNotify) camel_pstring_free);
+		g_hash_table_foreach (summary->priv->uids, folder_summary_dupe_uids_to_array, res);
+
+		summary->priv->uids_snapshot = res;
+	}
+
+	res = g_ptr_array_ref (summary->priv->uids_snapshot);
+
+	camel_folder_summary_unlock (summary);
+
+	return res;
+}
+
+/**
+ * camel_folder_summary_get_array_version:
+ * @summary: a #CamelFolderSummary object
+ *
+ * Returns a number which changes whenever a uid is added to or removed
+ * from the @summary, thus callers can find out whether the set of uids
+ * they obtained earlier, with camel_folder_summary_ref_array()
+ * or camel_folder_summary_get_array(), is still current.
+ *
+ * Returns: the current version of the set of uids
+ *
+ * Since: 3.20
+ **/
+guint
+camel_folder_summary_get_array_version (CamelFolderSummary *summary)
+{
+	guint version;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary), 0);
+
+	camel_folder_summary_lock (summary);
+	version = summary->priv->uids_version;
+	camel_folder_summary_unlock (summary);
+
+	return version;
+}
+
 /**
  * camel_folder_summary_get_array:
  * @summary: a #CamelFolderSummary object
@@ -2211,28 +2450,91 @@ cfs_cache_size (CamelFolderSummary *summary)
 
 /* Update preview of cached messages */
 
-static void
-msg_update_preview (const gchar *uid,
-                    gpointer value,
-                    CamelFolder *folder)
+/* How many previews are built before they are written to the
+ * database in one transaction and the job checks for pauses. */
+#define PREVIEW_BATCH_SIZE 50
+
+/* Blocks while preview generation is paused, see
+ * camel_folder_summary_pause_preview().  Returns FALSE when
+ * the job had been cancelled meanwhile. */
+static gboolean
+preview_wait_unpaused (CamelFolderSummary *summary,
+                       GCancellable *cancellable)
+{
+	g_mutex_lock (&summary->priv->preview_lock);
+
+	while (summary->priv->preview_paused > 0 &&
+	       !g_cancellable_is_cancelled (cancellable)) {
+		/* Wake up periodically to notice cancellation. */
+		g_cond_wait_until (
+			&summary->priv->preview_cond,
+			&summary->priv->preview_lock,
+			g_get_monotonic_time () + G_TIME_SPAN_SECOND / 2);
+	}
+
+	g_mutex_unlock (&summary->priv->preview_lock);
+
+	return !g_cancellable_is_cancelled (cancellable);
+}
+
+static gboolean
+msg_update_preview (CamelFolder *folder,
+                    const gchar *uid,
+                    GCancellable *cancellable)
 {
-	CamelMessageInfoBase *info = (CamelMessageInfoBase *) camel_folder_summary_get (folder->summary, uid);
+	CamelMessageInfoBase *info;
 	CamelMimeMessage *msg;
+	gboolean has_preview = FALSE;
+
+	info = (CamelMessageInfoBase *) camel_folder_summary_get (folder->summary, uid);
+	if (info == NULL)
+		return FALSE;
+
+	msg = camel_folder_get_message_sync (folder, uid, cancellable, NULL);
+	if (msg != NULL) {
+		g_free (info->preview);
+		info->preview = NULL;
+
+		has_preview = camel_mime_message_build_preview ((CamelMimePart *) msg, (CamelMessageInfo *) info) && info->preview;
+
+		g_object_unref (msg);
+	}
+
+	camel_message_info_unref (info);
+
+	return has_preview;
+}
+
+static void
+msg_save_preview_batch (CamelFolder *folder,
+                        GPtrArray *uids)
+{
 	CamelStore *parent_store;
 	const gchar *full_name;
+	gint i;
+
+	if (uids->len == 0)
+		return;
 
 	full_name = camel_folder_get_full_name (folder);
 	parent_store = camel_folder_get_parent_store (folder);
 
-	/* FIXME Pass a GCancellable */
-	msg = camel_folder_get_message_sync (folder, uid, NULL, NULL);
-	if (msg != NULL) {
-		if (camel_mime_message_build_preview ((CamelMimePart *) msg, (CamelMessageInfo *) info) && info->preview) {
-			if (!is_in_memory_summary (folder->summary))
-				camel_db_write_preview_record (parent_store->cdb_w, full_name, info->uid, info->preview, NULL);
-		}
+	camel_db_begin_transaction (parent_store->cdb_w, NULL);
+
+	for (i = 0; i < uids->len; i++) {
+		CamelMessageInfoBase *info;
+
+		info = (CamelMessageInfoBase *) camel_folder_summary_get (folder->summary, uids->pdata[i]);
+		if (info == NULL)
+			continue;
+
+		if (info->preview)
+			camel_db_write_preview_record (parent_store->cdb_w, full_name, info->uid, info->preview, NULL);
+
+		camel_message_info_unref (info);
 	}
-	camel_message_info_unref (info);
+
+	camel_db_end_transaction (parent_store->cdb_w, NULL);
 }
 
 static void
@@ -2274,19 +2576,20 @@ preview_update (CamelSession *session,
                 CamelFolder *folder,
                 GError **error)
 {
-	/* FIXME: Either lock & use or copy & use.*/
-	GPtrArray *uids_uncached, *uids_array;
+	GPtrArray *uids_uncached, *uids_array, *uids_todo, *uids_batch;
 	GHashTable *preview_data, *uids_hash;
+	GHashTableIter iter;
+	gpointer key;
 	CamelStore *parent_store;
 	const gchar *full_name;
 	gboolean is_in_memory = is_in_memory_summary (folder->summary);
 	gint i;
 
-	uids_array = camel_folder_summary_get_array (folder->summary);
+	uids_array = camel_folder_summary_ref_array (folder->summary);
 	uids_hash = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) camel_pstring_free, NULL);
 	g_ptr_array_foreach (uids_array, copy_all_uids_to_hash, uids_hash);
 	uids_uncached = camel_folder_get_uncached_uids (folder, uids_array, NULL);
-	camel_folder_summary_free_array (uids_array);
+	g_ptr_array_unref (uids_array);
 	uids_array = NULL;
 
 	full_name = camel_folder_get_full_name (folder);
@@ -2305,15 +2608,47 @@ preview_update (CamelSession *session,
 		g_hash_table_remove (uids_hash, uids_uncached->pdata[i]);
 	}
 
-	camel_folder_lock (folder);
-	if (!is_in_memory)
-		camel_db_begin_transaction (parent_store->cdb_w, NULL);
-	g_hash_table_foreach (uids_hash, (GHFunc) msg_update_preview, folder);
-	if (!is_in_memory)
-		camel_db_end_transaction (parent_store->cdb_w, NULL);
-	camel_folder_unlock (folder);
 	camel_folder_free_uids (folder, uids_uncached);
+
+	uids_todo = g_ptr_array_new_full (g_hash_table_size (uids_hash), (GDestroyNotify) camel_pstring_free);
+	g_hash_table_iter_init (&iter, uids_hash);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		g_ptr_array_add (uids_todo, key);
+		g_hash_table_iter_steal (&iter);
+	}
 	g_hash_table_destroy (uids_hash);
+
+	/* Work in small batches, without holding the folder lock for
+	 * the whole run, so that user operations on the folder are not
+	 * blocked behind a long preview update.  Each batch is written
+	 * in its own short transaction. */
+	uids_batch = g_ptr_array_sized_new (PREVIEW_BATCH_SIZE);
+
+	for (i = 0; i < uids_todo->len; i++) {
+		if (!preview_wait_unpaused (folder->summary, cancellable))
+			break;
+
+		if (msg_update_preview (folder, uids_todo->pdata[i], cancellable))
+			g_ptr_array_add (uids_batch, uids_todo->pdata[i]);
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		if (uids_batch->len >= PREVIEW_BATCH_SIZE) {
+			if (!is_in_memory)
+				msg_save_preview_batch (folder, uids_batch);
+			g_ptr_array_set_size (uids_batch, 0);
+
+			camel_operation_progress (cancellable, (i + 1) * 100 / uids_todo->len);
+		}
+	}
+
+	/* Store also what was done before a cancellation. */
+	if (!is_in_memory)
+		msg_save_preview_batch (folder, uids_batch);
+
+	g_ptr_array_free (uids_batch, TRUE);
+	g_ptr_array_free (uids_todo, TRUE);
 }
 
 /* end */
@@ -2353,8 +2688,7 @@ cfs_reload_from_db (CamelFolderSummary *summary,
 	cfs_schedule_info_release_timer (summary);
 
 	/* FIXME Convert this to a GTask, submitted through
-	 *       camel_service_queue_task().  Then it won't
-	 *       have to call camel_folder_lock/unlock(). */
+	 *       camel_service_queue_task(). */
 	if (summary->priv->need_preview) {
 		CamelSession *session;
 
@@ -2423,20 +2757,36 @@ camel_folder_summary_prepare_fetch_all (CamelFolderSummary *summary,
 		camel_folder_summary_lock (summary);
 		cfs_reload_from_db (summary, error);
 		camel_folder_summary_unlock (summary);
+	} else if (known > loaded) {
+		GPtrArray *uids;
+		guint ii;
+
+		/* only a few are missing, load them one by one, walking
+		 * the shared snapshot instead of a copy of all the uids */
+		uids = camel_folder_summary_ref_array (summary);
+
+		for (ii = 0; ii < uids->len; ii++) {
+			const gchar *uid = g_ptr_array_index (uids, ii);
+			CamelMessageInfo *info;
+
+			info = camel_folder_summary_peek_loaded (summary, uid);
+			if (!info)
+				info = camel_folder_summary_get (summary, uid);
+
+			if (info)
+				camel_message_info_unref (info);
+		}
+
+		g_ptr_array_unref (uids);
 	}
 
 	/* update also cache load time, even when not loaded anything */
 	summary->priv->cache_load_time = time (NULL);
 }
 
-/**
- * camel_folder_summary_load_from_db:
- *
- * Since: 2.24
- **/
-gboolean
-camel_folder_summary_load_from_db (CamelFolderSummary *summary,
-                                   GError **error)
+static gboolean
+folder_summary_load_from_db (CamelFolderSummary *summary,
+                             GError **error)
 {
 	CamelDB *cdb;
 	CamelStore *parent_store;
@@ -2444,11 +2794,6 @@ camel_folder_summary_load_from_db (CamelFolderSummary *summary,
 	gint ret = 0;
 	GError *local_error = NULL;
 
-	g_return_val_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary), FALSE);
-
-	if (is_in_memory_summary (summary))
-		return TRUE;
-
 	camel_folder_summary_lock (summary);
 	camel_folder_summary_save_to_db (summary, NULL);
 
@@ -2468,20 +2813,59 @@ camel_folder_summary_load_from_db (CamelFolderSummary *summary,
 		cdb, full_name, summary->sort_by, summary->collate,
 		summary->priv->uids, &local_error);
 
+	folder_summary_uids_changed (summary);
+
 	if (local_error != NULL && local_error->message != NULL &&
 	    strstr (local_error->message, "no such table") != NULL) {
 		g_clear_error (&local_error);
 
 		/* create table the first time it is accessed and missing */
 		ret = camel_db_prepare_message_info_table (cdb, full_name, error);
-	} else if (local_error != NULL)
+	} else if (local_error != NULL) {
 		g_propagate_error (error, local_error);
+	} else if (!camel_db_has_message_ids (cdb, full_name)) {
+		/* migrate an existing table, thus SQL searches and Message-ID
+		 * lookups can rely on the side tables being filled */
+		ret = camel_db_prepare_message_info_table (cdb, full_name, error);
+	}
 
 	camel_folder_summary_unlock (summary);
 
 	return ret == 0;
 }
 
+/**
+ * camel_folder_summary_load_from_db:
+ *
+ * Since: 2.24
+ **/
+gboolean
+camel_folder_summary_load_from_db (CamelFolderSummary *summary,
+                                   GError **error)
+{
+	CamelTraceSpan span;
+	GError *local_error = NULL;
+	gboolean success;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER_SUMMARY (summary), FALSE);
+
+	if (is_in_memory_summary (summary))
+		return TRUE;
+
+	camel_trace_span_begin (
+		&span, "summary", "load",
+		camel_folder_get_full_name (summary->priv->folder));
+
+	success = folder_summary_load_from_db (summary, &local_error);
+
+	camel_trace_span_end (&span, -1, local_error);
+
+	if (local_error)
+		g_propagate_error (error, local_error);
+
+	return success;
+}
+
 static void
 mir_from_cols (CamelMIRecord *mir,
                CamelFolderSummary *summary,
@@ -2710,6 +3094,7 @@ save_to_db_cb (gpointer key,
 	The FOLDER_FLAGGED should be used to check if the changes are synced to the server.
 	So, dont unset the FOLDER_FLAGGED flag */
 	mi->dirty = FALSE;
+	mi->saved_columns = MI_RECORD_COLUMNS_SAVED;
 
 	camel_db_camel_mir_free (mir);
 }
@@ -2760,26 +3145,15 @@ msg_save_preview (const gchar *uid,
 		parent_store->cdb_w, full_name, uid, (gchar *) value, NULL);
 }
 
-/**
- * camel_folder_summary_save_to_db:
- *
- * Since: 2.24
- **/
-gboolean
-camel_folder_summary_save_to_db (CamelFolderSummary *summary,
-                                 GError **error)
+static gboolean
+folder_summary_save_to_db (CamelFolderSummary *summary,
+                           GError **error)
 {
 	CamelStore *parent_store;
 	CamelDB *cdb;
 	CamelFIRecord *record;
 	gint ret, count;
 
-	g_return_val_if_fail (summary != NULL, FALSE);
-
-	if (!(summary->flags & CAMEL_FOLDER_SUMMARY_DIRTY) ||
-	    is_in_memory_summary (summary))
-		return TRUE;
-
 	parent_store = camel_folder_get_parent_store (summary->priv->folder);
 	cdb = parent_store->cdb_w;
 
@@ -2858,6 +3232,39 @@ camel_folder_summary_save_to_db (CamelFolderSummary *summary,
 	return ret == 0;
 }
 
+/**
+ * camel_folder_summary_save_to_db:
+ *
+ * Since: 2.24
+ **/
+gboolean
+camel_folder_summary_save_to_db (CamelFolderSummary *summary,
+                                 GError **error)
+{
+	CamelTraceSpan span;
+	GError *local_error = NULL;
+	gboolean success;
+
+	g_return_val_if_fail (summary != NULL, FALSE);
+
+	if (!(summary->flags & CAMEL_FOLDER_SUMMARY_DIRTY) ||
+	    is_in_memory_summary (summary))
+		return TRUE;
+
+	camel_trace_span_begin (
+		&span, "summary", "save",
+		camel_folder_get_full_name (summary->priv->folder));
+
+	success = folder_summary_save_to_db (summary, &local_error);
+
+	camel_trace_span_end (&span, -1, local_error);
+
+	if (local_error)
+		g_propagate_error (error, local_error);
+
+	return success;
+}
+
 /**
  * camel_folder_summary_header_save_to_db:
  *
@@ -3019,6 +3426,7 @@ camel_folder_summary_add (CamelFolderSummary *summary,
 		summary->priv->uids,
 		(gpointer) camel_pstring_strdup (camel_message_info_uid (info)),
 		GUINT_TO_POINTER (camel_message_info_flags (info)));
+	folder_summary_uids_changed (summary);
 
 	/* Summary always holds a ref for the loaded infos */
 	g_hash_table_insert (summary->priv->loaded_infos, (gpointer) camel_message_info_uid (info), info);
@@ -3056,6 +3464,7 @@ camel_folder_summary_insert (CamelFolderSummary *summary,
 			summary->priv->uids,
 			(gpointer) camel_pstring_strdup (camel_message_info_uid (info)),
 			GUINT_TO_POINTER (camel_message_info_flags (info)));
+		folder_summary_uids_changed (summary);
 
 		camel_folder_summary_touch (summary);
 	}
@@ -3283,6 +3692,7 @@ camel_folder_summary_clear (CamelFolderSummary *summary,
 	}
 
 	g_hash_table_remove_all (summary->priv->uids);
+	folder_summary_uids_changed (summary);
 	remove_all_loaded (summary);
 	g_hash_table_remove_all (summary->priv->loaded_infos);
 
@@ -3376,6 +3786,7 @@ camel_folder_summary_remove_uid (CamelFolderSummary *summary,
 	uid_copy = camel_pstring_strdup (uid);
 	g_hash_table_remove (summary->priv->uids, uid_copy);
 	g_hash_table_remove (summary->priv->loaded_infos, uid_copy);
+	folder_summary_uids_changed (summary);
 
 	if (!is_in_memory_summary (summary)) {
 		full_name = camel_folder_get_full_name (summary->priv->folder);
@@ -3426,6 +3837,7 @@ camel_folder_summary_remove_uids (CamelFolderSummary *summary,
 
 			folder_summary_update_counts_by_flags (summary, GPOINTER_TO_UINT (ptr_flags), UPDATE_COUNTS_SUB);
 			g_hash_table_remove (summary->priv->uids, uid_copy);
+			folder_summary_uids_changed (summary);
 
 			mi = g_hash_table_lookup (summary->priv->loaded_infos, uid_copy);
 			g_hash_table_remove (summary->priv->loaded_infos, uid_copy);
@@ -3551,53 +3963,6 @@ content_info_new_from_message (CamelFolderSummary *summary,
 	return ci;
 }
 
-static gchar *
-summary_format_address (struct _camel_header_raw *h,
-                        const gchar *name,
-                        const gchar *charset)
-{
-	CamelHeaderAddress *addr;
-	gchar *text, *str;
-
-	if (!(text = (gchar *) camel_header_raw_find (&h, name, NULL)))
-		return NULL;
-
-	while (isspace ((unsigned) *text))
-		text++;
-
-	text = camel_header_unfold (text);
-
-	if ((addr = camel_header_address_decode (text, charset))) {
-		str = camel_header_address_list_format (addr);
-		camel_header_address_list_clear (&addr);
-		g_free (text);
-	} else {
-		str = text;
-	}
-
-	return str;
-}
-
-static gchar *
-summary_format_string (struct _camel_header_raw *h,
-                       const gchar *name,
-                       const gchar *charset)
-{
-	gchar *text, *str;
-
-	if (!(text = (gchar *) camel_header_raw_find (&h, name, NULL)))
-		return NULL;
-
-	while (isspace ((unsigned) *text))
-		text++;
-
-	text = camel_header_unfold (text);
-	str = camel_header_decode_string (text, charset);
-	g_free (text);
-
-	return str;
-}
-
 /**
  * camel_folder_summary_content_info_new:
  * @summary: a #CamelFolderSummary object
@@ -3622,9 +3987,10 @@ static CamelMessageInfo *
 message_info_new_from_header (CamelFolderSummary *summary,
                               struct _camel_header_raw *h)
 {
-	const gchar *received, *date, *content, *charset = NULL;
+	const gchar *content, *charset = NULL;
 	GSList *refs, *irt, *scan;
-	gchar *subject, *from, *to, *cc, *mlist;
+	CamelHeaderIndex *index;
+	gchar *mlist;
 	CamelContentType *ct = NULL;
 	CamelMessageInfoBase *mi;
 	guint8 *digest;
@@ -3637,7 +4003,11 @@ message_info_new_from_header (CamelFolderSummary *summary,
 
 	mi = (CamelMessageInfoBase *) camel_message_info_new (summary);
 
-	if ((content = camel_header_raw_find (&h, "Content-Type", NULL))
+	/* Long Received/DKIM header blocks make repeated list walks
+	 * expensive, hash the names once and look them up from there. */
+	index = camel_header_index_new (h);
+
+	if ((content = camel_header_index_find (index, "Content-Type", NULL))
 	     && (ct = camel_content_type_decode (content))
 	     && (charset = camel_content_type_param (ct, "charset"))
 	     && (g_ascii_strcasecmp (charset, "us-ascii") == 0))
@@ -3645,38 +4015,24 @@ message_info_new_from_header (CamelFolderSummary *summary,
 
 	charset = charset ? camel_iconv_charset_name (charset) : NULL;
 
-	subject = summary_format_string (h, "subject", charset);
-	from = summary_format_address (h, "from", charset);
-	to = summary_format_address (h, "to", charset);
-	cc = summary_format_address (h, "cc", charset);
+	mi->subject = camel_pstring_strdup (camel_header_index_get_decoded (index, "subject", charset));
+	mi->from = camel_pstring_strdup (camel_header_index_get_address (index, "from", charset));
+	mi->to = camel_pstring_strdup (camel_header_index_get_address (index, "to", charset));
+	mi->cc = camel_pstring_strdup (camel_header_index_get_address (index, "cc", charset));
+
 	mlist = camel_header_raw_check_mailing_list (&h);
+	mi->mlist = camel_pstring_add (mlist, TRUE);
 
 	if (ct)
 		camel_content_type_unref (ct);
 
-	mi->subject = camel_pstring_add (subject, TRUE);
-	mi->from = camel_pstring_add (from, TRUE);
-	mi->to = camel_pstring_add (to, TRUE);
-	mi->cc = camel_pstring_add (cc, TRUE);
-	mi->mlist = camel_pstring_add (mlist, TRUE);
-
 	mi->user_flags = NULL;
 	mi->user_tags = NULL;
 
-	if ((date = camel_header_raw_find (&h, "date", NULL)))
-		mi->date_sent = camel_header_decode_date (date, NULL);
-	else
-		mi->date_sent = 0;
-
-	received = camel_header_raw_find (&h, "received", NULL);
-	if (received)
-		received = strrchr (received, ';');
-	if (received)
-		mi->date_received = camel_header_decode_date (received + 1, NULL);
-	else
-		mi->date_received = 0;
+	mi->date_sent = camel_header_index_get_date (index, "date", NULL);
+	mi->date_received = camel_header_index_get_date (index, "received", NULL);
 
-	msgid = camel_header_msgid_decode (camel_header_raw_find (&h, "message-id", NULL));
+	msgid = camel_header_msgid_decode (camel_header_index_find (index, "message-id", NULL));
 	if (msgid) {
 		GChecksum *checksum;
 
@@ -3690,8 +4046,8 @@ message_info_new_from_header (CamelFolderSummary *summary,
 	}
 
 	/* decode our references and in-reply-to headers */
-	refs = camel_header_references_decode (camel_header_raw_find (&h, "references", NULL));
-	irt = camel_header_references_decode (camel_header_raw_find (&h, "in-reply-to", NULL));
+	refs = camel_header_references_decode (camel_header_index_find (index, "references", NULL));
+	irt = camel_header_references_decode (camel_header_index_find (index, "in-reply-to", NULL));
 	if (refs || irt) {
 		if (irt) {
 			/* The References field is populated from the "References" and/or "In-Reply-To"
@@ -3722,6 +4078,8 @@ message_info_new_from_header (CamelFolderSummary *summary,
 		g_slist_free_full (refs, g_free);
 	}
 
+	camel_header_index_free (index);
+
 	return (CamelMessageInfo *) mi;
 }
 
@@ -184,6 +184,8 @@ struct _CamelMessageInfoBase {
 	const gchar *uid;
 	/*FIXME: Make it work with the CAMEL_MESSADE_DB_DIRTY flag instead of another 4 bytes*/
 	guint dirty : 1;
+	/* CamelMIRecordColumns not changed since the info was loaded or saved */
+	guint saved_columns : 4;
 
 	const gchar *subject;
 	const gchar *from;
@@ -370,6 +372,14 @@ guint32		camel_folder_summary_get_junk_not_deleted_count
 						(CamelFolderSummary *summary);
 guint32		camel_folder_summary_get_visible_count
 						(CamelFolderSummary *summary);
+void		camel_folder_summary_adjust_counts
+						(CamelFolderSummary *summary,
+						 gint saved_count,
+						 gint unread_count,
+						 gint deleted_count,
+						 gint junk_count,
+						 gint junk_not_deleted_count,
+						 gint visible_count);
 
 void		camel_folder_summary_set_index	(CamelFolderSummary *summary,
 						 CamelIndex *index);
@@ -384,6 +394,10 @@ void		camel_folder_summary_set_need_preview
 						 gboolean preview);
 gboolean	camel_folder_summary_get_need_preview
 						(CamelFolderSummary *summary);
+void		camel_folder_summary_pause_preview
+						(CamelFolderSummary *summary);
+void		camel_folder_summary_resume_preview
+						(CamelFolderSummary *summary);
 guint32		camel_folder_summary_next_uid	(CamelFolderSummary *summary);
 void		camel_folder_summary_set_next_uid
 						(CamelFolderSummary *summary,
@@ -473,6 +487,9 @@ guint32		camel_folder_summary_get_info_flags
 						 const gchar *uid);
 GPtrArray *	camel_folder_summary_get_array	(CamelFolderSummary *summary);
 void		camel_folder_summary_free_array	(GPtrArray *array);
+GPtrArray *	camel_folder_summary_ref_array	(CamelFolderSummary *summary);
+guint		camel_folder_summary_get_array_version
+						(CamelFolderSummary *summary);
 
 GHashTable *	camel_folder_summary_get_hash	(CamelFolderSummary *summary);
 
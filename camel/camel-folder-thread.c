@@ -31,7 +31,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "camel-db.h"
 #include "camel-folder-thread.h"
+#include "camel-store.h"
 
 #define d(x)
 #define m(x)
@@ -633,6 +635,49 @@ thread_summary (CamelFolderThread *thread,
 #endif
 }
 
+static CamelFolderThread *
+folder_thread_new (CamelFolder *folder,
+                   GPtrArray *uids,
+                   gboolean thread_subject)
+{
+	CamelFolderThread *thread;
+	GPtrArray *summary;
+	GPtrArray *fsummary = NULL;
+	gint i;
+
+	thread = g_malloc (sizeof (*thread));
+	thread->refcount = 1;
+	thread->subject = thread_subject;
+	thread->tree = NULL;
+	thread->node_chunks = camel_memchunk_new (32, sizeof (CamelFolderThreadNode));
+	thread->folder = g_object_ref (folder);
+
+	thread->summary = summary = g_ptr_array_new ();
+
+	/* prefer given order from the summary order */
+	if (!uids) {
+		fsummary = camel_folder_summary_ref_array (folder->summary);
+		uids = fsummary;
+	}
+
+	for (i = 0; i < uids->len; i++) {
+		CamelMessageInfo *info;
+		gchar *uid = uids->pdata[i];
+
+		info = camel_folder_get_message_info (folder, uid);
+		if (info)
+			g_ptr_array_add (summary, info);
+		/* FIXME: Check if the info is leaking */
+	}
+
+	if (fsummary)
+		g_ptr_array_unref (fsummary);
+
+	thread_summary (thread, summary);
+
+	return thread;
+}
+
 /**
  * camel_folder_thread_new:
  * @folder:
@@ -657,41 +702,146 @@ camel_folder_thread_new (CamelFolder *folder,
                                   GPtrArray *uids,
                                   gboolean thread_subject)
 {
-	CamelFolderThread *thread;
-	GPtrArray *summary;
-	GPtrArray *fsummary = NULL;
-	gint i;
+	camel_folder_summary_prepare_fetch_all (folder->summary, NULL);
 
-	thread = g_malloc (sizeof (*thread));
-	thread->refcount = 1;
-	thread->subject = thread_subject;
-	thread->tree = NULL;
-	thread->node_chunks = camel_memchunk_new (32, sizeof (CamelFolderThreadNode));
-	thread->folder = g_object_ref (folder);
+	return folder_thread_new (folder, uids, thread_subject);
+}
 
-	camel_folder_summary_prepare_fetch_all (folder->summary, NULL);
-	thread->summary = summary = g_ptr_array_new ();
+typedef struct _RelatedData {
+	GHashTable *folders;	/* gchar *folder_name ~> GHashTable { gchar *uid } */
+	GQueue pending;		/* gchar *folder_name, gchar *uid pairs */
+} RelatedData;
 
-	/* prefer given order from the summary order */
+static void
+related_data_add (RelatedData *rd,
+                  const gchar *folder_name,
+                  const gchar *uid)
+{
+	GHashTable *uids;
+
+	uids = g_hash_table_lookup (rd->folders, folder_name);
 	if (!uids) {
-		fsummary = camel_folder_summary_get_array (folder->summary);
-		uids = fsummary;
+		uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		g_hash_table_insert (rd->folders, g_strdup (folder_name), uids);
 	}
 
-	for (i = 0; i < uids->len; i++) {
-		CamelMessageInfo *info;
-		gchar *uid = uids->pdata[i];
+	if (!g_hash_table_contains (uids, uid)) {
+		g_hash_table_add (uids, g_strdup (uid));
 
-		info = camel_folder_get_message_info (folder, uid);
-		if (info)
-			g_ptr_array_add (summary, info);
-		/* FIXME: Check if the info is leaking */
+		g_queue_push_tail (&rd->pending, g_strdup (folder_name));
+		g_queue_push_tail (&rd->pending, g_strdup (uid));
 	}
+}
 
-	if (fsummary)
-		camel_folder_summary_free_array (fsummary);
+static gint
+related_messages_cb (gpointer user_data,
+                     gint ncol,
+                     gchar **cols,
+                     gchar **names)
+{
+	RelatedData *rd = user_data;
 
-	thread_summary (thread, summary);
+	g_return_val_if_fail (ncol == 2, 0);
+
+	if (cols[0] && cols[1])
+		related_data_add (rd, cols[0], cols[1]);
+
+	return 0;
+}
+
+/**
+ * camel_folder_thread_new_related:
+ * @folder: a #CamelFolder
+ * @uid: UID of a message in the @folder
+ * @thread_subject: thread based on subject also
+ *
+ * Threads the conversation of the message @uid, without loading the whole
+ * folder summary.  The messages of the conversation are looked up in the
+ * #CAMEL_DB_MESSAGE_IDS_TABLE of the @folder's store with
+ * camel_db_find_related_messages(), following the References through
+ * the messages of all folders, like when a reply to a message of the @folder
+ * was saved in a Sent folder, but only those of the @folder are threaded.
+ * Only the messages saved in the folder summary database are found.
+ *
+ * Folders without the Message-ID table, like virtual folders, have all
+ * their messages threaded, as with camel_folder_thread_new().
+ *
+ * Returns: A CamelFolderThread containing a tree of CamelFolderThreadNode's
+ * which represent the threaded structure of the conversation.
+ *
+ * Since: 3.20
+ **/
+CamelFolderThread *
+camel_folder_thread_new_related (CamelFolder *folder,
+                                 const gchar *uid,
+                                 gboolean thread_subject)
+{
+	CamelFolderThread *thread;
+	CamelStore *parent_store;
+	CamelDB *cdb = NULL;
+	RelatedData rd;
+	GHashTable *folder_uids;
+	GPtrArray *uids;
+	const gchar *full_name;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (uid != NULL, NULL);
+
+	full_name = camel_folder_get_full_name (folder);
+	parent_store = camel_folder_get_parent_store (folder);
+	if (parent_store)
+		cdb = parent_store->cdb_r;
+
+	if (!cdb || (folder->summary->flags & CAMEL_FOLDER_SUMMARY_IN_MEMORY_ONLY) != 0 ||
+	    !camel_db_has_message_ids (cdb, full_name))
+		return camel_folder_thread_new (folder, NULL, thread_subject);
+
+	rd.folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_destroy);
+	g_queue_init (&rd.pending);
+
+	related_data_add (&rd, full_name, uid);
+
+	/* the related messages of the related messages reach the whole
+	 * conversation, like the other replies to the same message */
+	while (!g_queue_is_empty (&rd.pending)) {
+		gchar *pending_folder, *pending_uid;
+		gint ret;
+
+		pending_folder = g_queue_pop_head (&rd.pending);
+		pending_uid = g_queue_pop_head (&rd.pending);
+
+		ret = camel_db_find_related_messages (
+			cdb, pending_folder, pending_uid,
+			related_messages_cb, &rd, NULL);
+
+		g_free (pending_folder);
+		g_free (pending_uid);
+
+		if (ret != 0)
+			break;
+	}
+
+	while (!g_queue_is_empty (&rd.pending))
+		g_free (g_queue_pop_head (&rd.pending));
+
+	uids = g_ptr_array_new ();
+
+	folder_uids = g_hash_table_lookup (rd.folders, full_name);
+	if (folder_uids) {
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init (&iter, folder_uids);
+		while (g_hash_table_iter_next (&iter, &key, NULL))
+			g_ptr_array_add (uids, key);
+	}
+
+	camel_folder_sort_uids (folder, uids);
+
+	thread = folder_thread_new (folder, uids, thread_subject);
+
+	g_ptr_array_free (uids, TRUE);
+	g_hash_table_destroy (rd.folders);
 
 	return thread;
 }
@@ -50,6 +50,7 @@ typedef struct _CamelFolderThread {
 
 /* interface 1: using uid's */
 CamelFolderThread *camel_folder_thread_new (CamelFolder *folder, GPtrArray *uids, gboolean thread_subject);
+CamelFolderThread *camel_folder_thread_new_related (CamelFolder *folder, const gchar *uid, gboolean thread_subject);
 void camel_folder_thread_apply (CamelFolderThread *thread, GPtrArray *uids);
 
 /* interface 2: using messageinfo's. */
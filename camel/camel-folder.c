@@ -22,6 +22,7 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <string.h>
 
 #include <glib/gi18n-lib.h>
@@ -29,6 +30,7 @@
 #include "camel-db.h"
 #include "camel-debug.h"
 #include "camel-filter-driver.h"
+#include "camel-filter-driver-private.h"
 #include "camel-folder.h"
 #include "camel-mempool.h"
 #include "camel-mime-message.h"
@@ -272,6 +274,97 @@ prepare_folder_filter_data_free (FolderFilterData *data)
 	g_thread_unref (thread);
 }
 
+/* Feeds the junk filter with messages in batches of JUNK_LEARN_BATCH. */
+#define JUNK_LEARN_BATCH 32
+
+static gboolean
+folder_filter_learn_batch (CamelJunkFilter *junk_filter,
+                           GPtrArray *messages,
+                           gboolean is_junk,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	gboolean success;
+
+	if (is_junk)
+		success = camel_junk_filter_learn_junk_batch (
+			junk_filter, messages, cancellable, error);
+	else
+		success = camel_junk_filter_learn_not_junk_batch (
+			junk_filter, messages, cancellable, error);
+
+	g_ptr_array_set_size (messages, 0);
+
+	return success;
+}
+
+static gboolean
+folder_filter_learn (CamelFolder *folder,
+                     CamelJunkFilter *junk_filter,
+                     GPtrArray *uids,
+                     gboolean is_junk,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+	GPtrArray *messages;
+	gboolean success = TRUE;
+	gboolean learned = FALSE;
+	gint i;
+
+	messages = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (i = 0; success && i < uids->len; i++) {
+		CamelMimeMessage *message;
+		GError *local_error = NULL;
+		gint pc = 100 * i / uids->len;
+
+		if (g_cancellable_set_error_if_cancelled (
+			cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		message = camel_folder_get_message_sync (
+			folder, uids->pdata[i], cancellable, &local_error);
+
+		if (message == NULL) {
+			if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+				g_propagate_error (error, local_error);
+				success = FALSE;
+				break;
+			}
+
+			/* Skip only this one, the others can be learned */
+			if (camel_debug ("junk"))
+				printf (
+					"Junk learn skips message '%s': %s\n",
+					(const gchar *) uids->pdata[i],
+					local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+			continue;
+		}
+
+		camel_operation_progress (cancellable, pc);
+		g_ptr_array_add (messages, message);
+
+		if (messages->len >= JUNK_LEARN_BATCH) {
+			success = folder_filter_learn_batch (
+				junk_filter, messages, is_junk, cancellable, error);
+			learned |= success;
+		}
+	}
+
+	if (success && messages->len > 0) {
+		success = folder_filter_learn_batch (
+			junk_filter, messages, is_junk, cancellable, error);
+		learned |= success;
+	}
+
+	g_ptr_array_free (messages, TRUE);
+
+	return learned;
+}
+
 static void
 folder_filter (CamelSession *session,
                GCancellable *cancellable,
@@ -317,8 +410,6 @@ folder_filter (CamelSession *session,
 	}
 
 	if (data->junk) {
-		gboolean success = TRUE;
-
 		/* Translators: The %s is replaced with the
 		 * folder name where the operation is running. */
 		camel_operation_push_message (
@@ -327,28 +418,9 @@ folder_filter (CamelSession *session,
 			"Learning new spam messages in '%s'",
 			data->junk->len), display_name);
 
-		for (i = 0; success && i < data->junk->len; i++) {
-			CamelMimeMessage *message;
-			gint pc = 100 * i / data->junk->len;
-
-			if (g_cancellable_set_error_if_cancelled (
-				cancellable, error))
-				break;
-
-			message = camel_folder_get_message_sync (
-				data->folder, data->junk->pdata[i],
-				cancellable, error);
-
-			if (message == NULL)
-				break;
-
-			camel_operation_progress (cancellable, pc);
-			success = camel_junk_filter_learn_junk (
-				junk_filter, message, cancellable, error);
-			g_object_unref (message);
-
-			synchronize |= success;
-		}
+		synchronize |= folder_filter_learn (
+			data->folder, junk_filter, data->junk, TRUE,
+			cancellable, error);
 
 		camel_operation_pop_message (cancellable);
 	}
@@ -357,8 +429,6 @@ folder_filter (CamelSession *session,
 		goto exit;
 
 	if (data->notjunk) {
-		gboolean success = TRUE;
-
 		/* Translators: The %s is replaced with the
 		 * folder name where the operation is running. */
 		camel_operation_push_message (
@@ -367,28 +437,9 @@ folder_filter (CamelSession *session,
 			"Learning new ham messages in '%s'",
 			data->notjunk->len), display_name);
 
-		for (i = 0; success && i < data->notjunk->len; i++) {
-			CamelMimeMessage *message;
-			gint pc = 100 * i / data->notjunk->len;
-
-			if (g_cancellable_set_error_if_cancelled (
-				cancellable, error))
-				break;
-
-			message = camel_folder_get_message_sync (
-				data->folder, data->notjunk->pdata[i],
-				cancellable, error);
-
-			if (message == NULL)
-				break;
-
-			camel_operation_progress (cancellable, pc);
-			success = camel_junk_filter_learn_not_junk (
-				junk_filter, message, cancellable, error);
-			g_object_unref (message);
-
-			synchronize |= success;
-		}
+		synchronize |= folder_filter_learn (
+			data->folder, junk_filter, data->notjunk, FALSE,
+			cancellable, error);
 
 		camel_operation_pop_message (cancellable);
 	}
@@ -405,6 +456,7 @@ folder_filter (CamelSession *session,
 
 	if (data->driver && data->recents) {
 		CamelService *service;
+		GQueue deferred = G_QUEUE_INIT;
 		const gchar *store_uid;
 
 		/* Translators: The %s is replaced with the
@@ -433,15 +485,28 @@ folder_filter (CamelSession *session,
 				continue;
 			}
 
-			status = camel_filter_driver_filter_message (
-				data->driver, NULL, info, uid, data->folder,
-				store_uid, store_uid, cancellable, error);
+			status = _camel_filter_driver_filter_message_deferred (
+				data->driver, info, uid, data->folder,
+				store_uid, &deferred, cancellable, error);
 
 			camel_message_info_unref (info);
+
+			if (status == 0 && g_queue_get_length (&deferred) >= JUNK_CLASSIFY_BATCH)
+				status = _camel_filter_driver_filter_deferred (
+					data->driver, &deferred, NULL,
+					cancellable, error);
 		}
 
+		if (status == 0)
+			status = _camel_filter_driver_filter_deferred (
+				data->driver, &deferred, NULL,
+				cancellable, error);
+
 		camel_operation_pop_message (cancellable);
 
+		/* Those left when the filtering stopped early */
+		_camel_filter_driver_clear_deferred (&deferred);
+
 		camel_filter_driver_flush (data->driver, error);
 	}
 
@@ -2068,6 +2133,182 @@ camel_folder_sort_uids (CamelFolder *folder,
 	class->sort_uids (folder, uids);
 }
 
+static gint
+duplicate_message_ids_cb (gpointer user_data,
+                          gint ncol,
+                          gchar **cols,
+                          gchar **names)
+{
+	GPtrArray *groups = user_data;
+	GPtrArray *group = NULL;
+
+	g_return_val_if_fail (ncol == 3, 0);
+
+	if (!cols[0] || !cols[2])
+		return 0;
+
+	/* rows come ordered by msgid; a group's msgid is kept as its first element */
+	if (groups->len > 0) {
+		group = g_ptr_array_index (groups, groups->len - 1);
+		if (g_strcmp0 (g_ptr_array_index (group, 0), cols[0]) != 0)
+			group = NULL;
+	}
+
+	if (!group) {
+		group = g_ptr_array_new_with_free_func (g_free);
+		g_ptr_array_add (group, g_strdup (cols[0]));
+		g_ptr_array_add (groups, group);
+	}
+
+	g_ptr_array_add (group, g_strdup (cols[2]));
+
+	return 0;
+}
+
+/* Groups UIDs of the messages of the folder's summary by their Message-ID,
+ * for summaries which are not in the store's Message-ID table */
+static void
+folder_group_message_ids_in_memory (CamelFolder *folder,
+                                    GPtrArray *groups)
+{
+	GHashTable *by_id;
+	GPtrArray *array;
+	guint ii;
+
+	by_id = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+
+	camel_folder_summary_prepare_fetch_all (folder->summary, NULL);
+	array = camel_folder_summary_ref_array (folder->summary);
+
+	for (ii = 0; ii < array->len; ii++) {
+		CamelMessageInfoBase *info;
+		GPtrArray *group;
+		gint64 *msgid;
+
+		info = (CamelMessageInfoBase *) camel_folder_summary_get (folder->summary, g_ptr_array_index (array, ii));
+		if (!info)
+			continue;
+
+		if (info->message_id.id.id) {
+			msgid = g_new (gint64, 1);
+			*msgid = (gint64) info->message_id.id.id;
+
+			group = g_hash_table_lookup (by_id, msgid);
+			if (!group) {
+				group = g_ptr_array_new_with_free_func (g_free);
+				g_ptr_array_add (group, g_strdup_printf ("%" G_GINT64_FORMAT, *msgid));
+				g_ptr_array_add (groups, group);
+				g_hash_table_insert (by_id, msgid, group);
+			} else {
+				g_free (msgid);
+			}
+
+			g_ptr_array_add (group, g_strdup (camel_message_info_uid (info)));
+		}
+
+		camel_message_info_unref (info);
+	}
+
+	g_ptr_array_unref (array);
+	g_hash_table_destroy (by_id);
+}
+
+/**
+ * camel_folder_find_duplicate_uids:
+ * @folder: a #CamelFolder
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finds messages of the @folder which are duplicates of other messages
+ * of the same folder, like when the same message was delivered or copied
+ * into the folder twice.  Messages are duplicates when they have the same
+ * Message-ID and subject.  Of each set of duplicates, the first message
+ * in the camel_folder_sort_uids() order is not included in the result,
+ * thus removing the returned messages keeps one copy of each.
+ *
+ * The candidates are looked up with camel_db_find_duplicate_message_ids()
+ * in the store's Message-ID table, without loading the folder summary,
+ * when the folder's messages are there.
+ *
+ * Returns: (element-type utf8) (transfer full): UIDs of the duplicate
+ * messages, or %NULL on error; free it with g_ptr_array_unref()
+ *
+ * Since: 3.20
+ **/
+GPtrArray *
+camel_folder_find_duplicate_uids (CamelFolder *folder,
+                                  GError **error)
+{
+	CamelStore *parent_store;
+	CamelDB *cdb = NULL;
+	GPtrArray *groups, *duplicates;
+	const gchar *full_name;
+	guint ii, jj, kk;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+
+	full_name = camel_folder_get_full_name (folder);
+	parent_store = camel_folder_get_parent_store (folder);
+	if (parent_store)
+		cdb = parent_store->cdb_r;
+
+	groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+
+	if (cdb && (folder->summary->flags & CAMEL_FOLDER_SUMMARY_IN_MEMORY_ONLY) == 0 &&
+	    camel_db_has_message_ids (cdb, full_name)) {
+		if (camel_db_find_duplicate_message_ids (cdb, full_name, duplicate_message_ids_cb, groups, error) != 0) {
+			g_ptr_array_unref (groups);
+			return NULL;
+		}
+	} else {
+		folder_group_message_ids_in_memory (folder, groups);
+	}
+
+	duplicates = g_ptr_array_new_with_free_func (g_free);
+
+	for (ii = 0; ii < groups->len; ii++) {
+		GPtrArray *group = g_ptr_array_index (groups, ii);
+		GPtrArray *infos;
+
+		/* the first element is the Message-ID */
+		if (group->len < 3)
+			continue;
+
+		g_ptr_array_remove_index (group, 0);
+		camel_folder_sort_uids (folder, group);
+
+		infos = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_message_info_unref);
+
+		for (jj = 0; jj < group->len; jj++) {
+			CamelMessageInfo *info;
+			gboolean is_duplicate = FALSE;
+
+			info = camel_folder_get_message_info (folder, g_ptr_array_index (group, jj));
+			if (!info)
+				continue;
+
+			/* the Message-ID hash only finds the candidates */
+			for (kk = 0; kk < infos->len && !is_duplicate; kk++) {
+				is_duplicate = g_strcmp0 (
+					camel_message_info_subject (g_ptr_array_index (infos, kk)),
+					camel_message_info_subject (info)) == 0;
+			}
+
+			if (is_duplicate) {
+				g_ptr_array_add (duplicates, g_strdup (camel_message_info_uid (info)));
+				camel_message_info_unref (info);
+			} else {
+				g_ptr_array_add (infos, info);
+			}
+		}
+
+		g_ptr_array_unref (infos);
+	}
+
+	g_ptr_array_unref (groups);
+
+	return duplicates;
+}
+
 /**
  * camel_folder_get_summary:
  * @folder: a #CamelFolder
@@ -2142,9 +2383,17 @@ camel_folder_search_by_expression (CamelFolder *folder,
 
 	/* NOTE: that it is upto the callee to CAMEL_FOLDER_REC_LOCK */
 
+	/* Searches are interactive, let them not compete
+	 * with the background preview generation. */
+	if (folder->summary)
+		camel_folder_summary_pause_preview (folder->summary);
+
 	matches = class->search_by_expression (folder, expression, cancellable, error);
 	CAMEL_CHECK_GERROR (folder, search_by_expression, matches != NULL, error);
 
+	if (folder->summary)
+		camel_folder_summary_resume_preview (folder->summary);
+
 	return matches;
 }
 
@@ -3027,6 +3276,11 @@ camel_folder_get_message_sync (CamelFolder *folder,
 		cancellable, _("Retrieving message '%s' in %s"),
 		message_uid, camel_folder_get_display_name (folder));
 
+	/* Do not let the background preview generation
+	 * fetch further messages while this one is loading. */
+	if (folder->summary)
+		camel_folder_summary_pause_preview (folder->summary);
+
 	if (class->get_message_cached) {
 		/* Return cached message, if available locally; this should
 		 * not do any network I/O, only check if message is already
@@ -3040,14 +3294,19 @@ camel_folder_get_message_sync (CamelFolder *folder,
 
 	if (message == NULL) {
 		/* Recover from a dropped connection, unless we're offline. */
-		if (!folder_maybe_connect_sync (folder, cancellable, error))
+		if (!folder_maybe_connect_sync (folder, cancellable, error)) {
+			if (folder->summary)
+				camel_folder_summary_resume_preview (folder->summary);
 			return NULL;
+		}
 
 		camel_folder_lock (folder);
 
 		/* Check for cancellation after locking. */
 		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
 			camel_folder_unlock (folder);
+			if (folder->summary)
+				camel_folder_summary_resume_preview (folder->summary);
 			camel_operation_pop_message (cancellable);
 			return NULL;
 		}
@@ -3070,6 +3329,9 @@ camel_folder_get_message_sync (CamelFolder *folder,
 		camel_mime_message_set_source (message, uid);
 	}
 
+	if (folder->summary)
+		camel_folder_summary_resume_preview (folder->summary);
+
 	camel_operation_pop_message (cancellable);
 
 	if (message != NULL && camel_debug_start (":folder")) {
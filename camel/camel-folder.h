@@ -341,6 +341,9 @@ gint		camel_folder_cmp_uids		(CamelFolder *folder,
 						 const gchar *uid2);
 void		camel_folder_sort_uids		(CamelFolder *folder,
 						 GPtrArray *uids);
+GPtrArray *	camel_folder_find_duplicate_uids
+						(CamelFolder *folder,
+						 GError **error);
 GPtrArray *	camel_folder_search_by_expression
 						(CamelFolder *folder,
 						 const gchar *expression,
@@ -24,9 +24,66 @@
 
 G_DEFINE_INTERFACE (CamelJunkFilter, camel_junk_filter, G_TYPE_OBJECT)
 
+static gboolean
+junk_filter_classify_batch (CamelJunkFilter *junk_filter,
+                            GPtrArray *messages,
+                            CamelJunkStatus *out_statuses,
+                            GCancellable *cancellable,
+                            GError **error)
+{
+	gboolean success = TRUE;
+	guint ii;
+
+	for (ii = 0; ii < messages->len; ii++)
+		out_statuses[ii] = CAMEL_JUNK_STATUS_ERROR;
+
+	for (ii = 0; success && ii < messages->len; ii++) {
+		out_statuses[ii] = camel_junk_filter_classify (
+			junk_filter, messages->pdata[ii], cancellable, error);
+		success = out_statuses[ii] != CAMEL_JUNK_STATUS_ERROR;
+	}
+
+	return success;
+}
+
+static gboolean
+junk_filter_learn_junk_batch (CamelJunkFilter *junk_filter,
+                              GPtrArray *messages,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	gboolean success = TRUE;
+	guint ii;
+
+	for (ii = 0; success && ii < messages->len; ii++)
+		success = camel_junk_filter_learn_junk (
+			junk_filter, messages->pdata[ii], cancellable, error);
+
+	return success;
+}
+
+static gboolean
+junk_filter_learn_not_junk_batch (CamelJunkFilter *junk_filter,
+                                  GPtrArray *messages,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	gboolean success = TRUE;
+	guint ii;
+
+	for (ii = 0; success && ii < messages->len; ii++)
+		success = camel_junk_filter_learn_not_junk (
+			junk_filter, messages->pdata[ii], cancellable, error);
+
+	return success;
+}
+
 static void
 camel_junk_filter_default_init (CamelJunkFilterInterface *iface)
 {
+	iface->classify_batch = junk_filter_classify_batch;
+	iface->learn_junk_batch = junk_filter_learn_junk_batch;
+	iface->learn_not_junk_batch = junk_filter_learn_not_junk_batch;
 }
 
 /**
@@ -175,3 +232,120 @@ camel_junk_filter_synchronize (CamelJunkFilter *junk_filter,
 	return success;
 }
 
+/**
+ * camel_junk_filter_classify_batch:
+ * @junk_filter: a #CamelJunkFilter
+ * @messages: (element-type CamelMimeMessage): messages to classify
+ * @out_statuses: (array) (out caller-allocates): return location for
+ *    @messages->len junk statuses
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Classifies each message in @messages as junk, not junk or
+ * inconclusive, storing the result at the same index in @out_statuses.
+ * Implementations can use this to load their model once and to
+ * process the messages in parallel; the default implementation calls
+ * camel_junk_filter_classify() for each message in turn.
+ *
+ * If an error occurs, the function sets @error and returns %FALSE.
+ * Messages which could not be classified are left with
+ * %CAMEL_JUNK_STATUS_ERROR in @out_statuses.
+ *
+ * Returns: %TRUE if all @messages were classified
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_junk_filter_classify_batch (CamelJunkFilter *junk_filter,
+                                  GPtrArray *messages,
+                                  CamelJunkStatus *out_statuses,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	CamelJunkFilterInterface *iface;
+
+	g_return_val_if_fail (CAMEL_IS_JUNK_FILTER (junk_filter), FALSE);
+	g_return_val_if_fail (messages != NULL, FALSE);
+	g_return_val_if_fail (out_statuses != NULL, FALSE);
+
+	if (messages->len == 0)
+		return TRUE;
+
+	iface = CAMEL_JUNK_FILTER_GET_INTERFACE (junk_filter);
+	g_return_val_if_fail (iface->classify_batch != NULL, FALSE);
+
+	return iface->classify_batch (
+		junk_filter, messages, out_statuses, cancellable, error);
+}
+
+/**
+ * camel_junk_filter_learn_junk_batch:
+ * @junk_filter: a #CamelJunkFilter
+ * @messages: (element-type CamelMimeMessage): messages to learn as junk
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Batch variant of camel_junk_filter_learn_junk().
+ *
+ * If an error occurs, the function sets @error and returns %FALSE.
+ *
+ * Returns: %TRUE if all @messages were learned
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_junk_filter_learn_junk_batch (CamelJunkFilter *junk_filter,
+                                    GPtrArray *messages,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	CamelJunkFilterInterface *iface;
+
+	g_return_val_if_fail (CAMEL_IS_JUNK_FILTER (junk_filter), FALSE);
+	g_return_val_if_fail (messages != NULL, FALSE);
+
+	if (messages->len == 0)
+		return TRUE;
+
+	iface = CAMEL_JUNK_FILTER_GET_INTERFACE (junk_filter);
+	g_return_val_if_fail (iface->learn_junk_batch != NULL, FALSE);
+
+	return iface->learn_junk_batch (
+		junk_filter, messages, cancellable, error);
+}
+
+/**
+ * camel_junk_filter_learn_not_junk_batch:
+ * @junk_filter: a #CamelJunkFilter
+ * @messages: (element-type CamelMimeMessage): messages to learn as not junk
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Batch variant of camel_junk_filter_learn_not_junk().
+ *
+ * If an error occurs, the function sets @error and returns %FALSE.
+ *
+ * Returns: %TRUE if all @messages were learned
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_junk_filter_learn_not_junk_batch (CamelJunkFilter *junk_filter,
+                                        GPtrArray *messages,
+                                        GCancellable *cancellable,
+                                        GError **error)
+{
+	CamelJunkFilterInterface *iface;
+
+	g_return_val_if_fail (CAMEL_IS_JUNK_FILTER (junk_filter), FALSE);
+	g_return_val_if_fail (messages != NULL, FALSE);
+
+	if (messages->len == 0)
+		return TRUE;
+
+	iface = CAMEL_JUNK_FILTER_GET_INTERFACE (junk_filter);
+	g_return_val_if_fail (iface->learn_not_junk_batch != NULL, FALSE);
+
+	return iface->learn_not_junk_batch (
+		junk_filter, messages, cancellable, error);
+}
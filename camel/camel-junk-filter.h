@@ -75,6 +75,22 @@ struct _CamelJunkFilterInterface {
 	gboolean	(*synchronize)		(CamelJunkFilter *junk_filter,
 						 GCancellable *cancellable,
 						 GError **error);
+
+	/* Batch Methods; the defaults call the single message
+	 * methods above once per message. */
+	gboolean	(*classify_batch)	(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 CamelJunkStatus *out_statuses,
+						 GCancellable *cancellable,
+						 GError **error);
+	gboolean	(*learn_junk_batch)	(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 GCancellable *cancellable,
+						 GError **error);
+	gboolean	(*learn_not_junk_batch)	(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 GCancellable *cancellable,
+						 GError **error);
 };
 
 GType		camel_junk_filter_get_type	(void) G_GNUC_CONST;
@@ -94,6 +110,22 @@ gboolean	camel_junk_filter_learn_not_junk
 gboolean	camel_junk_filter_synchronize	(CamelJunkFilter *junk_filter,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	camel_junk_filter_classify_batch
+						(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 CamelJunkStatus *out_statuses,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	camel_junk_filter_learn_junk_batch
+						(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	camel_junk_filter_learn_not_junk_batch
+						(CamelJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 GCancellable *cancellable,
+						 GError **error);
 
 G_END_DECLS
 
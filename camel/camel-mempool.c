@@ -37,6 +37,7 @@ struct _CamelMemPool {
 	gint threshold;
 	guint align;
 	struct _MemPoolNode *blocks;
+	struct _MemPoolNode *free_blocks;	/* emptied by a flush, reused before allocating */
 	struct _MemPoolThresholdNode *threshold_blocks;
 };
 
@@ -77,6 +78,7 @@ camel_mempool_new (gint blocksize,
 	pool->blocksize = blocksize;
 	pool->threshold = threshold;
 	pool->blocks = NULL;
+	pool->free_blocks = NULL;
 	pool->threshold_blocks = NULL;
 
 	switch (flags & CAMEL_MEMPOOL_ALIGN_MASK) {
@@ -128,7 +130,12 @@ camel_mempool_alloc (CamelMemPool *pool,
 		/* maybe we could do some sort of the free blocks based on size, but
 		 * it doubt its worth it at all */
 
-		n = g_malloc (ALIGNED_SIZEOF (*n) + pool->blocksize);
+		if (pool->free_blocks) {
+			n = pool->free_blocks;
+			pool->free_blocks = n->next;
+		} else {
+			n = g_malloc (ALIGNED_SIZEOF (*n) + pool->blocksize);
+		}
 		n->next = pool->blocks;
 		pool->blocks = n;
 		n->free = pool->blocksize - size;
@@ -166,7 +173,9 @@ camel_mempool_strdup (CamelMemPool *pool,
  *
  * If @freeall is %TRUE, then all allocated blocks are free'd
  * as well.  Otherwise only blocks above the threshold are
- * actually freed, and the others are simply marked as empty.
+ * actually freed, and the others are kept for reuse by subsequent
+ * allocations, which makes a flushed pool suitable as a resettable
+ * arena.
  *
  * Since: 2.32
  **/
@@ -193,12 +202,24 @@ camel_mempool_flush (CamelMemPool *pool,
 			pw = pn;
 		}
 		pool->blocks = NULL;
+
+		pw = pool->free_blocks;
+		while (pw) {
+			pn = pw->next;
+			g_free (pw);
+			pw = pn;
+		}
+		pool->free_blocks = NULL;
 	} else {
 		pw = pool->blocks;
 		while (pw) {
+			pn = pw->next;
 			pw->free = pool->blocksize;
-			pw = pw->next;
+			pw->next = pool->free_blocks;
+			pool->free_blocks = pw;
+			pw = pn;
 		}
+		pool->blocks = NULL;
 	}
 }
 
@@ -499,11 +499,10 @@ camel_mime_message_get_date_received (CamelMimeMessage *msg,
 	if (msg->date_received == CAMEL_MESSAGE_DATE_CURRENT) {
 		const gchar *received;
 
-		received = camel_medium_get_header ((CamelMedium *) msg, "received");
-		if (received)
-			received = strrchr (received, ';');
-		if (received)
-			msg->date_received = camel_header_decode_date (received + 1, &msg->date_received_offset);
+		received = camel_medium_get_header (CAMEL_MEDIUM (msg), "received");
+		if (received && strchr (received, ';'))
+			msg->date_received = camel_mime_part_get_header_date (
+				CAMEL_MIME_PART (msg), "received", &msg->date_received_offset);
 	}
 
 	if (offset)
@@ -1219,7 +1218,7 @@ static const gchar tz_days[][4] = {
 gchar *
 camel_mime_message_build_mbox_from (CamelMimeMessage *message)
 {
-	struct _camel_header_raw *header = ((CamelMimePart *) message)->headers;
+	CamelMedium *medium = CAMEL_MEDIUM (message);
 	GString *out = g_string_new ("From ");
 	gchar *ret;
 	const gchar *tmp;
@@ -1227,9 +1226,9 @@ camel_mime_message_build_mbox_from (CamelMimeMessage *message)
 	gint offset;
 	struct tm tm;
 
-	tmp = camel_header_raw_find (&header, "Sender", NULL);
+	tmp = camel_medium_get_header (medium, "Sender");
 	if (tmp == NULL)
-		tmp = camel_header_raw_find (&header, "From", NULL);
+		tmp = camel_medium_get_header (medium, "From");
 	if (tmp != NULL) {
 		CamelHeaderAddress *addr = camel_header_address_decode (tmp, NULL);
 
@@ -1247,18 +1246,16 @@ camel_mime_message_build_mbox_from (CamelMimeMessage *message)
 		g_string_append (out, "unknown@nodomain.now.au");
 
 	/* try use the received header to get the date */
-	tmp = camel_header_raw_find (&header, "Received", NULL);
-	if (tmp) {
+	tmp = camel_medium_get_header (medium, "Received");
+	if (tmp)
 		tmp = strrchr (tmp, ';');
-		if (tmp)
-			tmp++;
-	}
 
 	/* if there isn't one, try the Date field */
-	if (tmp == NULL)
-		tmp = camel_header_raw_find (&header, "Date", NULL);
+	if (tmp != NULL)
+		thetime = camel_mime_part_get_header_date (CAMEL_MIME_PART (message), "Received", &offset);
+	else
+		thetime = camel_mime_part_get_header_date (CAMEL_MIME_PART (message), "Date", &offset);
 
-	thetime = camel_header_decode_date (tmp, &offset);
 	thetime += ((offset / 100) * (60 * 60)) + (offset % 100) * 60;
 	gmtime_r (&thetime, &tm);
 	g_string_append_printf (
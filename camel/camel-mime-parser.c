@@ -24,7 +24,12 @@
  * There is almost always a reason something was done a certain way.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -35,7 +40,7 @@
 #include "camel-mime-filter.h"
 #include "camel-mime-parser.h"
 #include "camel-mime-utils.h"
-#include "camel-stream.h"
+#include "camel-stream-fs.h"
 
 #define r(x)
 #define h(x)
@@ -46,14 +51,13 @@
 
 /*#define PURIFY*/
 
-#define MEMPOOL
-
 #ifdef PURIFY
 gint inend_id = -1,
   inbuffer_id = -1;
 #endif
 
 #define SCAN_BUF 4096		/* size of read buffer */
+#define SCAN_BUF_FILE 65536	/* size of read buffer for larger regular files */
 #define SCAN_HEAD 128		/* headroom guaranteed to be before each read buffer */
 
 /* a little hacky, but i couldn't be bothered renaming everything */
@@ -78,10 +82,11 @@ struct _header_scan_state {
 	gint ioerrno;		/* io error state */
 
 	/* for scanning input buffers */
-	gchar *realbuf;		/* the real buffer, SCAN_HEAD *2 + SCAN_BUF bytes */
+	gchar *realbuf;		/* the real buffer, SCAN_HEAD *2 + inbuf_size bytes */
 	gchar *inbuf;		/* points to a subset of the allocated memory, the underflow */
 	gchar *inptr;		/* (upto SCAN_HEAD) is for use by filters so they dont copy all data */
 	gchar *inend;
+	gint inbuf_size;	/* SCAN_BUF, or SCAN_BUF_FILE for larger regular files */
 
 	gint atleast;
 
@@ -106,6 +111,10 @@ struct _header_scan_state {
     /* per message/part info */
 	struct _header_scan_stack *parts;
 
+	/* Arena for the part stack, its headers and boundaries.  Nothing
+	 * allocated from it is freed individually; it is reset as a whole
+	 * once the stack is empty again, i.e. at the end of each message. */
+	CamelMemPool *pool;
 };
 
 struct _header_scan_stack {
@@ -113,10 +122,7 @@ struct _header_scan_stack {
 
 	camel_mime_parser_state_t savestate; /* state at invocation of this part */
 
-#ifdef MEMPOOL
-	CamelMemPool *pool;	/* memory pool to keep track of headers/etc at this level */
-#endif
-	struct _camel_header_raw *headers;	/* headers for this part */
+	struct _camel_header_raw *headers;	/* headers for this part, allocated from the state's pool */
 
 	CamelContentType *content_type;
 
@@ -127,7 +133,7 @@ struct _header_scan_stack {
 
 	GByteArray *from_line;	/* the from line */
 
-	gchar *boundary;		/* for multipart/ * boundaries, including leading -- and trailing -- for the final part */
+	gchar *boundary;		/* for multipart/ * boundaries, including leading -- and trailing -- for the final part, in the pool */
 	gint boundarylen;	/* actual length of boundary, including leading -- if there is one */
 	gint boundarylenfinal;	/* length of boundary, including trailing -- if there is one */
 	gint atleast;		/* the biggest boundary from here to the parent */
@@ -142,6 +148,7 @@ struct _header_scan_filter {
 static void folder_scan_reset (struct _header_scan_state *s);
 static void folder_scan_step (struct _header_scan_state *s, gchar **databuffer, gsize *datalength);
 static void folder_scan_drop_step (struct _header_scan_state *s);
+static void folder_scan_set_input_fd (struct _header_scan_state *s, gint fd);
 static gint folder_scan_init_with_fd (struct _header_scan_state *s, gint fd);
 static gint folder_scan_init_with_stream (struct _header_scan_state *s, CamelStream *stream, GError **error);
 static struct _header_scan_state *folder_scan_init (void);
@@ -152,11 +159,10 @@ static gint folder_scan_skip_line (struct _header_scan_state *s, GByteArray *sav
 static goffset folder_seek (struct _header_scan_state *s, goffset offset, gint whence);
 static goffset folder_tell (struct _header_scan_state *s);
 static gint folder_read (struct _header_scan_state *s);
+static struct _header_scan_stack *folder_alloc_part (struct _header_scan_state *s);
+static gchar *folder_alloc_boundary (struct _header_scan_state *s, struct _header_scan_stack *h, const gchar *boundary);
 static void folder_push_part (struct _header_scan_state *s, struct _header_scan_stack *h);
-
-#ifdef MEMPOOL
 static void header_append_mempool (struct _header_scan_state *s, struct _header_scan_stack *h, gchar *header, gint offset);
-#endif
 
 #if d(!)0
 static gchar *states[] = {
@@ -490,6 +496,7 @@ camel_mime_parser_init_with_input_stream (CamelMimeParser *parser,
 	struct _header_scan_state *s = _PRIVATE (parser);
 
 	folder_scan_reset (s);
+	folder_scan_set_input_fd (s, -1);
 	s->input_stream = g_object_ref (input_stream);
 }
 
@@ -888,14 +895,9 @@ camel_mime_parser_push_state (CamelMimeParser *mp,
 {
 	struct _header_scan_stack *h;
 	struct _header_scan_state *s = _PRIVATE (mp);
-	gsize boundary_len;
 
-	h = g_malloc0 (sizeof (*h));
-	h->boundarylen = strlen (boundary) + 2;
-	h->boundarylenfinal = h->boundarylen + 2;
-	boundary_len = h->boundarylen + 3;
-	h->boundary = g_malloc (boundary_len);
-	g_snprintf (h->boundary, boundary_len, "--%s--", boundary);
+	h = folder_alloc_part (s);
+	h->boundary = folder_alloc_boundary (s, h, boundary);
 	folder_push_part (s, h);
 	s->state = newstate;
 }
@@ -954,13 +956,13 @@ folder_read (struct _header_scan_state *s)
 	}
 	if (s->stream) {
 		len = camel_stream_read (
-			s->stream, s->inbuf + inoffset, SCAN_BUF - inoffset, NULL, NULL);
+			s->stream, s->inbuf + inoffset, s->inbuf_size - inoffset, NULL, NULL);
 	} else if (s->input_stream != NULL) {
 		len = g_input_stream_read (
 			s->input_stream, s->inbuf + inoffset,
-			SCAN_BUF - inoffset, NULL, NULL);
+			s->inbuf_size - inoffset, NULL, NULL);
 	} else {
-		len = read (s->fd, s->inbuf + inoffset, SCAN_BUF - inoffset);
+		len = read (s->fd, s->inbuf + inoffset, s->inbuf_size - inoffset);
 	}
 	r (printf ("read %d bytes, offset = %d\n", len, inoffset));
 	if (len >= 0) {
@@ -1049,6 +1051,35 @@ folder_seek (struct _header_scan_state *s,
 	return newoffset;
 }
 
+static struct _header_scan_stack *
+folder_alloc_part (struct _header_scan_state *s)
+{
+	struct _header_scan_stack *h;
+
+	h = camel_mempool_alloc (s->pool, sizeof (*h));
+	memset (h, 0, sizeof (*h));
+
+	return h;
+}
+
+/* sets up a multipart boundary "--boundary--" for the part @h */
+static gchar *
+folder_alloc_boundary (struct _header_scan_state *s,
+                       struct _header_scan_stack *h,
+                       const gchar *boundary)
+{
+	gchar *res;
+	gsize boundary_len;
+
+	h->boundarylen = strlen (boundary) + 2;
+	h->boundarylenfinal = h->boundarylen + 2;
+	boundary_len = h->boundarylen + 3;
+	res = camel_mempool_alloc (s->pool, boundary_len);
+	g_snprintf (res, boundary_len, "--%s--", boundary);
+
+	return res;
+}
+
 static void
 folder_push_part (struct _header_scan_state *s,
                   struct _header_scan_stack *h)
@@ -1070,12 +1101,6 @@ folder_pull_part (struct _header_scan_state *s)
 	h = s->parts;
 	if (h) {
 		s->parts = h->parent;
-		g_free (h->boundary);
-#ifdef MEMPOOL
-		camel_mempool_destroy (h->pool);
-#else
-		camel_header_raw_clear (&h->headers);
-#endif
 		camel_content_type_unref (h->content_type);
 		if (h->pretext)
 			g_byte_array_free (h->pretext, TRUE);
@@ -1083,7 +1108,11 @@ folder_pull_part (struct _header_scan_state *s)
 			g_byte_array_free (h->posttext, TRUE);
 		if (h->from_line)
 			g_byte_array_free (h->from_line, TRUE);
-		g_free (h);
+
+		/* the frame itself, its headers and boundary live in the
+		 * pool, release the whole message's worth in one go */
+		if (!s->parts)
+			camel_mempool_flush (s->pool, FALSE);
 	} else {
 		g_warning ("Header stack underflow!\n");
 	}
@@ -1173,7 +1202,6 @@ folder_boundary_check (struct _header_scan_state *s,
 	return NULL;
 }
 
-#ifdef MEMPOOL
 static void
 header_append_mempool (struct _header_scan_state *s,
                        struct _header_scan_stack *h,
@@ -1186,18 +1214,18 @@ header_append_mempool (struct _header_scan_state *s,
 	content = strchr (header, ':');
 	if (content) {
 		register gint len;
-		n = camel_mempool_alloc (h->pool, sizeof (*n));
+		n = camel_mempool_alloc (s->pool, sizeof (*n));
 		n->next = NULL;
 
 		len = content - header;
-		n->name = camel_mempool_alloc (h->pool, len + 1);
+		n->name = camel_mempool_alloc (s->pool, len + 1);
 		memcpy (n->name, header, len);
 		n->name[len] = 0;
 
 		content++;
 
 		len = s->outptr - content;
-		n->value = camel_mempool_alloc (h->pool, len + 1);
+		n->value = camel_mempool_alloc (s->pool, len + 1);
 		memcpy (n->value, content, len);
 		n->value[len] = 0;
 
@@ -1214,8 +1242,6 @@ header_append_mempool (struct _header_scan_state *s,
 
 #define header_raw_append_parse(a, b, c) (header_append_mempool(s, h, b, c))
 
-#endif
-
 /* Copy the string start->inptr into the header buffer (s->outbuf),
  * grow if necessary
  * remove trailing \r chars (\n's assumed already removed)
@@ -1256,10 +1282,7 @@ folder_scan_header (struct _header_scan_state *s,
 
 	h (printf ("scanning first bit\n"));
 
-	h = g_malloc0 (sizeof (*h));
-#ifdef MEMPOOL
-	h->pool = camel_mempool_new (8192, 4096, CAMEL_MEMPOOL_ALIGN_STRUCT);
-#endif
+	h = folder_alloc_part (s);
 
 	if (s->parts)
 		newatleast = s->parts->atleast;
@@ -1492,6 +1515,7 @@ folder_scan_close (struct _header_scan_state *s)
 	g_free (s->outbuf);
 	while (s->parts)
 		folder_pull_part (s);
+	camel_mempool_destroy (s->pool);
 	if (s->fd != -1)
 		close (s->fd);
 	g_clear_object (&s->stream);
@@ -1517,6 +1541,7 @@ folder_scan_init (void)
 
 	s->realbuf = g_malloc0 (SCAN_BUF + SCAN_HEAD * 2);
 	s->inbuf = s->realbuf + SCAN_HEAD;
+	s->inbuf_size = SCAN_BUF;
 	s->inptr = s->inbuf;
 	s->inend = s->inbuf;
 	s->atleast = 0;
@@ -1539,6 +1564,7 @@ folder_scan_init (void)
 	s->filterid = 1;
 
 	s->parts = NULL;
+	s->pool = camel_mempool_new (8192, 4096, CAMEL_MEMPOOL_ALIGN_STRUCT);
 
 	s->state = CAMEL_MIME_PARSER_STATE_INITIAL;
 	return s;
@@ -1571,11 +1597,42 @@ folder_scan_reset (struct _header_scan_state *s)
 	s->eof = FALSE;
 }
 
+/* Larger regular files, like mbox folders and cached messages, are
+ * mostly scanned from the start to the end, thus they are read in larger
+ * blocks and the kernel is asked to read ahead more aggressively.
+ * Call only after folder_scan_reset(), with the input buffer empty. */
+static void
+folder_scan_set_input_fd (struct _header_scan_state *s,
+                          gint fd)
+{
+	struct stat st;
+	gint size = SCAN_BUF;
+
+	if (fd != -1 && fstat (fd, &st) == 0 &&
+	    S_ISREG (st.st_mode) && st.st_size > SCAN_BUF) {
+		size = SCAN_BUF_FILE;
+#ifdef HAVE_POSIX_FADVISE
+		posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	}
+
+	if (size != s->inbuf_size) {
+		g_free (s->realbuf);
+		s->realbuf = g_malloc0 (size + SCAN_HEAD * 2);
+		s->inbuf = s->realbuf + SCAN_HEAD;
+		s->inptr = s->inbuf;
+		s->inend = s->inbuf;
+		s->inend[0] = '\n';
+		s->inbuf_size = size;
+	}
+}
+
 static gint
 folder_scan_init_with_fd (struct _header_scan_state *s,
 			  gint fd)
 {
 	folder_scan_reset (s);
+	folder_scan_set_input_fd (s, fd);
 	s->fd = fd;
 
 	return 0;
@@ -1587,6 +1644,9 @@ folder_scan_init_with_stream (struct _header_scan_state *s,
                               GError **error)
 {
 	folder_scan_reset (s);
+	folder_scan_set_input_fd (
+		s, CAMEL_IS_STREAM_FS (stream) ?
+		camel_stream_fs_get_fd (CAMEL_STREAM_FS (stream)) : -1);
 	s->stream = g_object_ref (stream);
 
 	return 0;
@@ -1606,7 +1666,6 @@ folder_scan_step (struct _header_scan_state *s,
 	CamelContentType *ct = NULL;
 	struct _header_scan_filter *f;
 	gsize presize;
-	gulong boundary_len;
 
 /*	printf("\nSCAN PASS: state = %d '%s'\n", s->state, states[s->state]);*/
 
@@ -1633,8 +1692,8 @@ tail_recurse:
 #ifdef USE_FROM
 	case CAMEL_MIME_PARSER_STATE_INITIAL:
 		if (s->scan_from) {
-			h = g_malloc0 (sizeof (*h));
-			h->boundary = g_strdup ("From ");
+			h = folder_alloc_part (s);
+			h->boundary = camel_mempool_strdup (s->pool, "From ");
 			h->boundarylen = strlen (h->boundary);
 			h->boundarylenfinal = h->boundarylen;
 			h->from_line = g_byte_array_new ();
@@ -1694,11 +1753,7 @@ tail_recurse:
 				if (!camel_content_type_is (ct, "multipart", "signed")
 				    && (bound = camel_content_type_param (ct, "boundary"))) {
 					d (printf ("multipart, boundary = %s\n", bound));
-					h->boundarylen = strlen (bound) + 2;
-					h->boundarylenfinal = h->boundarylen + 2;
-					boundary_len = h->boundarylen + 3;
-					h->boundary = g_malloc (boundary_len);
-					g_snprintf (h->boundary, boundary_len, "--%s--", bound);
+					h->boundary = folder_alloc_boundary (s, h, bound);
 					type = CAMEL_MIME_PARSER_STATE_MULTIPART;
 				} else {
 					/*camel_content_type_unref(ct);
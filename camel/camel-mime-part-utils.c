@@ -30,7 +30,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <glib/gstdio.h>
+
 #include "camel-charset-map.h"
+#include "camel-data-wrapper-private.h"
 #include "camel-html-parser.h"
 #include "camel-mime-filter-basic.h"
 #include "camel-mime-filter-charset.h"
@@ -48,6 +51,55 @@
 
 #define d(x) /* (printf("%s(%d): ", __FILE__, __LINE__),(x)) */
 
+/* How much of a text part is decoded when building a message preview. */
+#define PREVIEW_DECODE_LIMIT (16 * 1024)
+
+/* A growable memory stream, which takes the first PREVIEW_DECODE_LIMIT
+ * bytes, even of a larger write, and then fails the next write, to stop
+ * the decoder early. */
+typedef GMemoryOutputStream PreviewOutputStream;
+typedef GMemoryOutputStreamClass PreviewOutputStreamClass;
+
+static GType preview_output_stream_get_type (void);
+
+G_DEFINE_TYPE (PreviewOutputStream, preview_output_stream, G_TYPE_MEMORY_OUTPUT_STREAM)
+
+static gssize
+preview_output_stream_write (GOutputStream *stream,
+                             gconstpointer buffer,
+                             gsize count,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	gsize data_size;
+
+	data_size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
+
+	if (data_size >= PREVIEW_DECODE_LIMIT) {
+		g_set_error_literal (
+			error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+			"Enough data for the preview");
+		return -1;
+	}
+
+	return G_OUTPUT_STREAM_CLASS (preview_output_stream_parent_class)->write_fn (
+		stream, buffer, MIN (count, PREVIEW_DECODE_LIMIT - data_size), cancellable, error);
+}
+
+static void
+preview_output_stream_class_init (PreviewOutputStreamClass *class)
+{
+	GOutputStreamClass *output_stream_class;
+
+	output_stream_class = G_OUTPUT_STREAM_CLASS (class);
+	output_stream_class->write_fn = preview_output_stream_write;
+}
+
+static void
+preview_output_stream_init (PreviewOutputStream *stream)
+{
+}
+
 /* simple data wrapper */
 static gboolean
 simple_data_wrapper_construct_from_parser (CamelDataWrapper *dw,
@@ -57,25 +109,77 @@ simple_data_wrapper_construct_from_parser (CamelDataWrapper *dw,
 {
 	gchar *buf;
 	GByteArray *buffer;
-	CamelStream *mem;
+	CamelStream *stream = NULL;
+	gchar *temp_filename = NULL;
 	gsize len;
-	gboolean success;
+	gboolean success = TRUE;
 
 	d (printf ("simple_data_wrapper_construct_from_parser()\n"));
 
-	/* read in the entire content */
+	/* read in the entire content, large content into a temporary file */
 	buffer = g_byte_array_new ();
 	while (camel_mime_parser_step (mp, &buf, &len) != CAMEL_MIME_PARSER_STATE_BODY_END) {
 		d (printf ("appending o/p data: %d: %.*s\n", len, len, buf));
-		g_byte_array_append (buffer, (guint8 *) buf, len);
+
+		/* Keep reading till the end of the body even after a failure,
+		 * the parser is expected to be past the part on return */
+		if (!success)
+			continue;
+
+		if (stream == NULL && buffer->len + len > CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE) {
+			gint fd;
+
+			fd = _camel_data_wrapper_open_temp_file (&temp_filename, error);
+			if (fd == -1) {
+				success = FALSE;
+				continue;
+			}
+
+			stream = camel_stream_fs_new_with_fd (fd);
+			success = camel_stream_write (
+				stream, (const gchar *) buffer->data,
+				buffer->len, cancellable, error) >= 0;
+			g_byte_array_set_size (buffer, 0);
+		}
+
+		if (stream != NULL)
+			success = success && camel_stream_write (
+				stream, buf, len, cancellable, error) >= 0;
+		else
+			g_byte_array_append (buffer, (guint8 *) buf, len);
+	}
+
+	if (stream == NULL) {
+		d (printf ("message part kept in memory!\n"));
+
+		stream = camel_stream_mem_new_with_byte_array (buffer);
+
+		if (success)
+			success = camel_data_wrapper_construct_from_stream_sync (
+				dw, stream, cancellable, error);
+
+		g_object_unref (stream);
+
+		return success;
 	}
 
-	d (printf ("message part kept in memory!\n"));
+	d (printf ("message part kept in '%s'\n", temp_filename));
+
+	g_byte_array_free (buffer, TRUE);
 
-	mem = camel_stream_mem_new_with_byte_array (buffer);
-	success = camel_data_wrapper_construct_from_stream_sync (
-		dw, mem, cancellable, error);
-	g_object_unref (mem);
+	if (success)
+		success = camel_stream_close (stream, cancellable, error) == 0;
+
+	g_object_unref (stream);
+
+	/* The file already holds the content the way the data wrapper
+	 * keeps it, thus it is handed over rather than copied again */
+	if (success) {
+		_camel_data_wrapper_take_temp_file (dw, temp_filename);
+	} else {
+		g_unlink (temp_filename);
+		g_free (temp_filename);
+	}
 
 	return success;
 }
@@ -187,17 +291,40 @@ camel_mime_message_build_preview (CamelMimePart *msg,
 		/*    !camel_content_type_is (dw->mime_type, "text", "html") && */
 		    !camel_content_type_is (dw->mime_type, "text", "calendar")) {
 		CamelStream *mstream, *bstream;
-
-		/* FIXME Pass a GCancellable and GError here. */
-		mstream = camel_stream_mem_new ();
-		if (camel_data_wrapper_decode_to_stream_sync (dw, mstream, NULL, NULL) > 0) {
+		GOutputStream *output_stream;
+		gsize data_size;
+
+		/* The preview only ever looks at the first few lines, so
+		 * do not decode the whole part.  The stream refuses writes
+		 * once it holds enough, which stops the decoder early; the
+		 * error is expected and whatever was decoded until then
+		 * is used. */
+		output_stream = g_object_new (
+			preview_output_stream_get_type (),
+			"realloc-function", g_realloc,
+			"destroy-function", g_free,
+			NULL);
+
+		/* FIXME Pass a GCancellable here. */
+		camel_data_wrapper_decode_to_output_stream_sync (
+			dw, output_stream, NULL, NULL);
+
+		data_size = g_memory_output_stream_get_data_size (
+			G_MEMORY_OUTPUT_STREAM (output_stream));
+
+		mstream = NULL;
+		if (data_size > 0)
+			mstream = camel_stream_mem_new_with_buffer (
+				g_memory_output_stream_get_data (
+				G_MEMORY_OUTPUT_STREAM (output_stream)),
+				data_size);
+
+		g_object_unref (output_stream);
+
+		if (mstream != NULL) {
 			gchar *line = NULL;
 			GString *str = g_string_new (NULL);
 
-			g_seekable_seek (
-				G_SEEKABLE (mstream), 0,
-				G_SEEK_SET, NULL, NULL);
-
 			bstream = camel_stream_buffer_new (mstream, CAMEL_STREAM_BUFFER_READ | CAMEL_STREAM_BUFFER_BUFFER);
 
 			/* We should fetch just 200 unquoted lines. */
@@ -233,8 +360,8 @@ camel_mime_message_build_preview (CamelMimePart *msg,
 			g_string_free (str, TRUE);
 
 			g_object_unref (bstream);
+			g_object_unref (mstream);
 		}
-		g_object_unref (mstream);
 		return TRUE;
 	}
 
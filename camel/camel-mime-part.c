@@ -61,6 +61,11 @@ struct _CamelMimePartPrivate {
 	gchar *content_location;
 	GList *content_languages;
 	CamelTransferEncoding encoding;
+
+	/* Built on demand, dropped whenever the headers change;
+	 * its memoized values never leave the header_index_lock. */
+	GMutex header_index_lock;
+	CamelHeaderIndex *header_index;
 };
 
 struct _AsyncContext {
@@ -94,6 +99,42 @@ static GHashTable *header_formatted_table;
 
 G_DEFINE_TYPE (CamelMimePart, camel_mime_part, CAMEL_TYPE_MEDIUM)
 
+static void
+mime_part_invalidate_header_index (CamelMimePart *mime_part)
+{
+	g_mutex_lock (&mime_part->priv->header_index_lock);
+	camel_header_index_free (mime_part->priv->header_index);
+	mime_part->priv->header_index = NULL;
+	g_mutex_unlock (&mime_part->priv->header_index_lock);
+}
+
+/* Returns the header index with the header_index_lock held;
+ * release it with mime_part_unlock_header_index(). */
+static CamelHeaderIndex *
+mime_part_lock_header_index (CamelMimePart *mime_part)
+{
+	CamelMimePartPrivate *priv = mime_part->priv;
+
+	g_mutex_lock (&priv->header_index_lock);
+
+	if (priv->header_index &&
+	    camel_header_index_get_headers (priv->header_index) != mime_part->headers) {
+		camel_header_index_free (priv->header_index);
+		priv->header_index = NULL;
+	}
+
+	if (!priv->header_index)
+		priv->header_index = camel_header_index_new (mime_part->headers);
+
+	return priv->header_index;
+}
+
+static void
+mime_part_unlock_header_index (CamelMimePart *mime_part)
+{
+	g_mutex_unlock (&mime_part->priv->header_index_lock);
+}
+
 static void
 async_context_free (AsyncContext *async_context)
 {
@@ -449,6 +490,8 @@ mime_part_finalize (GObject *object)
 	g_list_free_full (priv->content_languages, (GDestroyNotify) g_free);
 	camel_content_disposition_unref (priv->disposition);
 
+	camel_header_index_free (priv->header_index);
+	g_mutex_clear (&priv->header_index_lock);
 	camel_header_raw_clear (&CAMEL_MIME_PART (object)->headers);
 
 	/* Chain up to parent's finalize() method. */
@@ -466,6 +509,8 @@ mime_part_add_header (CamelMedium *medium,
 	/* known, the job is done in the parsing routine. If not,         */
 	/* we simply add the header in a raw fashion                      */
 
+	mime_part_invalidate_header_index (part);
+
 	/* If it was one of the headers we handled, it must be unique, set it instead of add */
 	if (mime_part_process_header (medium, name, value))
 		camel_header_raw_replace (&part->headers, name, value, -1);
@@ -480,6 +525,8 @@ mime_part_set_header (CamelMedium *medium,
 {
 	CamelMimePart *part = CAMEL_MIME_PART (medium);
 
+	mime_part_invalidate_header_index (part);
+
 	mime_part_process_header (medium, name, value);
 	camel_header_raw_replace (&part->headers, name, value, -1);
 }
@@ -490,6 +537,8 @@ mime_part_remove_header (CamelMedium *medium,
 {
 	CamelMimePart *part = (CamelMimePart *) medium;
 
+	mime_part_invalidate_header_index (part);
+
 	mime_part_process_header (medium, name, NULL);
 	camel_header_raw_remove (&part->headers, name);
 }
@@ -501,7 +550,9 @@ mime_part_get_header (CamelMedium *medium,
 	CamelMimePart *part = (CamelMimePart *) medium;
 	const gchar *value;
 
-	value = camel_header_raw_find (&part->headers, name, NULL);
+	/* the raw value is owned by the header list, not by the index */
+	value = camel_header_index_find (mime_part_lock_header_index (part), name, NULL);
+	mime_part_unlock_header_index (part);
 
 	/* Skip leading whitespace. */
 	while (value != NULL && g_ascii_isspace (*value))
@@ -1103,6 +1154,7 @@ camel_mime_part_init (CamelMimePart *mime_part)
 
 	mime_part->priv = CAMEL_MIME_PART_GET_PRIVATE (mime_part);
 	mime_part->priv->encoding = CAMEL_TRANSFER_ENCODING_DEFAULT;
+	g_mutex_init (&mime_part->priv->header_index_lock);
 
 	data_wrapper = CAMEL_DATA_WRAPPER (mime_part);
 
@@ -1575,6 +1627,90 @@ camel_mime_part_set_filename (CamelMimePart *mime_part,
 	g_free (str);
 }
 
+/**
+ * camel_mime_part_dup_decoded_header:
+ * @mime_part: a #CamelMimePart
+ * @name: header name
+ * @default_charset: (allow-none): charset to use for 8-bit text, or %NULL
+ *
+ * Returns the first header named @name of @mime_part unfolded and decoded
+ * like camel_header_index_get_decoded() does.  The decoded value is kept
+ * in a header index of @mime_part until its headers change, thus repeated
+ * calls do not decode it again.
+ *
+ * Returns: (transfer full): a newly allocated decoded header value, or %NULL;
+ * free it with g_free()
+ *
+ * Since: 3.20
+ **/
+gchar *
+camel_mime_part_dup_decoded_header (CamelMimePart *mime_part,
+                                    const gchar *name,
+                                    const gchar *default_charset)
+{
+	gchar *value;
+
+	g_return_val_if_fail (CAMEL_IS_MIME_PART (mime_part), NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	value = g_strdup (camel_header_index_get_decoded (
+		mime_part_lock_header_index (mime_part), name, default_charset));
+	mime_part_unlock_header_index (mime_part);
+
+	return value;
+}
+
+/**
+ * camel_mime_part_get_header_date:
+ * @mime_part: a #CamelMimePart
+ * @name: header name
+ * @tz_offset: (out) (allow-none): return location for the timezone offset, or %NULL
+ *
+ * Decodes the first header named @name of @mime_part as a date, like
+ * camel_header_index_get_date() does, remembering it until the headers
+ * of @mime_part change.
+ *
+ * Returns: the decoded date, or 0 when there is no such header
+ *
+ * Since: 3.20
+ **/
+time_t
+camel_mime_part_get_header_date (CamelMimePart *mime_part,
+                                 const gchar *name,
+                                 gint *tz_offset)
+{
+	time_t date;
+
+	g_return_val_if_fail (CAMEL_IS_MIME_PART (mime_part), 0);
+	g_return_val_if_fail (name != NULL, 0);
+
+	date = camel_header_index_get_date (
+		mime_part_lock_header_index (mime_part), name, tz_offset);
+	mime_part_unlock_header_index (mime_part);
+
+	return date;
+}
+
+/**
+ * camel_mime_part_headers_changed:
+ * @mime_part: a #CamelMimePart
+ *
+ * Drops the header index of @mime_part, together with the values decoded
+ * through it.  Headers added, changed or removed through the #CamelMedium
+ * API do this on their own; code which modifies the @headers list of
+ * @mime_part directly, like unlinking Bcc headers for a while, has to call
+ * this after each modification.
+ *
+ * Since: 3.20
+ **/
+void
+camel_mime_part_headers_changed (CamelMimePart *mime_part)
+{
+	g_return_if_fail (CAMEL_IS_MIME_PART (mime_part));
+
+	mime_part_invalidate_header_index (mime_part);
+}
+
 /**
  * camel_mime_part_construct_from_parser_sync:
  * @mime_part: a #CamelMimePart
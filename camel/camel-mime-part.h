@@ -120,6 +120,16 @@ void		camel_mime_part_set_content	(CamelMimePart *mime_part,
 						 const gchar *data,
 						 gint length,
 						 const gchar *type);
+gchar *		camel_mime_part_dup_decoded_header
+						(CamelMimePart *mime_part,
+						 const gchar *name,
+						 const gchar *default_charset);
+time_t		camel_mime_part_get_header_date
+						(CamelMimePart *mime_part,
+						 const gchar *name,
+						 gint *tz_offset);
+void		camel_mime_part_headers_changed
+						(CamelMimePart *mime_part);
 
 gboolean	camel_mime_part_construct_from_parser_sync
 						(CamelMimePart *mime_part,
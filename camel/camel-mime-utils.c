@@ -4651,6 +4651,309 @@ camel_header_raw_clear (struct _camel_header_raw **list)
 	*list = NULL;
 }
 
+/* Header index, a hashed view over a raw header list.  Names are hashed
+ * case-insensitively, so no lower-cased copies are made, and only the
+ * first occurrence of each name is recorded, which is what
+ * camel_header_raw_find() returns.  Decoded values are computed on the
+ * first request and kept until the index is freed. */
+struct _CamelHeaderIndex {
+	struct _camel_header_raw *headers;
+	GHashTable *nodes;	/* name -> struct _camel_header_raw * */
+	GHashTable *decoded;	/* kind, charset and name -> gchar * */
+	GHashTable *dates;	/* "name" -> struct _header_index_date * */
+};
+
+struct _header_index_date {
+	time_t date;
+	gint tz_offset;
+};
+
+static guint
+header_index_name_hash (gconstpointer key)
+{
+	const gchar *p = key;
+	guint h = 5381;
+
+	while (*p) {
+		h = (h << 5) + h + g_ascii_tolower (*p);
+		p++;
+	}
+
+	return h;
+}
+
+static gboolean
+header_index_name_equal (gconstpointer a,
+                         gconstpointer b)
+{
+	return g_ascii_strcasecmp (a, b) == 0;
+}
+
+/**
+ * camel_header_index_new:
+ * @headers: a raw header list
+ *
+ * Creates a hashed index over @headers.  The index does not copy nor
+ * own the list, thus it is valid only as long as @headers is not
+ * modified or freed.
+ *
+ * Returns: a new #CamelHeaderIndex; free it with camel_header_index_free()
+ *
+ * Since: 3.20
+ **/
+CamelHeaderIndex *
+camel_header_index_new (struct _camel_header_raw *headers)
+{
+	CamelHeaderIndex *index;
+	struct _camel_header_raw *h;
+
+	index = g_slice_new0 (CamelHeaderIndex);
+	index->headers = headers;
+	index->nodes = g_hash_table_new (header_index_name_hash, header_index_name_equal);
+
+	for (h = headers; h; h = h->next) {
+		if (h->name && !g_hash_table_contains (index->nodes, h->name))
+			g_hash_table_insert (index->nodes, h->name, h);
+	}
+
+	return index;
+}
+
+/**
+ * camel_header_index_free:
+ * @index: a #CamelHeaderIndex
+ *
+ * Frees @index together with all the memoized decoded values.
+ * The indexed header list is left untouched.
+ *
+ * Since: 3.20
+ **/
+void
+camel_header_index_free (CamelHeaderIndex *index)
+{
+	if (!index)
+		return;
+
+	g_hash_table_destroy (index->nodes);
+	if (index->decoded)
+		g_hash_table_destroy (index->decoded);
+	if (index->dates)
+		g_hash_table_destroy (index->dates);
+
+	g_slice_free (CamelHeaderIndex, index);
+}
+
+/**
+ * camel_header_index_get_headers:
+ * @index: a #CamelHeaderIndex
+ *
+ * Returns: (transfer none): the header list @index was created for
+ *
+ * Since: 3.20
+ **/
+struct _camel_header_raw *
+camel_header_index_get_headers (CamelHeaderIndex *index)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+
+	return index->headers;
+}
+
+/**
+ * camel_header_index_find:
+ * @index: a #CamelHeaderIndex
+ * @name: header name to look for
+ * @offset: (out) (allow-none): return location for the header offset, or %NULL
+ *
+ * Hashed equivalent of camel_header_raw_find().
+ *
+ * Returns: raw value of the first header named @name, or %NULL
+ *
+ * Since: 3.20
+ **/
+const gchar *
+camel_header_index_find (CamelHeaderIndex *index,
+                         const gchar *name,
+                         gint *offset)
+{
+	struct _camel_header_raw *h;
+
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	h = g_hash_table_lookup (index->nodes, name);
+	if (!h)
+		return NULL;
+
+	if (offset)
+		*offset = h->offset;
+
+	return h->value;
+}
+
+static const gchar *
+header_index_get_memoized (CamelHeaderIndex *index,
+                           gchar kind,
+                           const gchar *name,
+                           const gchar *default_charset)
+{
+	const gchar *raw;
+	gchar *key, *lower, *text, *value;
+	gpointer cached = NULL;
+
+	raw = camel_header_index_find (index, name, NULL);
+	if (!raw)
+		return NULL;
+
+	if (!index->decoded)
+		index->decoded = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	lower = g_ascii_strdown (name, -1);
+	key = g_strdup_printf ("%c%s\n%s", kind, default_charset ? default_charset : "", lower);
+	g_free (lower);
+
+	if (g_hash_table_lookup_extended (index->decoded, key, NULL, &cached)) {
+		g_free (key);
+		return cached;
+	}
+
+	while (isspace ((guchar) *raw))
+		raw++;
+
+	text = camel_header_unfold (raw);
+
+	if (kind == 'a') {
+		CamelHeaderAddress *addr;
+
+		if ((addr = camel_header_address_decode (text, default_charset))) {
+			value = camel_header_address_list_format (addr);
+			camel_header_address_list_clear (&addr);
+			g_free (text);
+		} else {
+			value = text;
+		}
+	} else {
+		value = camel_header_decode_string (text, default_charset);
+		g_free (text);
+	}
+
+	g_hash_table_insert (index->decoded, key, value);
+
+	return value;
+}
+
+/**
+ * camel_header_index_get_decoded:
+ * @index: a #CamelHeaderIndex
+ * @name: header name
+ * @default_charset: (allow-none): charset to use for 8-bit text, or %NULL
+ *
+ * Unfolds and decodes the first header named @name as an unstructured
+ * string, the same way camel_header_decode_string() does.  The result is
+ * computed once and then reused for subsequent calls with the same
+ * @default_charset.
+ *
+ * Returns: the decoded header value, or %NULL; owned by @index
+ *
+ * Since: 3.20
+ **/
+const gchar *
+camel_header_index_get_decoded (CamelHeaderIndex *index,
+                                const gchar *name,
+                                const gchar *default_charset)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	return header_index_get_memoized (index, 's', name, default_charset);
+}
+
+/**
+ * camel_header_index_get_address:
+ * @index: a #CamelHeaderIndex
+ * @name: header name
+ * @default_charset: (allow-none): charset to use for 8-bit text, or %NULL
+ *
+ * Like camel_header_index_get_decoded(), only the first header named
+ * @name is decoded as an address list and formatted for display with
+ * camel_header_address_list_format().  If the value cannot be parsed
+ * as an address list, the unfolded raw value is returned.
+ *
+ * Returns: the formatted address list, or %NULL; owned by @index
+ *
+ * Since: 3.20
+ **/
+const gchar *
+camel_header_index_get_address (CamelHeaderIndex *index,
+                                const gchar *name,
+                                const gchar *default_charset)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	return header_index_get_memoized (index, 'a', name, default_charset);
+}
+
+/**
+ * camel_header_index_get_date:
+ * @index: a #CamelHeaderIndex
+ * @name: header name
+ * @tz_offset: (out) (allow-none): return location for the timezone offset, or %NULL
+ *
+ * Decodes the first header named @name with camel_header_decode_date()
+ * and remembers the result.  For "Received" headers the date following
+ * the last semicolon is used.
+ *
+ * Returns: the decoded date, or 0 when there is no such header
+ *
+ * Since: 3.20
+ **/
+time_t
+camel_header_index_get_date (CamelHeaderIndex *index,
+                             const gchar *name,
+                             gint *tz_offset)
+{
+	struct _header_index_date *cached;
+	const gchar *raw;
+	gchar *key;
+
+	g_return_val_if_fail (index != NULL, 0);
+	g_return_val_if_fail (name != NULL, 0);
+
+	if (tz_offset)
+		*tz_offset = 0;
+
+	raw = camel_header_index_find (index, name, NULL);
+	if (!raw)
+		return 0;
+
+	if (!index->dates)
+		index->dates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	key = g_ascii_strdown (name, -1);
+	cached = g_hash_table_lookup (index->dates, key);
+	if (!cached) {
+		if (g_ascii_strcasecmp (name, "received") == 0) {
+			raw = strrchr (raw, ';');
+			if (raw)
+				raw++;
+		}
+
+		cached = g_new0 (struct _header_index_date, 1);
+		if (raw)
+			cached->date = camel_header_decode_date (raw, &cached->tz_offset);
+
+		g_hash_table_insert (index->dates, key, cached);
+	} else {
+		g_free (key);
+	}
+
+	if (tz_offset)
+		*tz_offset = cached->tz_offset;
+
+	return cached->date;
+}
+
 /**
  * camel_header_msgid_generate:
  * @domain: domain to use (like "example.com") for the ID suffix; can be NULL
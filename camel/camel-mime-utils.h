@@ -65,6 +65,9 @@ struct _camel_header_raw {
 	gint offset;		/* in file, if known */
 };
 
+/* a hashed view over a raw header list */
+typedef struct _CamelHeaderIndex CamelHeaderIndex;
+
 typedef struct _CamelContentDisposition {
 	gchar *disposition;
 	struct _camel_header_param *params;
@@ -161,6 +164,15 @@ void camel_header_raw_clear (struct _camel_header_raw **list);
 
 gchar *camel_header_raw_check_mailing_list (struct _camel_header_raw **list);
 
+/* indexed raw headers */
+CamelHeaderIndex *camel_header_index_new (struct _camel_header_raw *headers);
+void camel_header_index_free (CamelHeaderIndex *index);
+struct _camel_header_raw *camel_header_index_get_headers (CamelHeaderIndex *index);
+const gchar *camel_header_index_find (CamelHeaderIndex *index, const gchar *name, gint *offset);
+const gchar *camel_header_index_get_decoded (CamelHeaderIndex *index, const gchar *name, const gchar *default_charset);
+const gchar *camel_header_index_get_address (CamelHeaderIndex *index, const gchar *name, const gchar *default_charset);
+time_t camel_header_index_get_date (CamelHeaderIndex *index, const gchar *name, gint *tz_offset);
+
 /* fold a header */
 gchar *camel_header_address_fold (const gchar *in, gsize headerlen);
 gchar *camel_header_fold (const gchar *in, gsize headerlen);
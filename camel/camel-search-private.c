@@ -585,7 +585,31 @@ output_c (GString *w,
 	g_string_append (w, utf8);
 }
 
-static void
+/* A word with a run of more than two characters of a script without
+ * spaces, or with such characters next to others, is indexed as pieces
+ * which can only tell which messages may contain it */
+static gboolean
+word_is_ngram (const gchar *in)
+{
+	const guchar *ptr = (const guchar *) in;
+	gint run = 0, unspaced = 0, other = 0;
+	guint32 c;
+
+	while ((c = camel_utf8_getc (&ptr))) {
+		if (g_unichar_isalnum (c) && camel_search_char_is_unspaced (c)) {
+			unspaced++;
+			if (++run > 2)
+				return TRUE;
+		} else {
+			other++;
+			run = 0;
+		}
+	}
+
+	return unspaced && other;
+}
+
+static gint
 output_w (GString *w,
           GPtrArray *list,
           gint type)
@@ -593,12 +617,17 @@ output_w (GString *w,
 	struct _camel_search_word *word;
 
 	if (w->len) {
+		if ((type & CAMEL_SEARCH_WORD_8BIT) != 0 && word_is_ngram (w->str))
+			type |= CAMEL_SEARCH_WORD_NGRAM;
+
 		word = g_malloc0 (sizeof (*word));
 		word->word = g_strdup (w->str);
 		word->type = type;
 		g_ptr_array_add (list, word);
 		g_string_truncate (w, 0);
 	}
+
+	return type;
 }
 
 struct _camel_search_words *
@@ -620,8 +649,7 @@ camel_search_words_split (const guchar *in)
 		if (c == 0
 		    || (inquote && c == '"')
 		    || (!inquote && g_unichar_isspace (c))) {
-			output_w (w, list, type);
-			all |= type;
+			all |= output_w (w, list, type);
 			type = CAMEL_SEARCH_WORD_SIMPLE;
 			inquote = 0;
 		} else {
@@ -630,8 +658,7 @@ camel_search_words_split (const guchar *in)
 				if (c)
 					output_c (w, c, &type);
 				else {
-					output_w (w, list, type);
-					all |= type;
+					all |= output_w (w, list, type);
 				}
 			} else if (c == '\"') {
 				inquote = 1;
@@ -650,14 +677,46 @@ camel_search_words_split (const guchar *in)
 	return words;
 }
 
+/* the words are ANDed through a 32 bit mask in camel-folder-search.c */
+#define SIMPLE_WORDS_MAX (31)
+
+static void
+output_simple (GPtrArray *list,
+               const guchar *start,
+               const guchar *end,
+               gint *all)
+{
+	struct _camel_search_word *word;
+	const guchar *ptr;
+	gint type = CAMEL_SEARCH_WORD_SIMPLE;
+
+	if (end <= start || list->len >= SIMPLE_WORDS_MAX)
+		return;
+
+	for (ptr = start; ptr < end; ptr++) {
+		if (*ptr > 0x80) {
+			type = CAMEL_SEARCH_WORD_8BIT;
+			break;
+		}
+	}
+
+	word = g_malloc0 (sizeof (*word));
+	word->word = g_strndup ((gchar *) start, end - start);
+	word->type = type;
+	g_ptr_array_add (list, word);
+	*all |= type;
+}
+
 /* Takes an existing 'words' list, and converts it to another consisting
- * of only simple words, with any punctuation, etc stripped. */
+ * of only simple words, with any punctuation, etc stripped.  Runs of
+ * characters from scripts without spaces are broken into overlapping
+ * pairs, the same way CamelTextIndex indexes them. */
 struct _camel_search_words *
 camel_search_words_simple (struct _camel_search_words *wordin)
 {
 	gint i;
-	const guchar *ptr, *start, *last;
-	gint type = CAMEL_SEARCH_WORD_SIMPLE, all = 0;
+	const guchar *ptr, *start, *last, *pair;
+	gint all = 0, run;
 	GPtrArray *list = g_ptr_array_new ();
 	struct _camel_search_word *word;
 	struct _camel_search_words *words;
@@ -666,29 +725,35 @@ camel_search_words_simple (struct _camel_search_words *wordin)
 	words = g_malloc0 (sizeof (*words));
 
 	for (i = 0; i < wordin->len; i++) {
-		if ((wordin->words[i]->type & CAMEL_SEARCH_WORD_COMPLEX) == 0) {
+		if ((wordin->words[i]->type & (CAMEL_SEARCH_WORD_COMPLEX | CAMEL_SEARCH_WORD_NGRAM)) == 0) {
 			word = g_malloc0 (sizeof (*word));
 			word->type = wordin->words[i]->type;
 			word->word = g_strdup (wordin->words[i]->word);
 			g_ptr_array_add (list, word);
 		} else {
 			ptr = (const guchar *) wordin->words[i]->word;
-			start = last = ptr;
+			start = last = pair = ptr;
+			run = 0;
 			do {
 				c = camel_utf8_getc (&ptr);
-				if (c == 0 || !g_unichar_isalnum (c)) {
-					if (last > start) {
-						word = g_malloc0 (sizeof (*word));
-						word->word = g_strndup ((gchar *) start, last - start);
-						word->type = type;
-						g_ptr_array_add (list, word);
-						all |= type;
-						type = CAMEL_SEARCH_WORD_SIMPLE;
-					}
+				if (c != 0 && g_unichar_isalnum (c) && camel_search_char_is_unspaced (c)) {
+					output_simple (list, start, last, &all);
+					if (run > 0)
+						output_simple (list, pair, ptr, &all);
+					pair = last;
+					run++;
 					start = ptr;
+				} else {
+					/* a lone character has no pair */
+					if (run == 1)
+						output_simple (list, pair, last, &all);
+					run = 0;
+
+					if (c == 0 || !g_unichar_isalnum (c)) {
+						output_simple (list, start, last, &all);
+						start = ptr;
+					}
 				}
-				if (c > 0x80)
-					type = CAMEL_SEARCH_WORD_8BIT;
 				last = ptr;
 			} while (c);
 		}
@@ -702,6 +767,25 @@ camel_search_words_simple (struct _camel_search_words *wordin)
 	return words;
 }
 
+/* Scripts written without spaces between words, which the text index
+ * breaks into pairs of characters instead */
+gboolean
+camel_search_char_is_unspaced (gunichar c)
+{
+	switch (g_unichar_get_script (c)) {
+	case G_UNICODE_SCRIPT_HAN:
+	case G_UNICODE_SCRIPT_HIRAGANA:
+	case G_UNICODE_SCRIPT_KATAKANA:
+	case G_UNICODE_SCRIPT_THAI:
+	case G_UNICODE_SCRIPT_LAO:
+	case G_UNICODE_SCRIPT_KHMER:
+	case G_UNICODE_SCRIPT_MYANMAR:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
 void
 camel_search_words_free (struct _camel_search_words *words)
 {
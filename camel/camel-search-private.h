@@ -80,7 +80,8 @@ const gchar *	camel_ustrstrcase		(const gchar *haystack,
 typedef enum _camel_search_word_t {
 	CAMEL_SEARCH_WORD_SIMPLE = 1,
 	CAMEL_SEARCH_WORD_COMPLEX = 2,
-	CAMEL_SEARCH_WORD_8BIT = 4
+	CAMEL_SEARCH_WORD_8BIT = 4,
+	CAMEL_SEARCH_WORD_NGRAM = 8	/* indexed as pairs, which may not be adjacent */
 } camel_search_word_t;
 
 struct _camel_search_word {
@@ -99,6 +100,12 @@ struct _camel_search_words *
 struct _camel_search_words *
 		camel_search_words_simple	(struct _camel_search_words *words);
 void		camel_search_words_free		(struct _camel_search_words *words);
+gboolean	camel_search_char_is_unspaced	(gunichar c);
+
+/* implemented in camel-folder-search.c */
+gchar *		camel_search_folder_expression_to_sql
+						(CamelFolder *folder,
+						 const gchar *expr);
 
 G_END_DECLS
 
@@ -61,6 +61,25 @@ camel_db_free_sqlized_string (gchar *string)
 #include "camel-search-private.h"
 #endif
 
+#ifdef TEST_MAIN
+#define CAMEL_DB_LABELS_TABLE "message_labels"
+#define CAMEL_DB_USERTAGS_TABLE "message_usertags"
+#endif
+
+/* Prefix of the intermediate result of 'user-tag', which is turned
+ * into a sub-select by the comparison function using it. */
+#define USERTAG_MARKER "\001user-tag\001"
+
+typedef struct _SQLSExpData {
+	/* keep first, functions access it through a gboolean pointer */
+	gboolean contains_unknown_column;
+	const gchar *folder_name;
+	/* whether labels and user tags are searched in their own tables */
+	gboolean with_message_tags;
+	/* whether the folder has a full-text index of header columns */
+	gboolean with_header_index;
+} SQLSExpData;
+
 static gchar *
 get_db_safe_string (const gchar *str)
 {
@@ -73,6 +92,42 @@ get_db_safe_string (const gchar *str)
 	return ret;
 }
 
+static gchar *
+usertag_condition (SQLSExpData *ssd,
+                   const gchar *marked_name,
+                   const gchar *value)
+{
+	gchar *folder, *name, *qvalue, *res;
+
+	folder = get_db_safe_string (ssd->folder_name);
+	name = get_db_safe_string (marked_name + strlen (USERTAG_MARKER));
+
+	if (!value || !*value) {
+		/* unset and empty tags are the same thing */
+		res = g_strdup_printf (
+			"uid NOT IN (SELECT uid FROM %s WHERE folder_name = %s AND name = %s AND value <> '')",
+			CAMEL_DB_USERTAGS_TABLE, folder, name);
+	} else {
+		qvalue = get_db_safe_string (value);
+		res = g_strdup_printf (
+			"uid IN (SELECT uid FROM %s WHERE folder_name = %s AND name = %s AND value = %s)",
+			CAMEL_DB_USERTAGS_TABLE, folder, name, qvalue);
+		g_free (qvalue);
+	}
+
+	g_free (folder);
+	g_free (name);
+
+	return res;
+}
+
+static gboolean
+is_usertag_marker (CamelSExpResult *res)
+{
+	return res->type == CAMEL_SEXP_RES_STRING && res->value.string &&
+		g_str_has_prefix (res->value.string, USERTAG_MARKER);
+}
+
 /* Configuration of your sexp expression */
 
 static CamelSExpResult *
@@ -183,14 +238,30 @@ eval_eq (struct _CamelSExp *f,
 		r1 = camel_sexp_term_eval (f, argv[0]);
 		r2 = camel_sexp_term_eval (f, argv[1]);
 
-		if (r1->type == CAMEL_SEXP_RES_INT)
+		if (is_usertag_marker (r1)) {
+			gchar *value = NULL, *cond;
+
+			if (r2->type == CAMEL_SEXP_RES_INT)
+				value = g_strdup_printf ("%d", r2->value.number);
+			else if (r2->type == CAMEL_SEXP_RES_TIME)
+				value = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) r2->value.time);
+			else if (r2->type == CAMEL_SEXP_RES_STRING)
+				value = g_strdup (r2->value.string);
+
+			cond = usertag_condition (data, r1->value.string, value);
+			g_string_append (str, cond);
+			g_free (cond);
+			g_free (value);
+		} else if (r1->type == CAMEL_SEXP_RES_INT)
 			g_string_append_printf (str, "%d", r1->value.number);
 		else if (r1->type == CAMEL_SEXP_RES_TIME)
 			g_string_append_printf (str, "%" G_GINT64_FORMAT, (gint64) r1->value.time);
 		else if (r1->type == CAMEL_SEXP_RES_STRING)
 			g_string_append_printf (str, "%s", r1->value.string);
 
-		if (g_str_equal (str->str, "( msgid") || g_str_equal (str->str, "( references")) {
+		if (is_usertag_marker (r1)) {
+			/* already complete */
+		} else if (g_str_equal (str->str, "( msgid") || g_str_equal (str->str, "( references")) {
 			gboolean is_msgid = g_str_equal (str->str, "( msgid");
 
 			g_string_assign (str, "( part LIKE ");
@@ -264,6 +335,12 @@ eval_lt (struct _CamelSExp *f,
 		else if (r1->type == CAMEL_SEXP_RES_STRING)
 			g_string_append_printf (str, "%s", r1->value.string);
 
+		if (is_usertag_marker (r1) || is_usertag_marker (r2)) {
+			/* tag values are text; leave ordering comparisons on them
+			 * to the in-memory search */
+			((SQLSExpData *) data)->contains_unknown_column = TRUE;
+		}
+
 		g_string_append_printf (str, " < ");
 		if (r2->type == CAMEL_SEXP_RES_INT)
 			g_string_append_printf (str, "%d", r2->value.number);
@@ -306,6 +383,12 @@ eval_gt (struct _CamelSExp *f,
 		else if (r1->type == CAMEL_SEXP_RES_STRING)
 			g_string_append_printf (str, "%s", r1->value.string);
 
+		if (is_usertag_marker (r1) || is_usertag_marker (r2)) {
+			/* tag values are text; leave ordering comparisons on them
+			 * to the in-memory search */
+			((SQLSExpData *) data)->contains_unknown_column = TRUE;
+		}
+
 		g_string_append_printf (str, " > ");
 		if (r2->type == CAMEL_SEXP_RES_INT)
 			g_string_append_printf (str, "%d", r2->value.number);
@@ -374,6 +457,104 @@ match_threads (struct _CamelSExp *f,
 	return r;
 }
 
+/* Turns @value into a full-text query over the header index, which
+ * returns a superset of the rows matching @value the @how way, or
+ * returns %NULL when the index cannot narrow the search. Tokens are
+ * runs of alphanumeric characters, the same as the unicode61 tokenizer
+ * uses, thus whole tokens of @value are whole tokens of the header. */
+static gchar *
+header_index_query (const gchar *value,
+                    camel_search_match_t how)
+{
+	GPtrArray *tokens;
+	GString *token = NULL, *query;
+	gboolean starts_in_token, ends_in_token = FALSE;
+	const gchar *ptr;
+	guint ii;
+
+	if (!value || !*value || !g_utf8_validate (value, -1, NULL))
+		return NULL;
+
+	tokens = g_ptr_array_new_with_free_func (g_free);
+	starts_in_token = g_unichar_isalnum (g_utf8_get_char (value));
+
+	for (ptr = value; *ptr; ptr = g_utf8_next_char (ptr)) {
+		gunichar c = g_utf8_get_char (ptr);
+
+		ends_in_token = g_unichar_isalnum (c);
+		if (ends_in_token) {
+			if (!token)
+				token = g_string_new (NULL);
+			g_string_append_unichar (token, c);
+		} else if (token) {
+			g_ptr_array_add (tokens, g_string_free (token, FALSE));
+			token = NULL;
+		}
+	}
+
+	if (token)
+		g_ptr_array_add (tokens, g_string_free (token, FALSE));
+
+	/* a substring can begin in the middle of a header token */
+	if (how == CAMEL_SEARCH_MATCH_CONTAINS && starts_in_token && tokens->len > 0)
+		g_ptr_array_remove_index (tokens, 0);
+
+	if (!tokens->len) {
+		g_ptr_array_unref (tokens);
+		return NULL;
+	}
+
+	query = g_string_new (NULL);
+
+	if (how == CAMEL_SEARCH_MATCH_WORD) {
+		/* all the words, in any order */
+		for (ii = 0; ii < tokens->len; ii++) {
+			g_string_append_printf (query, "%s\"%s\"", ii ? " " : "", (const gchar *) g_ptr_array_index (tokens, ii));
+		}
+	} else {
+		/* a phrase, whose last token can be cut */
+		g_string_append_c (query, '"');
+		for (ii = 0; ii < tokens->len; ii++) {
+			g_string_append_printf (query, "%s%s", ii ? " " : "", (const gchar *) g_ptr_array_index (tokens, ii));
+		}
+		if (ends_in_token)
+			g_string_append_c (query, '*');
+		g_string_append_c (query, '"');
+	}
+
+	g_ptr_array_unref (tokens);
+
+	return g_string_free (query, FALSE);
+}
+
+static gchar *
+header_index_condition (SQLSExpData *ssd,
+                        const gchar *headername,
+                        const gchar *value,
+                        camel_search_match_t how)
+{
+	gchar *fts_query, *tmp, *table, *query, *res;
+
+	fts_query = header_index_query (value, how);
+	if (!fts_query)
+		return NULL;
+
+	tmp = g_strconcat (ssd->folder_name, "_fts", NULL);
+	table = get_db_safe_string (tmp);
+	g_free (tmp);
+
+	query = get_db_safe_string (fts_query);
+
+	/* the index shares rowid-s with the folder table */
+	res = g_strdup_printf ("rowid IN (SELECT docid FROM %s WHERE %s MATCH %s)", table, headername, query);
+
+	g_free (fts_query);
+	g_free (table);
+	g_free (query);
+
+	return res;
+}
+
 static CamelSExpResult *
 check_header (struct _CamelSExp *f,
               gint argc,
@@ -381,31 +562,56 @@ check_header (struct _CamelSExp *f,
               gpointer data,
               camel_search_match_t how)
 {
+	SQLSExpData *ssd = data;
 	CamelSExpResult *r;
-	gchar *str = NULL;
+	GString *str = NULL;
+	gint n_values = 0;
 
 	d (printf ("executing check-header %d\n", how));
 
 	/* are we inside a match-all? */
 	if (argc > 1 && argv[0]->type == CAMEL_SEXP_RES_STRING) {
 		gchar *headername;
+		gboolean use_index = FALSE;
 		gint i;
 
 		/* only a subset of headers are supported .. */
 		headername = camel_db_get_column_name (argv[0]->value.string);
 		if (!headername) {
-			gboolean *pcontains_unknown_column = (gboolean *) data;
-			*pcontains_unknown_column = TRUE;
+			ssd->contains_unknown_column = TRUE;
 
 			headername = g_strdup ("unknown");
+		} else if (ssd->folder_name && ssd->with_header_index) {
+			use_index =
+				g_str_equal (headername, "subject") ||
+				g_str_equal (headername, "mail_from") ||
+				g_str_equal (headername, "mail_to") ||
+				g_str_equal (headername, "mail_cc") ||
+				g_str_equal (headername, "mlist");
 		}
 
+		str = g_string_new (NULL);
+
 		/* performs an OR of all words */
 		for (i = 1; i < argc; i++) {
 			if (argv[i]->type == CAMEL_SEXP_RES_STRING) {
-				gchar *value = NULL, *tstr = NULL;
+				gchar *value = NULL, *tstr = NULL, *index_cond = NULL;
 				if (argv[i]->value.string[0] == 0)
 					continue;
+
+				if (use_index && (how == CAMEL_SEARCH_MATCH_WORD || how == CAMEL_SEARCH_MATCH_CONTAINS || how == CAMEL_SEARCH_MATCH_STARTS))
+					index_cond = header_index_condition (ssd, headername, argv[i]->value.string, how);
+
+				if (n_values)
+					g_string_append (str, " OR ");
+				n_values++;
+
+				if (index_cond && how == CAMEL_SEARCH_MATCH_WORD) {
+					g_string_append_printf (str, "(%s)", index_cond);
+					g_free (index_cond);
+					continue;
+				}
+
 				if (how == CAMEL_SEARCH_MATCH_CONTAINS || how == CAMEL_SEARCH_MATCH_WORD) {
 					tstr = g_strdup_printf ("%c%s%c", '%', argv[i]->value.string, '%');
 					value = get_db_safe_string (tstr);
@@ -423,16 +629,27 @@ check_header (struct _CamelSExp *f,
 					value = get_db_safe_string (tstr);
 					g_free (tstr);
 				}
-				str = g_strdup_printf ("(%s IS NOT NULL AND %s LIKE %s)", headername, headername, value);
+				g_string_append_printf (str, "(%s IS NOT NULL AND %s LIKE %s", headername, headername, value);
+				if (index_cond)
+					g_string_append_printf (str, " AND %s", index_cond);
+				g_string_append_c (str, ')');
+				g_free (index_cond);
 				g_free (value);
 			}
 		}
 		g_free (headername);
+
+		if (n_values > 1) {
+			g_string_prepend (str, "( ");
+			g_string_append (str, " )");
+		}
 	}
 	/* TODO: else, find all matches */
 
 	r = camel_sexp_result_new (f, CAMEL_SEXP_RES_STRING);
-	r->value.string = str;
+	r->value.string = (str && n_values) ? g_string_free (str, FALSE) : NULL;
+	if (str && !n_values)
+		g_string_free (str, TRUE);
 
 	return r;
 }
@@ -529,6 +746,15 @@ user_tag (struct _CamelSExp *f,
 	d (printf ("executing user-tag: %d", argc));
 
 	r = camel_sexp_result_new (f, CAMEL_SEXP_RES_STRING);
+	if (((SQLSExpData *) data)->with_message_tags) {
+		if (argc == 1 && argv[0]->type == CAMEL_SEXP_RES_STRING && argv[0]->value.string)
+			r->value.string = g_strconcat (USERTAG_MARKER, argv[0]->value.string, NULL);
+		else
+			r->value.string = g_strdup ("(0)");
+
+		return r;
+	}
+
 	/* Hacks no otherway to fix these really :( */
 	if (g_strcmp0 (argv[0]->value.string, "completed-on") == 0)
 		r->value.string = g_strdup_printf ("(usertags LIKE '%ccompleted-on 0%c' AND usertags LIKE '%ccompleted-on%c')", '%', '%', '%', '%');
@@ -555,6 +781,14 @@ user_flag (struct _CamelSExp *f,
 
 	if (argc != 1) {
 		r->value.string = g_strdup ("(0)");
+	} else if (((SQLSExpData *) data)->with_message_tags) {
+		tstr = get_db_safe_string (((SQLSExpData *) data)->folder_name);
+		qstr = get_db_safe_string (argv[0]->value.string);
+		r->value.string = g_strdup_printf (
+			"(uid IN (SELECT uid FROM %s WHERE folder_name = %s AND label = %s))",
+			CAMEL_DB_LABELS_TABLE, tstr, qstr);
+		g_free (tstr);
+		g_free (qstr);
 	} else {
 		tstr = g_strdup_printf ("%s", argv[0]->value.string);
 		qstr = get_db_safe_string (tstr);
@@ -748,23 +982,64 @@ static struct {
  **/
 gchar *
 camel_sexp_to_sql_sexp (const gchar *sql)
+{
+	return camel_sexp_to_sql_sexp_with_folder (sql, NULL, FALSE, FALSE);
+}
+
+/**
+ * camel_sexp_to_sql_sexp_with_folder:
+ * @sql: a search expression
+ * @folder_name: (allow-none): full name of the searched folder, or %NULL
+ * @with_message_tags: whether the folder's labels and user tags are indexed
+ * @with_header_index: whether the folder has a header index
+ *
+ * Converts search expression @sql into an SQL WHERE clause, the same as
+ * camel_sexp_to_sql_sexp() does. With @with_message_tags, user flags
+ * and user tags are looked up in the #CAMEL_DB_LABELS_TABLE and
+ * #CAMEL_DB_USERTAGS_TABLE tables, which is much faster than matching
+ * the encoded 'labels' and 'usertags' columns of each message. Only
+ * folders for which camel_db_has_message_tags() returns %TRUE have
+ * their rows in those tables.
+ *
+ * With @with_header_index the 'header-has-words', 'header-contains' and
+ * 'header-starts-with' checks of the subject, from, to, cc and mailing
+ * list headers use the folder's full-text index, as described at
+ * camel_db_has_header_index(). Substrings, which cannot be looked up
+ * in it, are still compared on the summary columns with LIKE, the same
+ * as without the index.
+ *
+ * Returns: a newly allocated SQL clause, or %NULL when the expression
+ *    cannot be run as SQL. Free it with g_free(), when no longer needed.
+ *
+ * Since: 3.20
+ **/
+gchar *
+camel_sexp_to_sql_sexp_with_folder (const gchar *sql,
+                                    const gchar *folder_name,
+                                    gboolean with_message_tags,
+                                    gboolean with_header_index)
 {
 	CamelSExp *sexp;
 	CamelSExpResult *r;
 	gint i;
 	gchar *res = NULL;
-	gboolean contains_unknown_column = FALSE;
+	SQLSExpData ssd;
+
+	ssd.contains_unknown_column = FALSE;
+	ssd.folder_name = folder_name;
+	ssd.with_message_tags = with_message_tags && folder_name;
+	ssd.with_header_index = with_header_index && folder_name;
 
 	sexp = camel_sexp_new ();
 
 	for (i = 0; i < G_N_ELEMENTS (symbols); i++) {
 		if (symbols[i].immediate)
 			camel_sexp_add_ifunction (sexp, 0, symbols[i].name,
-					     (CamelSExpIFunc) symbols[i].func, &contains_unknown_column);
+					     (CamelSExpIFunc) symbols[i].func, &ssd);
 		else
 			camel_sexp_add_function (
 				sexp, 0, symbols[i].name,
-				symbols[i].func, &contains_unknown_column);
+				symbols[i].func, &ssd);
 	}
 
 	camel_sexp_input_text (sexp, sql, strlen (sql));
@@ -779,7 +1054,8 @@ camel_sexp_to_sql_sexp (const gchar *sql)
 		return NULL;
 	}
 
-	if (!contains_unknown_column && r->type == CAMEL_SEXP_RES_STRING) {
+	if (!ssd.contains_unknown_column && r->type == CAMEL_SEXP_RES_STRING &&
+	    (!r->value.string || !strstr (r->value.string, USERTAG_MARKER))) {
 		res = g_strdup (r->value.string);
 	}
 
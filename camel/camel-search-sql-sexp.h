@@ -30,6 +30,11 @@ G_BEGIN_DECLS
 
 /* FIXME: Weird naming, since, I want both parsers to be there for some time.*/
 gchar * camel_sexp_to_sql_sexp (const gchar *sexp);
+gchar * camel_sexp_to_sql_sexp_with_folder
+					(const gchar *sql,
+					 const gchar *folder_name,
+					 gboolean with_message_tags,
+					 gboolean with_header_index);
 
 G_END_DECLS
 
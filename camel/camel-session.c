@@ -42,6 +42,7 @@
 #include "camel-session.h"
 #include "camel-store.h"
 #include "camel-string-utils.h"
+#include "camel-trace.h"
 #include "camel-transport.h"
 #include "camel-url.h"
 
@@ -96,6 +97,8 @@ struct _JobData {
 	GDestroyNotify notify;
 	GMainContext *main_context;
 	GError *error;
+	gchar *description;
+	CamelTraceSpan queue_span;
 };
 
 enum {
@@ -157,6 +160,10 @@ job_data_free (JobData *job_data)
 	g_object_unref (job_data->session);
 	g_object_unref (job_data->cancellable);
 	g_clear_error (&job_data->error);
+	g_free (job_data->description);
+
+	/* When the job did not run */
+	camel_trace_span_clear (&job_data->queue_span);
 
 	if (job_data->main_context)
 		g_main_context_unref (job_data->main_context);
@@ -187,16 +194,22 @@ session_job_thread (gpointer data,
 		    gpointer user_data)
 {
 	JobData *job_data = (JobData *) data;
+	CamelTraceSpan span;
 	GSource *source;
 
 	g_return_if_fail (job_data != NULL);
 
+	camel_trace_span_end (&job_data->queue_span, -1, NULL);
+	camel_trace_span_begin (&span, "job", job_data->description, NULL);
+
 	job_data->callback (
 		job_data->session,
 		job_data->cancellable,
 		job_data->user_data,
 		&job_data->error);
 
+	camel_trace_span_end (&span, -1, job_data->error);
+
 	source = g_idle_source_new ();
 	g_source_set_priority (source, G_PRIORITY_DEFAULT);
 	g_source_set_callback (source, session_finish_job_cb, job_data, (GDestroyNotify) job_data_free);
@@ -1452,6 +1465,10 @@ camel_session_submit_job (CamelSession *session,
 	job_data->notify = notify;
 	job_data->main_context = NULL;
 	job_data->error = NULL;
+	job_data->description = g_strdup (description);
+
+	/* Measures the wait for a free thread of the job pool */
+	camel_trace_span_begin (&job_data->queue_span, "job-queue", description, NULL);
 
 	camel_operation_push_message (job_data->cancellable, "%s", description);
 
@@ -23,11 +23,13 @@
 
 struct _CamelStoreSettingsPrivate {
 	gboolean filter_inbox;
+	gboolean header_index;
 };
 
 enum {
 	PROP_0,
-	PROP_FILTER_INBOX
+	PROP_FILTER_INBOX,
+	PROP_HEADER_INDEX
 };
 
 G_DEFINE_TYPE (
@@ -47,6 +49,12 @@ store_settings_set_property (GObject *object,
 				CAMEL_STORE_SETTINGS (object),
 				g_value_get_boolean (value));
 			return;
+
+		case PROP_HEADER_INDEX:
+			camel_store_settings_set_header_index (
+				CAMEL_STORE_SETTINGS (object),
+				g_value_get_boolean (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -65,6 +73,13 @@ store_settings_get_property (GObject *object,
 				camel_store_settings_get_filter_inbox (
 				CAMEL_STORE_SETTINGS (object)));
 			return;
+
+		case PROP_HEADER_INDEX:
+			g_value_set_boolean (
+				value,
+				camel_store_settings_get_header_index (
+				CAMEL_STORE_SETTINGS (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -92,6 +107,18 @@ camel_store_settings_class_init (CamelStoreSettingsClass *class)
 			G_PARAM_READWRITE |
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_HEADER_INDEX,
+		g_param_spec_boolean (
+			"header-index",
+			"Header Index",
+			"Whether to keep a full-text index of message headers",
+			FALSE,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -142,3 +169,49 @@ camel_store_settings_set_filter_inbox (CamelStoreSettings *settings,
 
 	g_object_notify (G_OBJECT (settings), "filter-inbox");
 }
+
+/**
+ * camel_store_settings_get_header_index:
+ * @settings: a #CamelStoreSettings
+ *
+ * Returns whether to keep a full-text index of the subject and address
+ * headers of the messages in the store's folders, which speeds up quick
+ * searches on these headers.  The index of a folder is built in the
+ * background when the folder is opened.
+ *
+ * Returns: whether to keep a full-text index of message headers
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_store_settings_get_header_index (CamelStoreSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_STORE_SETTINGS (settings), FALSE);
+
+	return settings->priv->header_index;
+}
+
+/**
+ * camel_store_settings_set_header_index:
+ * @settings: a #CamelStoreSettings
+ * @header_index: whether to keep a full-text index of message headers
+ *
+ * Sets whether to keep a full-text index of the subject and address
+ * headers of the messages in the store's folders.  Indexes which exist
+ * already are kept up to date regardless of this setting.
+ *
+ * Since: 3.20
+ **/
+void
+camel_store_settings_set_header_index (CamelStoreSettings *settings,
+                                       gboolean header_index)
+{
+	g_return_if_fail (CAMEL_IS_STORE_SETTINGS (settings));
+
+	if (settings->priv->header_index == header_index)
+		return;
+
+	settings->priv->header_index = header_index;
+
+	g_object_notify (G_OBJECT (settings), "header-index");
+}
@@ -72,6 +72,11 @@ gboolean	camel_store_settings_get_filter_inbox
 void		camel_store_settings_set_filter_inbox
 						(CamelStoreSettings *settings,
 						 gboolean filter_inbox);
+gboolean	camel_store_settings_get_header_index
+						(CamelStoreSettings *settings);
+void		camel_store_settings_set_header_index
+						(CamelStoreSettings *settings,
+						 gboolean header_index);
 
 G_END_DECLS
 
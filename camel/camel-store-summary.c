@@ -48,10 +48,25 @@
 /* current version */
 #define CAMEL_STORE_SUMMARY_VERSION (2)
 
+/* version of the count journal, written next to the summary file */
+#define CAMEL_STORE_SUMMARY_JOURNAL_VERSION (1)
+
+/* the summary is rewritten, and the journal dropped, once it holds this many records */
+#define CAMEL_STORE_SUMMARY_JOURNAL_MAX_RECORDS (1024)
+
 #define CAMEL_STORE_SUMMARY_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_STORE_SUMMARY, CamelStoreSummaryPrivate))
 
+typedef struct _StoreSummaryNode StoreSummaryNode;
+
+struct _StoreSummaryNode {
+	StoreSummaryNode *parent;
+	GQueue children;	/* StoreSummaryNode * */
+	CamelStoreInfo *info;	/* not referenced, NULL for intermediate nodes */
+	gchar *path;
+};
+
 struct _CamelStoreSummaryPrivate {
 	GRecMutex summary_lock;	/* for the summary hashtable/array */
 	GRecMutex io_lock;	/* load/save lock, for access to saved_count, etc */
@@ -68,10 +83,97 @@ struct _CamelStoreSummaryPrivate {
 	GHashTable *folder_summaries; /* CamelFolderSummary->path; doesn't add reference to CamelFolderSummary */
 
 	guint scheduled_save_id;
+
+	/* folder counts changed since the last save, to be appended
+	 * to the journal instead of rewriting the whole summary */
+	GHashTable *journal_pending; /* gchar *path */
+	guint journal_records;	/* how many records the journal file holds */
+
+	/* the folders as a tree, including intermediate nodes for
+	 * the paths not stored in the summary */
+	GHashTable *nodes;	/* gchar *path ~> StoreSummaryNode * */
+	StoreSummaryNode *root;
 };
 
 G_DEFINE_TYPE (CamelStoreSummary, camel_store_summary, G_TYPE_OBJECT)
 
+static void
+store_summary_node_free (gpointer ptr)
+{
+	StoreSummaryNode *node = ptr;
+
+	g_queue_clear (&node->children);
+	g_free (node->path);
+	g_slice_free (StoreSummaryNode, node);
+}
+
+/* Call with summary_lock held */
+static StoreSummaryNode *
+store_summary_ensure_node (CamelStoreSummary *summary,
+                           const gchar *path)
+{
+	StoreSummaryNode *node;
+	const gchar *slash;
+	gchar *parent_path;
+
+	node = g_hash_table_lookup (summary->priv->nodes, path);
+	if (node != NULL)
+		return node;
+
+	node = g_slice_new0 (StoreSummaryNode);
+	node->path = g_strdup (path);
+	g_queue_init (&node->children);
+
+	/* The root node, with an empty path, has no parent */
+	if (*path != '\0') {
+		slash = strrchr (path, '/');
+		parent_path = slash != NULL ? g_strndup (path, slash - path) : g_strdup ("");
+		node->parent = store_summary_ensure_node (summary, parent_path);
+		g_free (parent_path);
+
+		g_queue_push_tail (&node->parent->children, node);
+	}
+
+	g_hash_table_insert (summary->priv->nodes, node->path, node);
+
+	return node;
+}
+
+/* Call with summary_lock held */
+static void
+store_summary_tree_insert (CamelStoreSummary *summary,
+                           CamelStoreInfo *info)
+{
+	StoreSummaryNode *node;
+
+	node = store_summary_ensure_node (summary, camel_store_info_path (summary, info));
+	node->info = info;
+}
+
+/* Call with summary_lock held */
+static void
+store_summary_tree_remove (CamelStoreSummary *summary,
+                           const gchar *path)
+{
+	StoreSummaryNode *node;
+
+	node = g_hash_table_lookup (summary->priv->nodes, path);
+	if (node == NULL)
+		return;
+
+	node->info = NULL;
+
+	/* Drop the intermediate nodes which are not needed anymore */
+	while (node->parent != NULL && node->info == NULL && g_queue_is_empty (&node->children)) {
+		StoreSummaryNode *parent = node->parent;
+
+		g_queue_remove (&parent->children, node);
+		g_hash_table_remove (summary->priv->nodes, node->path);
+
+		node = parent;
+	}
+}
+
 static void
 store_summary_finalize (GObject *object)
 {
@@ -88,6 +190,8 @@ store_summary_finalize (GObject *object)
 	g_ptr_array_free (summary->folders, TRUE);
 	g_hash_table_destroy (summary->folders_path);
 	g_hash_table_destroy (summary->priv->folder_summaries);
+	g_hash_table_destroy (summary->priv->journal_pending);
+	g_hash_table_destroy (summary->priv->nodes);
 
 	g_free (summary->priv->summary_path);
 
@@ -243,9 +347,11 @@ store_summary_store_info_set_string (CamelStoreSummary *summary,
 	switch (type) {
 	case CAMEL_STORE_INFO_PATH:
 		g_hash_table_remove (summary->folders_path, (gchar *) camel_store_info_path (summary, info));
+		store_summary_tree_remove (summary, camel_store_info_path (summary, info));
 		g_free (info->path);
 		info->path = g_strdup (str);
 		g_hash_table_insert (summary->folders_path, (gchar *) camel_store_info_path (summary, info), info);
+		store_summary_tree_insert (summary, info);
 		summary->priv->dirty = TRUE;
 		break;
 	}
@@ -283,6 +389,11 @@ camel_store_summary_init (CamelStoreSummary *summary)
 	summary->folders_path = g_hash_table_new (g_str_hash, g_str_equal);
 	summary->priv->folder_summaries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 	summary->priv->scheduled_save_id = 0;
+	summary->priv->journal_pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* The nodes own their paths */
+	summary->priv->nodes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, store_summary_node_free);
+	summary->priv->root = store_summary_ensure_node (summary, "");
 
 	g_rec_mutex_init (&summary->priv->summary_lock);
 	g_rec_mutex_init (&summary->priv->io_lock);
@@ -394,6 +505,63 @@ camel_store_summary_array_free (CamelStoreSummary *summary,
 	g_ptr_array_free (array, TRUE);
 }
 
+static void
+store_summary_collect_subtree (CamelStoreSummary *summary,
+                               StoreSummaryNode *node,
+                               GPtrArray *array)
+{
+	GList *link;
+
+	if (node->info != NULL)
+		g_ptr_array_add (array, camel_store_summary_info_ref (summary, node->info));
+
+	for (link = g_queue_peek_head_link (&node->children); link != NULL; link = g_list_next (link)) {
+		store_summary_collect_subtree (summary, link->data, array);
+	}
+}
+
+/**
+ * camel_store_summary_subtree_array:
+ * @summary: a #CamelStoreSummary object
+ * @top: (nullable): path of the subtree, or %NULL or an empty string for all folders
+ *
+ * Obtain a copy of the summary items with path @top and those below it,
+ * like camel_store_summary_array() does for all items.  The items are
+ * looked up in a folder tree kept up to date with the summary, thus
+ * the cost depends on the size of the subtree, not of the summary.
+ * Parents are always before their children in the array.
+ *
+ * It must be freed using camel_store_summary_array_free().
+ *
+ * Returns: (element-type CamelStoreInfo) (transfer full): the summary items of the subtree
+ *
+ * Since: 3.20
+ **/
+GPtrArray *
+camel_store_summary_subtree_array (CamelStoreSummary *summary,
+                                   const gchar *top)
+{
+	StoreSummaryNode *node;
+	GPtrArray *res;
+
+	g_return_val_if_fail (CAMEL_IS_STORE_SUMMARY (summary), NULL);
+
+	if (top == NULL)
+		top = "";
+
+	g_rec_mutex_lock (&summary->priv->summary_lock);
+
+	node = g_hash_table_lookup (summary->priv->nodes, top);
+
+	res = g_ptr_array_new ();
+	if (node != NULL)
+		store_summary_collect_subtree (summary, node, res);
+
+	g_rec_mutex_unlock (&summary->priv->summary_lock);
+
+	return res;
+}
+
 /**
  * camel_store_summary_path:
  * @summary: a #CamelStoreSummary object
@@ -428,6 +596,129 @@ camel_store_summary_path (CamelStoreSummary *summary,
 	return info;
 }
 
+static gchar *
+store_summary_dup_journal_path (CamelStoreSummary *summary)
+{
+	return g_strconcat (summary->priv->summary_path, ".journal", NULL);
+}
+
+/* Applies the folder counts saved in the journal over the just loaded
+ * summary.  Returns whether the summary should be rewritten, either
+ * because the journal is too long or because it cannot be appended to. */
+static gboolean
+store_summary_journal_replay (CamelStoreSummary *summary)
+{
+	FILE *in;
+	gchar *journal_path;
+	gint32 version;
+	gint chr;
+
+	summary->priv->journal_records = 0;
+
+	journal_path = store_summary_dup_journal_path (summary);
+	in = g_fopen (journal_path, "rb");
+	g_free (journal_path);
+
+	if (in == NULL)
+		return FALSE;
+
+	if (camel_file_util_decode_fixed_int32 (in, &version) == -1 ||
+	    version != CAMEL_STORE_SUMMARY_JOURNAL_VERSION) {
+		fclose (in);
+		return TRUE;
+	}
+
+	while ((chr = fgetc (in)) != EOF) {
+		CamelStoreInfo *info;
+		gchar *path = NULL;
+		guint32 unread, total;
+
+		ungetc (chr, in);
+
+		/* A record torn by a crash ends the journal */
+		if (camel_file_util_decode_string (in, &path) == -1 ||
+		    camel_file_util_decode_uint32 (in, &unread) == -1 ||
+		    camel_file_util_decode_uint32 (in, &total) == -1) {
+			g_free (path);
+			fclose (in);
+			return TRUE;
+		}
+
+		info = g_hash_table_lookup (summary->folders_path, path);
+		if (info != NULL) {
+			info->unread = unread;
+			info->total = total;
+		}
+
+		g_free (path);
+
+		summary->priv->journal_records++;
+	}
+
+	fclose (in);
+
+	return summary->priv->journal_records > CAMEL_STORE_SUMMARY_JOURNAL_MAX_RECORDS;
+}
+
+/* Appends the changed folder counts to the journal.  Returns %FALSE
+ * when the whole summary should be written instead.
+ * Call with io_lock and then summary_lock held, the order
+ * camel_store_summary_load() takes them in. */
+static gboolean
+store_summary_journal_append (CamelStoreSummary *summary)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gchar *journal_path;
+	FILE *out;
+	gboolean success = TRUE;
+
+	if (summary->priv->journal_records + g_hash_table_size (summary->priv->journal_pending) >
+	    CAMEL_STORE_SUMMARY_JOURNAL_MAX_RECORDS)
+		return FALSE;
+
+	journal_path = store_summary_dup_journal_path (summary);
+	out = g_fopen (journal_path, "ab");
+	g_free (journal_path);
+
+	if (out == NULL)
+		return FALSE;
+
+	io (printf ("** appending %u records to summary journal\n", g_hash_table_size (summary->priv->journal_pending)));
+
+	if (fseek (out, 0, SEEK_END) == -1)
+		success = FALSE;
+	else if (ftell (out) == 0)
+		success = camel_file_util_encode_fixed_int32 (out, CAMEL_STORE_SUMMARY_JOURNAL_VERSION) != -1;
+
+	g_hash_table_iter_init (&iter, summary->priv->journal_pending);
+	while (success && g_hash_table_iter_next (&iter, &key, NULL)) {
+		CamelStoreInfo *info;
+
+		info = g_hash_table_lookup (summary->folders_path, key);
+		if (info == NULL)
+			continue;
+
+		success =
+			camel_file_util_encode_string (out, camel_store_info_path (summary, info)) != -1 &&
+			camel_file_util_encode_uint32 (out, info->unread) != -1 &&
+			camel_file_util_encode_uint32 (out, info->total) != -1;
+
+		summary->priv->journal_records++;
+	}
+
+	if (success)
+		success = fflush (out) == 0 && fsync (fileno (out)) != -1;
+
+	if (fclose (out) != 0)
+		success = FALSE;
+
+	if (success)
+		g_hash_table_remove_all (summary->priv->journal_pending);
+
+	return success;
+}
+
 /**
  * camel_store_summary_load:
  * @summary: a #CamelStoreSummary object
@@ -474,7 +765,7 @@ camel_store_summary_load (CamelStoreSummary *summary)
 	if (fclose (in) != 0)
 		return -1;
 
-	summary->priv->dirty = FALSE;
+	summary->priv->dirty = store_summary_journal_replay (summary);
 
 	return 0;
 
@@ -494,7 +785,10 @@ error:
  * @summary: a #CamelStoreSummary object
  *
  * Writes the summary to disk.  The summary is only written if changes
- * have occurred.
+ * have occurred.  When only the folder counts changed, as tracked by
+ * camel_store_summary_connect_folder_summary(), they are appended
+ * to a journal next to the summary file instead; the journal is folded
+ * into the summary when it grows too long or on the next full write.
  *
  * Returns: %0 on succes or %-1 on fail
  **/
@@ -504,6 +798,7 @@ camel_store_summary_save (CamelStoreSummary *summary)
 	CamelStoreSummaryClass *class;
 	CamelStoreInfo *info;
 	FILE *out;
+	gchar *journal_path;
 	gint fd;
 	gint i;
 	guint32 count;
@@ -517,10 +812,37 @@ camel_store_summary_save (CamelStoreSummary *summary)
 	io (printf ("** saving summary\n"));
 
 	if (!summary->priv->dirty) {
-		io (printf ("**  summary clean no save\n"));
-		return 0;
+		gboolean appended = TRUE;
+
+		/* Only folder counts changed, append them to the journal */
+		g_rec_mutex_lock (&summary->priv->io_lock);
+		g_rec_mutex_lock (&summary->priv->summary_lock);
+		if (g_hash_table_size (summary->priv->journal_pending) > 0)
+			appended = store_summary_journal_append (summary);
+		g_rec_mutex_unlock (&summary->priv->summary_lock);
+		g_rec_mutex_unlock (&summary->priv->io_lock);
+
+		if (appended) {
+			io (printf ("**  summary clean no save\n"));
+			return 0;
+		}
 	}
 
+	/* The summary written below holds everything the journal does.
+	 * Remove the journal first, so that it is never applied over
+	 * a newer summary. */
+	journal_path = store_summary_dup_journal_path (summary);
+	if (g_unlink (journal_path) == -1 && errno != ENOENT) {
+		i = errno;
+		io (printf ("**  journal unlink error: %s\n", g_strerror (errno)));
+		g_free (journal_path);
+		errno = i;
+		return -1;
+	}
+	g_free (journal_path);
+
+	summary->priv->journal_records = 0;
+
 	fd = g_open (
 		summary->priv->summary_path,
 		O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0600);
@@ -572,7 +894,10 @@ camel_store_summary_save (CamelStoreSummary *summary)
 	if (fclose (out) != 0)
 		return -1;
 
+	g_rec_mutex_lock (&summary->priv->summary_lock);
+	g_hash_table_remove_all (summary->priv->journal_pending);
 	summary->priv->dirty = FALSE;
+	g_rec_mutex_unlock (&summary->priv->summary_lock);
 
 	return 0;
 }
@@ -608,6 +933,7 @@ camel_store_summary_add (CamelStoreSummary *summary,
 
 	g_ptr_array_add (summary->folders, info);
 	g_hash_table_insert (summary->folders_path, (gchar *) camel_store_info_path (summary, info), info);
+	store_summary_tree_insert (summary, info);
 	summary->priv->dirty = TRUE;
 
 	g_rec_mutex_unlock (&summary->priv->summary_lock);
@@ -647,6 +973,7 @@ camel_store_summary_add_from_path (CamelStoreSummary *summary,
 
 		g_ptr_array_add (summary->folders, info);
 		g_hash_table_insert (summary->folders_path, (gchar *) camel_store_info_path (summary, info), info);
+		store_summary_tree_insert (summary, info);
 		summary->priv->dirty = TRUE;
 	}
 
@@ -734,6 +1061,7 @@ camel_store_summary_remove (CamelStoreSummary *summary,
 
 	g_rec_mutex_lock (&summary->priv->summary_lock);
 	g_hash_table_remove (summary->folders_path, camel_store_info_path (summary, info));
+	store_summary_tree_remove (summary, camel_store_info_path (summary, info));
 	g_ptr_array_remove (summary->folders, info);
 	summary->priv->dirty = TRUE;
 	g_rec_mutex_unlock (&summary->priv->summary_lock);
@@ -932,14 +1260,14 @@ store_summary_sync_folder_summary_count_cb (CamelFolderSummary *folder_summary,
 		new_count = camel_folder_summary_get_saved_count (folder_summary);
 		if (si->total != new_count) {
 			si->total = new_count;
-			camel_store_summary_touch (summary);
+			g_hash_table_add (summary->priv->journal_pending, g_strdup (path));
 			store_summary_schedule_save (summary);
 		}
 	} else if (g_strcmp0 (g_param_spec_get_name (param), "unread-count") == 0) {
 		new_count = camel_folder_summary_get_unread_count (folder_summary);
 		if (si->unread != new_count) {
 			si->unread = new_count;
-			camel_store_summary_touch (summary);
+			g_hash_table_add (summary->priv->journal_pending, g_strdup (path));
 			store_summary_schedule_save (summary);
 		}
 	} else {
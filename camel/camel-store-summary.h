@@ -161,6 +161,9 @@ CamelStoreInfo *
 GPtrArray *	camel_store_summary_array	(CamelStoreSummary *summary);
 void		camel_store_summary_array_free	(CamelStoreSummary *summary,
 						 GPtrArray *array);
+GPtrArray *	camel_store_summary_subtree_array
+						(CamelStoreSummary *summary,
+						 const gchar *top);
 
 void		camel_store_info_set_string	(CamelStoreSummary *summary,
 						 CamelStoreInfo *info,
@@ -24,6 +24,7 @@
 #endif
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -36,20 +37,34 @@
 #include "camel-folder.h"
 #include "camel-network-service.h"
 #include "camel-offline-store.h"
+#include "camel-search-private.h"
 #include "camel-session.h"
 #include "camel-store.h"
 #include "camel-store-settings.h"
+#include "camel-string-utils.h"
 #include "camel-subscribable.h"
 #include "camel-vtrash-folder.h"
 
 #define d(x)
 #define w(x)
 
+/* How many read-only connections the store database can use. */
+#define STORE_DB_READERS 3
+
+/* How many folder tables to search with one SQL statement;
+ * SQLite allows up to 500 parts of a compound SELECT by default. */
+#define STORE_SEARCH_CHUNK 100
+
+/* How many folders to search in parallel, when the expression
+ * cannot be translated to SQL */
+#define STORE_SEARCH_THREADS 4
+
 #define CAMEL_STORE_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_STORE, CamelStorePrivate))
 
 typedef struct _AsyncContext AsyncContext;
+typedef struct _StoreSearchData StoreSearchData;
 typedef struct _SignalClosure SignalClosure;
 
 struct _CamelStorePrivate {
@@ -73,6 +88,15 @@ struct _SignalClosure {
 	gchar *folder_name;
 };
 
+struct _StoreSearchData {
+	GPtrArray *folders;	/* CamelFolder *, as given */
+	GPtrArray *results;	/* GPtrArray * of UIDs, one per folder */
+	const gchar *expression;
+	GCancellable *cancellable;
+	GMutex lock;
+	GError *error;
+};
+
 enum {
 	FOLDER_CREATED,
 	FOLDER_DELETED,
@@ -570,6 +594,11 @@ store_initable_init (GInitable *initable,
 	if (camel_db_create_folders_table (store->cdb_r, error))
 		return FALSE;
 
+	/* Reads go through separate connections, thus searches and
+	 * counts do not wait for a summary save of another folder. */
+	if (camel_db_enable_readers (store->cdb_r, STORE_DB_READERS, error))
+		return FALSE;
+
 	/* keep cb_w to not break the ABI */
 	store->cdb_w = store->cdb_r;
 
@@ -1207,6 +1236,63 @@ camel_store_can_refresh_folder (CamelStore *store,
 	return class->can_refresh_folder (store, info, error);
 }
 
+static void
+store_build_header_index_thread (CamelSession *session,
+                                 GCancellable *cancellable,
+                                 CamelFolder *folder,
+                                 GError **error)
+{
+	CamelStore *parent_store;
+
+	parent_store = camel_folder_get_parent_store (folder);
+	if (!parent_store || !parent_store->cdb_w)
+		return;
+
+	if (camel_db_enable_header_index (parent_store->cdb_w, error) == 0)
+		camel_db_build_header_index (
+			parent_store->cdb_w,
+			camel_folder_get_full_name (folder),
+			error);
+}
+
+/* Quick searches on subject and addresses can use a full-text index, which
+ * is built for each folder when it is opened, unless it exists already. */
+static void
+store_maybe_build_header_index (CamelStore *store,
+                                CamelFolder *folder)
+{
+	CamelSession *session;
+	CamelSettings *settings;
+	gboolean header_index = FALSE;
+	gchar *description;
+
+	if (CAMEL_IS_VEE_FOLDER (folder) || !store->cdb_w)
+		return;
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (store));
+	if (CAMEL_IS_STORE_SETTINGS (settings))
+		header_index = camel_store_settings_get_header_index (CAMEL_STORE_SETTINGS (settings));
+	g_clear_object (&settings);
+
+	if (!header_index || camel_db_has_header_index (store->cdb_w, camel_folder_get_full_name (folder)))
+		return;
+
+	session = camel_service_ref_session (CAMEL_SERVICE (store));
+	if (!session)
+		return;
+
+	description = g_strdup_printf (_("Indexing headers of folder '%s'"), camel_folder_get_display_name (folder));
+
+	camel_session_submit_job (
+		session, description,
+		(CamelSessionCallback) store_build_header_index_thread,
+		g_object_ref (folder),
+		(GDestroyNotify) g_object_unref);
+
+	g_free (description);
+	g_object_unref (session);
+}
+
 /**
  * camel_store_get_folder_sync:
  * @store: a #CamelStore
@@ -1357,8 +1443,10 @@ try_again:
 
 	camel_operation_pop_message (cancellable);
 
-	if (folder != NULL)
+	if (folder != NULL) {
 		camel_store_folder_opened (store, folder);
+		store_maybe_build_header_index (store, folder);
+	}
 
 	/* Handle CAMEL_STORE_FOLDER_CREATE flag. */
 	if (create_folder) {
@@ -3134,3 +3222,266 @@ camel_store_maybe_run_db_maintenance (CamelStore *store,
 
 	return camel_db_maybe_run_maintenance (store->cdb_w, error);
 }
+
+static void
+store_search_free_uids (gpointer ptr)
+{
+	GPtrArray *uids = ptr;
+
+	if (uids) {
+		g_ptr_array_foreach (uids, (GFunc) camel_pstring_free, NULL);
+		g_ptr_array_free (uids, TRUE);
+	}
+}
+
+static gint
+store_search_read_cb (gpointer user_data,
+                      gint ncol,
+                      gchar **cols,
+                      gchar **names)
+{
+	StoreSearchData *ssd = user_data;
+	guint index;
+
+	if (ncol != 2 || !cols[0] || !cols[1])
+		return 0;
+
+	index = strtoul (cols[0], NULL, 10);
+	if (index < ssd->results->len)
+		g_ptr_array_add (
+			g_ptr_array_index (ssd->results, index),
+			(gpointer) camel_pstring_strdup (cols[1]));
+
+	return 0;
+}
+
+/* Runs selects[from, to) as one compound statement */
+static gboolean
+store_search_run_sql (CamelStore *store,
+                      StoreSearchData *ssd,
+                      GPtrArray *selects,
+                      guint from,
+                      guint to,
+                      GError **error)
+{
+	GString *stmt;
+	GError *local_error = NULL;
+	guint ii;
+
+	stmt = g_string_new (NULL);
+	for (ii = from; ii < to; ii++) {
+		if (ii > from)
+			g_string_append (stmt, " UNION ALL ");
+		g_string_append (stmt, g_ptr_array_index (selects, ii));
+	}
+
+	camel_db_select (store->cdb_r, stmt->str, store_search_read_cb, ssd, &local_error);
+
+	g_string_free (stmt, TRUE);
+
+	/* Some folder was never saved, which the statement preparation
+	 * found out before returning any row; go one by one and skip it,
+	 * the same as camel_folder_search_search() does. */
+	if (local_error && local_error->message &&
+	    g_str_has_prefix (local_error->message, "no such table")) {
+		g_clear_error (&local_error);
+
+		for (ii = from; ii < to && !local_error; ii++) {
+			camel_db_select (
+				store->cdb_r, g_ptr_array_index (selects, ii),
+				store_search_read_cb, ssd, &local_error);
+
+			if (local_error && local_error->message &&
+			    g_str_has_prefix (local_error->message, "no such table"))
+				g_clear_error (&local_error);
+		}
+	}
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+store_search_folder_thread (gpointer data,
+                            gpointer user_data)
+{
+	StoreSearchData *ssd = user_data;
+	guint index = GPOINTER_TO_UINT (data) - 1;
+	CamelFolder *folder;
+	GPtrArray *matches;
+	GError *local_error = NULL;
+	guint ii;
+
+	g_mutex_lock (&ssd->lock);
+	if (ssd->error) {
+		g_mutex_unlock (&ssd->lock);
+		return;
+	}
+	g_mutex_unlock (&ssd->lock);
+
+	if (g_cancellable_is_cancelled (ssd->cancellable))
+		return;
+
+	folder = g_ptr_array_index (ssd->folders, index);
+	matches = camel_folder_search_by_expression (folder, ssd->expression, ssd->cancellable, &local_error);
+
+	g_mutex_lock (&ssd->lock);
+	if (matches) {
+		GPtrArray *uids = g_ptr_array_index (ssd->results, index);
+
+		for (ii = 0; ii < matches->len; ii++) {
+			g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (g_ptr_array_index (matches, ii)));
+		}
+	} else if (local_error && !ssd->error) {
+		ssd->error = local_error;
+		local_error = NULL;
+	}
+	g_mutex_unlock (&ssd->lock);
+
+	if (matches)
+		camel_folder_search_free (folder, matches);
+	g_clear_error (&local_error);
+}
+
+/**
+ * camel_store_search_folders_sync:
+ * @store: a #CamelStore
+ * @folders: (element-type CamelFolder): folders of the @store to search in
+ * @expression: a search expression
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Searches all the @folders with one search @expression, the same as
+ * camel_folder_search_by_expression() called on each of them would do.
+ * When the @expression can be translated to SQL, the folder tables are
+ * searched together with a single compound statement, without loading
+ * the folder summaries, instead of one statement per folder.  Folders
+ * whose search cannot be done in SQL, like when the @expression checks
+ * message bodies, or which do not belong to the @store, are searched
+ * in parallel with camel_folder_search_by_expression().
+ *
+ * Free the returned #GHashTable with g_hash_table_destroy(), when no
+ * longer needed.
+ *
+ * Returns: (transfer full) (element-type CamelFolder GPtrArray): a #GHashTable
+ *    with a #GPtrArray of matching message UIDs for each of the @folders,
+ *    or %NULL on error.  The UIDs are from the camel_pstring_strdup() pool.
+ *
+ * Since: 3.20
+ **/
+GHashTable *
+camel_store_search_folders_sync (CamelStore *store,
+                                 GPtrArray *folders,
+                                 const gchar *expression,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+	StoreSearchData ssd;
+	GPtrArray *selects;
+	GArray *fallback;
+	GHashTable *result = NULL;
+	gboolean success = TRUE;
+	guint ii;
+
+	g_return_val_if_fail (CAMEL_IS_STORE (store), NULL);
+	g_return_val_if_fail (folders != NULL, NULL);
+
+	if (!expression || !*expression)
+		expression = "(match-all)";
+
+	ssd.folders = folders;
+	ssd.results = g_ptr_array_new_full (folders->len, store_search_free_uids);
+	ssd.expression = expression;
+	ssd.cancellable = cancellable;
+	ssd.error = NULL;
+	g_mutex_init (&ssd.lock);
+
+	selects = g_ptr_array_new_with_free_func (g_free);
+	fallback = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	for (ii = 0; ii < folders->len; ii++) {
+		CamelFolder *folder = g_ptr_array_index (folders, ii);
+		gchar *sql = NULL, *stmt;
+
+		g_ptr_array_add (ssd.results, g_ptr_array_new ());
+
+		if (store->cdb_r && folder->summary &&
+		    camel_folder_get_parent_store (folder) == store)
+			sql = camel_search_folder_expression_to_sql (folder, expression);
+
+		if (!sql) {
+			g_array_append_val (fallback, ii);
+			continue;
+		}
+
+		/* Sync the db, so that we search the db for changes */
+		camel_folder_summary_save_to_db (folder->summary, NULL);
+
+		stmt = sqlite3_mprintf (
+			"SELECT %u, uid FROM %Q WHERE %s", ii,
+			camel_folder_get_full_name (folder), sql);
+		g_ptr_array_add (selects, g_strdup (stmt));
+		sqlite3_free (stmt);
+		g_free (sql);
+	}
+
+	for (ii = 0; success && ii < selects->len; ii += STORE_SEARCH_CHUNK) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		success = store_search_run_sql (
+			store, &ssd, selects, ii,
+			MIN (ii + STORE_SEARCH_CHUNK, selects->len), error);
+	}
+
+	if (success && fallback->len == 1) {
+		store_search_folder_thread (GUINT_TO_POINTER (g_array_index (fallback, guint, 0) + 1), &ssd);
+	} else if (success && fallback->len > 1) {
+		GThreadPool *pool;
+
+		pool = g_thread_pool_new (
+			store_search_folder_thread, &ssd,
+			MIN (fallback->len, STORE_SEARCH_THREADS), FALSE, NULL);
+
+		for (ii = 0; ii < fallback->len; ii++) {
+			g_thread_pool_push (pool, GUINT_TO_POINTER (g_array_index (fallback, guint, ii) + 1), NULL);
+		}
+
+		/* waits for all the jobs to finish */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+
+	if (success && ssd.error) {
+		g_propagate_error (error, ssd.error);
+		ssd.error = NULL;
+		success = FALSE;
+	}
+
+	if (success && g_cancellable_set_error_if_cancelled (cancellable, error))
+		success = FALSE;
+
+	if (success) {
+		result = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, store_search_free_uids);
+
+		for (ii = 0; ii < folders->len; ii++) {
+			g_hash_table_insert (
+				result, g_object_ref (g_ptr_array_index (folders, ii)),
+				g_ptr_array_index (ssd.results, ii));
+			ssd.results->pdata[ii] = NULL;
+		}
+	}
+
+	g_clear_error (&ssd.error);
+	g_mutex_clear (&ssd.lock);
+	g_ptr_array_unref (ssd.results);
+	g_ptr_array_unref (selects);
+	g_array_free (fallback, TRUE);
+
+	return result;
+}
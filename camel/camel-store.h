@@ -404,6 +404,11 @@ gboolean	camel_store_initial_setup_finish
 gboolean	camel_store_maybe_run_db_maintenance
 						(CamelStore *store,
 						 GError **error);
+GHashTable *	camel_store_search_folders_sync	(CamelStore *store,
+						 GPtrArray *folders,
+						 const gchar *expression,
+						 GCancellable *cancellable,
+						 GError **error);
 
 G_END_DECLS
 
@@ -40,6 +40,7 @@ struct _CamelStreamBufferPrivate {
 
 	guchar *buf, *ptr, *end;
 	gint size;
+	gboolean filled;	/* the last read filled the whole buffer */
 
 	guchar *linebuf;	/* for reading lines at a time */
 	gint linesize;
@@ -51,6 +52,10 @@ G_DEFINE_TYPE (CamelStreamBuffer, camel_stream_buffer, CAMEL_TYPE_STREAM)
 
 #define BUF_SIZE 1024
 
+/* Read buffers double up to this size while the reads keep filling them,
+ * thus long sequential reads do not cost one syscall per kilobyte. */
+#define BUF_SIZE_MAX (64 * 1024)
+
 /* only returns the number passed in, or -1 on an error */
 static gssize
 stream_write_all (CamelStream *stream,
@@ -87,9 +92,26 @@ set_vbuf (CamelStreamBuffer *stream,
 	priv->ptr = priv->buf;
 	priv->end = priv->buf;
 	priv->size = BUF_SIZE;
+	priv->filled = FALSE;
 	priv->mode = mode;
 }
 
+/* Call only with an empty read buffer, just before refilling it */
+static void
+stream_buffer_grow (CamelStreamBufferPrivate *priv)
+{
+	if (!priv->filled || priv->size >= BUF_SIZE_MAX)
+		return;
+
+	priv->size = MIN (priv->size * 2, BUF_SIZE_MAX);
+	priv->filled = FALSE;
+
+	g_free (priv->buf);
+	priv->buf = g_malloc (priv->size);
+	priv->ptr = priv->buf;
+	priv->end = priv->buf;
+}
+
 static void
 stream_buffer_dispose (GObject *object)
 {
@@ -158,11 +180,13 @@ stream_buffer_read (CamelStream *stream,
 					bptr += bytes_read;
 				}
 			} else {
+				stream_buffer_grow (priv);
 				bytes_read = camel_stream_read (
 					priv->stream, (gchar *) priv->buf,
 					priv->size, cancellable, &local_error);
 				if (bytes_read > 0) {
 					gsize bytes_used = bytes_read > n ? n : bytes_read;
+					priv->filled = (bytes_read == priv->size);
 					priv->ptr = priv->buf;
 					priv->end = priv->buf + bytes_read;
 					memcpy (bptr, priv->ptr, bytes_used);
@@ -358,7 +382,8 @@ camel_stream_buffer_init (CamelStreamBuffer *stream)
  *
  * Create a new buffered stream of another stream.  A default
  * buffer size (1024 bytes), automatically managed will be used
- * for buffering.
+ * for buffering.  When reading, the buffer grows up to 64 kilobytes
+ * while the reads keep filling it.
  *
  * The following values are available for @mode:
  *
@@ -445,9 +470,11 @@ camel_stream_buffer_gets (CamelStreamBuffer *sbf,
 		if (outptr == outend)
 			break;
 
+		stream_buffer_grow (sbf->priv);
 		bytes_read = camel_stream_read (
 			sbf->priv->stream, (gchar *) sbf->priv->buf,
 			sbf->priv->size, cancellable, &local_error);
+		sbf->priv->filled = (bytes_read == sbf->priv->size);
 		if (bytes_read == -1) {
 			if (buf == outptr) {
 				if (local_error)
@@ -37,6 +37,7 @@
 #include "camel-mempool.h"
 #include "camel-object.h"
 #include "camel-partition-table.h"
+#include "camel-search-private.h"
 #include "camel-text-index.h"
 
 #define w(x)
@@ -65,6 +66,10 @@ struct _CamelTextIndexNamePrivate {
 	GString *buffer;
 	camel_key_t nameid;
 	CamelMemPool *pool;
+
+	/* current run of characters from a script without spaces */
+	gunichar ngram_last;
+	gint ngram_run;
 };
 
 CamelTextIndexName *camel_text_index_name_new (CamelTextIndex *idx, const gchar *name, camel_key_t nameid);
@@ -1551,6 +1556,48 @@ camel_utf8_next (const guchar **ptr,
 	return 0;
 }
 
+/* Scripts like Chinese, Japanese or Thai don't separate words with
+ * spaces, so a run of their characters would otherwise end up as one
+ * long token, usually longer than CAMEL_TEXT_INDEX_MAX_WORDLEN and so
+ * not indexed at all.  Such runs are indexed as overlapping pairs of
+ * characters instead, which camel_search_words_simple() generates for
+ * the search words as well. */
+static void
+text_index_name_add_ngram (CamelIndexName *idn,
+                           gunichar c)
+{
+	CamelTextIndexNamePrivate *p = CAMEL_TEXT_INDEX_NAME_GET_PRIVATE (idn);
+	gchar utf8[16];
+	gint utf8len;
+
+	if (p->ngram_run > 0) {
+		utf8len = g_unichar_to_utf8 (p->ngram_last, utf8);
+		utf8len += g_unichar_to_utf8 (c, utf8 + utf8len);
+		utf8[utf8len] = 0;
+		text_index_name_add_word (idn, utf8);
+	}
+
+	p->ngram_last = c;
+	p->ngram_run = MIN (p->ngram_run + 1, 2);
+}
+
+static void
+text_index_name_end_ngram (CamelIndexName *idn)
+{
+	CamelTextIndexNamePrivate *p = CAMEL_TEXT_INDEX_NAME_GET_PRIVATE (idn);
+	gchar utf8[8];
+	gint utf8len;
+
+	/* a lone character has no pair, index it on its own */
+	if (p->ngram_run == 1) {
+		utf8len = g_unichar_to_utf8 (p->ngram_last, utf8);
+		utf8[utf8len] = 0;
+		text_index_name_add_word (idn, utf8);
+	}
+
+	p->ngram_run = 0;
+}
+
 static gsize
 text_index_name_add_buffer (CamelIndexName *idn,
                             const gchar *buffer,
@@ -1563,6 +1610,7 @@ text_index_name_add_buffer (CamelIndexName *idn,
 	gint utf8len;
 
 	if (buffer == NULL) {
+		text_index_name_end_ngram (idn);
 		if (p->buffer->len) {
 			camel_index_name_add_word (idn, p->buffer->str);
 			g_string_truncate (p->buffer, 0);
@@ -1573,12 +1621,22 @@ text_index_name_add_buffer (CamelIndexName *idn,
 	ptr = (const guchar *) buffer;
 	ptrend = (const guchar *) buffer + len;
 	while ((c = camel_utf8_next (&ptr, ptrend))) {
-		if (g_unichar_isalnum (c)) {
+		if (g_unichar_isalnum (c) && camel_search_char_is_unspaced (c)) {
+			if (p->buffer->len > 0 && p->buffer->len <= CAMEL_TEXT_INDEX_MAX_WORDLEN)
+				text_index_name_add_word (idn, p->buffer->str);
+			g_string_truncate (p->buffer, 0);
+
+			text_index_name_add_ngram (idn, c);
+		} else if (g_unichar_isalnum (c)) {
+			text_index_name_end_ngram (idn);
+
 			c = g_unichar_tolower (c);
 			utf8len = g_unichar_to_utf8 (c, utf8);
 			utf8[utf8len] = 0;
 			g_string_append (p->buffer, utf8);
 		} else {
+			text_index_name_end_ngram (idn);
+
 			if (p->buffer->len > 0 && p->buffer->len <= CAMEL_TEXT_INDEX_MAX_WORDLEN) {
 				text_index_name_add_word (idn, p->buffer->str);
 				/*camel_index_name_add_word (idn, p->buffer->str);*/
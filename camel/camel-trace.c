@@ -0,0 +1,430 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * camel-trace.c
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * SECTION: camel-trace
+ * @short_description: Timed spans of camel operations
+ *
+ * The trace records how long the IMAP commands, the database transactions,
+ * the summary loads and saves, the filter runs and the session jobs took,
+ * in which thread and on which folder, so that a stall seen by the user
+ * can be matched with what camel was doing at that time.
+ *
+ * Each finished span is stored in a fixed-size in-memory ring buffer,
+ * keeping the last %CAMEL_TRACE_BUFFER_SIZE spans.  camel_trace_dump()
+ * writes them in the Chrome trace event format, which can be opened
+ * by chrome://tracing or by the Perfetto UI.
+ *
+ * Tracing is off by default and then each span costs one atomic read.
+ * It is turned on with camel_trace_set_enabled() or by setting the
+ * CAMEL_TRACE environment variable.  When CAMEL_TRACE holds a file name,
+ * other than "1", the trace is also dumped into that file by camel_shutdown().
+ **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifndef G_OS_WIN32
+#include <unistd.h>
+#endif
+
+#include <gio/gio.h>
+
+#include "camel-trace.h"
+
+typedef struct _TraceRecord TraceRecord;
+
+enum {
+	TRACE_RESULT_OK,
+	TRACE_RESULT_ERROR,
+	TRACE_RESULT_CANCELLED
+};
+
+/* Only the category is interned, there are few of them.  The name
+ * and the folder are owned by the record, they can be anything
+ * like a job description or a folder name. */
+struct _TraceRecord {
+	const gchar *category;
+	gchar *name;
+	gchar *folder;
+	gint64 start;
+	gint64 duration;
+	gint64 bytes;
+	guint32 thread_id;
+	guint32 result;
+};
+
+/* -1 until first read from the environment */
+static volatile gint trace_enabled = -1;
+
+static GMutex trace_lock;
+static TraceRecord *trace_records;
+static guint64 trace_n_records; /* how many were ever added */
+
+static volatile gint trace_last_thread_id;
+static GPrivate trace_thread_id_key;
+
+/**
+ * camel_trace_get_enabled:
+ *
+ * Returns whether the spans are being recorded.
+ *
+ * Returns: %TRUE, when the tracing is enabled
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_trace_get_enabled (void)
+{
+	gint enabled;
+
+	enabled = g_atomic_int_get (&trace_enabled);
+
+	if (G_UNLIKELY (enabled == -1)) {
+		enabled = g_getenv ("CAMEL_TRACE") != NULL ? 1 : 0;
+		g_atomic_int_compare_and_exchange (&trace_enabled, -1, enabled);
+		enabled = g_atomic_int_get (&trace_enabled);
+	}
+
+	return enabled == 1;
+}
+
+/**
+ * camel_trace_set_enabled:
+ * @enabled: whether to record the spans
+ *
+ * Starts or stops recording the spans.  The spans recorded so far
+ * are kept when disabling, use camel_trace_clear() to forget them.
+ *
+ * Since: 3.20
+ **/
+void
+camel_trace_set_enabled (gboolean enabled)
+{
+	g_atomic_int_set (&trace_enabled, enabled ? 1 : 0);
+}
+
+/* Small numbers read better in the trace viewers than the pthread IDs */
+static guint
+trace_get_thread_id (void)
+{
+	guint thread_id;
+
+	thread_id = GPOINTER_TO_UINT (g_private_get (&trace_thread_id_key));
+	if (!thread_id) {
+		thread_id = g_atomic_int_add (&trace_last_thread_id, 1) + 1;
+		g_private_set (&trace_thread_id_key, GUINT_TO_POINTER (thread_id));
+	}
+
+	return thread_id;
+}
+
+/**
+ * camel_trace_span_begin:
+ * @span: a #CamelTraceSpan to fill
+ * @category: a span category, like "imapx" or "db"
+ * @name: what the span measures, like an IMAP command name
+ * @folder: (nullable): a folder or file the operation works on, or %NULL
+ *
+ * Starts measuring an operation.  The @span is always initialized,
+ * but it is active only if the tracing is enabled, otherwise the matching
+ * camel_trace_span_end() does nothing.  The @span can be finished
+ * in another thread, it stays in the thread which began it.
+ *
+ * Since: 3.20
+ **/
+void
+camel_trace_span_begin (CamelTraceSpan *span,
+                        const gchar *category,
+                        const gchar *name,
+                        const gchar *folder)
+{
+	g_return_if_fail (span != NULL);
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	if (!camel_trace_get_enabled ()) {
+		memset (span, 0, sizeof (CamelTraceSpan));
+		return;
+	}
+
+	span->category = g_intern_string (category);
+	span->name = g_strdup (name);
+	span->folder = g_strdup (folder);
+	span->thread_id = trace_get_thread_id ();
+	span->start = g_get_monotonic_time ();
+}
+
+/**
+ * camel_trace_span_end:
+ * @span: a #CamelTraceSpan filled by camel_trace_span_begin()
+ * @bytes: how many bytes the operation transferred, or -1 when not known
+ * @error: (nullable): the #GError the operation failed with, or %NULL
+ *
+ * Finishes the @span and stores it into the trace.  The result of
+ * the span is "ok" when @error is %NULL, "cancelled" when @error is
+ * %G_IO_ERROR_CANCELLED and "error" otherwise.  The @span becomes
+ * inactive, thus finishing it once more does nothing.
+ *
+ * Each active span should be finished or cleared with
+ * camel_trace_span_clear(), to free what it holds.
+ *
+ * Since: 3.20
+ **/
+void
+camel_trace_span_end (CamelTraceSpan *span,
+                      gint64 bytes,
+                      const GError *error)
+{
+	TraceRecord *record;
+	gint64 now;
+
+	g_return_if_fail (span != NULL);
+
+	if (!span->start)
+		return;
+
+	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&trace_lock);
+
+	if (!trace_records)
+		trace_records = g_new0 (TraceRecord, CAMEL_TRACE_BUFFER_SIZE);
+
+	record = &trace_records[trace_n_records % CAMEL_TRACE_BUFFER_SIZE];
+	trace_n_records++;
+
+	/* Overwrites the oldest record when the buffer is full */
+	g_free (record->name);
+	g_free (record->folder);
+
+	/* The strings move from the span to the record */
+	record->category = span->category;
+	record->name = span->name;
+	record->folder = span->folder;
+	record->start = span->start;
+	record->duration = now - span->start;
+	record->bytes = bytes;
+	record->thread_id = span->thread_id;
+
+	if (!error)
+		record->result = TRACE_RESULT_OK;
+	else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		record->result = TRACE_RESULT_CANCELLED;
+	else
+		record->result = TRACE_RESULT_ERROR;
+
+	g_mutex_unlock (&trace_lock);
+
+	span->name = NULL;
+	span->folder = NULL;
+	span->start = 0;
+}
+
+/**
+ * camel_trace_span_clear:
+ * @span: a #CamelTraceSpan filled by camel_trace_span_begin()
+ *
+ * Drops the @span without storing it into the trace, like when
+ * the operation turned out not to be worth recording.  The @span
+ * becomes inactive.  Clearing an inactive span does nothing.
+ *
+ * Since: 3.20
+ **/
+void
+camel_trace_span_clear (CamelTraceSpan *span)
+{
+	g_return_if_fail (span != NULL);
+
+	g_free (span->name);
+	g_free (span->folder);
+
+	span->name = NULL;
+	span->folder = NULL;
+	span->start = 0;
+}
+
+/**
+ * camel_trace_span_is_active:
+ * @span: a #CamelTraceSpan
+ *
+ * Returns whether the @span was begun with the tracing enabled
+ * and was not finished yet.
+ *
+ * Returns: whether the @span is active
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_trace_span_is_active (const CamelTraceSpan *span)
+{
+	g_return_val_if_fail (span != NULL, FALSE);
+
+	return span->start != 0;
+}
+
+/**
+ * camel_trace_clear:
+ *
+ * Forgets all the spans recorded so far.
+ *
+ * Since: 3.20
+ **/
+void
+camel_trace_clear (void)
+{
+	guint ii;
+
+	g_mutex_lock (&trace_lock);
+
+	for (ii = 0; trace_records && ii < CAMEL_TRACE_BUFFER_SIZE; ii++) {
+		g_free (trace_records[ii].name);
+		g_free (trace_records[ii].folder);
+	}
+
+	g_free (trace_records);
+	trace_records = NULL;
+	trace_n_records = 0;
+
+	g_mutex_unlock (&trace_lock);
+}
+
+static void
+trace_append_json_string (GString *json,
+                          const gchar *str)
+{
+	const gchar *ptr;
+
+	g_string_append_c (json, '\"');
+
+	for (ptr = str; *ptr; ptr++) {
+		guchar chr = *ptr;
+
+		if (chr == '\"' || chr == '\\')
+			g_string_append_printf (json, "\\%c", chr);
+		else if (chr < 0x20)
+			g_string_append_printf (json, "\\u%04x", chr);
+		else
+			g_string_append_c (json, chr);
+	}
+
+	g_string_append_c (json, '\"');
+}
+
+/**
+ * camel_trace_dump:
+ * @filename: a file to write the trace to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the spans recorded so far, from the oldest, into @filename
+ * as a JSON document in the Chrome trace event format.  Each span is
+ * a complete ("X") event with the folder, the bytes and the result
+ * in its arguments.
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_trace_dump (const gchar *filename,
+                  GError **error)
+{
+	static const gchar *results[] = { "ok", "error", "cancelled" };
+	TraceRecord *records = NULL;
+	GString *json;
+	guint64 first;
+	guint ii, n_records;
+	gint pid;
+	gboolean success;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* Copy the records out, not to block the traced threads
+	 * while formatting them. */
+	g_mutex_lock (&trace_lock);
+
+	n_records = MIN (trace_n_records, CAMEL_TRACE_BUFFER_SIZE);
+	first = trace_n_records - n_records;
+
+	if (n_records > 0) {
+		records = g_new (TraceRecord, n_records);
+
+		for (ii = 0; ii < n_records; ii++) {
+			records[ii] = trace_records[(first + ii) % CAMEL_TRACE_BUFFER_SIZE];
+			records[ii].name = g_strdup (records[ii].name);
+			records[ii].folder = g_strdup (records[ii].folder);
+		}
+	}
+
+	g_mutex_unlock (&trace_lock);
+
+#ifndef G_OS_WIN32
+	pid = getpid ();
+#else
+	pid = 1;
+#endif
+
+	json = g_string_sized_new (128 + n_records * 160);
+	g_string_append (json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (ii = 0; ii < n_records; ii++) {
+		const TraceRecord *record = &records[ii];
+
+		if (ii > 0)
+			g_string_append_c (json, ',');
+
+		g_string_append (json, "\n{\"ph\":\"X\",\"cat\":");
+		trace_append_json_string (json, record->category);
+		g_string_append (json, ",\"name\":");
+		trace_append_json_string (json, record->name);
+		g_string_append_printf (
+			json, ",\"pid\":%d,\"tid\":%u"
+			",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT
+			",\"args\":{",
+			pid, record->thread_id, record->start, record->duration);
+
+		if (record->folder) {
+			g_string_append (json, "\"folder\":");
+			trace_append_json_string (json, record->folder);
+			g_string_append_c (json, ',');
+		}
+
+		if (record->bytes >= 0)
+			g_string_append_printf (json, "\"bytes\":%" G_GINT64_FORMAT ",", record->bytes);
+
+		g_string_append_printf (json, "\"result\":\"%s\"}}", results[record->result]);
+	}
+
+	g_string_append (json, "\n]}\n");
+
+	success = g_file_set_contents (filename, json->str, json->len, error);
+
+	g_string_free (json, TRUE);
+
+	for (ii = 0; ii < n_records; ii++) {
+		g_free (records[ii].name);
+		g_free (records[ii].folder);
+	}
+
+	g_free (records);
+
+	return success;
+}
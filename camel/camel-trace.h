@@ -0,0 +1,77 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * camel-trace.h
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if !defined (__CAMEL_H_INSIDE__) && !defined (CAMEL_COMPILATION)
+#error "Only <camel/camel.h> can be included directly."
+#endif
+
+#ifndef CAMEL_TRACE_H
+#define CAMEL_TRACE_H
+
+#include <glib.h>
+
+/**
+ * CAMEL_TRACE_BUFFER_SIZE:
+ *
+ * How many finished spans are kept in memory; when more spans
+ * finish, the oldest ones are overwritten.
+ *
+ * Since: 3.20
+ **/
+#define CAMEL_TRACE_BUFFER_SIZE 32768
+
+G_BEGIN_DECLS
+
+typedef struct _CamelTraceSpan CamelTraceSpan;
+
+/**
+ * CamelTraceSpan:
+ *
+ * One timed operation, usually a local variable of the function doing
+ * the operation.  Fill it with camel_trace_span_begin() and finish it
+ * with camel_trace_span_end().  The members are private.
+ *
+ * Since: 3.20
+ **/
+struct _CamelTraceSpan {
+	/*< private >*/
+	const gchar *category;
+	gchar *name;
+	gchar *folder;
+	gint64 start;
+	guint thread_id;
+};
+
+gboolean	camel_trace_get_enabled		(void);
+void		camel_trace_set_enabled		(gboolean enabled);
+void		camel_trace_span_begin		(CamelTraceSpan *span,
+						 const gchar *category,
+						 const gchar *name,
+						 const gchar *folder);
+void		camel_trace_span_end		(CamelTraceSpan *span,
+						 gint64 bytes,
+						 const GError *error);
+void		camel_trace_span_clear		(CamelTraceSpan *span);
+gboolean	camel_trace_span_is_active	(const CamelTraceSpan *span);
+void		camel_trace_clear		(void);
+gboolean	camel_trace_dump		(const gchar *filename,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* CAMEL_TRACE_H */
@@ -294,6 +294,26 @@ vee_folder_merge_matching (CamelVeeFolder *vfolder,
 	g_hash_table_foreach (all_uids, vee_folder_remove_unmatched_cb, &rud);
 }
 
+static void
+vee_folder_rebuild_folder_with_match (CamelVeeFolder *vfolder,
+                                      CamelFolder *subfolder,
+                                      GPtrArray *match,
+                                      CamelFolderChangeInfo *changes,
+                                      GCancellable *cancellable)
+{
+	if (!g_cancellable_is_cancelled (cancellable)) {
+		GHashTable *all_uids;
+
+		/* the live counts of the subfolder replace the stored,
+		 * even when nothing in it matches */
+		camel_vee_summary_drop_stored_counts (CAMEL_VEE_SUMMARY (CAMEL_FOLDER (vfolder)->summary), subfolder);
+
+		all_uids = camel_folder_summary_get_hash (subfolder->summary);
+		vee_folder_merge_matching (vfolder, subfolder, all_uids, match, changes, FALSE);
+		g_hash_table_destroy (all_uids);
+	}
+}
+
 static void
 vee_folder_rebuild_folder_with_changes (CamelVeeFolder *vfolder,
                                         CamelFolder *subfolder,
@@ -318,47 +338,144 @@ vee_folder_rebuild_folder_with_changes (CamelVeeFolder *vfolder,
 			return;
 	}
 
-	if (!g_cancellable_is_cancelled (cancellable)) {
-		GHashTable *all_uids;
-
-		all_uids = camel_folder_summary_get_hash (subfolder->summary);
-		vee_folder_merge_matching (vfolder, subfolder, all_uids, match, changes, FALSE);
-		g_hash_table_destroy (all_uids);
-	}
+	vee_folder_rebuild_folder_with_match (vfolder, subfolder, match, changes, cancellable);
 
 	camel_folder_search_free (subfolder, match);
 }
 
 static void
+vee_folder_free_matches (GHashTable *matches)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init (&iter, matches);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		GPtrArray *match = value;
+
+		g_ptr_array_foreach (match, (GFunc) camel_pstring_free, NULL);
+		g_ptr_array_free (match, TRUE);
+	}
+
+	g_hash_table_destroy (matches);
+}
+
+/* Searches all subfolders of the same store at once, which
+ * saves a statement and a summary load per folder; a failure
+ * of any of the stores fails the whole search */
+static GHashTable *
+vee_folder_search_subfolders (CamelVeeFolder *vfolder,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	GHashTable *by_store, *matches;
+	GHashTableIter iter;
+	gpointer key, value;
+	GList *link;
+
+	if (!vfolder->priv->expression)
+		return NULL;
+
+	by_store = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_ptr_array_unref);
+	matches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (link = vfolder->priv->subfolders; link; link = g_list_next (link)) {
+		CamelFolder *subfolder = link->data;
+		CamelStore *parent_store;
+		GPtrArray *folders;
+
+		parent_store = camel_folder_get_parent_store (subfolder);
+		if (!parent_store)
+			continue;
+
+		folders = g_hash_table_lookup (by_store, parent_store);
+		if (!folders) {
+			folders = g_ptr_array_new ();
+			g_hash_table_insert (by_store, parent_store, folders);
+		}
+
+		g_ptr_array_add (folders, subfolder);
+	}
+
+	g_hash_table_iter_init (&iter, by_store);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GHashTable *store_matches;
+		GHashTableIter miter;
+		gpointer mkey, mvalue;
+
+		store_matches = camel_store_search_folders_sync (key, value, vfolder->priv->expression, cancellable, error);
+		if (!store_matches) {
+			vee_folder_free_matches (matches);
+			matches = NULL;
+			break;
+		}
+
+		/* move the values, the keys are referenced by the subfolders list */
+		g_hash_table_iter_init (&miter, store_matches);
+		while (g_hash_table_iter_next (&miter, &mkey, &mvalue)) {
+			g_hash_table_insert (matches, mkey, mvalue);
+			g_hash_table_iter_steal (&miter);
+			g_object_unref (mkey);
+		}
+
+		g_hash_table_destroy (store_matches);
+	}
+
+	g_hash_table_destroy (by_store);
+
+	return matches;
+}
+
+static gboolean
 vee_folder_rebuild_all (CamelVeeFolder *vfolder,
-                        GCancellable *cancellable)
+                        GCancellable *cancellable,
+                        GError **error)
 {
 	CamelFolderChangeInfo *changes;
+	GHashTable *matches;
 	GList *iter;
+	GError *local_error = NULL;
 
-	g_return_if_fail (CAMEL_IS_VEE_FOLDER (vfolder));
+	g_return_val_if_fail (CAMEL_IS_VEE_FOLDER (vfolder), FALSE);
 
 	/* Unmatched folder cannot be rebuilt */
 	if (vee_folder_is_unmatched (vfolder))
-		return;
-
-	changes = camel_folder_change_info_new ();
+		return TRUE;
 
 	g_rec_mutex_lock (&vfolder->priv->subfolder_lock);
 
+	matches = vee_folder_search_subfolders (vfolder, cancellable, &local_error);
+	if (local_error) {
+		g_rec_mutex_unlock (&vfolder->priv->subfolder_lock);
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	changes = camel_folder_change_info_new ();
+
 	for (iter = vfolder->priv->subfolders;
 	     iter && !g_cancellable_is_cancelled (cancellable);
 	     iter = iter->next) {
 		CamelFolder *subfolder = iter->data;
+		GPtrArray *match;
 
-		vee_folder_rebuild_folder_with_changes (vfolder, subfolder, changes, cancellable);
+		match = matches ? g_hash_table_lookup (matches, subfolder) : NULL;
+		if (match)
+			vee_folder_rebuild_folder_with_match (vfolder, subfolder, match, changes, cancellable);
+		else
+			vee_folder_rebuild_folder_with_changes (vfolder, subfolder, changes, cancellable);
 	}
 
+	if (matches)
+		vee_folder_free_matches (matches);
+
 	g_rec_mutex_unlock (&vfolder->priv->subfolder_lock);
 
 	if (camel_folder_change_info_changed (changes))
 		camel_folder_changed (CAMEL_FOLDER (vfolder), changes);
 	camel_folder_change_info_free (changes);
+
+	return TRUE;
 }
 
 static void
@@ -557,6 +674,10 @@ vee_folder_dispose (GObject *object)
 		vfolder = CAMEL_VEE_FOLDER (object);
 		vfolder->priv->destroyed = TRUE;
 
+		/* remember the counts for the next session, before
+		 * the subfolders are removed */
+		camel_vee_summary_save_counts (CAMEL_VEE_SUMMARY (folder->summary), NULL);
+
 		camel_folder_freeze ((CamelFolder *) vfolder);
 		while (vfolder->priv->subfolders) {
 			CamelFolder *subfolder = vfolder->priv->subfolders->data;
@@ -799,6 +920,10 @@ vee_folder_delete (CamelFolder *folder)
 	}
 	g_rec_mutex_unlock (&vfolder->priv->subfolder_lock);
 
+	/* with no counts left this deletes the stored folder record */
+	camel_vee_summary_drop_stored_counts (CAMEL_VEE_SUMMARY (folder->summary), NULL);
+	camel_vee_summary_save_counts (CAMEL_VEE_SUMMARY (folder->summary), NULL);
+
 	((CamelFolderClass *) camel_vee_folder_parent_class)->delete_ (folder);
 }
 
@@ -914,9 +1039,8 @@ vee_folder_refresh_info_sync (CamelFolder *folder,
 	CamelVeeFolder *vf = (CamelVeeFolder *) folder;
 
 	vee_folder_propagate_skipped_changes (vf);
-	vee_folder_rebuild_all (vf, cancellable);
 
-	return TRUE;
+	return vee_folder_rebuild_all (vf, cancellable, error);
 }
 
 static gboolean
@@ -933,6 +1057,8 @@ vee_folder_synchronize_sync (CamelFolder *folder,
 
 	vee_folder_propagate_skipped_changes (vfolder);
 
+	camel_vee_summary_save_counts (CAMEL_VEE_SUMMARY (folder->summary), NULL);
+
 	/* basically no-op here, especially do not call synchronize on subfolders
 	 * if not expunging, they are responsible for themselfs */
 	if (!expunge ||
@@ -998,7 +1124,7 @@ vee_folder_set_expression (CamelVeeFolder *vee_folder,
 	if (query)
 		vee_folder->priv->expression = g_strdup (query);
 
-	vee_folder_rebuild_all (vee_folder, NULL);
+	vee_folder_rebuild_all (vee_folder, NULL, NULL);
 
 	g_rec_mutex_unlock (&vee_folder->priv->subfolder_lock);
 }
@@ -1090,6 +1216,8 @@ vee_folder_remove_folder (CamelVeeFolder *vfolder,
 		g_hash_table_destroy (uids);
 	}
 
+	camel_vee_summary_drop_stored_counts (CAMEL_VEE_SUMMARY (v_folder->summary), subfolder);
+
 	if (vfolder->priv->parent_vee_store)
 		camel_vee_store_note_subfolder_unused (vfolder->priv->parent_vee_store, subfolder, vfolder);
 
@@ -1500,6 +1628,10 @@ camel_vee_folder_set_folders (CamelVeeFolder *vf,
 	}
 	g_list_free_full (to_add, g_object_unref);
 
+	/* all folders were populated, any remaining stored
+	 * counts belong to folders which are not used anymore */
+	camel_vee_summary_drop_stored_counts (CAMEL_VEE_SUMMARY (CAMEL_FOLDER (vf)->summary), NULL);
+
 	camel_folder_thaw (CAMEL_FOLDER (vf));
 }
 
@@ -43,13 +43,214 @@
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_VEE_SUMMARY, CamelVeeSummaryPrivate))
 
+/* Version of the subfolder counts stored in the folder record's bdata */
+#define VEE_COUNTS_VERSION 1
+
+typedef struct _VeeCounts VeeCounts;
+
+struct _VeeCounts {
+	gchar *key;	/* store UID and subfolder full name */
+	guint32 saved_count;
+	guint32 unread_count;
+	guint32 deleted_count;
+	guint32 junk_count;
+	guint32 junk_not_deleted_count;
+	guint32 visible_count;
+};
+
 struct _CamelVeeSummaryPrivate {
 	/* CamelFolder * => GHashTable * of gchar *vuid */
 	GHashTable *vuids_by_subfolder;
+
+	/* CamelFolder * => VeeCounts *, what each subfolder
+	 * contributes to the counts of the summary */
+	GHashTable *counts_by_subfolder;
+
+	/* gchar *key => VeeCounts *, counts remembered from the previous
+	 * session for subfolders, which were not populated yet; these
+	 * are included in the summary counts until then */
+	GHashTable *stored_counts;
 };
 
 G_DEFINE_TYPE (CamelVeeSummary, camel_vee_summary, CAMEL_TYPE_FOLDER_SUMMARY)
 
+static VeeCounts *
+vee_counts_new (const gchar *key)
+{
+	VeeCounts *counts;
+
+	counts = g_new0 (VeeCounts, 1);
+	counts->key = g_strdup (key);
+
+	return counts;
+}
+
+static void
+vee_counts_free (VeeCounts *counts)
+{
+	if (counts) {
+		g_free (counts->key);
+		g_free (counts);
+	}
+}
+
+static gchar *
+vee_summary_dup_subfolder_key (CamelFolder *subfolder)
+{
+	CamelStore *parent_store;
+
+	parent_store = camel_folder_get_parent_store (subfolder);
+
+	return g_strdup_printf (
+		"%s:%s",
+		parent_store ? camel_service_get_uid (CAMEL_SERVICE (parent_store)) : "",
+		camel_folder_get_full_name (subfolder));
+}
+
+static void
+vee_summary_read_counts (CamelFolderSummary *summary,
+                         VeeCounts *counts)
+{
+	counts->saved_count = camel_folder_summary_get_saved_count (summary);
+	counts->unread_count = camel_folder_summary_get_unread_count (summary);
+	counts->deleted_count = camel_folder_summary_get_deleted_count (summary);
+	counts->junk_count = camel_folder_summary_get_junk_count (summary);
+	counts->junk_not_deleted_count = camel_folder_summary_get_junk_not_deleted_count (summary);
+	counts->visible_count = camel_folder_summary_get_visible_count (summary);
+}
+
+/* Attributes the change of the summary counts since @before was read
+ * to @subfolder.  Call with the summary lock held. */
+static void
+vee_summary_account_counts (CamelVeeSummary *summary,
+                            CamelFolder *subfolder,
+                            const VeeCounts *before)
+{
+	VeeCounts after, *counts;
+
+	vee_summary_read_counts (&summary->summary, &after);
+
+	counts = g_hash_table_lookup (summary->priv->counts_by_subfolder, subfolder);
+	if (!counts) {
+		gchar *key;
+
+		key = vee_summary_dup_subfolder_key (subfolder);
+		counts = vee_counts_new (key);
+		g_hash_table_insert (summary->priv->counts_by_subfolder, subfolder, counts);
+		g_free (key);
+	}
+
+	counts->saved_count += after.saved_count - before->saved_count;
+	counts->unread_count += after.unread_count - before->unread_count;
+	counts->deleted_count += after.deleted_count - before->deleted_count;
+	counts->junk_count += after.junk_count - before->junk_count;
+	counts->junk_not_deleted_count += after.junk_not_deleted_count - before->junk_not_deleted_count;
+	counts->visible_count += after.visible_count - before->visible_count;
+}
+
+static gboolean
+vee_summary_unstore_counts_cb (gpointer key,
+                               gpointer value,
+                               gpointer user_data)
+{
+	CamelFolderSummary *summary = user_data;
+	VeeCounts *counts = value;
+
+	camel_folder_summary_adjust_counts (
+		summary,
+		- (gint) counts->saved_count,
+		- (gint) counts->unread_count,
+		- (gint) counts->deleted_count,
+		- (gint) counts->junk_count,
+		- (gint) counts->junk_not_deleted_count,
+		- (gint) counts->visible_count);
+
+	return TRUE;
+}
+
+/* Call with the summary lock held. */
+static void
+vee_summary_drop_stored_counts_locked (CamelVeeSummary *summary,
+                                      CamelFolder *subfolder)
+{
+	gchar *key;
+	gpointer orig_key, value;
+
+	if (!g_hash_table_size (summary->priv->stored_counts))
+		return;
+
+	if (!subfolder) {
+		g_hash_table_foreach_remove (summary->priv->stored_counts, vee_summary_unstore_counts_cb, summary);
+		return;
+	}
+
+	key = vee_summary_dup_subfolder_key (subfolder);
+
+	if (g_hash_table_lookup_extended (summary->priv->stored_counts, key, &orig_key, &value)) {
+		vee_summary_unstore_counts_cb (orig_key, value, summary);
+		g_hash_table_remove (summary->priv->stored_counts, key);
+	}
+
+	g_free (key);
+}
+
+static void
+vee_summary_load_counts (CamelVeeSummary *summary,
+                         CamelDB *cdb,
+                         const gchar *full_name)
+{
+	CamelFIRecord record = { 0 };
+	gchar *part;
+	gint ii, n_counts;
+
+	if (camel_db_read_folder_info_record (cdb, full_name, &record, NULL) != 0 ||
+	    !record.bdata)
+		goto exit;
+
+	part = record.bdata;
+
+	if (bdata_extract_digit (&part) != VEE_COUNTS_VERSION)
+		goto exit;
+
+	n_counts = bdata_extract_digit (&part);
+
+	for (ii = 0; ii < n_counts && part && *part; ii++) {
+		VeeCounts *counts;
+		gchar *key;
+
+		key = bdata_extract_string (&part);
+		counts = vee_counts_new (key);
+		g_free (key);
+
+		counts->saved_count = bdata_extract_digit (&part);
+		counts->unread_count = bdata_extract_digit (&part);
+		counts->deleted_count = bdata_extract_digit (&part);
+		counts->junk_count = bdata_extract_digit (&part);
+		counts->junk_not_deleted_count = bdata_extract_digit (&part);
+		counts->visible_count = bdata_extract_digit (&part);
+
+		if (!*counts->key || g_hash_table_contains (summary->priv->stored_counts, counts->key)) {
+			vee_counts_free (counts);
+			continue;
+		}
+
+		g_hash_table_insert (summary->priv->stored_counts, counts->key, counts);
+
+		camel_folder_summary_adjust_counts (
+			&summary->summary,
+			counts->saved_count,
+			counts->unread_count,
+			counts->deleted_count,
+			counts->junk_count,
+			counts->junk_not_deleted_count,
+			counts->visible_count);
+	}
+
+ exit:
+	g_free (record.folder_name);
+	g_free (record.bdata);
+}
+
 static void
 vee_message_info_free (CamelFolderSummary *s,
                        CamelMessageInfo *info)
@@ -260,7 +461,7 @@ vee_info_set_flags (CamelMessageInfo *mi,
 
 		if (res) {
 			/* update flags on itself too */
-			camel_folder_summary_replace_flags (mi->summary, mi);
+			camel_vee_summary_replace_flags (CAMEL_VEE_SUMMARY (mi->summary), mi->uid);
 		}
 
 		if (ignore_changes) {
@@ -336,6 +537,8 @@ vee_summary_finalize (GObject *object)
 	priv = CAMEL_VEE_SUMMARY_GET_PRIVATE (object);
 
 	g_hash_table_destroy (priv->vuids_by_subfolder);
+	g_hash_table_destroy (priv->counts_by_subfolder);
+	g_hash_table_destroy (priv->stored_counts);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_vee_summary_parent_class)->finalize (object);
@@ -378,14 +581,29 @@ camel_vee_summary_init (CamelVeeSummary *vee_summary)
 		(GEqualFunc) g_direct_equal,
 		(GDestroyNotify) NULL,
 		(GDestroyNotify) g_hash_table_destroy);
+
+	vee_summary->priv->counts_by_subfolder = g_hash_table_new_full (
+		(GHashFunc) g_direct_hash,
+		(GEqualFunc) g_direct_equal,
+		(GDestroyNotify) NULL,
+		(GDestroyNotify) vee_counts_free);
+
+	/* the key is owned by the value */
+	vee_summary->priv->stored_counts = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) NULL,
+		(GDestroyNotify) vee_counts_free);
 }
 
 /**
  * camel_vee_summary_new:
  * @parent: Folder its attached to.
  *
- * This will create a new CamelVeeSummary object and read in the
- * summary data from disk, if it exists.
+ * This will create a new CamelVeeSummary object.  The message infos
+ * are not stored on disk, only the message counts the summary had
+ * in the previous session, which are reported until the subfolders
+ * of @parent are populated again.
  *
  * Returns: A new CamelVeeSummary object.
  **/
@@ -399,10 +617,15 @@ camel_vee_summary_new (CamelFolder *parent)
 	summary = g_object_new (CAMEL_TYPE_VEE_SUMMARY, "folder", parent, NULL);
 	summary->flags |= CAMEL_FOLDER_SUMMARY_IN_MEMORY_ONLY;
 
-	/* not using DB for vee folder summaries, drop the table */
 	full_name = camel_folder_get_full_name (parent);
 	parent_store = camel_folder_get_parent_store (parent);
+
+	vee_summary_load_counts (CAMEL_VEE_SUMMARY (summary), parent_store->cdb_r, full_name);
+
+	/* not using DB for vee folder summaries, drop the table;
+	 * this drops also the folder record, thus write it back */
 	camel_db_delete_folder (parent_store->cdb_w, full_name, NULL);
+	camel_vee_summary_save_counts (CAMEL_VEE_SUMMARY (summary), NULL);
 
 	return summary;
 }
@@ -458,6 +681,7 @@ camel_vee_summary_add (CamelVeeSummary *s,
 	CamelVeeSubfolderData *sf_data;
 	CamelFolder *orig_folder;
 	GHashTable *vuids;
+	VeeCounts before;
 
 	g_return_val_if_fail (CAMEL_IS_VEE_SUMMARY (s), NULL);
 	g_return_val_if_fail (CAMEL_IS_VEE_MESSAGE_INFO_DATA (mi_data), NULL);
@@ -480,6 +704,8 @@ camel_vee_summary_add (CamelVeeSummary *s,
 		return vmi;
 	}
 
+	vee_summary_drop_stored_counts_locked (s, orig_folder);
+
 	vmi = (CamelVeeMessageInfo *) camel_message_info_new (&s->summary);
 	vmi->orig_summary = g_object_ref (orig_folder->summary);
 	vmi->info.uid = (gchar *) camel_pstring_strdup (vuid);
@@ -495,7 +721,10 @@ camel_vee_summary_add (CamelVeeSummary *s,
 		g_hash_table_insert (s->priv->vuids_by_subfolder, orig_folder, vuids);
 	}
 
+	vee_summary_read_counts (&s->summary, &before);
 	camel_folder_summary_insert (&s->summary, (CamelMessageInfo *) vmi, FALSE);
+	vee_summary_account_counts (s, orig_folder, &before);
+
 	camel_folder_summary_unlock (&s->summary);
 
 	return vmi;
@@ -515,6 +744,7 @@ camel_vee_summary_remove (CamelVeeSummary *summary,
 {
 	CamelMessageInfo *mi;
 	GHashTable *vuids;
+	VeeCounts before;
 
 	g_return_if_fail (CAMEL_IS_VEE_SUMMARY (summary));
 	g_return_if_fail (vuid != NULL);
@@ -522,17 +752,21 @@ camel_vee_summary_remove (CamelVeeSummary *summary,
 
 	camel_folder_summary_lock (&summary->summary);
 
+	mi = camel_folder_summary_peek_loaded (&summary->summary, vuid);
+
+	vee_summary_read_counts (&summary->summary, &before);
+	camel_folder_summary_remove_uid (&summary->summary, vuid);
+	vee_summary_account_counts (summary, subfolder, &before);
+
 	vuids = g_hash_table_lookup (summary->priv->vuids_by_subfolder, subfolder);
 	if (vuids) {
 		g_hash_table_remove (vuids, vuid);
-		if (!g_hash_table_size (vuids))
+		if (!g_hash_table_size (vuids)) {
 			g_hash_table_remove (summary->priv->vuids_by_subfolder, subfolder);
+			g_hash_table_remove (summary->priv->counts_by_subfolder, subfolder);
+		}
 	}
 
-	mi = camel_folder_summary_peek_loaded (&summary->summary, vuid);
-
-	camel_folder_summary_remove_uid (&summary->summary, vuid);
-
 	if (mi) {
 		/* under twice, the first for camel_folder_summary_peek_loaded(),
 		 * the second to actually free the mi */
@@ -559,6 +793,7 @@ camel_vee_summary_replace_flags (CamelVeeSummary *summary,
                                  const gchar *uid)
 {
 	CamelMessageInfo *mi;
+	VeeCounts before;
 
 	g_return_if_fail (CAMEL_IS_VEE_SUMMARY (summary));
 	g_return_if_fail (uid != NULL);
@@ -571,8 +806,143 @@ camel_vee_summary_replace_flags (CamelVeeSummary *summary,
 		return;
 	}
 
+	vee_summary_read_counts (&summary->summary, &before);
 	camel_folder_summary_replace_flags (&summary->summary, mi);
+	vee_summary_account_counts (
+		summary,
+		camel_folder_summary_get_folder (((CamelVeeMessageInfo *) mi)->orig_summary),
+		&before);
+
 	camel_message_info_unref (mi);
 
 	camel_folder_summary_unlock (&summary->summary);
 }
+
+/**
+ * camel_vee_summary_drop_stored_counts:
+ * @summary: a #CamelVeeSummary
+ * @subfolder: (allow-none): a subfolder, or %NULL for all subfolders
+ *
+ * Stops including counts remembered from the previous session for
+ * @subfolder in the counts of @summary.  This is done automatically
+ * when messages of @subfolder are added to @summary; the virtual folder
+ * calls it also after it populated a subfolder with no matching
+ * messages, or when the subfolder is not part of it anymore.
+ *
+ * Since: 3.20
+ **/
+void
+camel_vee_summary_drop_stored_counts (CamelVeeSummary *summary,
+                                      CamelFolder *subfolder)
+{
+	g_return_if_fail (CAMEL_IS_VEE_SUMMARY (summary));
+
+	camel_folder_summary_lock (&summary->summary);
+	vee_summary_drop_stored_counts_locked (summary, subfolder);
+	camel_folder_summary_unlock (&summary->summary);
+}
+
+static void
+vee_summary_put_counts (GString *bdata,
+                        const VeeCounts *counts)
+{
+	g_string_append_printf (
+		bdata, " %d-%s %u %u %u %u %u %u",
+		(gint) strlen (counts->key), counts->key,
+		counts->saved_count,
+		counts->unread_count,
+		counts->deleted_count,
+		counts->junk_count,
+		counts->junk_not_deleted_count,
+		counts->visible_count);
+}
+
+/**
+ * camel_vee_summary_save_counts:
+ * @summary: a #CamelVeeSummary
+ * @error: return location for a #GError, or %NULL
+ *
+ * Stores the message counts of @summary, per subfolder, in the database
+ * of the parent store, thus the next session can report them before
+ * the virtual folder is populated.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ *
+ * Since: 3.20
+ **/
+gboolean
+camel_vee_summary_save_counts (CamelVeeSummary *summary,
+                               GError **error)
+{
+	CamelFolder *folder;
+	CamelStore *parent_store;
+	CamelFIRecord record = { 0 };
+	GHashTableIter iter;
+	gpointer value;
+	GString *bdata;
+	gchar *header;
+	gint n_counts = 0;
+	gint ret;
+
+	g_return_val_if_fail (CAMEL_IS_VEE_SUMMARY (summary), FALSE);
+
+	folder = camel_folder_summary_get_folder (&summary->summary);
+	parent_store = camel_folder_get_parent_store (folder);
+
+	if (!parent_store || !parent_store->cdb_w)
+		return TRUE;
+
+	bdata = g_string_new ("");
+
+	camel_folder_summary_lock (&summary->summary);
+
+	g_hash_table_iter_init (&iter, summary->priv->counts_by_subfolder);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		VeeCounts *counts = value;
+
+		if (!counts->saved_count)
+			continue;
+
+		vee_summary_put_counts (bdata, counts);
+		n_counts++;
+	}
+
+	g_hash_table_iter_init (&iter, summary->priv->stored_counts);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		vee_summary_put_counts (bdata, value);
+		n_counts++;
+	}
+
+	camel_folder_summary_unlock (&summary->summary);
+
+	if (!n_counts) {
+		g_string_free (bdata, TRUE);
+
+		return camel_db_delete_folder (parent_store->cdb_w, camel_folder_get_full_name (folder), error) == 0;
+	}
+
+	header = g_strdup_printf ("%d %d", VEE_COUNTS_VERSION, n_counts);
+	g_string_prepend (bdata, header);
+	g_free (header);
+
+	record.folder_name = (gchar *) camel_folder_get_full_name (folder);
+	record.saved_count = camel_folder_summary_get_saved_count (&summary->summary);
+	record.unread_count = camel_folder_summary_get_unread_count (&summary->summary);
+	record.deleted_count = camel_folder_summary_get_deleted_count (&summary->summary);
+	record.junk_count = camel_folder_summary_get_junk_count (&summary->summary);
+	record.jnd_count = camel_folder_summary_get_junk_not_deleted_count (&summary->summary);
+	record.visible_count = camel_folder_summary_get_visible_count (&summary->summary);
+	record.time = time (NULL);
+	record.bdata = bdata->str;
+
+	camel_db_begin_transaction (parent_store->cdb_w, NULL);
+	ret = camel_db_write_folder_info_record (parent_store->cdb_w, &record, error);
+	if (ret == 0)
+		ret = camel_db_end_transaction (parent_store->cdb_w, error);
+	else
+		camel_db_abort_transaction (parent_store->cdb_w, NULL);
+
+	g_string_free (bdata, TRUE);
+
+	return ret == 0;
+}
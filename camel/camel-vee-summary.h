@@ -86,6 +86,11 @@ void		camel_vee_summary_replace_flags	(CamelVeeSummary *summary,
 GHashTable *	camel_vee_summary_get_uids_for_subfolder
 						(CamelVeeSummary *summary,
 						 CamelFolder *subfolder);
+void		camel_vee_summary_drop_stored_counts
+						(CamelVeeSummary *summary,
+						 CamelFolder *subfolder);
+gboolean	camel_vee_summary_save_counts	(CamelVeeSummary *summary,
+						 GError **error);
 
 G_END_DECLS
 
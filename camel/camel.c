@@ -37,6 +37,7 @@
 #include "camel-certdb.h"
 #include "camel-debug.h"
 #include "camel-provider.h"
+#include "camel-trace.h"
 #include "camel-win32.h"
 
 /* To protect NSS initialization and shutdown. This prevents
@@ -236,6 +237,28 @@ skip_nss_init:
 	return 0;
 }
 
+/* The variable set to 1 only enables the collecting,
+ * anything else is a file name to store the data to. */
+static void
+camel_dump_to_env_file (const gchar *env_name,
+                        gboolean (*dump_func) (const gchar *filename,
+                                               GError **error))
+{
+	const gchar *filename;
+	GError *local_error = NULL;
+
+	filename = g_getenv (env_name);
+	if (!filename || !*filename || g_strcmp0 (filename, "1") == 0)
+		return;
+
+	if (!dump_func (filename, &local_error)) {
+		g_warning (
+			"Failed to write %s to '%s': %s", env_name,
+			filename, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+}
+
 /**
  * camel_shutdown:
  *
@@ -255,6 +278,9 @@ camel_shutdown (void)
 		camel_certdb_set_default (NULL);
 	}
 
+	camel_dump_to_env_file ("CAMEL_TRACE", camel_trace_dump);
+	camel_dump_to_env_file ("CAMEL_SQLITE_PROFILE", camel_db_dump_profile);
+
 	/* These next calls must come last. */
 
 	if (nss_initlock != NULL) {
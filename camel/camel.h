@@ -122,6 +122,7 @@
 #include <camel/camel-string-utils.h>
 #include <camel/camel-subscribable.h>
 #include <camel/camel-text-index.h>
+#include <camel/camel-trace.h>
 #include <camel/camel-transport.h>
 #include <camel/camel-trie.h>
 #include <camel/camel-uid-cache.h>
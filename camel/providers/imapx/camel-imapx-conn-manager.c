@@ -65,6 +65,7 @@ struct _CamelIMAPXConnManagerPrivate {
 
 	GRecMutex job_queue_lock;
 	GSList *job_queue; /* CamelIMAPXJob * */
+	guint status_pass; /* protected by job_queue_lock */
 
 	GMutex busy_connections_lock;
 	GCond busy_connections_cond;
@@ -1431,23 +1432,138 @@ camel_imapx_conn_manager_list_sync (CamelIMAPXConnManager *conn_man,
 	return success;
 }
 
+/* A refresh pass lasts while refreshes wait in the queue. When the status
+ * of the mailbox of @job was not asked for in the current pass yet, returns
+ * it together with the mailboxes of the other waiting refreshes, whose
+ * statuses are to be asked for at once, otherwise returns %NULL. */
+static GPtrArray *
+imapx_conn_manager_ref_status_pass_mailboxes (CamelIMAPXConnManager *conn_man,
+					      CamelIMAPXJob *job,
+					      guint *out_status_pass)
+{
+	CamelIMAPXMailbox *mailbox;
+	GPtrArray *mailboxes = NULL;
+	GSList *link;
+	guint status_pass;
+
+	mailbox = camel_imapx_job_get_mailbox (job);
+
+	JOB_QUEUE_LOCK (conn_man);
+
+	if (!conn_man->priv->status_pass)
+		conn_man->priv->status_pass = 1;
+
+	status_pass = conn_man->priv->status_pass;
+
+	if (camel_imapx_mailbox_get_status_pass (mailbox) != status_pass) {
+		for (link = conn_man->priv->job_queue; link; link = g_slist_next (link)) {
+			CamelIMAPXJob *queued_job = link->data;
+			CamelIMAPXMailbox *queued_mailbox;
+
+			if (!queued_job || queued_job == job ||
+			    camel_imapx_job_get_kind (queued_job) != CAMEL_IMAPX_JOB_REFRESH_INFO)
+				continue;
+
+			/* Only those not running yet */
+			queued_mailbox = camel_imapx_job_get_mailbox (queued_job);
+			if (!queued_mailbox || queued_mailbox == mailbox ||
+			    camel_imapx_mailbox_get_status_pass (queued_mailbox) == status_pass ||
+			    imapx_conn_manager_is_mailbox_busy (conn_man, queued_mailbox))
+				continue;
+
+			if (!mailboxes) {
+				mailboxes = g_ptr_array_new_with_free_func (g_object_unref);
+				g_ptr_array_add (mailboxes, g_object_ref (mailbox));
+			}
+
+			g_ptr_array_add (mailboxes, g_object_ref (queued_mailbox));
+		}
+	}
+
+	*out_status_pass = status_pass;
+
+	JOB_QUEUE_UNLOCK (conn_man);
+
+	return mailboxes;
+}
+
+/* Ends the refresh pass when no other refresh waits in the queue, thus
+ * the statuses left unused, like those of the cancelled refreshes, are
+ * not used by any later refresh. */
+static void
+imapx_conn_manager_end_status_pass (CamelIMAPXConnManager *conn_man,
+				    CamelIMAPXJob *job,
+				    guint status_pass)
+{
+	GSList *link;
+
+	JOB_QUEUE_LOCK (conn_man);
+
+	for (link = conn_man->priv->job_queue; link; link = g_slist_next (link)) {
+		CamelIMAPXJob *queued_job = link->data;
+
+		if (queued_job && queued_job != job &&
+		    camel_imapx_job_get_kind (queued_job) == CAMEL_IMAPX_JOB_REFRESH_INFO)
+			break;
+	}
+
+	if (!link && conn_man->priv->status_pass == status_pass) {
+		conn_man->priv->status_pass++;
+
+		/* 0 means no pass */
+		if (!conn_man->priv->status_pass)
+			conn_man->priv->status_pass++;
+	}
+
+	JOB_QUEUE_UNLOCK (conn_man);
+}
+
 static gboolean
 imapx_conn_manager_refresh_info_run_sync (CamelIMAPXJob *job,
 					  CamelIMAPXServer *server,
 					  GCancellable *cancellable,
 					  GError **error)
 {
+	CamelIMAPXConnManager *conn_man;
 	CamelIMAPXMailbox *mailbox;
+	GPtrArray *mailboxes;
+	guint status_pass = 0;
 	gboolean success;
 	GError *local_error = NULL;
 
 	g_return_val_if_fail (job != NULL, FALSE);
 	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (server), FALSE);
 
+	conn_man = camel_imapx_job_get_user_data (job);
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (conn_man), FALSE);
+
 	mailbox = camel_imapx_job_get_mailbox (job);
 	g_return_val_if_fail (CAMEL_IS_IMAPX_MAILBOX (mailbox), FALSE);
 
-	success = camel_imapx_server_refresh_info_sync (server, mailbox, cancellable, &local_error);
+	/* The folders to be checked for new messages are refreshed one
+	 * by one, each with its own STATUS round-trip. Asking for the
+	 * statuses of all the waiting refreshes at once lets the server
+	 * pipeline the STATUS commands. */
+	mailboxes = imapx_conn_manager_ref_status_pass_mailboxes (conn_man, job, &status_pass);
+	if (mailboxes) {
+		success = camel_imapx_server_status_sync (server, mailboxes, status_pass, cancellable, &local_error);
+
+		/* Not fatal when the server refused some, each refresh
+		 * asks for its status when it has none */
+		if (!success && g_error_matches (local_error, CAMEL_ERROR, CAMEL_ERROR_GENERIC)) {
+			g_clear_error (&local_error);
+			success = TRUE;
+		}
+
+		g_ptr_array_unref (mailboxes);
+	} else {
+		success = TRUE;
+	}
+
+	if (success)
+		success = camel_imapx_server_refresh_info_sync (server, mailbox, status_pass, cancellable, &local_error);
+
+	imapx_conn_manager_end_status_pass (conn_man, job, status_pass);
 
 	camel_imapx_job_set_result (job, success, NULL, local_error, NULL);
 
@@ -1474,6 +1590,9 @@ camel_imapx_conn_manager_refresh_info_sync (CamelIMAPXConnManager *conn_man,
 	job = camel_imapx_job_new (CAMEL_IMAPX_JOB_REFRESH_INFO, mailbox,
 		imapx_conn_manager_refresh_info_run_sync, NULL, NULL);
 
+	/* The job does not outlive this call, thus no reference needed */
+	camel_imapx_job_set_user_data (job, conn_man, NULL);
+
 	success = camel_imapx_conn_manager_run_job_sync (conn_man, job,
 		imapx_conn_manager_matches_sync_changes_or_refresh_info,
 		cancellable, error);
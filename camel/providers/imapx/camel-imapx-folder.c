@@ -1433,7 +1433,7 @@ camel_imapx_folder_invalidate_local_cache (CamelIMAPXFolder *folder,
 	summary = CAMEL_FOLDER (folder)->summary;
 
 	changes = camel_folder_change_info_new ();
-	array = camel_folder_summary_get_array (summary);
+	array = camel_folder_summary_ref_array (summary);
 
 	for (ii = 0; ii < array->len; ii++) {
 		const gchar *uid = array->pdata[ii];
@@ -1450,7 +1450,7 @@ camel_imapx_folder_invalidate_local_cache (CamelIMAPXFolder *folder,
 	camel_folder_changed (CAMEL_FOLDER (folder), changes);
 
 	camel_folder_change_info_free (changes);
-	camel_folder_summary_free_array (array);
+	g_ptr_array_unref (array);
 }
 
 gboolean
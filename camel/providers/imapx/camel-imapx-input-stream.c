@@ -45,6 +45,8 @@ struct _CamelIMAPXInputStreamPrivate {
 
 	guchar *tokenbuf;
 	guint bufsize;
+
+	guint64 bytes_read; /* from the base stream */
 };
 
 /* Forward Declarations */
@@ -88,6 +90,7 @@ imapx_input_stream_fill (CamelIMAPXInputStream *is,
 		is->priv->bufsize - (is->priv->end - is->priv->buf),
 		cancellable, error);
 	if (left > 0) {
+		is->priv->bytes_read += left;
 		is->priv->end += left;
 		return is->priv->end - is->priv->ptr;
 	} else {
@@ -154,6 +157,8 @@ imapx_input_stream_read (GInputStream *stream,
 			base_stream, buffer, max, cancellable, error);
 		if (max <= 0)
 			return max;
+
+		priv->bytes_read += max;
 	}
 
 	priv->literal -= max;
@@ -328,6 +333,15 @@ camel_imapx_input_stream_buffered (CamelIMAPXInputStream *is)
 	return is->priv->end - is->priv->ptr;
 }
 
+/* Returns how many bytes were read from the server so far */
+guint64
+camel_imapx_input_stream_get_bytes_read (CamelIMAPXInputStream *is)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_INPUT_STREAM (is), 0);
+
+	return is->priv->bytes_read;
+}
+
 /* FIXME: these should probably handle it themselves,
  * and get rid of the token interface? */
 gboolean
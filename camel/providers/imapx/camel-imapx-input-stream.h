@@ -76,6 +76,8 @@ GType		camel_imapx_input_stream_get_type
 GInputStream *	camel_imapx_input_stream_new	(GInputStream *base_stream);
 gint		camel_imapx_input_stream_buffered
 						(CamelIMAPXInputStream *is);
+guint64		camel_imapx_input_stream_get_bytes_read
+						(CamelIMAPXInputStream *is);
 
 camel_imapx_token_t
 		camel_imapx_input_stream_token	(CamelIMAPXInputStream *is,
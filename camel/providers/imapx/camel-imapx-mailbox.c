@@ -48,6 +48,9 @@ struct _CamelIMAPXMailboxPrivate {
 	guint64 highestmodseq;
 	guint32 permanentflags;
 
+	/* The refresh pass the last STATUS response was asked for, or 0 */
+	guint status_pass;
+
 	CamelIMAPXMailboxState state;
 
 	GMutex property_lock;
@@ -1199,6 +1202,45 @@ camel_imapx_mailbox_handle_status_response (CamelIMAPXMailbox *mailbox,
 		mailbox->priv->highestmodseq = value64;
 }
 
+/**
+ * camel_imapx_mailbox_get_status_pass:
+ * @mailbox: a #CamelIMAPXMailbox
+ *
+ * Returns the refresh pass set by camel_imapx_mailbox_set_status_pass(),
+ * that is the pass whose refresh of @mailbox can use the last received
+ * status instead of asking for it again, or 0 when there is none.
+ *
+ * Returns: the refresh pass of the received status of @mailbox, or 0
+ *
+ * Since: 3.20
+ **/
+guint
+camel_imapx_mailbox_get_status_pass (CamelIMAPXMailbox *mailbox)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_MAILBOX (mailbox), 0);
+
+	return (guint) g_atomic_int_get (&mailbox->priv->status_pass);
+}
+
+/**
+ * camel_imapx_mailbox_set_status_pass:
+ * @mailbox: a #CamelIMAPXMailbox
+ * @status_pass: a refresh pass, or 0
+ *
+ * Marks the last received status of @mailbox as asked for by the refresh
+ * pass @status_pass. Use 0 to mark the status as used.
+ *
+ * Since: 3.20
+ **/
+void
+camel_imapx_mailbox_set_status_pass (CamelIMAPXMailbox *mailbox,
+                                     guint status_pass)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_MAILBOX (mailbox));
+
+	g_atomic_int_set (&mailbox->priv->status_pass, status_pass);
+}
+
 gint
 camel_imapx_mailbox_get_update_count (CamelIMAPXMailbox *mailbox)
 {
@@ -174,6 +174,11 @@ void		camel_imapx_mailbox_handle_lsub_response
 void		camel_imapx_mailbox_handle_status_response
 					(CamelIMAPXMailbox *mailbox,
 					 CamelIMAPXStatusResponse *response);
+guint		camel_imapx_mailbox_get_status_pass
+					(CamelIMAPXMailbox *mailbox);
+void		camel_imapx_mailbox_set_status_pass
+					(CamelIMAPXMailbox *mailbox,
+					 guint status_pass);
 
 gint		camel_imapx_mailbox_get_update_count
 					(CamelIMAPXMailbox *mailbox);
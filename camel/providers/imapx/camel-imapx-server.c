@@ -71,6 +71,10 @@
    to be queued, before actually sending IDLE */
 #define IMAPX_IDLE_WAIT_SECONDS 2
 
+/* How many tagged commands can be written ahead of reading
+ * their completions by imapx_server_process_commands_sync() */
+#define IMAPX_PIPELINE_WINDOW 16
+
 #ifdef G_OS_WIN32
 #ifdef gmtime_r
 #undef gmtime_r
@@ -304,6 +308,11 @@ struct _CamelIMAPXServerPrivate {
 	CamelIMAPXCommand *current_command;
 	CamelIMAPXCommand *continuation_command;
 
+	/* Commands written by imapx_server_process_commands_sync(),
+	 * still waiting for their completion, the oldest first;
+	 * not referenced, guarded by the command_lock */
+	GQueue pipelined_commands;
+
 	/* operation data */
 	GIOStream *get_message_stream;
 
@@ -2245,11 +2254,24 @@ imapx_completion (CamelIMAPXServer *is,
 
 	COMMAND_LOCK (is);
 
-	if (is->priv->current_command != NULL && is->priv->current_command->tag == tag)
+	if (is->priv->current_command != NULL && is->priv->current_command->tag == tag) {
 		ic = camel_imapx_command_ref (is->priv->current_command);
-	else
+	} else {
+		GList *link;
+
 		ic = NULL;
 
+		/* The servers may complete pipelined commands in any order */
+		for (link = g_queue_peek_head_link (&is->priv->pipelined_commands); link; link = g_list_next (link)) {
+			CamelIMAPXCommand *pipelined = link->data;
+
+			if (pipelined->tag == tag) {
+				ic = camel_imapx_command_ref (pipelined);
+				break;
+			}
+		}
+	}
+
 	COMMAND_UNLOCK (is);
 
 	if (ic == NULL) {
@@ -3410,6 +3432,7 @@ camel_imapx_server_init (CamelIMAPXServer *is)
 	is->priv->idle_stamp = 0;
 
 	g_rec_mutex_init (&is->priv->command_lock);
+	g_queue_init (&is->priv->pipelined_commands);
 }
 
 CamelIMAPXServer *
@@ -3639,6 +3662,27 @@ camel_imapx_server_ensure_selected_sync (CamelIMAPXServer *is,
 	return success;
 }
 
+/* Takes ownership of the local_error */
+static void
+imapx_server_propagate_command_error (GError *local_error,
+				      const gchar *error_prefix,
+				      GError **error)
+{
+	/* Sadly, G_IO_ERROR_FAILED is also used for 'Connection reset by peer' error;
+	   since GLib 2.44 is used G_IO_ERROR_CONNECTION_CLOSED, which is the same as G_IO_ERROR_BROKEN_PIPE */
+	if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_FAILED) ||
+	    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) ||
+	    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)) {
+		local_error->domain = CAMEL_IMAPX_SERVER_ERROR;
+		local_error->code = CAMEL_IMAPX_SERVER_ERROR_TRY_RECONNECT;
+	}
+
+	if (error_prefix)
+		g_prefix_error (&local_error, "%s: ", error_prefix);
+
+	g_propagate_error (error, local_error);
+}
+
 gboolean
 camel_imapx_server_process_command_sync (CamelIMAPXServer *is,
 					 CamelIMAPXCommand *ic,
@@ -3653,6 +3697,9 @@ camel_imapx_server_process_command_sync (CamelIMAPXServer *is,
 	GList *head;
 	gchar *string;
 	gboolean success = FALSE;
+	CamelTraceSpan span;
+	CamelIMAPXMailbox *trace_mailbox;
+	guint64 bytes_read = 0;
 	GError *local_error = NULL;
 
 	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
@@ -3716,6 +3763,17 @@ camel_imapx_server_process_command_sync (CamelIMAPXServer *is,
 	input_stream = camel_imapx_server_ref_input_stream (is);
 	output_stream = camel_imapx_server_ref_output_stream (is);
 
+	/* Look up the mailbox name only when it is going to be used */
+	trace_mailbox = camel_trace_get_enabled () ? camel_imapx_server_ref_selected (is) : NULL;
+	camel_trace_span_begin (
+		&span, "imapx", camel_imapx_job_get_kind_name (ic->job_kind),
+		trace_mailbox ? camel_imapx_mailbox_get_name (trace_mailbox) : NULL);
+	g_clear_object (&trace_mailbox);
+
+	if (input_stream != NULL)
+		bytes_read = camel_imapx_input_stream_get_bytes_read (
+			CAMEL_IMAPX_INPUT_STREAM (input_stream));
+
 	if (output_stream == NULL) {
 		local_error = g_error_new_literal (
 			CAMEL_IMAPX_SERVER_ERROR, CAMEL_IMAPX_SERVER_ERROR_TRY_RECONNECT,
@@ -3799,20 +3857,247 @@ camel_imapx_server_process_command_sync (CamelIMAPXServer *is,
 			"%s", ic->status->text);
 	}
 
+	if (camel_trace_span_is_active (&span) && input_stream != NULL) {
+		bytes_read = camel_imapx_input_stream_get_bytes_read (
+			CAMEL_IMAPX_INPUT_STREAM (input_stream)) - bytes_read;
+		camel_trace_span_end (&span, bytes_read, local_error);
+	} else {
+		camel_trace_span_end (&span, -1, local_error);
+	}
+
 	if (local_error) {
-		/* Sadly, G_IO_ERROR_FAILED is also used for 'Connection reset by peer' error;
-		   since GLib 2.44 is used G_IO_ERROR_CONNECTION_CLOSED, which is the same as G_IO_ERROR_BROKEN_PIPE */
-		if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_FAILED) ||
-		    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) ||
-		    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)) {
-			local_error->domain = CAMEL_IMAPX_SERVER_ERROR;
-			local_error->code = CAMEL_IMAPX_SERVER_ERROR_TRY_RECONNECT;
+		imapx_server_propagate_command_error (local_error, error_prefix, error);
+
+		success = FALSE;
+	}
+
+	g_clear_object (&input_stream);
+	g_clear_object (&output_stream);
+
+	return success;
+}
+
+/* Commands which leave the connection state as it is, thus their
+ * completions can be waited for after the next commands are written.
+ * A literal would need the continuation response, which cannot be
+ * told apart from other commands' responses. */
+static gboolean
+imapx_server_command_can_pipeline (CamelIMAPXCommand *ic)
+{
+	CamelIMAPXCommandPart *cp;
+
+	if (ic->job_kind != CAMEL_IMAPX_JOB_STATUS &&
+	    ic->job_kind != CAMEL_IMAPX_JOB_SYNC_CHANGES)
+		return FALSE;
+
+	if (g_queue_get_length (&ic->parts) != 1)
+		return FALSE;
+
+	cp = g_queue_peek_head (&ic->parts);
+
+	return (cp->type & (CAMEL_IMAPX_COMMAND_LITERAL_PLUS | CAMEL_IMAPX_COMMAND_CONTINUATION)) == 0 &&
+		(cp->type & CAMEL_IMAPX_COMMAND_MASK) == CAMEL_IMAPX_COMMAND_SIMPLE;
+}
+
+/* Runs all the @commands, writing up to IMAPX_PIPELINE_WINDOW of them
+ * before their tagged completions are read, thus the round-trips overlap.
+ * Falls back to camel_imapx_server_process_command_sync() for each command
+ * when any of them cannot be pipelined.  Fails when any command fails,
+ * after all the written commands completed.  With @stop_on_failure no more
+ * commands are written once any of them fails.
+ *
+ * When it fails on an I/O error or a cancel with commands still in flight,
+ * the connection is dropped, because their completions would otherwise
+ * arrive while the next command runs. */
+static gboolean
+imapx_server_process_commands_sync (CamelIMAPXServer *is,
+				    GPtrArray *commands,
+				    gboolean stop_on_failure,
+				    const gchar *error_prefix,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	CamelIMAPXCommand *ic;
+	GInputStream *input_stream = NULL;
+	GOutputStream *output_stream = NULL;
+	GString *buffer;
+	CamelTraceSpan span;
+	guint64 bytes_read = 0;
+	guint n_sent = 0, n_done = 0, ii;
+	gboolean success = TRUE, failed = FALSE, in_flight;
+	GError *local_error = NULL;
+
+	for (ii = 0; ii < commands->len; ii++) {
+		ic = g_ptr_array_index (commands, ii);
+
+		camel_imapx_command_close (ic);
+
+		if (!imapx_server_command_can_pipeline (ic))
+			break;
+	}
+
+	if (commands->len < 2 || ii < commands->len) {
+		for (ii = 0; ii < commands->len && success; ii++) {
+			ic = g_ptr_array_index (commands, ii);
+			success = camel_imapx_server_process_command_sync (is, ic, error_prefix, cancellable, error);
 		}
 
-		if (error_prefix && local_error)
-			g_prefix_error (&local_error, "%s: ", error_prefix);
+		return success;
+	}
 
-		g_propagate_error (error, local_error);
+	COMMAND_LOCK (is);
+
+	if (is->priv->current_command != NULL) {
+		g_warning ("%s: [%c] %p: Starting %u commands while still processing %p (%s)", G_STRFUNC,
+			is->priv->tagprefix, is, commands->len,
+			is->priv->current_command, camel_imapx_job_get_kind_name (is->priv->current_command->job_kind));
+	}
+
+	COMMAND_UNLOCK (is);
+
+	for (ii = 0; ii < commands->len; ii++) {
+		ic = g_ptr_array_index (commands, ii);
+
+		if (ic->status) {
+			imapx_free_status (ic->status);
+			ic->status = NULL;
+		}
+		ic->completed = FALSE;
+		ic->current_part = g_queue_peek_head_link (&ic->parts);
+	}
+
+	input_stream = camel_imapx_server_ref_input_stream (is);
+	output_stream = camel_imapx_server_ref_output_stream (is);
+
+	ic = g_ptr_array_index (commands, 0);
+	camel_trace_span_begin (&span, "imapx", camel_imapx_job_get_kind_name (ic->job_kind), NULL);
+
+	if (input_stream != NULL)
+		bytes_read = camel_imapx_input_stream_get_bytes_read (
+			CAMEL_IMAPX_INPUT_STREAM (input_stream));
+
+	if (output_stream == NULL) {
+		local_error = g_error_new_literal (
+			CAMEL_IMAPX_SERVER_ERROR, CAMEL_IMAPX_SERVER_ERROR_TRY_RECONNECT,
+			_("Cannot issue command, no stream available"));
+		success = FALSE;
+	}
+
+	buffer = g_string_sized_new (IMAPX_PIPELINE_WINDOW * 64);
+
+	while (success && n_done < (failed ? n_sent : commands->len)) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error)) {
+			success = FALSE;
+			break;
+		}
+
+		/* Fill the window, with a single write */
+		g_string_truncate (buffer, 0);
+
+		COMMAND_LOCK (is);
+
+		while (!failed && n_sent < commands->len && n_sent - n_done < IMAPX_PIPELINE_WINDOW) {
+			CamelIMAPXCommandPart *cp;
+
+			ic = g_ptr_array_index (commands, n_sent);
+			cp = ic->current_part->data;
+
+			c (is->priv->tagprefix, "Starting pipelined command %c%05u %s\r\n", is->priv->tagprefix, ic->tag, cp->data);
+
+			g_string_append_printf (buffer, "%c%05u %s\r\n", is->priv->tagprefix, ic->tag, cp->data);
+			g_queue_push_tail (&is->priv->pipelined_commands, ic);
+
+			n_sent++;
+		}
+
+		/* The untagged handlers look at the current command */
+		is->priv->current_command = g_queue_peek_head (&is->priv->pipelined_commands);
+
+		COMMAND_UNLOCK (is);
+
+		if (buffer->len > 0) {
+			g_mutex_lock (&is->priv->stream_lock);
+			success = g_output_stream_write_all (
+				output_stream, buffer->str, buffer->len,
+				NULL, cancellable, &local_error);
+			g_mutex_unlock (&is->priv->stream_lock);
+
+			if (!success)
+				break;
+		}
+
+		/* Read until the oldest command completes; completions
+		 * of the later commands are noted on the way */
+		ic = g_ptr_array_index (commands, n_done);
+		while (success && !ic->completed)
+			success = imapx_step (is, input_stream, output_stream, cancellable, &local_error);
+
+		COMMAND_LOCK (is);
+
+		while (n_done < n_sent) {
+			ic = g_ptr_array_index (commands, n_done);
+			if (!ic->completed)
+				break;
+
+			g_queue_remove (&is->priv->pipelined_commands, ic);
+			n_done++;
+
+			if (stop_on_failure && ic->status && ic->status->result != IMAPX_OK)
+				failed = TRUE;
+		}
+
+		is->priv->current_command = g_queue_peek_head (&is->priv->pipelined_commands);
+
+		COMMAND_UNLOCK (is);
+	}
+
+	g_string_free (buffer, TRUE);
+
+	COMMAND_LOCK (is);
+
+	c (is->priv->tagprefix, "%s: done %u of %u commands; success:%d local-error:%s\n", G_STRFUNC,
+		n_done, commands->len, success, local_error ? local_error->message : "[null]");
+
+	/* Nothing more will be read for the unfinished commands */
+	in_flight = !g_queue_is_empty (&is->priv->pipelined_commands);
+	g_queue_clear (&is->priv->pipelined_commands);
+	is->priv->current_command = NULL;
+
+	COMMAND_UNLOCK (is);
+
+	if (in_flight) {
+		c (is->priv->tagprefix, "%s: disconnecting, %u commands still in flight\n", G_STRFUNC, n_sent - n_done);
+
+		imapx_disconnect (is);
+	}
+
+	if (success) {
+		imapx_server_reset_inactivity_timer (is);
+
+		/* Server reported error. */
+		for (ii = 0; ii < commands->len; ii++) {
+			ic = g_ptr_array_index (commands, ii);
+
+			if (ic->status && ic->status->result != IMAPX_OK) {
+				g_set_error (
+					&local_error, CAMEL_ERROR,
+					CAMEL_ERROR_GENERIC,
+					"%s", ic->status->text);
+				break;
+			}
+		}
+	}
+
+	if (camel_trace_span_is_active (&span) && input_stream != NULL) {
+		bytes_read = camel_imapx_input_stream_get_bytes_read (
+			CAMEL_IMAPX_INPUT_STREAM (input_stream)) - bytes_read;
+		camel_trace_span_end (&span, bytes_read, local_error);
+	} else {
+		camel_trace_span_end (&span, -1, local_error);
+	}
+
+	if (local_error) {
+		imapx_server_propagate_command_error (local_error, error_prefix, error);
 
 		success = FALSE;
 	}
@@ -4854,9 +5139,62 @@ imapx_server_fetch_changes (CamelIMAPXServer *is,
 	return success;
 }
 
+/* Asks for the status of all the @mailboxes at once. Unless @status_pass
+ * is 0, the mailboxes whose STATUS succeeded are marked with it, thus
+ * camel_imapx_server_refresh_info_sync() in the same refresh pass can
+ * skip their STATUS. The selected mailbox is skipped. */
+gboolean
+camel_imapx_server_status_sync (CamelIMAPXServer *is,
+				GPtrArray *mailboxes,
+				guint status_pass,
+				GCancellable *cancellable,
+				GError **error)
+{
+	CamelIMAPXMailbox *selected_mailbox;
+	GPtrArray *commands, *queried;
+	guint ii;
+	gboolean success;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	g_return_val_if_fail (mailboxes != NULL, FALSE);
+
+	selected_mailbox = camel_imapx_server_ref_pending_or_selected (is);
+	commands = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_imapx_command_unref);
+	queried = g_ptr_array_new ();
+
+	for (ii = 0; ii < mailboxes->len; ii++) {
+		CamelIMAPXMailbox *mailbox = g_ptr_array_index (mailboxes, ii);
+		CamelIMAPXCommand *ic;
+
+		if (mailbox == selected_mailbox)
+			continue;
+
+		ic = camel_imapx_command_new (is, CAMEL_IMAPX_JOB_STATUS, "STATUS %M (%t)", mailbox, is->priv->status_data_items);
+		g_ptr_array_add (commands, ic);
+		g_ptr_array_add (queried, mailbox);
+	}
+
+	g_clear_object (&selected_mailbox);
+
+	success = imapx_server_process_commands_sync (is, commands, FALSE, _("Error running STATUS"), cancellable, error);
+
+	for (ii = 0; status_pass && ii < commands->len; ii++) {
+		CamelIMAPXCommand *ic = g_ptr_array_index (commands, ii);
+
+		if (ic->completed && ic->status && ic->status->result == IMAPX_OK)
+			camel_imapx_mailbox_set_status_pass (g_ptr_array_index (queried, ii), status_pass);
+	}
+
+	g_ptr_array_unref (commands);
+	g_ptr_array_unref (queried);
+
+	return success;
+}
+
 gboolean
 camel_imapx_server_refresh_info_sync (CamelIMAPXServer *is,
 				      CamelIMAPXMailbox *mailbox,
+				      guint status_pass,
 				      GCancellable *cancellable,
 				      GError **error)
 {
@@ -4872,15 +5210,23 @@ camel_imapx_server_refresh_info_sync (CamelIMAPXServer *is,
 	guint64 highestmodseq;
 	guint32 total;
 	guint64 uidl;
+	gboolean have_status;
 	gboolean need_rescan;
 	gboolean success;
 
 	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
 	g_return_val_if_fail (CAMEL_IS_IMAPX_MAILBOX (mailbox), FALSE);
 
+	have_status = status_pass != 0 && camel_imapx_mailbox_get_status_pass (mailbox) == status_pass;
+
 	selected_mailbox = camel_imapx_server_ref_pending_or_selected (is);
 	if (selected_mailbox == mailbox) {
 		success = camel_imapx_server_noop_sync (is, mailbox, cancellable, error);
+	} else if (have_status) {
+		/* The status was asked for by camel_imapx_server_status_sync()
+		 * earlier in this refresh pass */
+		c (is->priv->tagprefix, "Using received status of '%s'\n", camel_imapx_mailbox_get_name (mailbox));
+		success = TRUE;
 	} else {
 		ic = camel_imapx_command_new (is, CAMEL_IMAPX_JOB_STATUS, "STATUS %M (%t)", mailbox, is->priv->status_data_items);
 
@@ -4890,6 +5236,9 @@ camel_imapx_server_refresh_info_sync (CamelIMAPXServer *is,
 	}
 	g_clear_object (&selected_mailbox);
 
+	/* Each status is used only once, the next refresh asks again */
+	camel_imapx_mailbox_set_status_pass (mailbox, 0);
+
 	if (!success)
 		return FALSE;
 
@@ -4982,7 +5331,7 @@ camel_imapx_server_refresh_info_sync (CamelIMAPXServer *is,
 
 		changes = camel_folder_change_info_new ();
 
-		array = camel_folder_summary_get_array (folder->summary);
+		array = camel_folder_summary_ref_array (folder->summary);
 		for (ii = 0; array && ii < array->len; ii++) {
 			const gchar *uid = array->pdata[ii];
 
@@ -5012,7 +5361,7 @@ camel_imapx_server_refresh_info_sync (CamelIMAPXServer *is,
 		}
 
 		camel_folder_change_info_free (changes);
-		camel_folder_summary_free_array (array);
+		g_ptr_array_unref (array);
 	}
 
 	g_hash_table_destroy (known_uids);
@@ -5106,6 +5455,7 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 	guint i, jj, on, on_orset, off_orset;
 	GPtrArray *changed_uids;
 	GArray *on_user = NULL, *off_user = NULL;
+	GPtrArray *store_commands;
 	CamelFolder *folder;
 	CamelIMAPXMessageInfo *info;
 	GHashTable *changed_meanwhile;
@@ -5313,12 +5663,14 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 
 	permanentflags = camel_imapx_mailbox_get_permanentflags (mailbox);
 
-	success = TRUE;
-	for (on = 0; on < 2 && success; on++) {
+	/* All the UID STOREs are pipelined, they do not depend on each other */
+	store_commands = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_imapx_command_unref);
+
+	for (on = 0; on < 2; on++) {
 		guint32 orset = on ? on_orset : off_orset;
 		GArray *user_set = on ? on_user : off_user;
 
-		for (jj = 0; jj < G_N_ELEMENTS (flags_table) && success; jj++) {
+		for (jj = 0; jj < G_N_ELEMENTS (flags_table); jj++) {
 			guint32 flag = flags_table[jj].flag;
 			CamelIMAPXCommand *ic = NULL;
 
@@ -5327,7 +5679,7 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 
 			c (is->priv->tagprefix, "checking/storing %s flags '%s'\n", on ? "on" : "off", flags_table[jj].name);
 			imapx_uidset_init (&uidset, 0, 100);
-			for (i = 0; i < changed_uids->len && success; i++) {
+			for (i = 0; i < changed_uids->len; i++) {
 				CamelIMAPXMessageInfo *info;
 				gboolean remove_deleted_flag;
 				guint32 flags;
@@ -5367,13 +5719,8 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 				if (send == 1 || (i == changed_uids->len - 1 && ic && imapx_uidset_done (&uidset, ic))) {
 					camel_imapx_command_add (ic, " %tFLAGS.SILENT (%t)", on ? "+" : "-", flags_table[jj].name);
 
-					success = camel_imapx_server_process_command_sync (is, ic, _("Error syncing changes"), cancellable, error);
-
-					camel_imapx_command_unref (ic);
+					g_ptr_array_add (store_commands, ic);
 					ic = NULL;
-
-					if (!success)
-						break;
 				}
 				if (flag == CAMEL_MESSAGE_SEEN) {
 					/* Remember how the server's unread count will change if this
@@ -5396,10 +5743,10 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 			g_warn_if_fail (ic == NULL);
 		}
 
-		if (user_set && (permanentflags & CAMEL_MESSAGE_USER) != 0 && success) {
+		if (user_set && (permanentflags & CAMEL_MESSAGE_USER) != 0) {
 			CamelIMAPXCommand *ic = NULL;
 
-			for (jj = 0; jj < user_set->len && success; jj++) {
+			for (jj = 0; jj < user_set->len; jj++) {
 				struct _imapx_flag_change *c = &g_array_index (user_set, struct _imapx_flag_change, jj);
 
 				imapx_uidset_init (&uidset, 0, 100);
@@ -5419,19 +5766,18 @@ camel_imapx_server_sync_changes_sync (CamelIMAPXServer *is,
 
 						g_free (utf7);
 
-						success = camel_imapx_server_process_command_sync (is, ic, _("Error syncing changes"), cancellable, error);
-
-						camel_imapx_command_unref (ic);
+						g_ptr_array_add (store_commands, ic);
 						ic = NULL;
-
-						if (!success)
-							break;
 					}
 				}
 			}
 		}
 	}
 
+	success = imapx_server_process_commands_sync (is, store_commands, TRUE, _("Error syncing changes"), cancellable, error);
+
+	g_ptr_array_unref (store_commands);
+
 	g_signal_handler_disconnect (folder->summary, changed_meanwhile_handler_id);
 
 	if (success) {
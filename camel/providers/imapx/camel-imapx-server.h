@@ -186,9 +186,15 @@ gboolean	camel_imapx_server_list_sync	(CamelIMAPXServer *is,
 						 CamelStoreGetFolderInfoFlags flags,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	camel_imapx_server_status_sync	(CamelIMAPXServer *is,
+						 GPtrArray *mailboxes,
+						 guint status_pass,
+						 GCancellable *cancellable,
+						 GError **error);
 gboolean	camel_imapx_server_refresh_info_sync
 						(CamelIMAPXServer *is,
 						 CamelIMAPXMailbox *mailbox,
+						 guint status_pass,
 						 GCancellable *cancellable,
 						 GError **error);
 gboolean	camel_imapx_server_sync_changes_sync
@@ -1119,7 +1119,10 @@ get_folder_info_offline (CamelStore *store,
 	 * the moment. So let it do the right thing by bailing out if it's
 	 * not a folder we're explicitly interested in. */
 
-	array = camel_store_summary_array (imapx_store->summary);
+	if (include_inbox)
+		array = camel_store_summary_array (imapx_store->summary);
+	else
+		array = camel_store_summary_subtree_array (imapx_store->summary, top);
 
 	for (ii = 0; ii < array->len; ii++) {
 		CamelStoreInfo *si;
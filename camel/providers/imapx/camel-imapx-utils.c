@@ -293,6 +293,10 @@ imapx_update_user_flags (CamelMessageInfo *info,
 	if (set_note)
 		camel_flag_set (&binfo->user_flags, "$has_note", TRUE);
 
+	/* The flags were changed behind camel_message_info_set_user_flag() */
+	if (changed)
+		binfo->saved_columns &= ~CAMEL_MI_RECORD_COLUMN_LABELS;
+
 	return changed;
 }
 
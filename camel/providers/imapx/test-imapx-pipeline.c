@@ -0,0 +1,625 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Runs pipelined STATUS commands against a local IMAP stand-in, which
+ * answers each command only after a fixed delay, like a distant server. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "camel-imapx-conn-manager.h"
+#include "camel-imapx-store.h"
+
+#define N_FOLDERS 32
+
+typedef struct _FakeServer FakeServer;
+typedef struct _FakeConnection FakeConnection;
+typedef struct _FakeLine FakeLine;
+
+struct _FakeServer {
+	GSocketListener *listener;
+	GCancellable *cancellable;
+	GThread *accept_thread;
+	guint16 port;
+	gulong latency; /* in microseconds */
+	gchar *mailboxes[N_FOLDERS + 1];
+
+	GMutex lock;
+	GSList *threads; /* GThread *, the writers */
+	guint n_connections;
+	guint n_status;
+	guint in_flight;
+	guint max_in_flight;
+};
+
+struct _FakeConnection {
+	FakeServer *server;
+	GSocketConnection *connection;
+	GAsyncQueue *lines; /* FakeLine * */
+};
+
+struct _FakeLine {
+	gchar *text; /* NULL at the end of the input */
+	gint64 arrival;
+};
+
+typedef struct _Fixture {
+	FakeServer *server;
+	gchar *tmp_dir;
+	CamelSession *session;
+	CamelService *service;
+	CamelIMAPXConnManager *conn_man;
+} Fixture;
+
+/* Returns the next atom, quoted string or parenthesized list of @pline */
+static gchar *
+fake_server_next_token (const gchar **pline)
+{
+	const gchar *ptr = *pline, *start;
+
+	while (*ptr == ' ')
+		ptr++;
+
+	start = ptr;
+
+	if (*ptr == '"') {
+		ptr++;
+		while (*ptr && *ptr != '"') {
+			if (*ptr == '\\' && ptr[1])
+				ptr++;
+			ptr++;
+		}
+		if (*ptr)
+			ptr++;
+	} else if (*ptr == '(') {
+		while (*ptr && *ptr != ')')
+			ptr++;
+		if (*ptr)
+			ptr++;
+	} else {
+		while (*ptr && *ptr != ' ')
+			ptr++;
+	}
+
+	*pline = ptr;
+
+	return g_strndup (start, ptr - start);
+}
+
+static gchar *
+fake_server_respond (FakeServer *server,
+                     const gchar *line)
+{
+	GString *response;
+	gchar *tag, *verb;
+
+	response = g_string_new ("");
+
+	tag = fake_server_next_token (&line);
+	verb = fake_server_next_token (&line);
+
+	if (g_ascii_strcasecmp (verb, "UID") == 0) {
+		g_free (verb);
+		verb = fake_server_next_token (&line);
+	}
+
+	if (g_ascii_strcasecmp (verb, "CAPABILITY") == 0) {
+		g_string_append (response, "* CAPABILITY IMAP4rev1\r\n");
+	} else if (g_ascii_strcasecmp (verb, "LIST") == 0 ||
+		   g_ascii_strcasecmp (verb, "LSUB") == 0) {
+		gchar *reference, *pattern;
+		guint ii;
+
+		reference = fake_server_next_token (&line);
+		pattern = fake_server_next_token (&line);
+
+		if (g_strcmp0 (pattern, "\"\"") == 0) {
+			g_string_append_printf (response, "* %s (\\Noselect) \"/\" \"\"\r\n", verb);
+		} else {
+			for (ii = 0; ii <= N_FOLDERS; ii++) {
+				if (ii > 0 && g_ascii_strcasecmp (pattern, "INBOX") == 0)
+					break;
+
+				g_string_append_printf (response, "* %s () \"/\" %s\r\n", verb, server->mailboxes[ii]);
+			}
+		}
+
+		g_free (reference);
+		g_free (pattern);
+	} else if (g_ascii_strcasecmp (verb, "STATUS") == 0) {
+		gchar *name;
+
+		name = fake_server_next_token (&line);
+
+		g_string_append_printf (response, "* STATUS %s (MESSAGES 0 UNSEEN 0 UIDNEXT 1 UIDVALIDITY 1)\r\n", name);
+
+		g_mutex_lock (&server->lock);
+		server->n_status++;
+		g_mutex_unlock (&server->lock);
+
+		g_free (name);
+	} else if (g_ascii_strcasecmp (verb, "LOGOUT") == 0) {
+		g_string_append (response, "* BYE logging out\r\n");
+	}
+
+	g_string_append_printf (response, "%s OK %s completed\r\n", tag, verb);
+
+	g_free (tag);
+	g_free (verb);
+
+	return g_string_free (response, FALSE);
+}
+
+static gpointer
+fake_connection_reader_thread (gpointer user_data)
+{
+	FakeConnection *fc = user_data;
+	FakeServer *server = fc->server;
+	GDataInputStream *input_stream;
+	FakeLine *fl;
+
+	input_stream = g_data_input_stream_new (
+		g_io_stream_get_input_stream (G_IO_STREAM (fc->connection)));
+	g_data_input_stream_set_newline_type (input_stream, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+	while (TRUE) {
+		gchar *text;
+
+		text = g_data_input_stream_read_line (input_stream, NULL, server->cancellable, NULL);
+		if (!text)
+			break;
+
+		g_mutex_lock (&server->lock);
+		server->in_flight++;
+		if (server->in_flight > server->max_in_flight)
+			server->max_in_flight = server->in_flight;
+		g_mutex_unlock (&server->lock);
+
+		fl = g_new0 (FakeLine, 1);
+		fl->text = text;
+		fl->arrival = g_get_monotonic_time ();
+
+		g_async_queue_push (fc->lines, fl);
+	}
+
+	g_object_unref (input_stream);
+
+	/* Tell the writer the client is gone */
+	g_async_queue_push (fc->lines, g_new0 (FakeLine, 1));
+
+	return NULL;
+}
+
+/* Answers each command only after the latency, counted from its arrival,
+ * thus the commands written together are answered together */
+static gpointer
+fake_connection_writer_thread (gpointer user_data)
+{
+	FakeConnection *fc = user_data;
+	FakeServer *server = fc->server;
+	GOutputStream *output_stream;
+	GThread *reader;
+	FakeLine *fl;
+	const gchar *greeting = "* OK [CAPABILITY IMAP4rev1] IMAP stand-in ready\r\n";
+	gboolean can_write;
+
+	output_stream = g_io_stream_get_output_stream (G_IO_STREAM (fc->connection));
+	can_write = g_output_stream_write_all (output_stream, greeting, strlen (greeting), NULL, NULL, NULL);
+
+	reader = g_thread_new ("fake-imap-reader", fake_connection_reader_thread, fc);
+
+	while (fl = g_async_queue_pop (fc->lines), fl->text) {
+		gchar *response;
+		gint64 now;
+
+		now = g_get_monotonic_time ();
+		if (fl->arrival + server->latency > now)
+			g_usleep (fl->arrival + server->latency - now);
+
+		response = fake_server_respond (server, fl->text);
+
+		if (can_write)
+			can_write = g_output_stream_write_all (output_stream, response, strlen (response), NULL, NULL, NULL);
+
+		g_mutex_lock (&server->lock);
+		server->in_flight--;
+		g_mutex_unlock (&server->lock);
+
+		g_free (response);
+		g_free (fl->text);
+		g_free (fl);
+	}
+
+	g_free (fl);
+
+	g_io_stream_close (G_IO_STREAM (fc->connection), NULL, NULL);
+	g_thread_join (reader);
+
+	g_async_queue_unref (fc->lines);
+	g_object_unref (fc->connection);
+	g_free (fc);
+
+	return NULL;
+}
+
+static gpointer
+fake_server_accept_thread (gpointer user_data)
+{
+	FakeServer *server = user_data;
+	GSocketConnection *connection;
+
+	while ((connection = g_socket_listener_accept (server->listener, NULL, server->cancellable, NULL)) != NULL) {
+		FakeConnection *fc;
+		GThread *writer;
+
+		fc = g_new0 (FakeConnection, 1);
+		fc->server = server;
+		fc->connection = connection;
+		fc->lines = g_async_queue_new ();
+
+		writer = g_thread_new ("fake-imap-writer", fake_connection_writer_thread, fc);
+
+		g_mutex_lock (&server->lock);
+		server->n_connections++;
+		server->threads = g_slist_prepend (server->threads, writer);
+		g_mutex_unlock (&server->lock);
+	}
+
+	return NULL;
+}
+
+static FakeServer *
+fake_server_new (gulong latency_ms)
+{
+	FakeServer *server;
+	GInetAddress *inet_address;
+	GSocketAddress *address, *effective_address = NULL;
+	GError *error = NULL;
+	guint ii;
+
+	server = g_new0 (FakeServer, 1);
+	server->latency = latency_ms * 1000;
+	server->cancellable = g_cancellable_new ();
+	server->listener = g_socket_listener_new ();
+	g_mutex_init (&server->lock);
+
+	server->mailboxes[0] = g_strdup ("INBOX");
+	for (ii = 1; ii <= N_FOLDERS; ii++)
+		server->mailboxes[ii] = g_strdup_printf ("Folder%02u", ii);
+
+	inet_address = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+	address = g_inet_socket_address_new (inet_address, 0);
+
+	g_socket_listener_add_address (
+		server->listener, address, G_SOCKET_TYPE_STREAM,
+		G_SOCKET_PROTOCOL_TCP, NULL, &effective_address, &error);
+	g_assert_no_error (error);
+
+	server->port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (effective_address));
+
+	g_object_unref (effective_address);
+	g_object_unref (address);
+	g_object_unref (inet_address);
+
+	server->accept_thread = g_thread_new ("fake-imap-accept", fake_server_accept_thread, server);
+
+	return server;
+}
+
+static void
+fake_server_free (FakeServer *server)
+{
+	GSList *link;
+	guint ii;
+
+	g_cancellable_cancel (server->cancellable);
+	g_thread_join (server->accept_thread);
+
+	for (link = server->threads; link; link = g_slist_next (link))
+		g_thread_join (link->data);
+
+	g_slist_free (server->threads);
+	g_socket_listener_close (server->listener);
+	g_object_unref (server->listener);
+	g_object_unref (server->cancellable);
+	g_mutex_clear (&server->lock);
+
+	for (ii = 0; ii <= N_FOLDERS; ii++)
+		g_free (server->mailboxes[ii]);
+
+	g_free (server);
+}
+
+/* The default authentication of CamelSession only warns */
+typedef struct _TestSession {
+	CamelSession parent;
+} TestSession;
+
+typedef struct _TestSessionClass {
+	CamelSessionClass parent_class;
+} TestSessionClass;
+
+GType test_session_get_type (void);
+
+G_DEFINE_TYPE (TestSession, test_session, CAMEL_TYPE_SESSION)
+
+static gboolean
+test_session_authenticate_sync (CamelSession *session,
+                                CamelService *service,
+                                const gchar *mechanism,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	return camel_service_authenticate_sync (service, mechanism, cancellable, error) == CAMEL_AUTHENTICATION_ACCEPTED;
+}
+
+static void
+test_session_class_init (TestSessionClass *class)
+{
+	CamelSessionClass *session_class;
+
+	session_class = CAMEL_SESSION_CLASS (class);
+	session_class->authenticate_sync = test_session_authenticate_sync;
+}
+
+static void
+test_session_init (TestSession *session)
+{
+}
+
+static void
+fixture_setup (Fixture *fixture,
+               gconstpointer user_data)
+{
+	CamelSettings *settings;
+	GError *error = NULL;
+
+	fixture->server = fake_server_new (GPOINTER_TO_UINT (user_data));
+	fixture->tmp_dir = g_dir_make_tmp ("test-imapx-pipeline-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	fixture->session = g_object_new (
+		test_session_get_type (),
+		"user-data-dir", fixture->tmp_dir,
+		"user-cache-dir", fixture->tmp_dir,
+		NULL);
+	camel_session_set_online (fixture->session, TRUE);
+
+	fixture->service = camel_session_add_service (
+		fixture->session, "test-imapx", "imapx",
+		CAMEL_PROVIDER_STORE, &error);
+	g_assert_no_error (error);
+	g_assert (CAMEL_IS_IMAPX_STORE (fixture->service));
+
+	settings = camel_service_ref_settings (fixture->service);
+	g_object_set (
+		settings,
+		"host", "127.0.0.1",
+		"port", (guint) fixture->server->port,
+		"user", "user",
+		"security-method", CAMEL_NETWORK_SECURITY_METHOD_NONE,
+		"concurrent-connections", 1,
+		"use-idle", FALSE,
+		NULL);
+	g_object_unref (settings);
+
+	camel_service_set_password (fixture->service, "password");
+
+	camel_service_connect_sync (fixture->service, NULL, &error);
+	g_assert_no_error (error);
+
+	fixture->conn_man = camel_imapx_store_get_conn_manager (CAMEL_IMAPX_STORE (fixture->service));
+
+	camel_imapx_conn_manager_list_sync (fixture->conn_man, "*", 0, NULL, &error);
+	g_assert_no_error (error);
+
+	/* Only the commands of the test itself count */
+	g_mutex_lock (&fixture->server->lock);
+	fixture->server->max_in_flight = 0;
+	fixture->server->n_status = 0;
+	g_mutex_unlock (&fixture->server->lock);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *child = g_build_filename (path, name, NULL);
+
+			remove_tree (child);
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+static void
+fixture_teardown (Fixture *fixture,
+                  gconstpointer user_data)
+{
+	camel_service_disconnect_sync (fixture->service, FALSE, NULL, NULL);
+
+	g_object_unref (fixture->service);
+	g_object_unref (fixture->session);
+
+	fake_server_free (fixture->server);
+
+	remove_tree (fixture->tmp_dir);
+	g_free (fixture->tmp_dir);
+}
+
+static GPtrArray *
+fixture_ref_mailboxes (Fixture *fixture,
+                       guint n_mailboxes)
+{
+	GPtrArray *mailboxes;
+	guint ii;
+
+	mailboxes = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (ii = 1; ii <= n_mailboxes; ii++) {
+		CamelIMAPXMailbox *mailbox;
+
+		mailbox = camel_imapx_store_ref_mailbox (CAMEL_IMAPX_STORE (fixture->service), fixture->server->mailboxes[ii]);
+		g_assert (mailbox != NULL);
+
+		g_ptr_array_add (mailboxes, mailbox);
+	}
+
+	return mailboxes;
+}
+
+static gboolean
+status_run_sync (CamelIMAPXJob *job,
+                 CamelIMAPXServer *server,
+                 GCancellable *cancellable,
+                 GError **error)
+{
+	return camel_imapx_server_status_sync (server, camel_imapx_job_get_user_data (job), 0, cancellable, error);
+}
+
+/* Asks for the status of the @mailboxes on one of the connections */
+static gboolean
+status_sync (Fixture *fixture,
+             GPtrArray *mailboxes,
+             GCancellable *cancellable,
+             GError **error)
+{
+	CamelIMAPXJob *job;
+	gboolean success;
+
+	job = camel_imapx_job_new (CAMEL_IMAPX_JOB_STATUS, NULL, status_run_sync, NULL, NULL);
+	camel_imapx_job_set_user_data (job, g_ptr_array_ref (mailboxes), (GDestroyNotify) g_ptr_array_unref);
+
+	success = camel_imapx_conn_manager_run_job_sync (fixture->conn_man, job, NULL, cancellable, error);
+
+	camel_imapx_job_unref (job);
+
+	return success;
+}
+
+static void
+test_status_pipelined (Fixture *fixture,
+                       gconstpointer user_data)
+{
+	GPtrArray *mailboxes;
+	gint64 started, elapsed;
+	GError *error = NULL;
+
+	mailboxes = fixture_ref_mailboxes (fixture, 8);
+
+	started = g_get_monotonic_time ();
+	status_sync (fixture, mailboxes, NULL, &error);
+	elapsed = g_get_monotonic_time () - started;
+
+	g_assert_no_error (error);
+	g_assert_cmpuint (fixture->server->n_status, ==, 8);
+	g_assert_cmpuint (fixture->server->max_in_flight, >, 1);
+
+	/* One by one it would take 8 round-trips */
+	g_assert_cmpint (elapsed, <, 4 * (gint64) fixture->server->latency);
+
+	g_ptr_array_unref (mailboxes);
+}
+
+static gpointer
+cancel_later_thread (gpointer user_data)
+{
+	/* Half of the latency, thus the first window is in flight */
+	g_usleep (100 * 1000);
+
+	g_cancellable_cancel (user_data);
+
+	return NULL;
+}
+
+static void
+test_status_cancel (Fixture *fixture,
+                    gconstpointer user_data)
+{
+	GPtrArray *mailboxes;
+	GCancellable *cancellable;
+	GThread *thread;
+	GError *error = NULL;
+
+	mailboxes = fixture_ref_mailboxes (fixture, N_FOLDERS);
+	cancellable = g_cancellable_new ();
+
+	thread = g_thread_new ("cancel-later", cancel_later_thread, cancellable);
+
+	g_assert (!status_sync (fixture, mailboxes, cancellable, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_clear_error (&error);
+
+	g_thread_join (thread);
+	g_object_unref (cancellable);
+
+	g_assert_cmpuint (fixture->server->max_in_flight, >, 1);
+	g_assert_cmpuint (fixture->server->n_status, <, N_FOLDERS);
+
+	/* The responses of the cancelled commands were not read, thus
+	 * the connection cannot be used anymore and a new one is made */
+	status_sync (fixture, mailboxes, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (fixture->server->n_connections, ==, 2);
+
+	g_ptr_array_unref (mailboxes);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	gchar *providers_dir;
+	gint res;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* The provider is built into this program,
+	 * do not load the installed ones */
+	providers_dir = g_dir_make_tmp ("test-imapx-providers-XXXXXX", NULL);
+	g_assert (providers_dir != NULL);
+	g_setenv (EDS_CAMEL_PROVIDER_DIR, providers_dir, TRUE);
+
+	camel_init (providers_dir, FALSE);
+	camel_provider_init ();
+	camel_provider_module_init ();
+
+	g_test_add (
+		"/CamelIMAPXServer/StatusPipelined", Fixture, GUINT_TO_POINTER (100),
+		fixture_setup, test_status_pipelined, fixture_teardown);
+	g_test_add (
+		"/CamelIMAPXServer/StatusCancel", Fixture, GUINT_TO_POINTER (200),
+		fixture_setup, test_status_cancel, fixture_teardown);
+
+	res = g_test_run ();
+
+	g_rmdir (providers_dir);
+	g_free (providers_dir);
+
+	return res;
+}
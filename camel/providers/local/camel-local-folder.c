@@ -48,6 +48,9 @@
 #define PATH_MAX _POSIX_PATH_MAX
 #endif
 
+/* How many messages are indexed between index syncs */
+#define INDEX_BATCH_SIZE 32
+
 #define CAMEL_LOCAL_FOLDER_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_LOCAL_FOLDER, CamelLocalFolderPrivate))
@@ -61,6 +64,259 @@ enum {
 
 G_DEFINE_TYPE (CamelLocalFolder, camel_local_folder, CAMEL_TYPE_FOLDER)
 
+/* The uids queued for indexing are also appended to this file, thus
+ * they are indexed after a restart too; it is removed once the queue
+ * is empty */
+static gchar *
+local_folder_dup_index_pending_path (CamelLocalFolder *local_folder)
+{
+	return g_strconcat (local_folder->index_path, ".pending", NULL);
+}
+
+static void
+local_folder_index_text (CamelMimeFilter *filter_index,
+                         CamelDataWrapper *object,
+                         GCancellable *cancellable)
+{
+	CamelDataWrapper *containee;
+	CamelContentType *ct;
+	CamelStream *null_stream, *filter_stream;
+	const gchar *charset;
+	gint ii, n_parts;
+
+	containee = camel_medium_get_content (CAMEL_MEDIUM (object));
+	if (containee == NULL)
+		return;
+
+	if (CAMEL_IS_MULTIPART (containee)) {
+		n_parts = camel_multipart_get_number (CAMEL_MULTIPART (containee));
+		for (ii = 0; ii < n_parts; ii++) {
+			CamelMimePart *part;
+
+			part = camel_multipart_get_part (CAMEL_MULTIPART (containee), ii);
+			if (part != NULL)
+				local_folder_index_text (filter_index, CAMEL_DATA_WRAPPER (part), cancellable);
+		}
+		return;
+	}
+
+	if (CAMEL_IS_MIME_MESSAGE (containee)) {
+		local_folder_index_text (filter_index, containee, cancellable);
+		return;
+	}
+
+	ct = containee->mime_type;
+	if (!camel_content_type_is (ct, "text", "*"))
+		return;
+
+	null_stream = camel_stream_null_new ();
+	filter_stream = camel_stream_filter_new (null_stream);
+
+	/* the same filters the summary uses when indexing from a parser */
+	charset = camel_content_type_param (ct, "charset");
+	if (charset != NULL
+	    && g_ascii_strcasecmp (charset, "us-ascii") != 0
+	    && g_ascii_strcasecmp (charset, "utf-8") != 0) {
+		CamelMimeFilter *filter;
+
+		filter = camel_mime_filter_charset_new (charset, "UTF-8");
+		if (filter != NULL) {
+			camel_stream_filter_add (CAMEL_STREAM_FILTER (filter_stream), filter);
+			g_object_unref (filter);
+		}
+	}
+
+	if (camel_content_type_is (ct, "text", "html")) {
+		CamelMimeFilter *filter;
+
+		filter = camel_mime_filter_html_new ();
+		camel_stream_filter_add (CAMEL_STREAM_FILTER (filter_stream), filter);
+		g_object_unref (filter);
+	}
+
+	camel_stream_filter_add (CAMEL_STREAM_FILTER (filter_stream), filter_index);
+
+	camel_data_wrapper_decode_to_stream_sync (containee, filter_stream, cancellable, NULL);
+	camel_stream_flush (filter_stream, cancellable, NULL);
+
+	g_object_unref (filter_stream);
+	g_object_unref (null_stream);
+}
+
+static void
+local_folder_index_message (CamelLocalFolder *local_folder,
+                            const gchar *uid,
+                            GCancellable *cancellable)
+{
+	CamelFolder *folder = CAMEL_FOLDER (local_folder);
+	CamelMimeMessage *message;
+	CamelMimeFilter *filter_index;
+	CamelIndexName *name;
+
+	/* expunged meanwhile, or indexed by a summary check */
+	if (!camel_folder_summary_check_uid (folder->summary, uid) ||
+	    camel_index_has_name (local_folder->index, uid))
+		return;
+
+	message = camel_folder_get_message_sync (folder, uid, cancellable, NULL);
+	if (message == NULL)
+		return;
+
+	name = camel_index_add_name (local_folder->index, uid);
+	if (name != NULL) {
+		filter_index = camel_mime_filter_index_new (local_folder->index);
+		camel_mime_filter_index_set_name (CAMEL_MIME_FILTER_INDEX (filter_index), name);
+
+		local_folder_index_text (filter_index, CAMEL_DATA_WRAPPER (message), cancellable);
+
+		camel_mime_filter_index_set_name (CAMEL_MIME_FILTER_INDEX (filter_index), NULL);
+		g_object_unref (filter_index);
+
+		camel_index_write_name (local_folder->index, name);
+		g_object_unref (name);
+	}
+
+	g_object_unref (message);
+}
+
+/* Takes up to INDEX_BATCH_SIZE queued uids; when the queue is empty,
+ * all the earlier batches are in the index, thus the pending file
+ * is removed and the job finishes */
+static GPtrArray *
+local_folder_take_index_batch (CamelLocalFolder *local_folder,
+                               GCancellable *cancellable)
+{
+	CamelLocalFolderPrivate *priv = local_folder->priv;
+	GPtrArray *batch = NULL;
+	GHashTableIter iter;
+	gpointer key;
+
+	g_mutex_lock (&priv->index_lock);
+
+	if (g_hash_table_size (priv->index_pending) == 0) {
+		gchar *pending_path;
+
+		pending_path = local_folder_dup_index_pending_path (local_folder);
+		g_unlink (pending_path);
+		g_free (pending_path);
+	} else if (!g_cancellable_is_cancelled (cancellable)) {
+		batch = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_pstring_free);
+
+		g_hash_table_iter_init (&iter, priv->index_pending);
+		while (batch->len < INDEX_BATCH_SIZE && g_hash_table_iter_next (&iter, &key, NULL)) {
+			g_hash_table_iter_steal (&iter);
+			g_ptr_array_add (batch, key);
+		}
+	}
+
+	if (batch == NULL)
+		priv->index_job_running = FALSE;
+
+	g_mutex_unlock (&priv->index_lock);
+
+	return batch;
+}
+
+static void
+local_folder_index_job_cb (CamelSession *session,
+                           GCancellable *cancellable,
+                           gpointer user_data,
+                           GError **error)
+{
+	CamelLocalFolder *local_folder = user_data;
+	GPtrArray *batch;
+
+	while ((batch = local_folder_take_index_batch (local_folder, cancellable)) != NULL) {
+		guint ii;
+
+		for (ii = 0; ii < batch->len && !g_cancellable_is_cancelled (cancellable); ii++) {
+			local_folder_index_message (
+				local_folder, g_ptr_array_index (batch, ii), cancellable);
+		}
+
+		/* put back what was not indexed, to be picked by the next job */
+		if (ii < batch->len) {
+			g_mutex_lock (&local_folder->priv->index_lock);
+			for (; ii < batch->len; ii++) {
+				g_hash_table_add (
+					local_folder->priv->index_pending,
+					(gpointer) camel_pstring_strdup (g_ptr_array_index (batch, ii)));
+			}
+			g_mutex_unlock (&local_folder->priv->index_lock);
+		}
+
+		if (camel_index_sync (local_folder->index) == -1)
+			g_warning ("Could not sync index for %s: %s", local_folder->folder_path, g_strerror (errno));
+
+		g_ptr_array_free (batch, TRUE);
+	}
+}
+
+/* Call with index_lock held */
+static void
+local_folder_schedule_index_job (CamelLocalFolder *local_folder)
+{
+	CamelSession *session;
+	gchar *description;
+
+	if (local_folder->priv->index_job_running)
+		return;
+
+	session = camel_service_ref_session (CAMEL_SERVICE (camel_folder_get_parent_store (CAMEL_FOLDER (local_folder))));
+	if (session == NULL)
+		return;
+
+	local_folder->priv->index_job_running = TRUE;
+
+	description = g_strdup_printf (
+		_("Indexing messages in folder '%s'"),
+		camel_folder_get_full_name (CAMEL_FOLDER (local_folder)));
+
+	camel_session_submit_job (
+		session, description,
+		local_folder_index_job_cb,
+		g_object_ref (local_folder),
+		(GDestroyNotify) g_object_unref);
+
+	g_free (description);
+	g_object_unref (session);
+}
+
+/* Queues the uids left in the pending file by a previous session */
+static void
+local_folder_load_index_pending (CamelLocalFolder *local_folder)
+{
+	gchar *pending_path, *contents = NULL;
+	gchar **uids;
+	gint ii;
+
+	pending_path = local_folder_dup_index_pending_path (local_folder);
+
+	if (g_file_get_contents (pending_path, &contents, NULL, NULL)) {
+		uids = g_strsplit (contents, "\n", -1);
+
+		g_mutex_lock (&local_folder->priv->index_lock);
+
+		for (ii = 0; uids[ii] != NULL; ii++) {
+			if (*uids[ii] != '\0') {
+				g_hash_table_add (
+					local_folder->priv->index_pending,
+					(gpointer) camel_pstring_strdup (uids[ii]));
+			}
+		}
+
+		if (g_hash_table_size (local_folder->priv->index_pending) > 0)
+			local_folder_schedule_index_job (local_folder);
+
+		g_mutex_unlock (&local_folder->priv->index_lock);
+
+		g_strfreev (uids);
+		g_free (contents);
+	}
+
+	g_free (pending_path);
+}
+
 static void
 local_folder_set_property (GObject *object,
                            guint property_id,
@@ -143,6 +399,8 @@ local_folder_finalize (GObject *object)
 	camel_folder_change_info_free (local_folder->changes);
 
 	g_mutex_clear (&local_folder->priv->search_lock);
+	g_mutex_clear (&local_folder->priv->index_lock);
+	g_hash_table_destroy (local_folder->priv->index_pending);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_local_folder_parent_class)->finalize (object);
@@ -305,9 +563,15 @@ local_folder_delete (CamelFolder *folder)
 {
 	CamelLocalFolder *lf = (CamelLocalFolder *) folder;
 
+	gchar *pending_path;
+
 	if (lf->index)
 		camel_index_delete (lf->index);
 
+	pending_path = local_folder_dup_index_pending_path (lf);
+	g_unlink (pending_path);
+	g_free (pending_path);
+
 	CAMEL_FOLDER_CLASS (camel_local_folder_parent_class)->delete_ (folder);
 }
 
@@ -316,7 +580,7 @@ local_folder_rename (CamelFolder *folder,
                      const gchar *newname)
 {
 	CamelLocalFolder *lf = (CamelLocalFolder *) folder;
-	gchar *statepath;
+	gchar *statepath, *old_pending_path, *new_pending_path;
 	CamelLocalStore *ls;
 	CamelStore *parent_store;
 
@@ -327,11 +591,22 @@ local_folder_rename (CamelFolder *folder,
 
 	/* Sync? */
 
+	g_mutex_lock (&lf->priv->index_lock);
+
+	old_pending_path = local_folder_dup_index_pending_path (lf);
+
 	g_free (lf->folder_path);
 	g_free (lf->index_path);
 
 	lf->folder_path = camel_local_store_get_full_path (ls, newname);
 	lf->index_path = camel_local_store_get_meta_path (ls, newname, ".ibex");
+
+	new_pending_path = local_folder_dup_index_pending_path (lf);
+	g_rename (old_pending_path, new_pending_path);
+	g_free (old_pending_path);
+	g_free (new_pending_path);
+
+	g_mutex_unlock (&lf->priv->index_lock);
 	statepath = camel_local_store_get_meta_path (ls, newname, ".cmeta");
 	camel_object_set_state_filename (CAMEL_OBJECT (lf), statepath);
 	g_free (statepath);
@@ -509,6 +784,10 @@ camel_local_folder_init (CamelLocalFolder *local_folder)
 
 	local_folder->priv = CAMEL_LOCAL_FOLDER_GET_PRIVATE (local_folder);
 	g_mutex_init (&local_folder->priv->search_lock);
+	g_mutex_init (&local_folder->priv->index_lock);
+	local_folder->priv->index_pending = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) camel_pstring_free, NULL);
 
 	folder->folder_flags |= CAMEL_FOLDER_HAS_SUMMARY_CAPABILITY;
 
@@ -603,8 +882,6 @@ camel_local_folder_construct (CamelLocalFolder *lf,
 	 * the old-format 'ibex' files that might be lying around */
 	g_unlink (lf->index_path);
 
-	/* FIXME: Need to run indexing off of the setv method */
-
 	/* if we have no/invalid index file, force it */
 	forceindex = camel_text_index_check (lf->index_path) == -1;
 	if (lf->flags & CAMEL_STORE_FOLDER_BODY_INDEX) {
@@ -641,6 +918,9 @@ camel_local_folder_construct (CamelLocalFolder *lf,
 		}
 	}
 
+	if (lf->index != NULL)
+		local_folder_load_index_pending (lf);
+
 	/* TODO: This probably shouldn't be here? */
 	if ((flags & CAMEL_STORE_FOLDER_CREATE) != 0) {
 		CamelFolderInfo *fi;
@@ -679,6 +959,45 @@ camel_local_folder_set_index_body (CamelLocalFolder *local_folder,
 	g_object_notify (G_OBJECT (local_folder), "index-body");
 }
 
+/* Queues the message @uid for indexing in a background job, unless
+ * the folder has no body index */
+void
+camel_local_folder_queue_index (CamelLocalFolder *local_folder,
+                                const gchar *uid)
+{
+	gchar *pending_path;
+	gchar *line;
+	FILE *file;
+
+	g_return_if_fail (CAMEL_IS_LOCAL_FOLDER (local_folder));
+	g_return_if_fail (uid != NULL);
+
+	if (local_folder->index == NULL)
+		return;
+
+	g_mutex_lock (&local_folder->priv->index_lock);
+
+	if (!g_hash_table_contains (local_folder->priv->index_pending, uid)) {
+		g_hash_table_add (
+			local_folder->priv->index_pending,
+			(gpointer) camel_pstring_strdup (uid));
+
+		pending_path = local_folder_dup_index_pending_path (local_folder);
+		file = g_fopen (pending_path, "ab");
+		if (file != NULL) {
+			line = g_strconcat (uid, "\n", NULL);
+			fputs (line, file);
+			fclose (file);
+			g_free (line);
+		}
+		g_free (pending_path);
+	}
+
+	local_folder_schedule_index_job (local_folder);
+
+	g_mutex_unlock (&local_folder->priv->index_lock);
+}
+
 /* lock the folder, may be called repeatedly (with matching unlock calls),
  * with type the same or less than the first call */
 gint
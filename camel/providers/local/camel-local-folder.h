@@ -104,6 +104,8 @@ gboolean	camel_local_folder_get_index_body
 void		camel_local_folder_set_index_body
 						(CamelLocalFolder *local_folder,
 						 gboolean index_body);
+void		camel_local_folder_queue_index	(CamelLocalFolder *local_folder,
+						 const gchar *uid);
 
 /* Lock the folder for internal use.  May be called repeatedly */
 /* UNIMPLEMENTED */
@@ -22,9 +22,37 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
 
 #include "camel-local-private.h"
 
+/* How many files are read ahead of the one being summarised */
+#define PREFETCH_WINDOW 32
+
+/* Larger files are not read ahead, the caller reads them itself */
+#define PREFETCH_MAX_FILE_SIZE (1024 * 1024)
+
+typedef struct _PrefetchFile PrefetchFile;
+
+struct _PrefetchFile {
+	gchar *filename;
+	GBytes *content;
+	gboolean done;
+};
+
+struct _CamelLocalPrefetch {
+	GMutex lock;
+	GCond cond;
+	GThreadPool *pool;
+
+	PrefetchFile *files;
+	guint n_files;
+	guint next;	/* the file camel_local_prefetch_next() returns */
+	guint queued;	/* how many files were pushed to the pool */
+};
+
 gint
 camel_local_frompos_sort (gpointer enc,
                           gint len1,
@@ -52,3 +80,147 @@ camel_local_frompos_sort (gpointer enc,
 
 	return a1 - a2;
 }
+
+static void
+local_prefetch_read_thread (gpointer data,
+                            gpointer user_data)
+{
+	PrefetchFile *file = data;
+	CamelLocalPrefetch *prefetch = user_data;
+	GBytes *content = NULL;
+	struct stat st;
+
+	if (g_stat (file->filename, &st) == 0 && st.st_size <= PREFETCH_MAX_FILE_SIZE) {
+		gchar *contents = NULL;
+		gsize length = 0;
+
+		if (g_file_get_contents (file->filename, &contents, &length, NULL))
+			content = g_bytes_new_take (contents, length);
+	}
+
+	g_mutex_lock (&prefetch->lock);
+	file->content = content;
+	file->done = TRUE;
+	g_cond_broadcast (&prefetch->cond);
+	g_mutex_unlock (&prefetch->lock);
+}
+
+static void
+local_prefetch_queue (CamelLocalPrefetch *prefetch)
+{
+	while (prefetch->queued < prefetch->n_files &&
+	       prefetch->queued < prefetch->next + PREFETCH_WINDOW) {
+		g_thread_pool_push (
+			prefetch->pool,
+			&prefetch->files[prefetch->queued], NULL);
+		prefetch->queued++;
+	}
+}
+
+/**
+ * camel_local_prefetch_new:
+ * @path: a directory containing the files
+ * @names: (element-type utf8): file names within the @path
+ *
+ * Starts reading the @names files, in the given order, in a pool
+ * of worker threads.  Their content is then picked with
+ * camel_local_prefetch_next(), in the same order.  Only a limited
+ * number of files is read ahead, thus the memory use is bounded.
+ *
+ * Returns: a new #CamelLocalPrefetch, free it with camel_local_prefetch_free()
+ **/
+CamelLocalPrefetch *
+camel_local_prefetch_new (const gchar *path,
+                          GPtrArray *names)
+{
+	CamelLocalPrefetch *prefetch;
+	guint ii;
+
+	g_return_val_if_fail (path != NULL, NULL);
+	g_return_val_if_fail (names != NULL, NULL);
+
+	prefetch = g_new0 (CamelLocalPrefetch, 1);
+	g_mutex_init (&prefetch->lock);
+	g_cond_init (&prefetch->cond);
+
+	prefetch->n_files = names->len;
+	prefetch->files = g_new0 (PrefetchFile, names->len);
+
+	for (ii = 0; ii < names->len; ii++) {
+		prefetch->files[ii].filename = g_build_filename (
+			path, g_ptr_array_index (names, ii), NULL);
+	}
+
+	prefetch->pool = g_thread_pool_new (
+		local_prefetch_read_thread, prefetch,
+		CLAMP (g_get_num_processors (), 2, 8), FALSE, NULL);
+
+	local_prefetch_queue (prefetch);
+
+	return prefetch;
+}
+
+/**
+ * camel_local_prefetch_next:
+ * @prefetch: a #CamelLocalPrefetch
+ *
+ * Waits for the next file to be read and returns its content.
+ * It is called once for each of the names given to
+ * camel_local_prefetch_new(), in the same order.
+ *
+ * Returns: (transfer full) (nullable): the content of the next file,
+ * or %NULL when it could not be read or is too large to be read ahead;
+ * the caller reads the file itself then
+ **/
+GBytes *
+camel_local_prefetch_next (CamelLocalPrefetch *prefetch)
+{
+	PrefetchFile *file;
+	GBytes *content;
+
+	g_return_val_if_fail (prefetch != NULL, NULL);
+	g_return_val_if_fail (prefetch->next < prefetch->n_files, NULL);
+
+	file = &prefetch->files[prefetch->next];
+
+	g_mutex_lock (&prefetch->lock);
+	while (!file->done)
+		g_cond_wait (&prefetch->cond, &prefetch->lock);
+	content = file->content;
+	file->content = NULL;
+	g_mutex_unlock (&prefetch->lock);
+
+	prefetch->next++;
+	local_prefetch_queue (prefetch);
+
+	return content;
+}
+
+/**
+ * camel_local_prefetch_free:
+ * @prefetch: a #CamelLocalPrefetch
+ *
+ * Stops reading the files not picked yet and frees the @prefetch.
+ **/
+void
+camel_local_prefetch_free (CamelLocalPrefetch *prefetch)
+{
+	guint ii;
+
+	if (prefetch == NULL)
+		return;
+
+	/* Drops the queued files and waits for those being read */
+	g_thread_pool_free (prefetch->pool, TRUE, TRUE);
+
+	for (ii = 0; ii < prefetch->n_files; ii++) {
+		g_free (prefetch->files[ii].filename);
+		if (prefetch->files[ii].content != NULL)
+			g_bytes_unref (prefetch->files[ii].content);
+	}
+
+	g_free (prefetch->files);
+	g_mutex_clear (&prefetch->lock);
+	g_cond_clear (&prefetch->cond);
+	g_free (prefetch);
+}
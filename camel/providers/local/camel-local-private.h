@@ -33,6 +33,10 @@ G_BEGIN_DECLS
 
 struct _CamelLocalFolderPrivate {
 	GMutex search_lock;	/* for locking the search object */
+
+	GMutex index_lock;	/* for the fields below */
+	GHashTable *index_pending; /* uids to index in the background, from the string pool */
+	gboolean index_job_running;
 };
 
 #define CAMEL_LOCAL_FOLDER_LOCK(f, l) \
@@ -46,6 +50,16 @@ gint		camel_local_frompos_sort	(gpointer enc,
 						 gint len2,
 						 gpointer data2);
 
+/* Reads message files of a directory-based folder in worker threads,
+ * ahead of the summary being built from them in the calling thread */
+typedef struct _CamelLocalPrefetch CamelLocalPrefetch;
+
+CamelLocalPrefetch *
+		camel_local_prefetch_new	(const gchar *path,
+						 GPtrArray *names);
+GBytes *	camel_local_prefetch_next	(CamelLocalPrefetch *prefetch);
+void		camel_local_prefetch_free	(CamelLocalPrefetch *prefetch);
+
 G_END_DECLS
 
 #endif /* CAMEL_LOCAL_PRIVATE_H */
@@ -31,6 +31,7 @@
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 
+#include "camel-local-folder.h"
 #include "camel-local-summary.h"
 
 #define w(x)
@@ -371,10 +372,24 @@ camel_local_summary_add (CamelLocalSummary *cls,
                          GError **error)
 {
 	CamelLocalSummaryClass *local_summary_class;
+	CamelFolder *folder;
+	CamelMessageInfo *mi;
 
 	local_summary_class = CAMEL_LOCAL_SUMMARY_GET_CLASS (cls);
 
-	return local_summary_class->add (cls, msg, info, ci, error);
+	/* Index the body in the background, thus adding a message
+	 * does not take longer with its size */
+	folder = camel_folder_summary_get_folder (CAMEL_FOLDER_SUMMARY (cls));
+	cls->index_defer = cls->index != NULL && CAMEL_IS_LOCAL_FOLDER (folder);
+
+	mi = local_summary_class->add (cls, msg, info, ci, error);
+
+	if (mi != NULL && cls->index_defer)
+		camel_local_folder_queue_index (CAMEL_LOCAL_FOLDER (folder), camel_message_info_uid (mi));
+
+	cls->index_defer = FALSE;
+
+	return mi;
 }
 
 /**
@@ -756,7 +771,7 @@ message_info_new_from_header (CamelFolderSummary *s,
 			doindex = TRUE;
 		}
 
-		if (cls->index
+		if (cls->index && !cls->index_defer
 		    && (doindex
 			|| cls->index_force
 			|| !camel_index_has_name (cls->index, camel_message_info_uid (mi)))) {
@@ -68,6 +68,7 @@ struct _CamelLocalSummary {
 	CamelIndex *index;
 	guint index_force:1; /* do we force index during creation? */
 	guint check_force:1; /* does a check force a full check? */
+	guint index_defer:1; /* leave indexing of added messages to the folder's queue */
 };
 
 struct _CamelLocalSummaryClass {
@@ -38,6 +38,7 @@
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 
+#include "camel-local-private.h"
 #include "camel-maildir-summary.h"
 
 #define CAMEL_MAILDIR_SUMMARY_GET_PRIVATE(obj) \
@@ -513,9 +514,11 @@ maildir_summary_load (CamelLocalSummary *cls,
 	return ret;
 }
 
+/* The @content is the file content, when it was read ahead already */
 static gint
 camel_maildir_summary_add (CamelLocalSummary *cls,
                            const gchar *name,
+                           GBytes *content,
                            gint forceindex,
                            GCancellable *cancellable)
 {
@@ -530,15 +533,22 @@ camel_maildir_summary_add (CamelLocalSummary *cls,
 
 	summary = CAMEL_FOLDER_SUMMARY (cls);
 
-	fd = open (filename, O_RDONLY | O_LARGEFILE);
-	if (fd == -1) {
-		g_warning ("Cannot summarise/index: %s: %s", filename, g_strerror (errno));
-		g_free (filename);
-		return -1;
-	}
 	mp = camel_mime_parser_new ();
 	camel_mime_parser_scan_from (mp, FALSE);
-	camel_mime_parser_init_with_fd (mp, fd);
+
+	if (content != NULL) {
+		camel_mime_parser_init_with_bytes (mp, content);
+	} else {
+		fd = open (filename, O_RDONLY | O_LARGEFILE);
+		if (fd == -1) {
+			g_warning ("Cannot summarise/index: %s: %s", filename, g_strerror (errno));
+			g_object_unref (mp);
+			g_free (filename);
+			return -1;
+		}
+		camel_mime_parser_init_with_fd (mp, fd);
+	}
+
 	if (cls->index && (forceindex || !camel_index_has_name (cls->index, name))) {
 		d (printf ("forcing indexing of message content\n"));
 		camel_folder_summary_set_index (summary, cls->index);
@@ -595,6 +605,7 @@ maildir_summary_check (CamelLocalSummary *cls,
 	gchar *uid;
 	struct _remove_data rd = { cls, changes };
 	GPtrArray *known_uids;
+	GPtrArray *add_names, *add_uids;
 
 	g_mutex_lock (&((CamelMaildirSummary *) cls)->priv->summary_lock);
 
@@ -634,6 +645,12 @@ maildir_summary_check (CamelLocalSummary *cls,
 		}
 	}
 
+	/* files to summarise, and the uids new to the summary, NULL for those
+	 * only being re-indexed; they are summarised after the scan, while
+	 * the following files are read ahead in worker threads */
+	add_names = g_ptr_array_new_with_free_func (g_free);
+	add_uids = g_ptr_array_new_with_free_func (g_free);
+
 	/* joy, use this to pre-count the total, so we can report progress meaningfully */
 	total = 0;
 	count = 0;
@@ -675,15 +692,15 @@ maildir_summary_check (CamelLocalSummary *cls,
 		info = camel_folder_summary_get ((CamelFolderSummary *) cls, uid);
 		if (info == NULL) {
 			/* must be a message incorporated by another client, this is not a 'recent' uid */
-			if (camel_maildir_summary_add (cls, d->d_name, forceindex, cancellable) == 0)
-				if (changes)
-					camel_folder_change_info_add_uid (changes, uid);
+			g_ptr_array_add (add_names, g_strdup (d->d_name));
+			g_ptr_array_add (add_uids, g_strdup (uid));
 		} else {
 			const gchar *filename;
 
 			if (cls->index && (!camel_index_has_name (cls->index, uid))) {
 				/* message_info_new will handle duplicates */
-				camel_maildir_summary_add (cls, d->d_name, forceindex, cancellable);
+				g_ptr_array_add (add_names, g_strdup (d->d_name));
+				g_ptr_array_add (add_uids, NULL);
 			}
 
 			mdi = (CamelMaildirMessageInfo *) info;
@@ -698,6 +715,35 @@ maildir_summary_check (CamelLocalSummary *cls,
 		g_free (uid);
 	}
 	closedir (dir);
+
+	if (add_names->len > 0) {
+		CamelLocalPrefetch *prefetch;
+
+		prefetch = camel_local_prefetch_new (cur, add_names);
+
+		for (i = 0; i < add_names->len; i++) {
+			GBytes *content;
+			const gchar *new_uid;
+
+			camel_operation_progress (cancellable, i * 100 / add_names->len);
+
+			content = camel_local_prefetch_next (prefetch);
+			new_uid = g_ptr_array_index (add_uids, i);
+
+			if (camel_maildir_summary_add (cls, g_ptr_array_index (add_names, i), content, forceindex, cancellable) == 0 &&
+			    new_uid != NULL && changes != NULL)
+				camel_folder_change_info_add_uid (changes, new_uid);
+
+			if (content != NULL)
+				g_bytes_unref (content);
+		}
+
+		camel_local_prefetch_free (prefetch);
+	}
+
+	g_ptr_array_free (add_names, TRUE);
+	g_ptr_array_free (add_uids, TRUE);
+
 	g_hash_table_foreach (left, (GHFunc) remove_summary, &rd);
 	g_hash_table_destroy (left);
 
@@ -755,7 +801,7 @@ maildir_summary_check (CamelLocalSummary *cls,
 			/* FIXME: This should probably use link/unlink */
 
 			if (g_rename (src, dest) == 0) {
-				camel_maildir_summary_add (cls, destfilename, forceindex, cancellable);
+				camel_maildir_summary_add (cls, destfilename, NULL, forceindex, cancellable);
 				if (changes) {
 					camel_folder_change_info_add_uid (changes, destname);
 					camel_folder_change_info_recent_uid (changes, destname);
@@ -148,9 +148,11 @@ mh_summary_next_uid_string (CamelFolderSummary *s)
 	return uidstr;
 }
 
+/* The @content is the file content, when it was read ahead already */
 static gint
 camel_mh_summary_add (CamelLocalSummary *cls,
                       const gchar *name,
+                      GBytes *content,
                       gint forceindex,
                       GCancellable *cancellable)
 {
@@ -165,15 +167,22 @@ camel_mh_summary_add (CamelLocalSummary *cls,
 
 	d (printf ("summarising: %s\n", name));
 
-	fd = open (filename, O_RDONLY | O_LARGEFILE);
-	if (fd == -1) {
-		g_warning ("Cannot summarise/index: %s: %s", filename, g_strerror (errno));
-		g_free (filename);
-		return -1;
-	}
 	mp = camel_mime_parser_new ();
 	camel_mime_parser_scan_from (mp, FALSE);
-	camel_mime_parser_init_with_fd (mp, fd);
+
+	if (content != NULL) {
+		camel_mime_parser_init_with_bytes (mp, content);
+	} else {
+		fd = open (filename, O_RDONLY | O_LARGEFILE);
+		if (fd == -1) {
+			g_warning ("Cannot summarise/index: %s: %s", filename, g_strerror (errno));
+			g_object_unref (mp);
+			g_free (filename);
+			return -1;
+		}
+		camel_mime_parser_init_with_fd (mp, fd);
+	}
+
 	if (cls->index && (forceindex || !camel_index_has_name (cls->index, name))) {
 		d (printf ("forcing indexing of message content\n"));
 		cls->index_force = TRUE;
@@ -221,6 +230,7 @@ mh_summary_check (CamelLocalSummary *cls,
 	gint i;
 	gboolean forceindex;
 	GPtrArray *known_uids;
+	GPtrArray *add_names;
 
 	/* FIXME: Handle changeinfo */
 
@@ -251,6 +261,10 @@ mh_summary_check (CamelLocalSummary *cls,
 	}
 	camel_folder_summary_free_array (known_uids);
 
+	/* files to summarise after the scan, while the following
+	 * ones are read ahead in worker threads */
+	add_names = g_ptr_array_new_with_free_func (g_free);
+
 	while ((d = readdir (dir))) {
 		/* FIXME: also run stat to check for regular file */
 		p = d->d_name;
@@ -273,7 +287,7 @@ mh_summary_check (CamelLocalSummary *cls,
 					camel_folder_summary_remove ((CamelFolderSummary *) cls, info);
 					camel_message_info_unref (info);
 				}
-				camel_mh_summary_add (cls, d->d_name, forceindex, cancellable);
+				g_ptr_array_add (add_names, g_strdup (d->d_name));
 			} else {
 				const gchar *uid = camel_message_info_uid (info);
 				CamelMessageInfo *old = g_hash_table_lookup (left, uid);
@@ -287,6 +301,27 @@ mh_summary_check (CamelLocalSummary *cls,
 		}
 	}
 	closedir (dir);
+
+	if (add_names->len > 0) {
+		CamelLocalPrefetch *prefetch;
+
+		prefetch = camel_local_prefetch_new (cls->folder_path, add_names);
+
+		for (i = 0; i < add_names->len; i++) {
+			GBytes *content;
+
+			content = camel_local_prefetch_next (prefetch);
+			camel_mh_summary_add (cls, g_ptr_array_index (add_names, i), content, forceindex, cancellable);
+
+			if (content != NULL)
+				g_bytes_unref (content);
+		}
+
+		camel_local_prefetch_free (prefetch);
+	}
+
+	g_ptr_array_free (add_names, TRUE);
+
 	g_hash_table_foreach (left, (GHFunc) remove_summary, cls);
 	g_hash_table_destroy (left);
 
@@ -466,6 +466,8 @@ nntp_folder_append_message_sync (CamelFolder *folder,
 		n = header->next;
 	}
 
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
+
 	nntp_stream = camel_nntp_store_ref_stream (nntp_store);
 
 	/* setup stream filtering */
@@ -512,6 +514,7 @@ nntp_folder_append_message_sync (CamelFolder *folder,
 	g_object_unref (filtered_stream);
 	g_free (group);
 	header->next = savedhdrs;
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 
 exit:
 	g_clear_object (&nntp_stream);
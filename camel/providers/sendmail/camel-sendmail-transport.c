@@ -223,6 +223,8 @@ sendmail_send_to_sync (CamelTransport *transport,
 		n = header->next;
 	}
 
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
+
 	if (pipe (fd) == -1) {
 		g_set_error (
 			error, G_IO_ERROR,
@@ -232,6 +234,7 @@ sendmail_send_to_sync (CamelTransport *transport,
 
 		/* restore the bcc headers */
 		header->next = savedbcc;
+		camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 		g_free (custom_binary);
 		g_free (custom_args);
 		g_ptr_array_free (argv_arr, TRUE);
@@ -260,6 +263,7 @@ sendmail_send_to_sync (CamelTransport *transport,
 
 		/* restore the bcc headers */
 		header->next = savedbcc;
+		camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 		g_free (custom_binary);
 		g_free (custom_args);
 		g_ptr_array_free (argv_arr, TRUE);
@@ -311,6 +315,7 @@ sendmail_send_to_sync (CamelTransport *transport,
 
 		/* restore the bcc headers */
 		header->next = savedbcc;
+		camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 		g_free (custom_binary);
 		g_free (custom_args);
 
@@ -327,6 +332,7 @@ sendmail_send_to_sync (CamelTransport *transport,
 
 	/* restore the bcc headers */
 	header->next = savedbcc;
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 
 	if (!WIFEXITED (wstat)) {
 		g_set_error (
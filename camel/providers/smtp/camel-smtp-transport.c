@@ -1714,6 +1714,8 @@ smtp_data (CamelSmtpTransport *transport,
 		n = header->next;
 	}
 
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
+
 	/* find out how large the message is... */
 	null = CAMEL_STREAM_NULL (camel_stream_null_new ());
 	camel_data_wrapper_write_to_stream_sync (
@@ -1747,6 +1749,7 @@ smtp_data (CamelSmtpTransport *transport,
 
 	/* restore the bcc headers */
 	header->next = savedbcc;
+	camel_mime_part_headers_changed (CAMEL_MIME_PART (message));
 
 	if (ret == -1) {
 		g_prefix_error (error, _("DATA command failed: "));
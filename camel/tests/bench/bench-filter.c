@@ -0,0 +1,188 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* CamelFilterDriver throughput */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "camel-test.h"
+#include "session.h"
+
+#include "bench.h"
+#include "corpus.h"
+
+static CamelSession *session;
+
+typedef struct _FilterData {
+	gchar *mbox;
+	CamelFilterDriver *driver;
+	GPtrArray *messages;
+	GPtrArray *infos;
+} FilterData;
+
+/* a typical rule set; actions which need no folder, thus the
+ * measurement is about matching, not about appending messages */
+static const struct {
+	const gchar *name;
+	const gchar *match;
+	const gchar *action;
+} rules[] = {
+	{ "list", "(match-all (header-exists \"List-Id\"))", "(set-label \"lists\")" },
+	{ "boss", "(match-all (header-contains \"from\" \"Grace Gardner\"))", "(set-system-flag \"Flagged\")" },
+	{ "team", "(match-all (header-contains \"cc\" \"team@example.com\"))", "(adjust-score 1)" },
+	{ "invoices", "(match-all (or (header-contains \"subject\" \"invoice\") (header-contains \"subject\" \"payment\")))", "(set-label \"finance\")" },
+	{ "replies", "(match-all (header-matches \"subject\" \"Re:\"))", "(set-score 2)" },
+	{ "rare", "(match-all (body-contains \"marker100x\"))", "(set-system-flag \"Seen\")" }
+};
+
+static void
+filter_teardown (gpointer data)
+{
+	FilterData *fd = data;
+
+	g_clear_object (&fd->driver);
+	if (fd->messages)
+		g_ptr_array_unref (fd->messages);
+	if (fd->infos)
+		g_ptr_array_unref (fd->infos);
+	g_remove (fd->mbox);
+	g_free (fd->mbox);
+	g_free (fd);
+}
+
+static gpointer
+filter_setup (const CamelBenchOptions *options,
+              GError **error)
+{
+	FilterData *fd;
+	gint ii;
+
+	fd = g_new0 (FilterData, 1);
+	fd->mbox = camel_bench_build_path (options, "filter.mbox", NULL);
+
+	if (!camel_bench_corpus_write_mbox (options, fd->mbox, error)) {
+		filter_teardown (fd);
+		return NULL;
+	}
+
+	fd->driver = camel_filter_driver_new (session);
+	for (ii = 0; ii < G_N_ELEMENTS (rules); ii++) {
+		camel_filter_driver_add_rule (fd->driver, rules[ii].name, rules[ii].match, rules[ii].action);
+	}
+
+	return fd;
+}
+
+/* parses and filters the whole mbox, like an incoming spool does */
+static gint64
+filter_run_mbox (gpointer data,
+                 const CamelBenchOptions *options,
+                 GError **error)
+{
+	FilterData *fd = data;
+
+	if (camel_filter_driver_filter_mbox (fd->driver, fd->mbox, NULL, NULL, error) == -1)
+		return -1;
+
+	return options->messages;
+}
+
+static gpointer
+filter_setup_messages (const CamelBenchOptions *options,
+                       GError **error)
+{
+	FilterData *fd;
+	gint ii;
+
+	fd = filter_setup (options, error);
+	if (!fd)
+		return NULL;
+
+	fd->messages = g_ptr_array_new_with_free_func (g_object_unref);
+	fd->infos = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_message_info_unref);
+
+	for (ii = 0; ii < options->messages; ii++) {
+		CamelMimeMessage *message;
+		CamelStream *stream;
+		gchar *text;
+
+		text = camel_bench_corpus_message (options, ii);
+		stream = camel_stream_mem_new_with_buffer (text, strlen (text));
+		g_free (text);
+
+		message = camel_mime_message_new ();
+		if (!camel_data_wrapper_construct_from_stream_sync (CAMEL_DATA_WRAPPER (message), stream, NULL, error)) {
+			g_object_unref (message);
+			g_object_unref (stream);
+			filter_teardown (fd);
+			return NULL;
+		}
+
+		g_object_unref (stream);
+
+		g_ptr_array_add (fd->messages, message);
+		g_ptr_array_add (fd->infos, camel_message_info_new_from_header (NULL, CAMEL_MIME_PART (message)->headers));
+	}
+
+	return fd;
+}
+
+/* filters already parsed messages, measuring only the rules */
+static gint64
+filter_run_messages (gpointer data,
+                     const CamelBenchOptions *options,
+                     GError **error)
+{
+	FilterData *fd = data;
+	guint ii;
+
+	for (ii = 0; ii < fd->messages->len; ii++) {
+		if (camel_filter_driver_filter_message (
+			fd->driver, g_ptr_array_index (fd->messages, ii),
+			g_ptr_array_index (fd->infos, ii), NULL, NULL,
+			"bench", "bench", NULL, error) == -1)
+			return -1;
+	}
+
+	return fd->messages->len;
+}
+
+static const CamelBenchScenario scenarios[] = {
+	{ "filter-mbox", "CamelFilterDriver over an mbox spool",
+	  filter_setup, filter_run_mbox, filter_teardown, "messages" },
+	{ "filter-message", "CamelFilterDriver rules on parsed messages",
+	  filter_setup_messages, filter_run_messages, filter_teardown, "messages" }
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	gchar *path;
+	gint ret;
+
+	camel_test_init (0, NULL);
+
+	path = g_build_filename (g_get_tmp_dir (), "camel-bench-session", NULL);
+	session = camel_test_session_new (path);
+	g_free (path);
+
+	ret = camel_bench_main (argc, argv, "filter", scenarios, G_N_ELEMENTS (scenarios));
+
+	g_object_unref (session);
+
+	return ret;
+}
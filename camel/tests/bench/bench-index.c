@@ -0,0 +1,181 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* CamelTextIndex build and lookup throughput */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include <camel/camel.h>
+
+#include "bench.h"
+#include "corpus.h"
+
+typedef struct _IndexData {
+	gchar *path;
+	GPtrArray *texts;
+	CamelIndex *index;
+} IndexData;
+
+/* looked up by the find scenario, from rare to common */
+static const gchar *lookup_words[] = {
+	"meeting", "project", "invoice", "weather", "coffee", "the", "message"
+};
+
+static void
+index_teardown (gpointer data)
+{
+	IndexData *id = data;
+
+	g_clear_object (&id->index);
+	camel_text_index_remove (id->path);
+	g_ptr_array_unref (id->texts);
+	g_free (id->path);
+	g_free (id);
+}
+
+static gpointer
+index_setup (const CamelBenchOptions *options,
+             GError **error)
+{
+	IndexData *id;
+	gint ii;
+
+	id = g_new0 (IndexData, 1);
+	id->path = camel_bench_build_path (options, "bench.ibex", NULL);
+	id->texts = g_ptr_array_new_with_free_func (g_free);
+
+	for (ii = 0; ii < options->messages; ii++) {
+		g_ptr_array_add (id->texts, camel_bench_corpus_message (options, ii));
+	}
+
+	return id;
+}
+
+static gint64
+index_build (IndexData *id,
+             GError **error)
+{
+	guint ii;
+
+	g_clear_object (&id->index);
+	camel_text_index_remove (id->path);
+
+	id->index = (CamelIndex *) camel_text_index_new (id->path, O_RDWR | O_CREAT | O_TRUNC);
+	if (!id->index) {
+		g_set_error (
+			error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"Cannot create index '%s': %s", id->path, g_strerror (errno));
+		return -1;
+	}
+
+	for (ii = 0; ii < id->texts->len; ii++) {
+		const gchar *text = g_ptr_array_index (id->texts, ii);
+		CamelIndexName *idn;
+		gchar name[16];
+
+		g_snprintf (name, sizeof (name), "%u", ii);
+
+		idn = camel_index_add_name (id->index, name);
+		camel_index_name_add_buffer (idn, text, strlen (text));
+		camel_index_name_add_buffer (idn, NULL, 0);
+		camel_index_write_name (id->index, idn);
+		g_object_unref (idn);
+	}
+
+	if (camel_index_sync (id->index) == -1) {
+		g_set_error (
+			error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+			"Cannot sync index '%s'", id->path);
+		return -1;
+	}
+
+	return id->texts->len;
+}
+
+static gint64
+index_run_build (gpointer data,
+                 const CamelBenchOptions *options,
+                 GError **error)
+{
+	return index_build (data, error);
+}
+
+static gpointer
+index_setup_built (const CamelBenchOptions *options,
+                   GError **error)
+{
+	IndexData *id;
+
+	id = index_setup (options, error);
+	if (id && index_build (id, error) < 0) {
+		index_teardown (id);
+		return NULL;
+	}
+
+	return id;
+}
+
+static gint64
+index_run_find (gpointer data,
+                const CamelBenchOptions *options,
+                GError **error)
+{
+	IndexData *id = data;
+	const gchar *markers[3];
+	gint64 lookups = 0;
+	gint ii;
+
+	markers[0] = camel_bench_corpus_word (100);
+	markers[1] = camel_bench_corpus_word (10);
+	markers[2] = camel_bench_corpus_word (2);
+
+	for (ii = 0; ii < G_N_ELEMENTS (markers) + G_N_ELEMENTS (lookup_words); ii++) {
+		CamelIndexCursor *cursor;
+		const gchar *word;
+
+		if (ii < G_N_ELEMENTS (markers))
+			word = markers[ii];
+		else
+			word = lookup_words[ii - G_N_ELEMENTS (markers)];
+
+		cursor = camel_index_find (id->index, word);
+		if (cursor) {
+			while (camel_index_cursor_next (cursor) != NULL)
+				;
+			g_object_unref (cursor);
+		}
+
+		lookups++;
+	}
+
+	return lookups;
+}
+
+static const CamelBenchScenario scenarios[] = {
+	{ "index-build", "CamelTextIndex build from raw messages",
+	  index_setup, index_run_build, index_teardown, "messages" },
+	{ "index-find", "CamelTextIndex word lookups with all matches",
+	  index_setup_built, index_run_find, index_teardown, "lookups" }
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	camel_init (g_get_tmp_dir (), FALSE);
+
+	return camel_bench_main (argc, argv, "index", scenarios, G_N_ELEMENTS (scenarios));
+}
@@ -0,0 +1,257 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* mime parser and message throughput */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <camel/camel.h>
+
+#include "bench.h"
+#include "corpus.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+typedef struct _MimeData {
+	gchar *mbox;
+	GPtrArray *messages;
+} MimeData;
+
+static void
+mime_teardown (gpointer data)
+{
+	MimeData *md = data;
+
+	if (md->messages)
+		g_ptr_array_unref (md->messages);
+	g_remove (md->mbox);
+	g_free (md->mbox);
+	g_free (md);
+}
+
+static gpointer
+mime_setup (const CamelBenchOptions *options,
+            GError **error)
+{
+	MimeData *md;
+
+	md = g_new0 (MimeData, 1);
+	md->mbox = camel_bench_build_path (options, "mime.mbox", NULL);
+
+	if (!camel_bench_corpus_write_mbox (options, md->mbox, error)) {
+		mime_teardown (md);
+		return NULL;
+	}
+
+	return md;
+}
+
+static CamelMimeParser *
+mime_open_parser (MimeData *md,
+                  GError **error)
+{
+	CamelMimeParser *mp;
+	gint fd;
+
+	fd = g_open (md->mbox, O_RDONLY | O_BINARY, 0);
+	if (fd == -1) {
+		g_set_error (
+			error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"Cannot open '%s': %s", md->mbox, g_strerror (errno));
+		return NULL;
+	}
+
+	mp = camel_mime_parser_new ();
+	camel_mime_parser_scan_from (mp, TRUE);
+	camel_mime_parser_init_with_fd (mp, fd);
+
+	return mp;
+}
+
+/* walks all the parts of all messages, without building any object */
+static gint64
+mime_run_scan (gpointer data,
+               const CamelBenchOptions *options,
+               GError **error)
+{
+	CamelMimeParser *mp;
+	CamelMimeParserState state;
+	gint64 count = 0;
+	gchar *buffer;
+	gsize len;
+
+	mp = mime_open_parser (data, error);
+	if (!mp)
+		return -1;
+
+	while ((state = camel_mime_parser_step (mp, &buffer, &len)) != CAMEL_MIME_PARSER_STATE_EOF) {
+		if (state == CAMEL_MIME_PARSER_STATE_FROM)
+			count++;
+	}
+
+	g_object_unref (mp);
+
+	return count;
+}
+
+static gint64
+mime_construct_messages (MimeData *md,
+                         GPtrArray *keep,
+                         GError **error)
+{
+	CamelMimeParser *mp;
+	gint64 count = 0;
+
+	mp = mime_open_parser (md, error);
+	if (!mp)
+		return -1;
+
+	while (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
+		CamelMimeMessage *message;
+
+		message = camel_mime_message_new ();
+		if (!camel_mime_part_construct_from_parser_sync (CAMEL_MIME_PART (message), mp, NULL, error)) {
+			g_object_unref (message);
+			g_object_unref (mp);
+			return -1;
+		}
+
+		if (keep)
+			g_ptr_array_add (keep, message);
+		else
+			g_object_unref (message);
+
+		count++;
+
+		/* skip over the FROM_END state */
+		camel_mime_parser_step (mp, NULL, NULL);
+	}
+
+	g_object_unref (mp);
+
+	return count;
+}
+
+static gint64
+mime_run_construct (gpointer data,
+                    const CamelBenchOptions *options,
+                    GError **error)
+{
+	return mime_construct_messages (data, NULL, error);
+}
+
+static gpointer
+mime_setup_messages (const CamelBenchOptions *options,
+                     GError **error)
+{
+	MimeData *md;
+
+	md = mime_setup (options, error);
+	if (!md)
+		return NULL;
+
+	md->messages = g_ptr_array_new_with_free_func (g_object_unref);
+	if (mime_construct_messages (md, md->messages, error) < 0) {
+		mime_teardown (md);
+		return NULL;
+	}
+
+	return md;
+}
+
+/* serializes the messages, which encodes all their parts */
+static gint64
+mime_run_write (gpointer data,
+                const CamelBenchOptions *options,
+                GError **error)
+{
+	MimeData *md = data;
+	CamelStream *stream;
+	guint ii;
+
+	stream = camel_stream_null_new ();
+
+	for (ii = 0; ii < md->messages->len; ii++) {
+		CamelDataWrapper *wrapper = g_ptr_array_index (md->messages, ii);
+
+		if (camel_data_wrapper_write_to_stream_sync (wrapper, stream, NULL, error) == -1) {
+			g_object_unref (stream);
+			return -1;
+		}
+	}
+
+	g_object_unref (stream);
+
+	return md->messages->len;
+}
+
+/* decodes the text of every part, like a preview or an index does */
+static gint64
+mime_run_decode (gpointer data,
+                 const CamelBenchOptions *options,
+                 GError **error)
+{
+	MimeData *md = data;
+	guint ii;
+
+	for (ii = 0; ii < md->messages->len; ii++) {
+		CamelMimePart *part = g_ptr_array_index (md->messages, ii);
+		CamelDataWrapper *content;
+
+		content = camel_medium_get_content (CAMEL_MEDIUM (part));
+		while (CAMEL_IS_MULTIPART (content) &&
+		       camel_multipart_get_number (CAMEL_MULTIPART (content)) > 0) {
+			part = camel_multipart_get_part (CAMEL_MULTIPART (content), 0);
+			content = camel_medium_get_content (CAMEL_MEDIUM (part));
+		}
+
+		if (content) {
+			CamelStream *stream;
+
+			stream = camel_stream_null_new ();
+			if (camel_data_wrapper_decode_to_stream_sync (content, stream, NULL, error) == -1) {
+				g_object_unref (stream);
+				return -1;
+			}
+			g_object_unref (stream);
+		}
+	}
+
+	return md->messages->len;
+}
+
+static const CamelBenchScenario scenarios[] = {
+	{ "parser-scan", "CamelMimeParser walk over an mbox",
+	  mime_setup, mime_run_scan, mime_teardown, "messages" },
+	{ "message-construct", "CamelMimeMessage construction from an mbox",
+	  mime_setup, mime_run_construct, mime_teardown, "messages" },
+	{ "message-write", "CamelMimeMessage serialization",
+	  mime_setup_messages, mime_run_write, mime_teardown, "messages" },
+	{ "message-decode", "Decoding of the first text part",
+	  mime_setup_messages, mime_run_decode, mime_teardown, "messages" }
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	camel_init (g_get_tmp_dir (), FALSE);
+
+	return camel_bench_main (argc, argv, "mime", scenarios, G_N_ELEMENTS (scenarios));
+}
@@ -0,0 +1,378 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* CamelDB writes, folder summary load and save, and folder searches */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "camel-test.h"
+#include "camel-test-provider.h"
+#include "session.h"
+
+#include "bench.h"
+#include "corpus.h"
+
+static const gchar *local_drivers[] = { "local" };
+
+static CamelSession *session;
+
+typedef struct _DBData {
+	CamelDB *cdb;
+	GPtrArray *records;
+} DBData;
+
+typedef struct _StoreData {
+	CamelStore *store;
+	CamelFolder *folder;
+	gint iteration;
+} StoreData;
+
+static void
+db_teardown (gpointer data)
+{
+	DBData *dd = data;
+
+	if (dd->cdb)
+		camel_db_close (dd->cdb);
+	g_ptr_array_unref (dd->records);
+	g_free (dd);
+}
+
+static gpointer
+db_setup (const CamelBenchOptions *options,
+          GError **error)
+{
+	DBData *dd;
+	gchar *path;
+	gint ii;
+
+	dd = g_new0 (DBData, 1);
+	dd->records = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_db_camel_mir_free);
+
+	path = camel_bench_build_path (options, "bench.db", NULL);
+	dd->cdb = camel_db_open (path, error);
+	g_free (path);
+
+	if (!dd->cdb ||
+	    camel_db_create_folders_table (dd->cdb, error) != 0 ||
+	    camel_db_prepare_message_info_table (dd->cdb, "bench", error) != 0) {
+		db_teardown (dd);
+		return NULL;
+	}
+
+	/* records with the summary values of the corpus messages */
+	for (ii = 0; ii < options->messages; ii++) {
+		CamelMIRecord *record;
+
+		record = g_new0 (CamelMIRecord, 1);
+		record->uid = g_strdup_printf ("%d", ii);
+		record->flags = ii % 3 ? CAMEL_MESSAGE_SEEN : 0;
+		record->read = ii % 3 != 0;
+		record->size = options->body_size + 1024;
+		record->dsent = 1400000000 + ii * 3600;
+		record->dreceived = record->dsent + 60;
+		record->subject = g_strdup_printf ("About %s %d", camel_bench_corpus_word (ii % 10 ? 2 : 10), ii);
+		record->from = g_strdup_printf ("User %d <user%d@example.com>", ii % 20, ii % 20);
+		record->to = g_strdup ("Team <team@example.com>");
+		record->cc = g_strdup ("");
+		record->mlist = g_strdup (ii % 4 ? "" : "bench.lists.example.com");
+		record->part = g_strdup_printf ("%d %d %d", ii + 1, 7, 0);
+		record->labels = g_strdup (ii % 13 ? "" : "important");
+		record->usertags = g_strdup (ii % 11 ? "0" : "1 4-tag 5-value");
+		record->cinfo = g_strdup ("");
+		record->bdata = g_strdup ("");
+		g_ptr_array_add (dd->records, record);
+	}
+
+	return dd;
+}
+
+/* rewrites all records in one transaction, like a summary save does */
+static gint64
+db_run_write (gpointer data,
+              const CamelBenchOptions *options,
+              GError **error)
+{
+	DBData *dd = data;
+	guint ii;
+
+	if (camel_db_begin_transaction (dd->cdb, error) != 0)
+		return -1;
+
+	for (ii = 0; ii < dd->records->len; ii++) {
+		if (camel_db_write_message_info_record (dd->cdb, "bench", g_ptr_array_index (dd->records, ii), error) != 0) {
+			camel_db_abort_transaction (dd->cdb, NULL);
+			return -1;
+		}
+	}
+
+	if (camel_db_end_transaction (dd->cdb, error) != 0)
+		return -1;
+
+	return dd->records->len;
+}
+
+static void
+store_teardown (gpointer data)
+{
+	StoreData *sd = data;
+
+	g_clear_object (&sd->folder);
+	if (sd->store) {
+		camel_session_remove_service (session, CAMEL_SERVICE (sd->store));
+		g_object_unref (sd->store);
+	}
+	g_free (sd);
+}
+
+/* an mbox store with one body-indexed folder holding the corpus */
+static gpointer
+store_setup (const CamelBenchOptions *options,
+             GError **error)
+{
+	static gint counter = 0;
+	StoreData *sd;
+	CamelService *service;
+	gchar *uid, *path, *uri, *mbox;
+
+	sd = g_new0 (StoreData, 1);
+
+	uid = g_strdup_printf ("bench-store-%d", ++counter);
+	path = camel_bench_build_path (options, uid, NULL);
+	g_mkdir_with_parents (path, 0700);
+
+	mbox = g_build_filename (path, "bench", NULL);
+	if (!camel_bench_corpus_write_mbox (options, mbox, error)) {
+		g_free (mbox);
+		g_free (path);
+		g_free (uid);
+		store_teardown (sd);
+		return NULL;
+	}
+	g_free (mbox);
+
+	uri = g_strconcat ("mbox://", path, NULL);
+	service = camel_session_add_service (session, uid, uri, CAMEL_PROVIDER_STORE, error);
+	g_free (uri);
+	g_free (path);
+	g_free (uid);
+
+	if (!service) {
+		store_teardown (sd);
+		return NULL;
+	}
+
+	sd->store = CAMEL_STORE (service);
+	sd->folder = camel_store_get_folder_sync (
+		sd->store, "bench", CAMEL_STORE_FOLDER_BODY_INDEX, NULL, error);
+
+	/* builds the summary and the body index from the mbox */
+	if (!sd->folder ||
+	    !camel_folder_refresh_info_sync (sd->folder, NULL, error) ||
+	    !camel_folder_synchronize_sync (sd->folder, FALSE, NULL, error)) {
+		store_teardown (sd);
+		return NULL;
+	}
+
+	return sd;
+}
+
+/* a fresh summary, loading all infos from the database */
+static gint64
+store_run_summary_load (gpointer data,
+                        const CamelBenchOptions *options,
+                        GError **error)
+{
+	StoreData *sd = data;
+	CamelFolderSummary *summary;
+	GPtrArray *uids;
+	gint64 count = 0;
+	guint ii;
+
+	summary = camel_folder_summary_new (sd->folder);
+
+	if (!camel_folder_summary_load_from_db (summary, error)) {
+		g_object_unref (summary);
+		return -1;
+	}
+
+	camel_folder_summary_prepare_fetch_all (summary, NULL);
+
+	uids = camel_folder_summary_get_array (summary);
+	for (ii = 0; ii < uids->len; ii++) {
+		CamelMessageInfo *info;
+
+		info = camel_folder_summary_get (summary, g_ptr_array_index (uids, ii));
+		if (info) {
+			camel_message_info_unref (info);
+			count++;
+		}
+	}
+	camel_folder_summary_free_array (uids);
+
+	g_object_unref (summary);
+
+	return count;
+}
+
+/* changes every info and saves them all */
+static gint64
+store_run_summary_save (gpointer data,
+                        const CamelBenchOptions *options,
+                        GError **error)
+{
+	StoreData *sd = data;
+	GPtrArray *uids;
+	gchar value[16];
+	guint ii;
+
+	g_snprintf (value, sizeof (value), "%d", ++sd->iteration);
+
+	uids = camel_folder_summary_get_array (sd->folder->summary);
+	for (ii = 0; ii < uids->len; ii++) {
+		CamelMessageInfo *info;
+
+		info = camel_folder_summary_get (sd->folder->summary, g_ptr_array_index (uids, ii));
+		if (info) {
+			camel_message_info_set_user_tag (info, "bench", value);
+			camel_message_info_unref (info);
+		}
+	}
+
+	if (!camel_folder_summary_save_to_db (sd->folder->summary, error)) {
+		camel_folder_summary_free_array (uids);
+		return -1;
+	}
+
+	ii = uids->len;
+	camel_folder_summary_free_array (uids);
+
+	return ii;
+}
+
+static gint64
+store_search (StoreData *sd,
+              const gchar *expression,
+              GError **error)
+{
+	GPtrArray *uids;
+
+	uids = camel_folder_search_by_expression (sd->folder, expression, NULL, error);
+	if (!uids)
+		return -1;
+
+	camel_folder_search_free (sd->folder, uids);
+
+	return 1;
+}
+
+static gint64
+store_run_search_flags (gpointer data,
+                        const CamelBenchOptions *options,
+                        GError **error)
+{
+	return store_search (data, "(match-all (not (system-flag \"Seen\")))", error);
+}
+
+static gint64
+store_run_search_header (gpointer data,
+                         const CamelBenchOptions *options,
+                         GError **error)
+{
+	gchar *expression;
+	gint64 ret;
+
+	expression = g_strdup_printf (
+		"(match-all (or (header-contains \"subject\" \"%s\") "
+		"(header-contains \"from\" \"Grace\")))",
+		camel_bench_corpus_word (10));
+	ret = store_search (data, expression, error);
+	g_free (expression);
+
+	return ret;
+}
+
+static gint64
+store_run_search_body (gpointer data,
+                       const CamelBenchOptions *options,
+                       GError **error)
+{
+	gchar *expression;
+	gint64 ret;
+
+	expression = g_strdup_printf (
+		"(match-all (body-contains \"%s\"))",
+		camel_bench_corpus_word (100));
+	ret = store_search (data, expression, error);
+	g_free (expression);
+
+	return ret;
+}
+
+static gint64
+store_run_thread (gpointer data,
+                          const CamelBenchOptions *options,
+                          GError **error)
+{
+	StoreData *sd = data;
+	GPtrArray *uids;
+	CamelFolderThread *thread;
+
+	uids = camel_folder_get_uids (sd->folder);
+	thread = camel_folder_thread_new (sd->folder, uids, TRUE);
+	camel_folder_thread_unref (thread);
+	camel_folder_free_uids (sd->folder, uids);
+
+	return 1;
+}
+
+static const CamelBenchScenario scenarios[] = {
+	{ "db-write", "CamelDB message info record writes",
+	  db_setup, db_run_write, db_teardown, "records" },
+	{ "summary-load", "Folder summary load with all infos",
+	  store_setup, store_run_summary_load, store_teardown, "messages" },
+	{ "summary-save", "Folder summary save of changed infos",
+	  store_setup, store_run_summary_save, store_teardown, "messages" },
+	{ "search-flags", "Folder search on system flags",
+	  store_setup, store_run_search_flags, store_teardown, "searches" },
+	{ "search-header", "Folder search on subject and sender",
+	  store_setup, store_run_search_header, store_teardown, "searches" },
+	{ "search-body", "Folder search in indexed message bodies",
+	  store_setup, store_run_search_body, store_teardown, "searches" },
+	{ "thread", "Threading of the whole folder",
+	  store_setup, store_run_thread, store_teardown, "folders" }
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	gchar *path;
+	gint ret;
+
+	camel_test_init (0, NULL);
+	camel_test_provider_init (1, local_drivers);
+
+	path = g_build_filename (g_get_tmp_dir (), "camel-bench-session", NULL);
+	session = camel_test_session_new (path);
+	g_free (path);
+
+	ret = camel_bench_main (argc, argv, "store", scenarios, G_N_ELEMENTS (scenarios));
+
+	g_object_unref (session);
+
+	return ret;
+}
@@ -0,0 +1,338 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "bench-common.h"
+#include "bench.h"
+
+typedef struct _BenchResult {
+	gint64 units;
+	BenchSummary summary;
+	gint64 peak_rss_kb;
+} BenchResult;
+
+static void
+bench_remove_recursive (const gchar *path)
+{
+	GDir *dir;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		const gchar *name;
+
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *child = g_build_filename (path, name, NULL);
+
+			bench_remove_recursive (child);
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+/**
+ * camel_bench_build_path:
+ * @options: benchmark options
+ * @first_element: first path element below the work directory
+ *
+ * Returns: a newly allocated path inside the work directory
+ **/
+gchar *
+camel_bench_build_path (const CamelBenchOptions *options,
+                        const gchar *first_element,
+                        ...)
+{
+	GString *path;
+	const gchar *element;
+	va_list ap;
+
+	path = g_string_new (options->workdir);
+
+	va_start (ap, first_element);
+	for (element = first_element; element; element = va_arg (ap, const gchar *)) {
+		g_string_append (path, G_DIR_SEPARATOR_S);
+		g_string_append (path, element);
+	}
+	va_end (ap);
+
+	return g_string_free (path, FALSE);
+}
+
+static gboolean
+bench_run_scenario (const CamelBenchScenario *scenario,
+                    const CamelBenchOptions *options,
+                    BenchResult *result,
+                    GError **error)
+{
+	gpointer data;
+	gdouble *times;
+	gint ii, n_times = 0;
+	gboolean success = TRUE;
+
+	memset (result, 0, sizeof (BenchResult));
+
+	data = scenario->setup ? scenario->setup (options, error) : NULL;
+	if (scenario->setup && !data)
+		return FALSE;
+
+	for (ii = 0; success && ii < options->warmup; ii++) {
+		if (scenario->run (data, options, error) < 0)
+			success = FALSE;
+	}
+
+	times = g_new0 (gdouble, options->iterations);
+
+	for (ii = 0; success && ii < options->iterations; ii++) {
+		gint64 started, units;
+
+		started = bench_timer_start ();
+		units = scenario->run (data, options, error);
+		times[ii] = bench_timer_elapsed_ms (started);
+
+		if (units < 0) {
+			success = FALSE;
+			break;
+		}
+
+		result->units += units;
+		n_times++;
+	}
+
+	if (scenario->teardown)
+		scenario->teardown (data);
+
+	bench_summarize (times, n_times, &result->summary);
+
+	result->peak_rss_kb = bench_peak_rss_kb ();
+
+	g_free (times);
+
+	return success;
+}
+
+static void
+bench_print_json (const gchar *suite,
+                  const CamelBenchScenario *scenario,
+                  const CamelBenchOptions *options,
+                  const BenchResult *result,
+                  const GError *error)
+{
+	const BenchSummary *summary = &result->summary;
+	GString *json;
+	gchar *charsets;
+
+	charsets = g_strjoinv (",", options->charsets);
+
+	json = bench_json_begin ();
+	bench_json_add_string (json, "suite", suite);
+	bench_json_add_string (json, "scenario", scenario->name);
+	bench_json_add_string (json, "unit", scenario->unit ? scenario->unit : "ops");
+	bench_json_add_int (json, "iterations", summary->n_samples);
+	bench_json_add_int (json, "units", result->units);
+	bench_json_add_double (json, "ops_per_sec", summary->total_ms > 0.0 ? result->units * 1000.0 / summary->total_ms : 0.0);
+	bench_json_add_double (json, "mean_ms", summary->n_samples > 0 ? summary->total_ms / summary->n_samples : 0.0);
+	bench_json_add_double (json, "p50_ms", summary->p50_ms);
+	bench_json_add_double (json, "p99_ms", summary->p99_ms);
+	bench_json_add_double (json, "min_ms", summary->min_ms);
+	bench_json_add_double (json, "max_ms", summary->max_ms);
+	bench_json_add_int (json, "peak_rss_kb", result->peak_rss_kb);
+	bench_json_add_int (json, "messages", options->messages);
+	bench_json_add_int (json, "body_size", options->body_size);
+	bench_json_add_int (json, "mime_depth", options->mime_depth);
+	bench_json_add_string (json, "charsets", charsets);
+	bench_json_add_int (json, "seed", options->seed);
+
+	if (error)
+		bench_json_add_string (json, "error", error->message);
+
+	bench_json_end (json);
+
+	g_free (charsets);
+}
+
+static void
+bench_print_text (const CamelBenchScenario *scenario,
+                  const BenchResult *result,
+                  const GError *error)
+{
+	if (error) {
+		printf ("%-28s FAILED: %s\n", scenario->name, error->message);
+		return;
+	}
+
+	printf (
+		"%-28s %12.1f %-10s %10.3f %10.3f %10.3f %10" G_GINT64_FORMAT "\n",
+		scenario->name,
+		result->summary.total_ms > 0.0 ? result->units * 1000.0 / result->summary.total_ms : 0.0,
+		scenario->unit ? scenario->unit : "ops",
+		result->summary.p50_ms, result->summary.p99_ms, result->summary.max_ms,
+		result->peak_rss_kb);
+}
+
+/**
+ * camel_bench_main:
+ * @argc: argument count
+ * @argv: arguments
+ * @suite: name of the benchmark suite, for the output
+ * @scenarios: scenarios of the suite
+ * @n_scenarios: number of @scenarios
+ *
+ * Parses the command line and runs the selected scenarios, each one
+ * first set up, then run the warm-up and the measured iterations, and
+ * finally torn down.  Results are printed as they are known.
+ *
+ * Returns: an exit code, non-zero when any scenario failed
+ **/
+gint
+camel_bench_main (gint argc,
+                  gchar **argv,
+                  const gchar *suite,
+                  const CamelBenchScenario *scenarios,
+                  guint n_scenarios)
+{
+	CamelBenchOptions options;
+	GOptionContext *context;
+	gboolean own_workdir = FALSE;
+	gint failed = 0;
+	guint ii;
+	GError *error = NULL;
+
+	memset (&options, 0, sizeof (CamelBenchOptions));
+	options.iterations = 10;
+	options.warmup = 1;
+	options.messages = 1000;
+	options.body_size = 4096;
+	options.mime_depth = 1;
+	options.seed = 1;
+
+	{
+		GOptionEntry entries[] = {
+			{ "iterations", 'i', 0, G_OPTION_ARG_INT, &options.iterations, "Measured runs of each scenario", "N" },
+			{ "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup, "Unmeasured runs before them", "N" },
+			{ "messages", 'n', 0, G_OPTION_ARG_INT, &options.messages, "Messages in the generated corpus", "N" },
+			{ "body-size", 's', 0, G_OPTION_ARG_INT, &options.body_size, "Approximate body size in bytes", "BYTES" },
+			{ "mime-depth", 'd', 0, G_OPTION_ARG_INT, &options.mime_depth, "Nesting of multiparts", "N" },
+			{ "charset", 'c', 0, G_OPTION_ARG_STRING_ARRAY, &options.charsets, "Charset of text parts, can repeat", "CHARSET" },
+			{ "seed", 0, 0, G_OPTION_ARG_INT, &options.seed, "Seed of the corpus generator", "N" },
+			{ "workdir", 0, 0, G_OPTION_ARG_FILENAME, &options.workdir, "Scratch directory", "DIR" },
+			{ "keep", 'k', 0, G_OPTION_ARG_NONE, &options.keep, "Do not remove the scratch directory", NULL },
+			{ "json", 'j', 0, G_OPTION_ARG_NONE, &options.json, "Print one JSON object per scenario", NULL },
+			{ "scenario", 0, 0, G_OPTION_ARG_STRING, &options.scenario, "Run scenarios whose name contains this", "NAME" },
+			{ "list", 'l', 0, G_OPTION_ARG_NONE, &options.list, "List scenarios and exit", NULL },
+			{ NULL }
+		};
+
+		context = g_option_context_new (NULL);
+		g_option_context_add_main_entries (context, entries, NULL);
+
+		if (!g_option_context_parse (context, &argc, &argv, &error)) {
+			g_printerr ("%s\n", error->message);
+			g_clear_error (&error);
+			g_option_context_free (context);
+			return 2;
+		}
+
+		g_option_context_free (context);
+	}
+
+	if (options.list) {
+		for (ii = 0; ii < n_scenarios; ii++) {
+			printf ("%-28s %s\n", scenarios[ii].name, scenarios[ii].description);
+		}
+
+		return 0;
+	}
+
+	if (options.iterations < 1)
+		options.iterations = 1;
+	if (options.warmup < 0)
+		options.warmup = 0;
+	if (options.messages < 1)
+		options.messages = 1;
+	if (options.body_size < 0)
+		options.body_size = 0;
+	if (options.mime_depth < 0)
+		options.mime_depth = 0;
+
+	if (!options.charsets || !*options.charsets) {
+		g_strfreev (options.charsets);
+		options.charsets = g_new0 (gchar *, 2);
+		options.charsets[0] = g_strdup ("UTF-8");
+	}
+
+	if (!options.workdir) {
+		options.workdir = g_dir_make_tmp ("camel-bench-XXXXXX", &error);
+		if (!options.workdir) {
+			g_printerr ("%s\n", error->message);
+			g_clear_error (&error);
+			return 2;
+		}
+
+		own_workdir = TRUE;
+	} else if (g_mkdir_with_parents (options.workdir, 0700) == -1) {
+		g_printerr ("Cannot create '%s': %s\n", options.workdir, g_strerror (errno));
+		return 2;
+	}
+
+	if (!options.json)
+		printf (
+			"%-28s %12s %-10s %10s %10s %10s %10s\n",
+			suite, "ops/s", "", "p50 ms", "p99 ms", "max ms", "rss kB");
+
+	for (ii = 0; ii < n_scenarios; ii++) {
+		const CamelBenchScenario *scenario = &scenarios[ii];
+		BenchResult result;
+
+		if (options.scenario && !strstr (scenario->name, options.scenario))
+			continue;
+
+		if (!bench_run_scenario (scenario, &options, &result, &error)) {
+			if (!error)
+				g_set_error_literal (&error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Unknown error");
+			failed++;
+		}
+
+		if (options.json)
+			bench_print_json (suite, scenario, &options, &result, error);
+		else
+			bench_print_text (scenario, &result, error);
+
+		fflush (stdout);
+		g_clear_error (&error);
+	}
+
+	/* only what we created, a given directory may hold other data */
+	if (own_workdir && !options.keep)
+		bench_remove_recursive (options.workdir);
+	else if (options.keep)
+		g_printerr ("Kept work directory '%s'\n", options.workdir);
+
+	g_strfreev (options.charsets);
+	g_free (options.workdir);
+	g_free (options.scenario);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* a small benchmark runner, measuring repeatable scenarios */
+
+#ifndef CAMEL_BENCH_H
+#define CAMEL_BENCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CamelBenchOptions CamelBenchOptions;
+typedef struct _CamelBenchScenario CamelBenchScenario;
+
+/* parameters of a run, from the command line; scenarios use them
+ * to generate their corpus, thus the same options give the same data */
+struct _CamelBenchOptions {
+	gint iterations;	/* measured runs of each scenario */
+	gint warmup;		/* unmeasured runs before them */
+	gint messages;		/* messages in the corpus */
+	gint body_size;		/* approximate size of a message body, in bytes */
+	gint mime_depth;	/* nesting of multiparts, 0 for single part messages */
+	gchar **charsets;	/* charsets of the text parts, used in turn */
+	gint seed;		/* seed of the corpus generator */
+	gchar *workdir;		/* scratch directory, removed afterwards unless --keep */
+	gboolean keep;
+	gboolean json;		/* one JSON object per line instead of a table */
+	gchar *scenario;	/* run only scenarios whose name contains this */
+	gboolean list;
+};
+
+struct _CamelBenchScenario {
+	const gchar *name;
+	const gchar *description;
+
+	/* prepares the scenario, outside of the measurement;
+	 * returns data passed to the other functions, or NULL with @error set */
+	gpointer	(*setup)	(const CamelBenchOptions *options,
+					 GError **error);
+	/* one measured operation; returns how many units it processed,
+	 * like messages or lookups, or -1 with @error set */
+	gint64		(*run)		(gpointer data,
+					 const CamelBenchOptions *options,
+					 GError **error);
+	void		(*teardown)	(gpointer data);
+
+	const gchar *unit;	/* what the units are, for the output */
+};
+
+gint		camel_bench_main		(gint argc,
+						 gchar **argv,
+						 const gchar *suite,
+						 const CamelBenchScenario *scenarios,
+						 guint n_scenarios);
+gchar *		camel_bench_build_path		(const CamelBenchOptions *options,
+						 const gchar *first_element,
+						 ...) G_GNUC_NULL_TERMINATED;
+
+G_END_DECLS
+
+#endif /* CAMEL_BENCH_H */
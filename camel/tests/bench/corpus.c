@@ -0,0 +1,492 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <camel/camel.h>
+
+#include "corpus.h"
+
+/* the corpus starts at this date, one message per hour */
+#define CORPUS_BASE_TIME 1400000000
+/* every n-th message starts a new thread, the others reply in it */
+#define CORPUS_THREAD_LENGTH 5
+
+static const gchar *words[] = {
+	"the", "message", "account", "meeting", "project", "report", "schedule",
+	"review", "budget", "release", "please", "thanks", "attached", "document",
+	"update", "question", "answer", "tomorrow", "yesterday", "office", "team",
+	"customer", "server", "network", "backup", "calendar", "contact", "folder",
+	"search", "index", "summary", "database", "invoice", "payment", "travel",
+	"hotel", "flight", "conference", "agenda", "minutes", "draft", "final",
+	"version", "change", "request", "issue", "ticket", "status", "priority",
+	"deadline", "weekend", "holiday", "coffee", "lunch", "dinner", "family",
+	"photo", "video", "music", "garden", "weather", "river", "mountain", "city"
+};
+
+static const gchar *names[] = {
+	"Alice Archer", "Bob Baker", "Carol Cooper", "Dave Draper", "Eve Evans",
+	"Frank Fisher", "Grace Gardner", "Heidi Hunter", "Ivan Ingram", "Judy Jones",
+	"Mallory Mason", "Niaj Nolan", "Olivia Owens", "Peggy Porter", "Rupert Reed",
+	"Sybil Stone", "Trent Turner", "Victor Vance", "Walter Ward", "Zoe Young"
+};
+
+/* non-ASCII words of each charset, in UTF-8 */
+static const struct {
+	const gchar *charset;
+	const gchar *words[4];
+} charset_words[] = {
+	{ "ISO-8859-1", { "caf\xc3\xa9", "na\xc3\xafve", "Gr\xc3\xbc\xc3\x9f" "e", "fa\xc3\xa7" "ade" } },
+	{ "ISO-8859-2", { "\xc5\xbc\xc3\xb3\xc5\x82w", "P\xc5\x99\xc3\xadli\xc5\xa1", "\xc4\x8f\xc3\xa1" "bel", "kr\xc3\xa1l" } },
+	{ "KOI8-R", { "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "\xd0\xbf\xd0\xb8\xd1\x81\xd1\x8c\xd0\xbc\xd0\xbe", "\xd0\xbf\xd0\xbe\xd1\x87\xd1\x82\xd0\xb0", "\xd0\xb4\xd0\xbe\xd0\xbc" } },
+	{ "ISO-2022-JP", { "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xe3\x83\xa1\xe3\x83\xbc\xe3\x83\xab", "\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88", "\xe4\xbc\x9a\xe8\xad\xb0" } },
+	{ "GB2312", { "\xe9\x82\xae\xe4\xbb\xb6", "\xe6\xb5\x8b\xe8\xaf\x95", "\xe4\xbc\x9a\xe8\xae\xae", "\xe6\x8a\xa5\xe5\x91\x8a" } },
+	{ "UTF-8", { "caf\xc3\xa9", "\xd0\xbf\xd0\xbe\xd1\x87\xd1\x82\xd0\xb0", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xce\xb1\xce\xb2\xce\xb3" } }
+};
+
+/* how often the marker words occur, see camel_bench_corpus_word() */
+static const gint markers[] = { 2, 10, 100 };
+
+const gchar *
+camel_bench_corpus_word (gint every)
+{
+	gchar *word;
+	const gchar *interned;
+
+	word = g_strdup_printf ("marker%dx", every);
+	interned = g_intern_string (word);
+	g_free (word);
+
+	return interned;
+}
+
+static const gchar *
+corpus_charset_word (const gchar *charset,
+                     GRand *rand)
+{
+	gint ii;
+
+	for (ii = 0; ii < G_N_ELEMENTS (charset_words); ii++) {
+		if (g_ascii_strcasecmp (charset, charset_words[ii].charset) == 0)
+			return charset_words[ii].words[g_rand_int_range (rand, 0, 4)];
+	}
+
+	/* unknown charsets get plain text */
+	return words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+}
+
+/* UTF-8 text of about @size bytes in lines of at most 72 characters */
+static gchar *
+corpus_text (const gchar *charset,
+             gint size,
+             gint index,
+             GRand *rand)
+{
+	GString *text;
+	gint line_len = 0, ii;
+
+	text = g_string_sized_new (size + 80);
+
+	for (ii = 0; ii < G_N_ELEMENTS (markers); ii++) {
+		if (index % markers[ii] == 0) {
+			g_string_append (text, camel_bench_corpus_word (markers[ii]));
+			g_string_append_c (text, ' ');
+		}
+	}
+
+	while (text->len < size) {
+		const gchar *word;
+		gint len;
+
+		if (g_rand_int_range (rand, 0, 8) == 0)
+			word = corpus_charset_word (charset, rand);
+		else
+			word = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+
+		len = strlen (word);
+		if (line_len + len > 72) {
+			g_string_append_c (text, '\n');
+			line_len = 0;
+		} else if (line_len > 0) {
+			g_string_append_c (text, ' ');
+			line_len++;
+		}
+
+		g_string_append (text, word);
+		line_len += len;
+	}
+
+	g_string_append_c (text, '\n');
+
+	return g_string_free (text, FALSE);
+}
+
+static void
+corpus_append_quoted_printable (GString *out,
+                                const gchar *in,
+                                gsize len)
+{
+	gint line_len = 0;
+	gsize ii;
+
+	for (ii = 0; ii < len; ii++) {
+		guchar c = in[ii];
+
+		if (c == '\n') {
+			g_string_append_c (out, '\n');
+			line_len = 0;
+			continue;
+		}
+
+		if (line_len >= 72) {
+			g_string_append (out, "=\n");
+			line_len = 0;
+		}
+
+		if (c == '=' || c > 126 || (c < 32 && c != '\t')) {
+			g_string_append_printf (out, "=%02X", c);
+			line_len += 3;
+		} else {
+			g_string_append_c (out, c);
+			line_len++;
+		}
+	}
+}
+
+static void
+corpus_append_base64 (GString *out,
+                      gint size,
+                      GRand *rand)
+{
+	guchar *data;
+	gchar *encoded;
+	gsize ii, len;
+
+	data = g_malloc (size);
+	for (ii = 0; ii < size; ii++)
+		data[ii] = g_rand_int_range (rand, 0, 256);
+
+	encoded = g_base64_encode (data, size);
+	len = strlen (encoded);
+
+	for (ii = 0; ii < len; ii += 76) {
+		g_string_append_len (out, encoded + ii, MIN (76, len - ii));
+		g_string_append_c (out, '\n');
+	}
+
+	g_free (encoded);
+	g_free (data);
+}
+
+static void
+corpus_append_text_part (GString *out,
+                         const gchar *charset,
+                         gint size,
+                         gint index,
+                         GRand *rand)
+{
+	gchar *text, *converted;
+	gsize len = 0;
+
+	text = corpus_text (charset, size, index, rand);
+
+	converted = g_convert (text, -1, charset, "UTF-8", NULL, &len, NULL);
+	if (!converted) {
+		charset = "UTF-8";
+		converted = text;
+		len = strlen (text);
+		text = NULL;
+	}
+
+	if (g_ascii_strcasecmp (charset, "ISO-2022-JP") == 0 ||
+	    g_ascii_strcasecmp (charset, "US-ASCII") == 0) {
+		g_string_append_printf (
+			out,
+			"Content-Type: text/plain; charset=\"%s\"\n"
+			"Content-Transfer-Encoding: 7bit\n\n",
+			charset);
+		g_string_append_len (out, converted, len);
+	} else if (index % 2) {
+		g_string_append_printf (
+			out,
+			"Content-Type: text/plain; charset=\"%s\"\n"
+			"Content-Transfer-Encoding: quoted-printable\n\n",
+			charset);
+		corpus_append_quoted_printable (out, converted, len);
+	} else {
+		g_string_append_printf (
+			out,
+			"Content-Type: text/plain; charset=\"%s\"\n"
+			"Content-Transfer-Encoding: 8bit\n\n",
+			charset);
+		g_string_append_len (out, converted, len);
+	}
+
+	g_free (converted);
+	g_free (text);
+}
+
+static void
+corpus_append_part (GString *out,
+                    const CamelBenchOptions *options,
+                    const gchar *charset,
+                    gint depth,
+                    gint size,
+                    gint index,
+                    GRand *rand)
+{
+	gchar *boundary;
+
+	if (depth <= 0) {
+		corpus_append_text_part (out, charset, size, index, rand);
+		return;
+	}
+
+	boundary = g_strdup_printf ("=-bench-%d-%d", depth, index);
+
+	g_string_append_printf (
+		out,
+		"Content-Type: multipart/mixed; boundary=\"%s\"\n\n"
+		"This is a multi-part message in MIME format.\n",
+		boundary);
+
+	g_string_append_printf (out, "--%s\n", boundary);
+	corpus_append_text_part (out, charset, size, index, rand);
+
+	g_string_append_printf (out, "\n--%s\n", boundary);
+	if (depth > 1) {
+		corpus_append_part (out, options, charset, depth - 1, size / 4, index, rand);
+	} else {
+		g_string_append_printf (
+			out,
+			"Content-Type: application/octet-stream; name=\"data%d.bin\"\n"
+			"Content-Disposition: attachment; filename=\"data%d.bin\"\n"
+			"Content-Transfer-Encoding: base64\n\n",
+			index, index);
+		corpus_append_base64 (out, MAX (size / 4, 16), rand);
+	}
+
+	g_string_append_printf (out, "\n--%s--\n", boundary);
+
+	g_free (boundary);
+}
+
+static void
+corpus_append_message_id (GString *out,
+                          const CamelBenchOptions *options,
+                          gint index)
+{
+	g_string_append_printf (out, "<%d.%d@bench.example.com>", index, options->seed);
+}
+
+gchar *
+camel_bench_corpus_message (const CamelBenchOptions *options,
+                            gint index)
+{
+	GString *out;
+	GRand *rand;
+	const gchar *charset;
+	gchar *subject, *encoded, *date;
+	gint from, to, ii, root;
+
+	/* each message has its own sequence, thus it does not depend
+	 * on which messages were generated before it */
+	rand = g_rand_new_with_seed (options->seed * 1000003 + index);
+
+	charset = options->charsets[index % g_strv_length (options->charsets)];
+	from = g_rand_int_range (rand, 0, G_N_ELEMENTS (names));
+	to = g_rand_int_range (rand, 0, G_N_ELEMENTS (names));
+
+	out = g_string_sized_new (options->body_size + 1024);
+
+	g_string_append_printf (
+		out, "From: %s <user%d@example.com>\n",
+		names[from], from);
+	g_string_append_printf (
+		out, "To: %s <user%d@example.com>\n",
+		names[to], to);
+	if (index % 3 == 0)
+		g_string_append_printf (
+			out, "Cc: %s <user%d@example.com>, team@example.com\n",
+			names[(from + to) % G_N_ELEMENTS (names)],
+			(from + to) % (gint) G_N_ELEMENTS (names));
+	if (index % 4 == 0)
+		g_string_append (out, "List-Id: Bench discussion <bench.lists.example.com>\n");
+
+	subject = g_strdup_printf (
+		"%s %s %s %d",
+		index % CORPUS_THREAD_LENGTH ? "Re:" : "About",
+		words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+		corpus_charset_word (charset, rand),
+		index - index % CORPUS_THREAD_LENGTH);
+	encoded = camel_header_encode_string ((const guchar *) subject);
+	g_string_append_printf (out, "Subject: %s\n", encoded);
+	g_free (encoded);
+	g_free (subject);
+
+	date = camel_header_format_date (CORPUS_BASE_TIME + index * 3600, 0);
+	g_string_append_printf (out, "Date: %s\n", date);
+	g_free (date);
+
+	g_string_append (out, "Message-ID: ");
+	corpus_append_message_id (out, options, index);
+	g_string_append_c (out, '\n');
+
+	root = index - index % CORPUS_THREAD_LENGTH;
+	if (root != index) {
+		g_string_append (out, "In-Reply-To: ");
+		corpus_append_message_id (out, options, index - 1);
+		g_string_append (out, "\nReferences:");
+		for (ii = root; ii < index; ii++) {
+			g_string_append (out, "\n ");
+			corpus_append_message_id (out, options, ii);
+		}
+		g_string_append_c (out, '\n');
+	}
+
+	g_string_append (out, "MIME-Version: 1.0\n");
+
+	corpus_append_part (out, options, charset, options->mime_depth, options->body_size, index, rand);
+
+	g_rand_free (rand);
+
+	return g_string_free (out, FALSE);
+}
+
+static gboolean
+corpus_write_file (const gchar *filename,
+                   const gchar *content,
+                   gboolean from_line,
+                   FILE *fp,
+                   GError **error)
+{
+	gboolean own_fp = fp == NULL;
+	gboolean success = TRUE;
+
+	if (own_fp) {
+		fp = g_fopen (filename, "wb");
+		if (!fp) {
+			g_set_error (
+				error, G_FILE_ERROR, g_file_error_from_errno (errno),
+				"Cannot write '%s': %s", filename, g_strerror (errno));
+			return FALSE;
+		}
+	}
+
+	if (from_line && fputs ("From bench@example.com Thu May 15 12:00:00 2014\n", fp) == EOF)
+		success = FALSE;
+
+	if (success && fputs (content, fp) == EOF)
+		success = FALSE;
+
+	/* mbox messages are separated by an empty line */
+	if (success && from_line && fputc ('\n', fp) == EOF)
+		success = FALSE;
+
+	if (own_fp && fclose (fp) != 0)
+		success = FALSE;
+
+	if (!success)
+		g_set_error (
+			error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"Cannot write '%s': %s", filename, g_strerror (errno));
+
+	return success;
+}
+
+gboolean
+camel_bench_corpus_write_mbox (const CamelBenchOptions *options,
+                               const gchar *filename,
+                               GError **error)
+{
+	FILE *fp;
+	gboolean success = TRUE;
+	gint ii;
+
+	fp = g_fopen (filename, "wb");
+	if (!fp) {
+		g_set_error (
+			error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"Cannot write '%s': %s", filename, g_strerror (errno));
+		return FALSE;
+	}
+
+	for (ii = 0; success && ii < options->messages; ii++) {
+		gchar *message;
+
+		message = camel_bench_corpus_message (options, ii);
+		success = corpus_write_file (filename, message, TRUE, fp, error);
+		g_free (message);
+	}
+
+	if (fclose (fp) != 0 && success) {
+		g_set_error (
+			error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"Cannot write '%s': %s", filename, g_strerror (errno));
+		success = FALSE;
+	}
+
+	return success;
+}
+
+gboolean
+camel_bench_corpus_write_maildir (const CamelBenchOptions *options,
+                                  const gchar *path,
+                                  GError **error)
+{
+	const gchar *subdirs[] = { "cur", "new", "tmp" };
+	gboolean success = TRUE;
+	gint ii;
+
+	for (ii = 0; ii < G_N_ELEMENTS (subdirs); ii++) {
+		gchar *dir = g_build_filename (path, subdirs[ii], NULL);
+
+		if (g_mkdir_with_parents (dir, 0700) == -1) {
+			g_set_error (
+				error, G_FILE_ERROR, g_file_error_from_errno (errno),
+				"Cannot create '%s': %s", dir, g_strerror (errno));
+			g_free (dir);
+			return FALSE;
+		}
+
+		g_free (dir);
+	}
+
+	for (ii = 0; success && ii < options->messages; ii++) {
+		gchar *message, *name, *filename;
+
+		/* every third message was not seen yet */
+		if (ii % 3 == 0)
+			name = g_strdup_printf ("new/%d.%d_%d.bench", CORPUS_BASE_TIME + ii * 3600, ii, options->seed);
+		else
+			name = g_strdup_printf ("cur/%d.%d_%d.bench:2,S", CORPUS_BASE_TIME + ii * 3600, ii, options->seed);
+
+		filename = g_build_filename (path, name, NULL);
+		message = camel_bench_corpus_message (options, ii);
+		success = corpus_write_file (filename, message, FALSE, NULL, error);
+
+		g_free (message);
+		g_free (filename);
+		g_free (name);
+	}
+
+	return success;
+}
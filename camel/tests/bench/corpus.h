@@ -0,0 +1,41 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* synthetic, repeatable mail corpora for the benchmarks */
+
+#ifndef CAMEL_BENCH_CORPUS_H
+#define CAMEL_BENCH_CORPUS_H
+
+#include "bench.h"
+
+G_BEGIN_DECLS
+
+/* the n-th message of the corpus described by the options, as raw
+ * RFC 5322 text; the same options always give the same message */
+gchar *		camel_bench_corpus_message	(const CamelBenchOptions *options,
+						 gint index);
+/* a word which occurs in roughly every n-th message, for searches */
+const gchar *	camel_bench_corpus_word		(gint every);
+
+gboolean	camel_bench_corpus_write_mbox	(const CamelBenchOptions *options,
+						 const gchar *filename,
+						 GError **error);
+gboolean	camel_bench_corpus_write_maildir
+						(const CamelBenchOptions *options,
+						 const gchar *path,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* CAMEL_BENCH_CORPUS_H */
@@ -0,0 +1,92 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  test3.c
+ *
+  Create a message with content larger than CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE,
+  save it, load it back and compare the content, in each transfer encoding.
+*/
+
+#include "camel-test.h"
+#include "messages.h"
+
+#include <unistd.h>
+#include <string.h>
+
+#define LARGE_TEXT_LEN (CAMEL_DATA_WRAPPER_MAX_MEMORY_SIZE + 12345)
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	CamelMimeMessage *msg, *msg2;
+	GByteArray *byte_array;
+	gchar *text, *p;
+	gint i;
+
+	camel_test_init (argc, argv);
+
+	srand (42);
+	p = text = g_malloc (LARGE_TEXT_LEN);
+	for (i = 0; i < LARGE_TEXT_LEN; i++) {
+		gint j = rand ();
+		if (j < RAND_MAX / 120)
+			*p++ = '\n';
+		else
+			*p++ = (j % 95) + 32;
+	}
+
+	camel_test_start ("Large content");
+
+	for (i = 0; i < CAMEL_TRANSFER_NUM_ENCODINGS; i++) {
+		push ("test large message, encoding %s", camel_transfer_encoding_to_string (i));
+		msg = test_message_create_simple ();
+
+		push ("set large content");
+		test_message_set_content_simple ((CamelMimePart *) msg, 1, "text/plain", text, LARGE_TEXT_LEN);
+		camel_mime_part_set_encoding ((CamelMimePart *) msg, i);
+		pull ();
+
+		push ("save message to test3.msg");
+		unlink ("test3.msg");
+		test_message_write_file (msg, "test3.msg");
+		check_unref (msg, 1);
+		pull ();
+
+		push ("read from test3.msg");
+		msg2 = test_message_read_file ("test3.msg");
+		pull ();
+
+		push ("compare read with original content");
+		test_message_compare_content (camel_medium_get_content ((CamelMedium *) msg2), text, LARGE_TEXT_LEN);
+		pull ();
+
+		push ("load the whole content into memory");
+		byte_array = camel_data_wrapper_get_byte_array (camel_medium_get_content ((CamelMedium *) msg2));
+		check (byte_array->len >= LARGE_TEXT_LEN);
+		test_message_compare_content (camel_medium_get_content ((CamelMedium *) msg2), text, LARGE_TEXT_LEN);
+		check_unref (msg2, 1);
+		pull ();
+
+		unlink ("test3.msg");
+		pull ();
+	}
+
+	camel_test_end ();
+
+	g_free (text);
+
+	return 0;
+}
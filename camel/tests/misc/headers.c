@@ -0,0 +1,133 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camel-test.h"
+
+static struct {
+	const gchar *name;
+	const gchar *value;
+} headers[] = {
+	{ "Received", "from a.example.com by b.example.com; Tue, 1 Mar 2016 10:00:00 +0100" },
+	{ "Received", "from c.example.com by a.example.com; Mon, 29 Feb 2016 10:00:00 +0000" },
+	{ "DKIM-Signature", "v=1; a=rsa-sha256; d=example.com" },
+	{ "Subject", " =?utf-8?q?caf=C3=A9?=" },
+	{ "From", "Joe Bloggs <joe@example.com>" },
+	{ "Date", "Tue, 1 Mar 2016 09:00:00 +0100" },
+	{ "subject", "second subject" },
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	struct _camel_header_raw *list = NULL, *unlinked;
+	CamelHeaderIndex *index;
+	CamelMimePart *part;
+	gchar *decoded;
+	const gchar *value, *again;
+	time_t date;
+	gint offset, i;
+
+	camel_test_init (argc, argv);
+
+	camel_test_start ("Indexed header lookup");
+
+	for (i = 0; i < G_N_ELEMENTS (headers); i++)
+		camel_header_raw_append (&list, headers[i].name, headers[i].value, i);
+
+	index = camel_header_index_new (list);
+
+	push ("case-insensitive lookup returns the first occurrence");
+	for (i = 0; i < G_N_ELEMENTS (headers); i++) {
+		const gchar *expect = camel_header_raw_find (&list, headers[i].name, NULL);
+
+		value = camel_header_index_find (index, headers[i].name, &offset);
+		check_msg (value == expect, "'%s' returned '%s'", headers[i].name, value);
+	}
+	check (camel_header_index_find (index, "RECEIVED", &offset) != NULL);
+	check (offset == 0);
+	check (camel_header_index_find (index, "X-Missing", NULL) == NULL);
+	pull ();
+
+	push ("decoded values are memoized");
+	value = camel_header_index_get_decoded (index, "Subject", NULL);
+	check_msg (string_equal (value, "caf\xc3\xa9"), "got '%s'", value);
+	again = camel_header_index_get_decoded (index, "SUBJECT", NULL);
+	check (value == again);
+	value = camel_header_index_get_address (index, "from", NULL);
+	check_msg (string_equal (value, "Joe Bloggs <joe@example.com>"), "got '%s'", value);
+	check (camel_header_index_get_decoded (index, "X-Missing", NULL) == NULL);
+	pull ();
+
+	push ("dates");
+	date = camel_header_index_get_date (index, "Date", &offset);
+	check (date == camel_header_decode_date (headers[5].value, NULL));
+	check (offset == 100);
+	date = camel_header_index_get_date (index, "Received", &offset);
+	check (date == camel_header_decode_date (strrchr (headers[0].value, ';') + 1, NULL));
+	check (camel_header_index_get_date (index, "X-Missing", NULL) == 0);
+	pull ();
+
+	camel_header_index_free (index);
+	camel_header_raw_clear (&list);
+
+	camel_test_end ();
+
+	camel_test_start ("Mime part header index");
+
+	part = camel_mime_part_new ();
+	camel_medium_set_header (CAMEL_MEDIUM (part), "Subject", headers[3].value);
+
+	push ("decoded values are copies");
+	decoded = camel_mime_part_dup_decoded_header (part, "subject", NULL);
+	check_msg (string_equal (decoded, "caf\xc3\xa9"), "got '%s'", decoded);
+	camel_medium_set_header (CAMEL_MEDIUM (part), "Subject", "changed");
+	check_msg (string_equal (decoded, "caf\xc3\xa9"), "got '%s'", decoded);
+	g_free (decoded);
+	pull ();
+
+	push ("changed headers are decoded again");
+	decoded = camel_mime_part_dup_decoded_header (part, "subject", NULL);
+	check_msg (string_equal (decoded, "changed"), "got '%s'", decoded);
+	g_free (decoded);
+	camel_medium_remove_header (CAMEL_MEDIUM (part), "Subject");
+	check (camel_mime_part_dup_decoded_header (part, "subject", NULL) == NULL);
+	pull ();
+
+	push ("directly modified headers");
+	camel_medium_add_header (CAMEL_MEDIUM (part), "X-First", "first");
+	camel_medium_add_header (CAMEL_MEDIUM (part), "Bcc", "joe@example.com");
+	check (camel_medium_get_header (CAMEL_MEDIUM (part), "Bcc") != NULL);
+	unlinked = part->headers->next;
+	part->headers->next = NULL;
+	camel_mime_part_headers_changed (part);
+	check (camel_medium_get_header (CAMEL_MEDIUM (part), "Bcc") == NULL);
+	part->headers->next = unlinked;
+	camel_mime_part_headers_changed (part);
+	check (camel_medium_get_header (CAMEL_MEDIUM (part), "Bcc") != NULL);
+	pull ();
+
+	g_object_unref (part);
+
+	camel_test_end ();
+
+	return 0;
+}
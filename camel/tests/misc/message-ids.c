@@ -0,0 +1,215 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <config.h>
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "camel-test.h"
+
+/* The 'part' column is "<hi> <lo> <count>" of the Message-ID,
+ * followed by <count> "<hi> <lo>" References, from parent to root */
+static struct {
+	const gchar *folder_name;
+	const gchar *uid;
+	const gchar *part;
+} records[] = {
+	{ "inbox", "1", "1 1 0" },
+	{ "inbox", "2", "2 2 1 1 1" },
+	{ "inbox", "3", "1 1 0" },
+	{ "inbox", "4", "4 4 0" },
+	{ "inbox", "5", "0 0 0" },
+	{ "sent", "10", "3 3 2 2 2 1 1" },
+	{ "sent", "11", "4 4 0" }
+};
+
+static gint
+read_messages_cb (gpointer user_data,
+                  gint ncol,
+                  gchar **cols,
+                  gchar **names)
+{
+	GPtrArray *messages = user_data;
+
+	/* camel_db_find_duplicate_message_ids() has the msgid first */
+	if (ncol == 3 && names[0] && g_str_equal (names[0], "msgid"))
+		cols++;
+
+	g_ptr_array_add (messages, g_strconcat (cols[0], "/", cols[1], NULL));
+
+	return 0;
+}
+
+static gint
+cmp_strings (gconstpointer a,
+             gconstpointer b)
+{
+	return strcmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+/* Returns "folder/uid" of the @messages, sorted and separated by spaces */
+static gchar *
+messages_to_string (GPtrArray *messages)
+{
+	GString *str;
+	guint ii;
+
+	g_ptr_array_sort (messages, cmp_strings);
+
+	str = g_string_new ("");
+	for (ii = 0; ii < messages->len; ii++) {
+		if (str->len)
+			g_string_append_c (str, ' ');
+		g_string_append (str, g_ptr_array_index (messages, ii));
+	}
+
+	g_ptr_array_set_size (messages, 0);
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+check_messages (GPtrArray *messages,
+                const gchar *expected)
+{
+	gchar *found;
+
+	found = messages_to_string (messages);
+	check_msg (g_str_equal (found, expected), "found '%s', expected '%s'", found, expected);
+	g_free (found);
+}
+
+static void
+write_record (CamelDB *cdb,
+              const gchar *folder_name,
+              const gchar *uid,
+              const gchar *part,
+              CamelMIRecordColumns unchanged)
+{
+	CamelMIRecord record = { 0 };
+	GError *error = NULL;
+
+	record.uid = (gchar *) uid;
+	record.part = (gchar *) part;
+	record.unchanged = unchanged;
+
+	camel_db_begin_transaction (cdb, NULL);
+	check (camel_db_write_message_info_record (cdb, folder_name, &record, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_end_transaction (cdb, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	CamelDB *cdb;
+	CamelSummaryMessageID mid;
+	GPtrArray *messages;
+	GError *error = NULL;
+	gchar *dirname, *filename;
+	gint i;
+
+	camel_test_init (argc, argv);
+
+	dirname = g_dir_make_tmp ("camel-message-ids-XXXXXX", &error);
+	check_msg (dirname != NULL, "%s", error ? error->message : "");
+	filename = g_build_filename (dirname, "folders.db", NULL);
+
+	cdb = camel_db_open (filename, &error);
+	check_msg (cdb != NULL, "%s", error ? error->message : "");
+	check (camel_db_create_folders_table (cdb, &error) == 0);
+	check (camel_db_prepare_message_info_table (cdb, "inbox", &error) == 0);
+	check (camel_db_prepare_message_info_table (cdb, "sent", &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_has_message_ids (cdb, "inbox"));
+	check (camel_db_has_message_ids (cdb, "sent"));
+
+	for (i = 0; i < G_N_ELEMENTS (records); i++) {
+		write_record (cdb, records[i].folder_name, records[i].uid, records[i].part, 0);
+	}
+
+	messages = g_ptr_array_new_with_free_func (g_free);
+
+	camel_test_start ("Message-ID lookups");
+
+	camel_test_push ("find message id");
+	mid.id.part.hi = 1;
+	mid.id.part.lo = 1;
+	check (camel_db_find_message_id (cdb, mid.id.id, FALSE, read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/3");
+	check (camel_db_find_message_id (cdb, mid.id.id, TRUE, read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/2 inbox/3 sent/10");
+	camel_test_pull ();
+
+	camel_test_push ("find related messages");
+	check (camel_db_find_related_messages (cdb, "inbox", "2", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/3 sent/10");
+	check (camel_db_find_related_messages (cdb, "sent", "10", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/2 inbox/3");
+	check (camel_db_find_related_messages (cdb, "inbox", "5", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "");
+	camel_test_pull ();
+
+	camel_test_push ("find duplicate message ids");
+	check (camel_db_find_duplicate_message_ids (cdb, "inbox", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/3");
+	check (camel_db_find_duplicate_message_ids (cdb, NULL, read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/3 inbox/4 sent/11");
+	camel_test_pull ();
+
+	camel_test_end ();
+
+	camel_test_start ("Message-ID table updates");
+
+	camel_test_push ("unchanged part");
+	write_record (cdb, "inbox", "2", "2 2 0", CAMEL_MI_RECORD_COLUMN_PART);
+	check (camel_db_find_related_messages (cdb, "inbox", "2", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "inbox/1 inbox/3 sent/10");
+	camel_test_pull ();
+
+	camel_test_push ("changed part");
+	write_record (cdb, "inbox", "2", "2 2 0", 0);
+	check (camel_db_find_related_messages (cdb, "inbox", "2", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "sent/10");
+	camel_test_pull ();
+
+	camel_test_push ("deleted message");
+	check (camel_db_delete_uid (cdb, "inbox", "3", &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_find_duplicate_message_ids (cdb, "inbox", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "");
+	camel_test_pull ();
+
+	camel_test_push ("renamed folder");
+	check (camel_db_rename_folder (cdb, "sent", "archive", &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_find_related_messages (cdb, "inbox", "2", read_messages_cb, messages, NULL) == 0);
+	check_messages (messages, "archive/10");
+	camel_test_pull ();
+
+	camel_test_end ();
+
+	g_ptr_array_unref (messages);
+	camel_db_close (cdb);
+
+	g_unlink (filename);
+	g_rmdir (dirname);
+	g_free (filename);
+	g_free (dirname);
+
+	return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <config.h>
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <camel/camel-search-sql-sexp.h>
+
+#include "camel-test.h"
+
+#define FOLDER_NAME "inbox"
+
+static struct {
+	const gchar *uid;
+	const gchar *labels;
+	const gchar *usertags;
+} records[] = {
+	{ "1", "work important", "2 5-label 4-work 5-score 1-5" },
+	{ "2", "personal", "1 5-label 8-personal" },
+	{ "3", NULL, "0" }
+};
+
+/* The expressions whose result is the same when evaluated
+ * on the 'labels' and 'usertags' columns */
+static struct {
+	const gchar *expr;
+	const gchar *uids;
+} search_tests[] = {
+	{ "(match-all (user-flag \"work\"))", "1" },
+	{ "(match-all (user-flag \"important\"))", "1" },
+	{ "(match-all (user-flag \"personal\"))", "2" },
+	{ "(match-all (user-flag \"later\"))", "" },
+	{ "(match-all (= (user-tag \"label\") \"work\"))", "1" },
+	{ "(match-all (= (user-tag \"label\") \"personal\"))", "2" },
+	{ "(match-all (or (user-flag \"personal\") (= (user-tag \"score\") \"5\")))", "1 2" },
+	{ "(match-all (and (user-flag \"work\") (= (user-tag \"label\") \"personal\")))", "" }
+};
+
+static gint
+read_uids_cb (gpointer user_data,
+              gint ncol,
+              gchar **cols,
+              gchar **names)
+{
+	GString *uids = user_data;
+
+	if (uids->len)
+		g_string_append_c (uids, ' ');
+	g_string_append (uids, cols[0] ? cols[0] : "");
+
+	return 0;
+}
+
+/* Returns the UIDs of the messages matching @expr, separated by spaces */
+static gchar *
+search_uids (CamelDB *cdb,
+             const gchar *expr,
+             gboolean with_message_tags,
+             gboolean with_header_index)
+{
+	GString *uids;
+	GError *error = NULL;
+	gchar *sql, *stmt;
+
+	sql = camel_sexp_to_sql_sexp_with_folder (expr, FOLDER_NAME, with_message_tags, with_header_index);
+	check_msg (sql != NULL, "'%s' was not translated", expr);
+	check_msg (
+		(strstr (sql, CAMEL_DB_LABELS_TABLE) || strstr (sql, CAMEL_DB_USERTAGS_TABLE)) == with_message_tags,
+		"'%s' translated to '%s'", expr, sql);
+
+	uids = g_string_new ("");
+	stmt = sqlite3_mprintf ("SELECT uid FROM %Q WHERE %s ORDER BY uid", FOLDER_NAME, sql);
+	camel_db_select (cdb, stmt, read_uids_cb, uids, &error);
+	check_msg (error == NULL, "'%s' failed: %s", stmt, error ? error->message : "");
+
+	sqlite3_free (stmt);
+	g_free (sql);
+
+	return g_string_free (uids, FALSE);
+}
+
+static void
+check_search (CamelDB *cdb,
+              const gchar *expr,
+              gboolean with_message_tags,
+              const gchar *expected)
+{
+	gchar *uids;
+
+	uids = search_uids (cdb, expr, with_message_tags, FALSE);
+	check_msg (g_str_equal (uids, expected), "'%s' found '%s', expected '%s'", expr, uids, expected);
+	g_free (uids);
+}
+
+static void
+check_header_search (CamelDB *cdb,
+                     const gchar *expr,
+                     const gchar *expected)
+{
+	gchar *uids;
+
+	uids = search_uids (cdb, expr, FALSE, TRUE);
+	check_msg (g_str_equal (uids, expected), "'%s' found '%s', expected '%s'", expr, uids, expected);
+	g_free (uids);
+}
+
+static void
+write_record (CamelDB *cdb,
+              const gchar *uid,
+              guint32 flags,
+              const gchar *labels,
+              const gchar *usertags,
+              CamelMIRecordColumns unchanged)
+{
+	CamelMIRecord record = { 0 };
+	GError *error = NULL;
+
+	record.uid = (gchar *) uid;
+	record.flags = flags;
+	record.labels = (gchar *) labels;
+	record.usertags = (gchar *) usertags;
+	record.unchanged = unchanged;
+
+	camel_db_begin_transaction (cdb, NULL);
+	check (camel_db_write_message_info_record (cdb, FOLDER_NAME, &record, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_end_transaction (cdb, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+}
+
+static void
+write_subject (CamelDB *cdb,
+               const gchar *uid,
+               guint32 flags,
+               const gchar *subject,
+               CamelMIRecordColumns unchanged)
+{
+	CamelMIRecord record = { 0 };
+	GError *error = NULL;
+
+	record.uid = (gchar *) uid;
+	record.flags = flags;
+	record.subject = (gchar *) subject;
+	record.unchanged = unchanged;
+
+	camel_db_begin_transaction (cdb, NULL);
+	check (camel_db_write_message_info_record (cdb, FOLDER_NAME, &record, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_end_transaction (cdb, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	CamelDB *cdb;
+	GError *error = NULL;
+	gchar *dirname, *filename;
+	gint i;
+
+	camel_test_init (argc, argv);
+
+	dirname = g_dir_make_tmp ("camel-search-sql-XXXXXX", &error);
+	check_msg (dirname != NULL, "%s", error ? error->message : "");
+	filename = g_build_filename (dirname, "folders.db", NULL);
+
+	cdb = camel_db_open (filename, &error);
+	check_msg (cdb != NULL, "%s", error ? error->message : "");
+	check (camel_db_create_folders_table (cdb, &error) == 0);
+	check (camel_db_prepare_message_info_table (cdb, FOLDER_NAME, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (camel_db_has_message_tags (cdb, FOLDER_NAME));
+
+	for (i = 0; i < G_N_ELEMENTS (records); i++) {
+		write_record (cdb, records[i].uid, 0, records[i].labels, records[i].usertags, 0);
+	}
+
+	camel_test_start ("Search SQL with label and user tag tables");
+
+	for (i = 0; i < G_N_ELEMENTS (search_tests); i++) {
+		camel_test_push ("search %d '%s'", i, search_tests[i].expr);
+		check_search (cdb, search_tests[i].expr, TRUE, search_tests[i].uids);
+		camel_test_pull ();
+	}
+
+	camel_test_push ("unset user tag");
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"\"))", TRUE, "3");
+	check_search (cdb, "(match-all (not (= (user-tag \"score\") \"\")))", TRUE, "1");
+	camel_test_pull ();
+
+	camel_test_end ();
+
+	camel_test_start ("Search SQL with label and user tag columns");
+
+	for (i = 0; i < G_N_ELEMENTS (search_tests); i++) {
+		camel_test_push ("search %d '%s'", i, search_tests[i].expr);
+		check_search (cdb, search_tests[i].expr, FALSE, search_tests[i].uids);
+		camel_test_pull ();
+	}
+
+	camel_test_end ();
+
+	camel_test_start ("Search SQL after changed labels and user tags");
+
+	camel_test_push ("flags changed only");
+	write_record (cdb, "3", 1, NULL, "0", 0);
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"\"))", TRUE, "3");
+	camel_test_pull ();
+
+	camel_test_push ("labels changed");
+	write_record (cdb, "1", 0, "important", records[0].usertags, 0);
+	check_search (cdb, "(match-all (user-flag \"work\"))", TRUE, "");
+	check_search (cdb, "(match-all (user-flag \"important\"))", TRUE, "1");
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"work\"))", TRUE, "1");
+	camel_test_pull ();
+
+	camel_test_push ("user tags changed");
+	write_record (cdb, "2", 0, "personal", "0", 0);
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"personal\"))", TRUE, "");
+	check_search (cdb, "(match-all (user-flag \"personal\"))", TRUE, "2");
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"\"))", TRUE, "2 3");
+	camel_test_pull ();
+
+	camel_test_push ("labels and user tags added");
+	write_record (cdb, "3", 1, "later", "1 5-label 5-later", 0);
+	check_search (cdb, "(match-all (user-flag \"later\"))", TRUE, "3");
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"later\"))", TRUE, "3");
+	camel_test_pull ();
+
+	camel_test_push ("labels and user tags marked unchanged");
+	write_record (
+		cdb, "3", 0, "later", "1 5-label 5-later",
+		CAMEL_MI_RECORD_COLUMN_LABELS | CAMEL_MI_RECORD_COLUMN_USERTAGS);
+	check_search (cdb, "(match-all (user-flag \"later\"))", TRUE, "3");
+	check_search (cdb, "(match-all (= (user-tag \"label\") \"later\"))", TRUE, "3");
+	camel_test_pull ();
+
+	camel_test_end ();
+
+	/* the SQLite library may have no FTS4 module */
+	write_subject (cdb, "1", 0, "Quarterly report", 0);
+	write_subject (cdb, "2", 0, "Weekly report draft", 0);
+	write_subject (cdb, "3", 0, "Lunch", 0);
+	check (camel_db_enable_header_index (cdb, NULL) == 0);
+	check (camel_db_build_header_index (cdb, FOLDER_NAME, &error) == 0);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+
+	if (camel_db_has_header_index (cdb, FOLDER_NAME)) {
+		camel_test_start ("Search SQL with header index");
+
+		camel_test_push ("built index");
+		check_header_search (cdb, "(match-all (header-has-words \"subject\" \"report\"))", "1 2");
+		check_header_search (cdb, "(match-all (header-contains \"subject\" \"REPORT d\"))", "2");
+		check_header_search (cdb, "(match-all (header-contains \"subject\" \"port\"))", "1 2");
+		camel_test_pull ();
+
+		camel_test_push ("headers marked unchanged");
+		write_subject (cdb, "1", 1, "Quarterly report", CAMEL_MI_RECORD_COLUMN_HEADERS);
+		check_header_search (cdb, "(match-all (header-has-words \"subject\" \"report\"))", "1 2");
+		camel_test_pull ();
+
+		camel_test_push ("headers changed");
+		write_subject (cdb, "2", 0, "Weekly summary", 0);
+		check_header_search (cdb, "(match-all (header-has-words \"subject\" \"report\"))", "1");
+		check_header_search (cdb, "(match-all (header-has-words \"subject\" \"summary\"))", "2");
+		camel_test_pull ();
+
+		camel_test_push ("new message");
+		write_subject (cdb, "4", 0, "Report of the week", 0);
+		check_header_search (cdb, "(match-all (header-has-words \"subject\" \"report\"))", "1 4");
+		camel_test_pull ();
+
+		camel_test_end ();
+	}
+
+	camel_db_close (cdb);
+
+	g_unlink (filename);
+	g_rmdir (dirname);
+	g_free (filename);
+	g_free (dirname);
+
+	return 0;
+}
@@ -15,14 +15,19 @@
 #include <config.h>
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <glib/gstdio.h>
 #include <camel/camel-search-private.h>
 
 #include "camel-test.h"
 
-/* TODO: should put utf8 stuff here too */
+/* Han characters, which are indexed as pairs */
+#define HAN_EAST "\xe6\x9d\xb1"
+#define HAN_CAPITAL "\xe4\xba\xac"
+#define HAN_CITY "\xe9\x83\xbd"
 
 static struct {
 	const gchar *word;
@@ -42,6 +47,9 @@ static struct {
 	{ "\"quoted gdouble \\\" escaped\"", 1, { { "quoted gdouble \" escaped", CAMEL_SEARCH_WORD_COMPLEX } } },
 	{ "\"quoted\\\"double\" \\\" escaped\\\"", 3, { { "quoted\"double", CAMEL_SEARCH_WORD_COMPLEX }, {"\"", CAMEL_SEARCH_WORD_COMPLEX}, { "escaped\"", CAMEL_SEARCH_WORD_COMPLEX } } },
 	{ "\\\"escaped", 1, { { "\"escaped", CAMEL_SEARCH_WORD_COMPLEX } } },
+	{ HAN_EAST HAN_CAPITAL, 1, { { HAN_EAST HAN_CAPITAL, CAMEL_SEARCH_WORD_SIMPLE | CAMEL_SEARCH_WORD_8BIT } } },
+	{ HAN_EAST HAN_CAPITAL HAN_CITY, 1, { { HAN_EAST HAN_CAPITAL HAN_CITY, CAMEL_SEARCH_WORD_SIMPLE | CAMEL_SEARCH_WORD_8BIT | CAMEL_SEARCH_WORD_NGRAM } } },
+	{ "to" HAN_EAST, 1, { { "to" HAN_EAST, CAMEL_SEARCH_WORD_SIMPLE | CAMEL_SEARCH_WORD_8BIT | CAMEL_SEARCH_WORD_NGRAM } } },
 
 };
 
@@ -61,14 +69,66 @@ static struct {
 	{ "compl;ex simple", 3, { { "compl", CAMEL_SEARCH_WORD_SIMPLE }, { "ex", CAMEL_SEARCH_WORD_SIMPLE }, { "simple", CAMEL_SEARCH_WORD_SIMPLE } } },
 	{ "\"quoted compl;ex\" simple", 4, { { "quoted", CAMEL_SEARCH_WORD_SIMPLE}, { "compl", CAMEL_SEARCH_WORD_SIMPLE }, { "ex", CAMEL_SEARCH_WORD_SIMPLE }, { "simple", CAMEL_SEARCH_WORD_SIMPLE } } },
 	{ "\\\" \"quoted\"compl;ex\" simple", 4, { { "quoted", CAMEL_SEARCH_WORD_SIMPLE}, { "compl", CAMEL_SEARCH_WORD_SIMPLE }, { "ex", CAMEL_SEARCH_WORD_SIMPLE }, { "simple", CAMEL_SEARCH_WORD_SIMPLE } } },
+	{ HAN_EAST HAN_CAPITAL HAN_CITY, 2, { { HAN_EAST HAN_CAPITAL, CAMEL_SEARCH_WORD_8BIT }, { HAN_CAPITAL HAN_CITY, CAMEL_SEARCH_WORD_8BIT } } },
+	{ "to" HAN_EAST HAN_CAPITAL "city", 3, { { "to", CAMEL_SEARCH_WORD_SIMPLE }, { HAN_EAST HAN_CAPITAL, CAMEL_SEARCH_WORD_8BIT }, { "city", CAMEL_SEARCH_WORD_SIMPLE } } },
+	{ "to" HAN_EAST, 2, { { "to", CAMEL_SEARCH_WORD_SIMPLE }, { HAN_EAST, CAMEL_SEARCH_WORD_8BIT } } },
 };
 
+/* The text is fed to the index in the given chunks, which end between
+ * characters of one run, and the words the index stores for it are
+ * the same as those camel_search_words_simple() makes of the text */
+static struct {
+	const gchar *text;
+	const gchar *chunks[4];
+} index_tests[] = {
+	{ HAN_EAST HAN_CAPITAL HAN_CITY, { HAN_EAST, HAN_CAPITAL, HAN_CITY } },
+	{ HAN_EAST HAN_CAPITAL HAN_CITY, { HAN_EAST HAN_CAPITAL, HAN_CITY } },
+	{ "to" HAN_EAST HAN_CAPITAL "city", { "to" HAN_EAST, HAN_CAPITAL "ci", "ty" } },
+	{ "x " HAN_EAST " y", { "x " HAN_EAST, " y" } },
+};
+
+static void
+check_index_words (CamelIndex *index,
+                   gint test)
+{
+	CamelIndexName *idn;
+	struct _camel_search_words *words, *tmp;
+	gint i;
+
+	idn = camel_index_add_name (index, "test");
+	check (idn != NULL);
+
+	for (i = 0; index_tests[test].chunks[i]; i++) {
+		camel_index_name_add_buffer (idn, index_tests[test].chunks[i], strlen (index_tests[test].chunks[i]));
+	}
+	camel_index_name_add_buffer (idn, NULL, 0);
+
+	tmp = camel_search_words_split ((const guchar *) index_tests[test].text);
+	words = camel_search_words_simple (tmp);
+
+	check_msg (
+		g_hash_table_size (idn->words) == words->len,
+		"indexed %d words, searched %d", g_hash_table_size (idn->words), words->len);
+
+	for (i = 0; i < words->len; i++) {
+		check_msg (
+			g_hash_table_contains (idn->words, words->words[i]->word),
+			"'%s' not indexed", words->words[i]->word);
+	}
+
+	camel_search_words_free (words);
+	camel_search_words_free (tmp);
+	g_object_unref (idn);
+}
+
 gint
 main (gint argc,
       gchar **argv)
 {
 	gint i, j;
 	struct _camel_search_words *words, *tmp;
+	CamelIndex *index;
+	gchar *dirname, *path;
 
 	camel_test_init (argc, argv);
 
@@ -120,5 +180,28 @@ main (gint argc,
 
 	camel_test_end ();
 
+	camel_test_start ("Search splitting - indexed words");
+
+	dirname = g_dir_make_tmp ("camel-split-XXXXXX", NULL);
+	check (dirname != NULL);
+	path = g_build_filename (dirname, "index", NULL);
+
+	index = (CamelIndex *) camel_text_index_new (path, O_RDWR | O_CREAT | O_TRUNC);
+	check (index != NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (index_tests); i++) {
+		camel_test_push ("index %d '%s'", i, index_tests[i].text);
+		check_index_words (index, i);
+		camel_test_pull ();
+	}
+
+	g_object_unref (index);
+	camel_text_index_remove (path);
+	g_rmdir (dirname);
+	g_free (path);
+	g_free (dirname);
+
+	camel_test_end ();
+
 	return 0;
 }
@@ -0,0 +1,145 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <config.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "camel-test.h"
+
+static gchar *
+dump_trace (void)
+{
+	gchar *filename, *contents = NULL;
+	GError *error = NULL;
+	gint fd;
+
+	fd = g_file_open_tmp ("camel-trace-XXXXXX.json", &filename, &error);
+	check_msg (fd != -1, "%s", error ? error->message : "");
+	close (fd);
+
+	check_msg (camel_trace_dump (filename, &error), "%s", error ? error->message : "");
+	check_msg (g_file_get_contents (filename, &contents, NULL, &error), "%s", error ? error->message : "");
+
+	g_unlink (filename);
+	g_free (filename);
+
+	return contents;
+}
+
+static guint
+count_events (const gchar *json)
+{
+	const gchar *ptr;
+	guint count = 0;
+
+	for (ptr = strstr (json, "\"ph\":\"X\""); ptr; ptr = strstr (ptr + 1, "\"ph\":\"X\""))
+		count++;
+
+	return count;
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	CamelTraceSpan span;
+	GError *error;
+	gchar *json;
+	gint i;
+
+	camel_test_init (argc, argv);
+
+	camel_test_start ("Trace spans");
+
+	camel_test_push ("disabled");
+	camel_trace_set_enabled (FALSE);
+	camel_trace_clear ();
+	camel_trace_span_begin (&span, "test", "disabled", NULL);
+	check (!camel_trace_span_is_active (&span));
+	camel_trace_span_end (&span, 10, NULL);
+	json = dump_trace ();
+	check_msg (count_events (json) == 0, "%s", json);
+	g_free (json);
+	camel_test_pull ();
+
+	camel_test_push ("results and escaping");
+	camel_trace_set_enabled (TRUE);
+
+	camel_trace_span_begin (&span, "test", "ok", "Inbox/\"quoted\"");
+	check (camel_trace_span_is_active (&span));
+	camel_trace_span_end (&span, 123, NULL);
+	check (!camel_trace_span_is_active (&span));
+
+	error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED, "cancelled");
+	camel_trace_span_begin (&span, "test", "cancel", NULL);
+	camel_trace_span_end (&span, -1, error);
+	g_clear_error (&error);
+
+	error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_FAILED, "failed");
+	camel_trace_span_begin (&span, "test", "fail", NULL);
+	camel_trace_span_end (&span, -1, error);
+	g_clear_error (&error);
+
+	json = dump_trace ();
+	check_msg (count_events (json) == 3, "%s", json);
+	check_msg (strstr (json, "\"folder\":\"Inbox/\\\"quoted\\\"\"") != NULL, "%s", json);
+	check_msg (strstr (json, "\"bytes\":123,\"result\":\"ok\"") != NULL, "%s", json);
+	check_msg (strstr (json, "\"result\":\"cancelled\"") != NULL, "%s", json);
+	check_msg (strstr (json, "\"result\":\"error\"") != NULL, "%s", json);
+	g_free (json);
+	camel_test_pull ();
+
+	camel_test_push ("copied names and cleared spans");
+	camel_trace_clear ();
+	{
+		gchar name[] = "job 1", folder[] = "folder 1";
+
+		camel_trace_span_begin (&span, "test", name, folder);
+		name[4] = '2';
+		folder[7] = '2';
+		camel_trace_span_end (&span, -1, NULL);
+	}
+	camel_trace_span_begin (&span, "test", "cleared", NULL);
+	camel_trace_span_clear (&span);
+	check (!camel_trace_span_is_active (&span));
+	camel_trace_span_end (&span, -1, NULL);
+	json = dump_trace ();
+	check_msg (count_events (json) == 1, "%s", json);
+	check_msg (strstr (json, "\"name\":\"job 1\"") != NULL, "%s", json);
+	check_msg (strstr (json, "\"folder\":\"folder 1\"") != NULL, "%s", json);
+	g_free (json);
+	camel_test_pull ();
+
+	camel_test_push ("ring buffer wraps");
+	camel_trace_clear ();
+	for (i = 0; i < CAMEL_TRACE_BUFFER_SIZE + 10; i++) {
+		camel_trace_span_begin (&span, "test", i < 10 ? "old" : "new", NULL);
+		camel_trace_span_end (&span, i, NULL);
+	}
+	json = dump_trace ();
+	check_msg (count_events (json) == CAMEL_TRACE_BUFFER_SIZE, "%u", count_events (json));
+	check (strstr (json, "\"name\":\"old\"") == NULL);
+	g_free (json);
+	camel_test_pull ();
+
+	camel_trace_set_enabled (FALSE);
+	camel_trace_clear ();
+
+	camel_test_end ();
+
+	return 0;
+}
@@ -235,6 +235,7 @@ struct _DataFactorySubprocessData {
 	gchar *uid;
 	gchar *module_filename;
 	gchar *subprocess_helpers_hash_key;
+	gint64 spawn_time;
 };
 
 static DataFactorySubprocessData *
@@ -589,6 +590,10 @@ data_factory_subprocess_appeared_cb (GDBusConnection *connection,
 
 	sd = user_data;
 
+	/* From spawning the subprocess until its bus name appeared */
+	e_metrics_timer_stop ("EDataFactory.subprocess-startup", sd->spawn_time);
+	sd->spawn_time = 0;
+
 	proxy = e_dbus_subprocess_backend_proxy_new_sync (
 		connection,
 		G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
@@ -1183,6 +1188,7 @@ data_factory_spawn_subprocess_backend (EDataFactory *data_factory,
 	EDataFactoryPrivate *priv;
 	GError *error = NULL;
 	GSubprocess *subprocess;
+	GSubprocessLauncher *launcher;
 	guint watched_id = 0;
 	gchar *backend_name = NULL;
 	gchar *subprocess_helpers_hash_key;
@@ -1279,8 +1285,18 @@ data_factory_spawn_subprocess_backend (EDataFactory *data_factory,
 		g_hash_table_insert (priv->subprocess_watched_ids, g_strdup (sd->bus_name), GUINT_TO_POINTER (watched_id));
 		g_mutex_unlock (&priv->subprocess_watched_ids_lock);
 
-		subprocess = g_subprocess_new (
-			G_SUBPROCESS_FLAGS_NONE,
+		launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+
+		/* The subprocess collects metrics when the factory does */
+		if (e_metrics_get_enabled ())
+			g_subprocess_launcher_setenv (launcher, "EDS_METRICS", "1", TRUE);
+		else
+			g_subprocess_launcher_unsetenv (launcher, "EDS_METRICS");
+
+		sd->spawn_time = e_metrics_timer_start ();
+
+		subprocess = g_subprocess_launcher_spawn (
+			launcher,
 			&error,
 			subprocess_path,
 			"--factory", sd->factory_name,
@@ -1288,6 +1304,7 @@ data_factory_spawn_subprocess_backend (EDataFactory *data_factory,
 			"--own-path", sd->path,
 			NULL);
 
+		g_object_unref (launcher);
 		g_object_unref (subprocess);
 	} else {
 		error = g_error_new (G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
@@ -184,6 +184,13 @@ static void
 dbus_server_bus_acquired (EDBusServer *server,
                           GDBusConnection *connection)
 {
+	GError *error = NULL;
+
+	if (!e_metrics_export (connection, &error)) {
+		g_warning ("%s: Failed to export metrics: %s", G_STRFUNC, error->message);
+		g_clear_error (&error);
+	}
+
 	if (server->priv->use_count == 0 && !server->priv->wait_for_client) {
 		server->priv->inactivity_timeout_id =
 			e_named_timeout_add_seconds (
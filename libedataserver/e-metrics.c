@@ -0,0 +1,389 @@
+/*
+ * e-metrics.c
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * SECTION: e-metrics
+ * @include: libedataserver/libedataserver.h
+ * @short_description: Runtime performance counters
+ *
+ * The metrics are named counters with a latency or size histogram,
+ * collected by the factories, the backend subprocesses and the source
+ * registry and read over D-Bus, for example by the evolution-dataserver-metrics
+ * tool.  Each sample is added with e_metrics_add_sample(), durations
+ * are measured with e_metrics_timer_start() and e_metrics_timer_stop().
+ *
+ * Nothing is collected unless the metrics are enabled, either with
+ * e_metrics_set_enabled(), the SetEnabled() D-Bus method or by setting
+ * the EDS_METRICS environment variable.  While disabled, each of the
+ * functions above costs only an atomic read.
+ **/
+
+#include <config.h>
+
+#include <string.h>
+
+#include <e-dbus-metrics.h>
+
+#include "e-metrics.h"
+
+typedef struct _MetricsEntry MetricsEntry;
+
+struct _MetricsEntry {
+	guint64 count;
+	guint64 sum;
+	guint64 max;
+	guint64 buckets[E_METRICS_N_BUCKETS];
+};
+
+/* -1 until first read from the environment */
+static volatile gint metrics_enabled = -1;
+
+static GMutex metrics_lock;
+static GHashTable *metrics_table; /* gchar *name ~> MetricsEntry * */
+
+/**
+ * e_metrics_get_enabled:
+ *
+ * Returns whether the metrics are collected by this process.
+ *
+ * Returns: %TRUE, when the metrics are enabled
+ *
+ * Since: 3.20
+ **/
+gboolean
+e_metrics_get_enabled (void)
+{
+	gint enabled;
+
+	enabled = g_atomic_int_get (&metrics_enabled);
+
+	if (G_UNLIKELY (enabled == -1)) {
+		enabled = g_getenv ("EDS_METRICS") != NULL ? 1 : 0;
+		g_atomic_int_compare_and_exchange (&metrics_enabled, -1, enabled);
+		enabled = g_atomic_int_get (&metrics_enabled);
+	}
+
+	return enabled == 1;
+}
+
+/**
+ * e_metrics_set_enabled:
+ * @enabled: whether to collect the metrics
+ *
+ * Starts or stops collecting the metrics.  The values collected so far
+ * are kept when disabling, use e_metrics_reset() to forget them.
+ *
+ * Since: 3.20
+ **/
+void
+e_metrics_set_enabled (gboolean enabled)
+{
+	g_atomic_int_set (&metrics_enabled, enabled ? 1 : 0);
+}
+
+static guint
+metrics_bucket_index (guint64 value)
+{
+	guint index = 0;
+
+	while (value != 0 && index < E_METRICS_N_BUCKETS - 1) {
+		value >>= 1;
+		index++;
+	}
+
+	return index;
+}
+
+/**
+ * e_metrics_add_sample:
+ * @name: a metric name
+ * @value: a sample value
+ *
+ * Adds one sample with value @value to the metric @name, creating
+ * the metric when needed.  The @name is like "EBookBackend.open",
+ * that is the type or the area, a dot and what is measured.
+ *
+ * Does nothing when the metrics are not enabled.
+ *
+ * Since: 3.20
+ **/
+void
+e_metrics_add_sample (const gchar *name,
+                      guint64 value)
+{
+	MetricsEntry *entry;
+
+	g_return_if_fail (name != NULL);
+
+	if (!e_metrics_get_enabled ())
+		return;
+
+	g_mutex_lock (&metrics_lock);
+
+	if (!metrics_table)
+		metrics_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	entry = g_hash_table_lookup (metrics_table, name);
+	if (!entry) {
+		entry = g_new0 (MetricsEntry, 1);
+		g_hash_table_insert (metrics_table, g_strdup (name), entry);
+	}
+
+	entry->count++;
+	entry->sum += value;
+	entry->max = MAX (entry->max, value);
+	entry->buckets[metrics_bucket_index (value)]++;
+
+	g_mutex_unlock (&metrics_lock);
+}
+
+/**
+ * e_metrics_timer_start:
+ *
+ * Starts measuring a duration, to be passed to e_metrics_timer_stop().
+ *
+ * Returns: a start time, or 0 when the metrics are not enabled
+ *
+ * Since: 3.20
+ **/
+gint64
+e_metrics_timer_start (void)
+{
+	if (!e_metrics_get_enabled ())
+		return 0;
+
+	return g_get_monotonic_time ();
+}
+
+/**
+ * e_metrics_timer_stop:
+ * @name: a metric name
+ * @start: a value returned by e_metrics_timer_start()
+ *
+ * Adds the time elapsed since @start, in microseconds, as a sample
+ * to the metric @name.  Does nothing when @start is 0, which means
+ * the metrics were not enabled when the timer started.
+ *
+ * Since: 3.20
+ **/
+void
+e_metrics_timer_stop (const gchar *name,
+                      gint64 start)
+{
+	gint64 elapsed;
+
+	if (start == 0)
+		return;
+
+	elapsed = g_get_monotonic_time () - start;
+
+	e_metrics_add_sample (name, MAX (elapsed, 0));
+}
+
+static gint
+metrics_compare_names (gconstpointer a,
+                       gconstpointer b)
+{
+	return strcmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+/**
+ * e_metrics_dup_snapshot:
+ *
+ * Returns all the metrics collected so far, as a #GVariant of type
+ * "a(stttat)"; each item has the metric name, the number of samples,
+ * their sum, the largest sample and the histogram with
+ * %E_METRICS_N_BUCKETS buckets.  The items are sorted by name.
+ *
+ * Returns: (transfer full): a new floating #GVariant
+ *
+ * Since: 3.20
+ **/
+GVariant *
+e_metrics_dup_snapshot (void)
+{
+	GVariantBuilder builder;
+	GPtrArray *names;
+	guint ii;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(stttat)"));
+
+	g_mutex_lock (&metrics_lock);
+
+	names = g_ptr_array_new ();
+
+	if (metrics_table) {
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init (&iter, metrics_table);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			g_ptr_array_add (names, key);
+		}
+	}
+
+	g_ptr_array_sort (names, metrics_compare_names);
+
+	for (ii = 0; ii < names->len; ii++) {
+		const gchar *name = g_ptr_array_index (names, ii);
+		MetricsEntry *entry;
+		GVariant *buckets;
+
+		entry = g_hash_table_lookup (metrics_table, name);
+
+		buckets = g_variant_new_fixed_array (
+			G_VARIANT_TYPE_UINT64, entry->buckets,
+			E_METRICS_N_BUCKETS, sizeof (guint64));
+
+		g_variant_builder_add (
+			&builder, "(sttt@at)", name, entry->count,
+			entry->sum, entry->max, buckets);
+	}
+
+	g_mutex_unlock (&metrics_lock);
+
+	g_ptr_array_free (names, TRUE);
+
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * e_metrics_reset:
+ *
+ * Forgets all the metrics collected so far.
+ *
+ * Since: 3.20
+ **/
+void
+e_metrics_reset (void)
+{
+	g_mutex_lock (&metrics_lock);
+
+	if (metrics_table)
+		g_hash_table_remove_all (metrics_table);
+
+	g_mutex_unlock (&metrics_lock);
+}
+
+static gboolean
+metrics_handle_set_enabled_cb (EDBusMetrics *dbus_interface,
+                               GDBusMethodInvocation *invocation,
+                               gboolean enabled)
+{
+	e_metrics_set_enabled (enabled);
+	e_dbus_metrics_set_enabled (dbus_interface, enabled);
+	e_dbus_metrics_complete_set_enabled (dbus_interface, invocation);
+
+	return TRUE;
+}
+
+static gboolean
+metrics_handle_get_metrics_cb (EDBusMetrics *dbus_interface,
+                               GDBusMethodInvocation *invocation)
+{
+	e_dbus_metrics_complete_get_metrics (
+		dbus_interface, invocation,
+		e_metrics_dup_snapshot ());
+
+	return TRUE;
+}
+
+static gboolean
+metrics_handle_reset_cb (EDBusMetrics *dbus_interface,
+                         GDBusMethodInvocation *invocation)
+{
+	e_metrics_reset ();
+	e_dbus_metrics_complete_reset (dbus_interface, invocation);
+
+	return TRUE;
+}
+
+/* Runs in the GDBus worker thread, for each message */
+static GDBusMessage *
+metrics_connection_filter_cb (GDBusConnection *connection,
+                              GDBusMessage *message,
+                              gboolean incoming,
+                              gpointer user_data)
+{
+	GVariant *body;
+
+	if (!e_metrics_get_enabled ())
+		return message;
+
+	body = g_dbus_message_get_body (message);
+
+	e_metrics_add_sample (
+		incoming ? "GDBus.bytes-received" : "GDBus.bytes-sent",
+		body != NULL ? g_variant_get_size (body) : 0);
+
+	return message;
+}
+
+/**
+ * e_metrics_export:
+ * @connection: a #GDBusConnection
+ * @error: return location for a #GError, or %NULL
+ *
+ * Exports the org.gnome.evolution.dataserver.Metrics interface on
+ * @connection, at %E_METRICS_OBJECT_PATH, and starts counting the
+ * D-Bus traffic of @connection.  The factories, the backend subprocesses
+ * and the source registry call this when they acquire their bus.
+ *
+ * Returns: %TRUE on success, %FALSE on failure
+ *
+ * Since: 3.20
+ **/
+gboolean
+e_metrics_export (GDBusConnection *connection,
+                  GError **error)
+{
+	EDBusMetrics *dbus_interface;
+
+	g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+
+	if (g_object_get_data (G_OBJECT (connection), "e-metrics-interface"))
+		return TRUE;
+
+	dbus_interface = e_dbus_metrics_skeleton_new ();
+	e_dbus_metrics_set_enabled (dbus_interface, e_metrics_get_enabled ());
+
+	g_signal_connect (
+		dbus_interface, "handle-set-enabled",
+		G_CALLBACK (metrics_handle_set_enabled_cb), NULL);
+	g_signal_connect (
+		dbus_interface, "handle-get-metrics",
+		G_CALLBACK (metrics_handle_get_metrics_cb), NULL);
+	g_signal_connect (
+		dbus_interface, "handle-reset",
+		G_CALLBACK (metrics_handle_reset_cb), NULL);
+
+	if (!g_dbus_interface_skeleton_export (
+		G_DBUS_INTERFACE_SKELETON (dbus_interface),
+		connection, E_METRICS_OBJECT_PATH, error)) {
+		g_object_unref (dbus_interface);
+		return FALSE;
+	}
+
+	g_dbus_connection_add_filter (connection, metrics_connection_filter_cb, NULL, NULL);
+
+	/* The connection owns the interface from now on */
+	g_object_set_data_full (
+		G_OBJECT (connection), "e-metrics-interface",
+		dbus_interface, g_object_unref);
+
+	return TRUE;
+}
@@ -0,0 +1,64 @@
+/*
+ * e-metrics.h
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if !defined (__LIBEDATASERVER_H_INSIDE__) && !defined (LIBEDATASERVER_COMPILATION)
+#error "Only <libedataserver/libedataserver.h> should be included directly."
+#endif
+
+#ifndef E_METRICS_H
+#define E_METRICS_H
+
+#include <gio/gio.h>
+
+/**
+ * E_METRICS_OBJECT_PATH:
+ *
+ * D-Bus object path on which e_metrics_export() exports the metrics
+ * of the process.
+ *
+ * Since: 3.20
+ **/
+#define E_METRICS_OBJECT_PATH "/org/gnome/evolution/dataserver/Metrics"
+
+/**
+ * E_METRICS_N_BUCKETS:
+ *
+ * Number of buckets of the histogram of each metric.  The bucket
+ * with index N counts the samples lower than 2^N, but not lower
+ * than 2^(N-1); the last bucket counts also all larger samples.
+ *
+ * Since: 3.20
+ **/
+#define E_METRICS_N_BUCKETS 32
+
+G_BEGIN_DECLS
+
+gboolean	e_metrics_get_enabled		(void);
+void		e_metrics_set_enabled		(gboolean enabled);
+void		e_metrics_add_sample		(const gchar *name,
+						 guint64 value);
+gint64		e_metrics_timer_start		(void);
+void		e_metrics_timer_stop		(const gchar *name,
+						 gint64 start);
+GVariant *	e_metrics_dup_snapshot		(void);
+void		e_metrics_reset			(void);
+gboolean	e_metrics_export		(GDBusConnection *connection,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* E_METRICS_H */
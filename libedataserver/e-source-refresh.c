@@ -32,15 +32,41 @@
  *
  *   extension = e_source_get_extension (source, E_SOURCE_EXTENSION_REFRESH);
  * ]|
+ *
+ * The periodic refreshes of all the data sources of a process, added with
+ * e_source_refresh_add_timeout(), go through a single scheduler.  It spreads
+ * the timeouts of the sources by a random amount, runs only a few refreshes
+ * at once, in total and against the same host, lets the sources with open
+ * views go first and prolongs the interval of the sources whose refresh
+ * failed.  The refreshes are considered running until the data source calls
+ * e_source_refresh_finished(), or for a short while, when it never does.
  **/
 
+#include "e-source-authentication.h"
+
 #include "e-source-refresh.h"
 
 #define E_SOURCE_REFRESH_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), E_TYPE_SOURCE_REFRESH, ESourceRefreshPrivate))
 
+/* How many refreshes can run at once, in total and against one host */
+#define SCHEDULER_MAX_RUNNING 4
+#define SCHEDULER_MAX_RUNNING_PER_HOST 2
+
+/* How long a running refresh holds its slot, when its source never called
+ * e_source_refresh_finished() and at most when it did */
+#define SCHEDULER_UNREPORTED_SECONDS 10
+#define SCHEDULER_REPORTED_SECONDS (10 * 60)
+
+/* Each failed refresh doubles the interval, up to 8 times */
+#define SCHEDULER_MAX_BACKOFF_SHIFT 3
+
+/* The timeouts are spread by up to a tenth of the interval */
+#define SCHEDULER_MAX_JITTER_SECONDS (5 * 60)
+
 typedef struct _TimeoutNode TimeoutNode;
+typedef struct _RunningRefresh RunningRefresh;
 
 struct _ESourceRefreshPrivate {
 	gboolean enabled;
@@ -49,6 +75,11 @@ struct _ESourceRefreshPrivate {
 	GMutex timeout_lock;
 	GHashTable *timeout_table;
 	guint next_timeout_id;
+
+	/* Runtime state for the scheduler, not saved with the source */
+	volatile gint n_failures;
+	volatile gint prioritized;
+	volatile gint reports_finished;
 };
 
 struct _TimeoutNode {
@@ -59,8 +90,29 @@ struct _TimeoutNode {
 	ESourceRefreshFunc callback;
 	gpointer user_data;
 	GDestroyNotify notify;
+
+	/* Which part of the maximum jitter the timeout is moved by,
+	 * chosen once, thus the node keeps its place among the others */
+	gdouble jitter;
+
+	/* Guarded by the scheduler_lock */
+	gboolean queued;
+	GSource *dispatch_source;
+	gchar *uid;
+	gchar *host;
+};
+
+struct _RunningRefresh {
+	gchar *host;
+	gint64 expires;
+	gboolean invoked; /* the callback was called for this slot */
 };
 
+static GMutex scheduler_lock;
+static GQueue scheduler_queue = G_QUEUE_INIT; /* TimeoutNode *, waiting for a slot */
+static GHashTable *scheduler_running; /* gchar *uid ~> RunningRefresh * */
+static GSource *scheduler_expiry_source; /* fires when the earliest slot expires */
+
 enum {
 	PROP_0,
 	PROP_ENABLED,
@@ -89,6 +141,7 @@ timeout_node_new (ESourceRefresh *extension,
 	node->callback = callback;
 	node->user_data = user_data;
 	node->notify = notify;
+	node->jitter = g_random_double ();
 
 	/* Do not reference.  The timeout node will
 	 * not outlive the ESourceRefresh extension. */
@@ -97,12 +150,13 @@ timeout_node_new (ESourceRefresh *extension,
 	return node;
 }
 
+/* Returns whether the callback was called */
 static gboolean
-timeout_node_invoke (gpointer data)
+timeout_node_invoke (TimeoutNode *node)
 {
-	TimeoutNode *node = data;
 	ESourceExtension *extension;
 	ESource *source;
+	gboolean invoked = FALSE;
 
 	extension = E_SOURCE_EXTENSION (node->extension);
 	source = e_source_extension_ref_source (extension);
@@ -110,10 +164,300 @@ timeout_node_invoke (gpointer data)
 
 	/* We allow timeouts to be scheduled for disabled data sources
 	 * but we don't invoke the callback.  Keeps the logic simple. */
-	if (e_source_get_enabled (source))
+	if (e_source_get_enabled (source)) {
 		node->callback (source, node->user_data);
+		invoked = TRUE;
+	}
+
+	g_object_unref (source);
+
+	return invoked;
+}
+
+static void
+running_refresh_free (RunningRefresh *running)
+{
+	g_free (running->host);
+	g_slice_free (RunningRefresh, running);
+}
+
+static guint
+scheduler_count_running_for_host_locked (const gchar *host)
+{
+	GHashTableIter iter;
+	gpointer value;
+	guint count = 0;
+
+	g_hash_table_iter_init (&iter, scheduler_running);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		RunningRefresh *running = value;
+
+		if (running->host != NULL && g_ascii_strcasecmp (running->host, host) == 0)
+			count++;
+	}
+
+	return count;
+}
+
+static gboolean timeout_node_dispatch_cb (gpointer data);
+static gboolean scheduler_expiry_cb (gpointer data);
+
+/* Nothing else frees the slots of the refreshes which never report
+ * they finished, thus wake up in the default main context when the
+ * earliest slot expires, while some refresh waits for one */
+static void
+scheduler_arm_expiry_locked (gint64 now)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gint64 earliest = 0;
+
+	if (scheduler_expiry_source != NULL) {
+		g_source_destroy (scheduler_expiry_source);
+		g_source_unref (scheduler_expiry_source);
+		scheduler_expiry_source = NULL;
+	}
+
+	if (g_queue_is_empty (&scheduler_queue))
+		return;
+
+	g_hash_table_iter_init (&iter, scheduler_running);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		RunningRefresh *running = value;
+
+		if (earliest == 0 || running->expires < earliest)
+			earliest = running->expires;
+	}
+
+	if (earliest == 0)
+		return;
+
+	/* Round up, to not wake up just before the expiry */
+	scheduler_expiry_source = g_timeout_source_new (
+		(earliest - now + 999) / 1000 + 1);
+	g_source_set_callback (
+		scheduler_expiry_source,
+		scheduler_expiry_cb,
+		NULL, (GDestroyNotify) NULL);
+	g_source_attach (scheduler_expiry_source, NULL);
+}
+
+/* Lets the queued refreshes run while there are free slots */
+static void
+scheduler_dispatch_locked (void)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GList *link;
+	gint64 now;
+
+	if (scheduler_running == NULL)
+		scheduler_running = g_hash_table_new_full (
+			(GHashFunc) g_str_hash,
+			(GEqualFunc) g_str_equal,
+			(GDestroyNotify) g_free,
+			(GDestroyNotify) running_refresh_free);
+
+	now = g_get_monotonic_time ();
+
+	g_hash_table_iter_init (&iter, scheduler_running);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		RunningRefresh *running = value;
+
+		if (running->expires <= now)
+			g_hash_table_iter_remove (&iter);
+	}
 
+	link = g_queue_peek_head_link (&scheduler_queue);
+
+	while (link != NULL && g_hash_table_size (scheduler_running) < SCHEDULER_MAX_RUNNING) {
+		TimeoutNode *node = link->data;
+		GList *next = g_list_next (link);
+		RunningRefresh *running;
+		gint seconds;
+
+		/* A refresh of the same source is still running, this one
+		 * waits for it; the other ones wait for their host. */
+		if (g_hash_table_contains (scheduler_running, node->uid) ||
+		    (node->host != NULL && scheduler_count_running_for_host_locked (node->host) >= SCHEDULER_MAX_RUNNING_PER_HOST)) {
+			link = next;
+			continue;
+		}
+
+		g_queue_delete_link (&scheduler_queue, link);
+		node->queued = FALSE;
+
+		if (g_atomic_int_get (&node->extension->priv->reports_finished))
+			seconds = SCHEDULER_REPORTED_SECONDS;
+		else
+			seconds = SCHEDULER_UNREPORTED_SECONDS;
+
+		running = g_slice_new0 (RunningRefresh);
+		running->host = g_strdup (node->host);
+		running->expires = now + seconds * G_USEC_PER_SEC;
+		g_hash_table_insert (scheduler_running, g_strdup (node->uid), running);
+
+		/* Call it in its own main context */
+		node->dispatch_source = g_idle_source_new ();
+		g_source_set_callback (
+			node->dispatch_source,
+			timeout_node_dispatch_cb,
+			node, (GDestroyNotify) NULL);
+		g_source_attach (node->dispatch_source, node->context);
+
+		link = next;
+	}
+
+	scheduler_arm_expiry_locked (now);
+}
+
+static gboolean
+scheduler_expiry_cb (gpointer data)
+{
+	g_mutex_lock (&scheduler_lock);
+
+	/* It is done, do not let it be destroyed again */
+	if (scheduler_expiry_source != NULL &&
+	    scheduler_expiry_source == g_main_current_source ()) {
+		g_source_unref (scheduler_expiry_source);
+		scheduler_expiry_source = NULL;
+	}
+
+	scheduler_dispatch_locked ();
+
+	g_mutex_unlock (&scheduler_lock);
+
+	return FALSE;
+}
+
+static void
+scheduler_release_locked (const gchar *uid)
+{
+	if (scheduler_running != NULL && uid != NULL)
+		g_hash_table_remove (scheduler_running, uid);
+
+	scheduler_dispatch_locked ();
+}
+
+static void
+scheduler_queue_node (TimeoutNode *node)
+{
+	ESource *source;
+	gchar *host = NULL;
+
+	source = e_source_extension_ref_source (E_SOURCE_EXTENSION (node->extension));
+	g_return_if_fail (source != NULL);
+
+	if (e_source_has_extension (source, E_SOURCE_EXTENSION_AUTHENTICATION)) {
+		ESourceAuthentication *auth_extension;
+
+		auth_extension = e_source_get_extension (source, E_SOURCE_EXTENSION_AUTHENTICATION);
+		host = e_source_authentication_dup_host (auth_extension);
+
+		if (host != NULL && *host == '\0') {
+			g_free (host);
+			host = NULL;
+		}
+	}
+
+	g_mutex_lock (&scheduler_lock);
+
+	/* A refresh already waiting covers this one as well */
+	if (!node->queued && node->dispatch_source == NULL) {
+		GList *link = NULL;
+
+		g_free (node->uid);
+		node->uid = g_strdup (e_source_get_uid (source));
+
+		g_free (node->host);
+		node->host = host;
+		host = NULL;
+
+		/* The prioritized ones go after the other prioritized ones */
+		if (g_atomic_int_get (&node->extension->priv->prioritized)) {
+			for (link = g_queue_peek_head_link (&scheduler_queue); link != NULL; link = g_list_next (link)) {
+				TimeoutNode *queued = link->data;
+
+				if (!g_atomic_int_get (&queued->extension->priv->prioritized))
+					break;
+			}
+		}
+
+		if (link != NULL)
+			g_queue_insert_before (&scheduler_queue, link, node);
+		else
+			g_queue_push_tail (&scheduler_queue, node);
+
+		node->queued = TRUE;
+	}
+
+	scheduler_dispatch_locked ();
+
+	g_mutex_unlock (&scheduler_lock);
+
+	g_free (host);
 	g_object_unref (source);
+}
+
+/* Drops the waiting refresh of the node, if any */
+static void
+scheduler_cancel_node (TimeoutNode *node)
+{
+	g_mutex_lock (&scheduler_lock);
+
+	if (node->queued) {
+		g_queue_remove (&scheduler_queue, node);
+		node->queued = FALSE;
+	}
+
+	if (node->dispatch_source != NULL) {
+		g_source_destroy (node->dispatch_source);
+		g_source_unref (node->dispatch_source);
+		node->dispatch_source = NULL;
+
+		scheduler_release_locked (node->uid);
+	}
+
+	g_mutex_unlock (&scheduler_lock);
+}
+
+static gboolean
+timeout_node_dispatch_cb (gpointer data)
+{
+	TimeoutNode *node = data;
+	RunningRefresh *running;
+
+	g_mutex_lock (&scheduler_lock);
+
+	if (node->dispatch_source != NULL) {
+		g_source_unref (node->dispatch_source);
+		node->dispatch_source = NULL;
+	}
+
+	/* Only the refresh started from this slot
+	 * can release it by e_source_refresh_finished() */
+	running = scheduler_running ? g_hash_table_lookup (scheduler_running, node->uid) : NULL;
+	if (running != NULL)
+		running->invoked = TRUE;
+
+	g_mutex_unlock (&scheduler_lock);
+
+	if (!timeout_node_invoke (node)) {
+		g_mutex_lock (&scheduler_lock);
+		scheduler_release_locked (node->uid);
+		g_mutex_unlock (&scheduler_lock);
+	}
+
+	return FALSE;
+}
+
+static gboolean
+timeout_node_timeout_cb (gpointer data)
+{
+	scheduler_queue_node (data);
 
 	return TRUE;
 }
@@ -121,18 +465,28 @@ timeout_node_invoke (gpointer data)
 static void
 timeout_node_attach (TimeoutNode *node)
 {
-	guint interval_minutes;
+	guint interval_seconds;
+	guint max_jitter;
+	gint n_failures;
 
 	if (node->source != NULL)
 		return;
 
-	interval_minutes =
-		e_source_refresh_get_interval_minutes (node->extension);
-	node->source = g_timeout_source_new_seconds (interval_minutes * 60);
+	interval_seconds =
+		e_source_refresh_get_interval_minutes (node->extension) * 60;
+
+	n_failures = g_atomic_int_get (&node->extension->priv->n_failures);
+	interval_seconds <<= MIN (n_failures, SCHEDULER_MAX_BACKOFF_SHIFT);
+
+	/* Keep the sources with the same interval apart */
+	max_jitter = MIN (interval_seconds / 10, SCHEDULER_MAX_JITTER_SECONDS);
+	interval_seconds += (guint) (max_jitter * node->jitter);
+
+	node->source = g_timeout_source_new_seconds (interval_seconds);
 
 	g_source_set_callback (
 		node->source,
-		timeout_node_invoke,
+		timeout_node_timeout_cb,
 		node,
 		(GDestroyNotify) NULL);
 
@@ -156,12 +510,17 @@ timeout_node_free (TimeoutNode *node)
 	if (node->source != NULL)
 		timeout_node_detach (node);
 
+	scheduler_cancel_node (node);
+
 	if (node->context != NULL)
 		g_main_context_unref (node->context);
 
 	if (node->notify != NULL)
 		node->notify (node->user_data);
 
+	g_free (node->uid);
+	g_free (node->host);
+
 	g_slice_free (TimeoutNode, node);
 }
 
@@ -180,8 +539,11 @@ source_refresh_update_timeouts (ESourceRefresh *extension,
 
 		timeout_node_detach (node);
 
-		if (invoke_callbacks)
+		if (invoke_callbacks) {
+			/* This is the waiting refresh, done right now */
+			scheduler_cancel_node (node);
 			timeout_node_invoke (node);
+		}
 
 		if (e_source_refresh_get_enabled (extension))
 			timeout_node_attach (node);
@@ -569,6 +931,142 @@ e_source_refresh_force_timeout (ESource *source)
 	source_refresh_update_timeouts (extension, TRUE);
 }
 
+/**
+ * e_source_refresh_schedule_timeout:
+ * @source: an #ESource
+ *
+ * For all timeouts added with e_source_refresh_add_timeout(), asks the
+ * refresh scheduler to invoke the #ESourceRefreshFunc callback as soon
+ * as it has a free slot.  Unlike e_source_refresh_force_timeout(), this
+ * respects the limit of refreshes running at once, thus it is the better
+ * choice when many data sources are to be refreshed at the same time,
+ * like when a network connection becomes available or when waking up
+ * from hibernation or suspend.  A refresh already waiting for a slot
+ * is not scheduled twice.
+ *
+ * Since: 3.20
+ **/
+void
+e_source_refresh_schedule_timeout (ESource *source)
+{
+	ESourceRefresh *extension;
+	const gchar *extension_name;
+	GHashTableIter iter;
+	gpointer value;
+
+	g_return_if_fail (E_IS_SOURCE (source));
+
+	extension_name = E_SOURCE_EXTENSION_REFRESH;
+	extension = e_source_get_extension (source, extension_name);
+
+	g_mutex_lock (&extension->priv->timeout_lock);
+
+	g_hash_table_iter_init (&iter, extension->priv->timeout_table);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		scheduler_queue_node (value);
+
+	g_mutex_unlock (&extension->priv->timeout_lock);
+}
+
+/**
+ * e_source_refresh_finished:
+ * @source: an #ESource
+ * @error: (allow-none): a #GError the refresh failed with, or %NULL
+ *
+ * Tells the refresh scheduler that the refresh of @source, started
+ * by an #ESourceRefreshFunc callback, finished.  This frees its slot
+ * for the next waiting refresh.  Data sources which call this are
+ * counted as running until they do so, the others only for a short while.
+ *
+ * When @error is set, other than %G_IO_ERROR_CANCELLED, the interval
+ * of the following refreshes is prolonged, until a refresh succeeds.
+ *
+ * Since: 3.20
+ **/
+void
+e_source_refresh_finished (ESource *source,
+                           const GError *error)
+{
+	ESourceRefresh *extension;
+	const gchar *extension_name;
+	gint n_failures, old_n_failures;
+
+	g_return_if_fail (E_IS_SOURCE (source));
+
+	g_mutex_lock (&scheduler_lock);
+
+	/* Not for the refreshes the scheduler did not start, like those
+	 * called directly, which would free the slot of another one */
+	if (scheduler_running != NULL) {
+		RunningRefresh *running;
+
+		running = g_hash_table_lookup (scheduler_running, e_source_get_uid (source));
+		if (running != NULL && running->invoked)
+			scheduler_release_locked (e_source_get_uid (source));
+	}
+
+	g_mutex_unlock (&scheduler_lock);
+
+	extension_name = E_SOURCE_EXTENSION_REFRESH;
+
+	if (!e_source_has_extension (source, extension_name))
+		return;
+
+	extension = e_source_get_extension (source, extension_name);
+
+	g_atomic_int_set (&extension->priv->reports_finished, 1);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		return;
+
+	old_n_failures = g_atomic_int_get (&extension->priv->n_failures);
+
+	if (error != NULL)
+		n_failures = MIN (old_n_failures + 1, SCHEDULER_MAX_BACKOFF_SHIFT);
+	else
+		n_failures = 0;
+
+	if (n_failures != old_n_failures) {
+		g_atomic_int_set (&extension->priv->n_failures, n_failures);
+
+		/* Reschedule with the new interval */
+		source_refresh_update_timeouts (extension, FALSE);
+	}
+}
+
+/**
+ * e_source_refresh_set_prioritized:
+ * @source: an #ESource
+ * @prioritized: whether the refreshes of @source go first
+ *
+ * Lets the refreshes of @source go before the refreshes of other
+ * data sources waiting for the refresh scheduler, for example when
+ * the data of @source are currently shown to the user.  This is
+ * not saved with @source.  Does nothing when @source has no
+ * #ESourceRefresh extension.
+ *
+ * Since: 3.20
+ **/
+void
+e_source_refresh_set_prioritized (ESource *source,
+                                  gboolean prioritized)
+{
+	ESourceRefresh *extension;
+	const gchar *extension_name;
+
+	g_return_if_fail (E_IS_SOURCE (source));
+
+	extension_name = E_SOURCE_EXTENSION_REFRESH;
+
+	if (!e_source_has_extension (source, extension_name))
+		return;
+
+	extension = e_source_get_extension (source, extension_name);
+
+	g_atomic_int_set (&extension->priv->prioritized, prioritized ? 1 : 0);
+}
+
 /**
  * e_source_refresh_remove_timeout:
  * @source: an #ESource
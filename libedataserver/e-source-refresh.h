@@ -102,6 +102,13 @@ guint		e_source_refresh_add_timeout	(ESource *source,
 						 gpointer user_data,
 						 GDestroyNotify notify);
 void		e_source_refresh_force_timeout	(ESource *source);
+void		e_source_refresh_schedule_timeout
+						(ESource *source);
+void		e_source_refresh_finished	(ESource *source,
+						 const GError *error);
+void		e_source_refresh_set_prioritized
+						(ESource *source,
+						 gboolean prioritized);
 gboolean	e_source_refresh_remove_timeout	(ESource *source,
 						 guint refresh_timeout_id);
 guint		e_source_refresh_remove_timeouts_by_data
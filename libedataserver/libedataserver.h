@@ -36,6 +36,7 @@
 #include <libedataserver/e-list-iterator.h>
 #include <libedataserver/e-list.h>
 #include <libedataserver/e-memory.h>
+#include <libedataserver/e-metrics.h>
 #include <libedataserver/e-module.h>
 #include <libedataserver/e-operation-pool.h>
 #include <libedataserver/e-proxy.h>
@@ -0,0 +1,273 @@
+/*
+ * evolution-dataserver-metrics.c
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include <libedataserver/libedataserver.h>
+
+#define PROGRAM_SUMMARY \
+	"Shows the performance metrics of the Evolution Data Server processes\n" \
+	"running on the session bus, that is of the source registry, of the\n" \
+	"factories and of the backend subprocesses.  The metrics are collected\n" \
+	"only after --enable was used or with EDS_METRICS set in the environment."
+
+#define BUS_NAME_PREFIX "org.gnome.evolution.dataserver."
+#define METRICS_INTERFACE "org.gnome.evolution.dataserver.Metrics"
+
+static gboolean opt_enable;
+static gboolean opt_disable;
+static gboolean opt_reset;
+static gboolean opt_histograms;
+
+static GOptionEntry entries[] = {
+	{ "enable", 'e', 0, G_OPTION_ARG_NONE, &opt_enable,
+	  "Start collecting the metrics", NULL },
+	{ "disable", 'd', 0, G_OPTION_ARG_NONE, &opt_disable,
+	  "Stop collecting the metrics", NULL },
+	{ "reset", 'r', 0, G_OPTION_ARG_NONE, &opt_reset,
+	  "Forget the collected metrics", NULL },
+	{ "histograms", 'H', 0, G_OPTION_ARG_NONE, &opt_histograms,
+	  "Print also the histogram of each metric", NULL },
+	{ NULL }
+};
+
+static GVariant *
+call_metrics (GDBusConnection *connection,
+              const gchar *bus_name,
+              const gchar *method_name,
+              GVariant *parameters,
+              const GVariantType *reply_type,
+              GError **error)
+{
+	return g_dbus_connection_call_sync (
+		connection, bus_name, E_METRICS_OBJECT_PATH,
+		METRICS_INTERFACE, method_name, parameters, reply_type,
+		G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL, error);
+}
+
+static GPtrArray *
+list_bus_names (GDBusConnection *connection,
+                GError **error)
+{
+	GVariant *reply;
+	GVariantIter *iter;
+	GPtrArray *names;
+	const gchar *name;
+
+	reply = g_dbus_connection_call_sync (
+		connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+		"org.freedesktop.DBus", "ListNames", NULL, G_VARIANT_TYPE ("(as)"),
+		G_DBUS_CALL_FLAGS_NONE, -1, NULL, error);
+
+	if (!reply)
+		return NULL;
+
+	names = g_ptr_array_new_with_free_func (g_free);
+
+	g_variant_get (reply, "(as)", &iter);
+	while (g_variant_iter_loop (iter, "&s", &name)) {
+		if (g_str_has_prefix (name, BUS_NAME_PREFIX))
+			g_ptr_array_add (names, g_strdup (name));
+	}
+	g_variant_iter_free (iter);
+	g_variant_unref (reply);
+
+	g_ptr_array_sort (names, (GCompareFunc) g_strcmp0);
+
+	return names;
+}
+
+static guint32
+get_bus_name_pid (GDBusConnection *connection,
+                  const gchar *bus_name)
+{
+	GVariant *reply;
+	guint32 pid = 0;
+
+	reply = g_dbus_connection_call_sync (
+		connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+		"org.freedesktop.DBus", "GetConnectionUnixProcessID",
+		g_variant_new ("(s)", bus_name), G_VARIANT_TYPE ("(u)"),
+		G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+
+	if (reply) {
+		g_variant_get (reply, "(u)", &pid);
+		g_variant_unref (reply);
+	}
+
+	return pid;
+}
+
+/* The upper bound of the bucket holding the given percentile */
+static guint64
+histogram_percentile (const guint64 *buckets,
+                      gsize n_buckets,
+                      guint64 count,
+                      guint64 max,
+                      gint percent)
+{
+	guint64 wanted, seen = 0;
+	gsize ii;
+
+	wanted = (count * percent + 99) / 100;
+
+	for (ii = 0; ii < n_buckets; ii++) {
+		seen += buckets[ii];
+		if (seen >= wanted && seen > 0)
+			return MIN (((guint64) 1) << ii, max);
+	}
+
+	return max;
+}
+
+static void
+print_metrics (const gchar *bus_name,
+               guint32 pid,
+               GVariant *metrics)
+{
+	GVariantIter iter;
+	GVariant *buckets_variant;
+	const gchar *name;
+	guint64 count, sum, max;
+
+	g_print ("%s (pid %u)\n", bus_name, pid);
+
+	if (g_variant_n_children (metrics) == 0) {
+		g_print ("  no metrics collected\n\n");
+		return;
+	}
+
+	g_print (
+		"  %-40s %10s %14s %10s %10s %10s %10s\n",
+		"metric", "count", "sum", "mean", "~p50", "~p99", "max");
+
+	g_variant_iter_init (&iter, metrics);
+	while (g_variant_iter_loop (&iter, "(&sttt@at)", &name, &count, &sum, &max, &buckets_variant)) {
+		const guint64 *buckets;
+		gsize n_buckets, ii;
+
+		buckets = g_variant_get_fixed_array (buckets_variant, &n_buckets, sizeof (guint64));
+
+		g_print (
+			"  %-40s %10" G_GUINT64_FORMAT " %14" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT
+			" %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+			name, count, sum, count ? sum / count : 0,
+			histogram_percentile (buckets, n_buckets, count, max, 50),
+			histogram_percentile (buckets, n_buckets, count, max, 99),
+			max);
+
+		if (!opt_histograms)
+			continue;
+
+		for (ii = 0; ii < n_buckets; ii++) {
+			if (buckets[ii] > 0) {
+				g_print (
+					"  %40s < %-12" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+					"", ((guint64) 1) << ii, buckets[ii]);
+			}
+		}
+	}
+
+	g_print ("\n");
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	GOptionContext *context;
+	GDBusConnection *connection;
+	GPtrArray *names;
+	GError *error = NULL;
+	guint ii;
+
+	setlocale (LC_ALL, "");
+	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, PROGRAM_SUMMARY);
+	g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+	g_option_context_parse (context, &argc, &argv, &error);
+	g_option_context_free (context);
+
+	if (error != NULL) {
+		g_printerr ("%s\n", error->message);
+		exit (EXIT_FAILURE);
+	}
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+	if (!connection) {
+		g_printerr ("Cannot connect to the session bus: %s\n", error->message);
+		exit (EXIT_FAILURE);
+	}
+
+	names = list_bus_names (connection, &error);
+	if (!names) {
+		g_printerr ("Cannot list bus names: %s\n", error->message);
+		g_object_unref (connection);
+		exit (EXIT_FAILURE);
+	}
+
+	for (ii = 0; ii < names->len; ii++) {
+		const gchar *bus_name = g_ptr_array_index (names, ii);
+		GVariant *reply;
+
+		if (opt_enable || opt_disable) {
+			reply = call_metrics (
+				connection, bus_name, "SetEnabled",
+				g_variant_new ("(b)", opt_enable),
+				NULL, NULL);
+
+			/* Not every service exports the metrics */
+			if (!reply)
+				continue;
+
+			g_variant_unref (reply);
+		}
+
+		if (opt_reset) {
+			reply = call_metrics (connection, bus_name, "Reset", NULL, NULL, NULL);
+			if (!reply)
+				continue;
+
+			g_variant_unref (reply);
+		}
+
+		reply = call_metrics (
+			connection, bus_name, "GetMetrics", NULL,
+			G_VARIANT_TYPE ("(a(stttat))"), NULL);
+
+		if (reply) {
+			GVariant *metrics;
+
+			metrics = g_variant_get_child_value (reply, 0);
+			print_metrics (bus_name, get_bus_name_pid (connection, bus_name), metrics);
+			g_variant_unref (metrics);
+			g_variant_unref (reply);
+		}
+	}
+
+	g_ptr_array_unref (names);
+	g_object_unref (connection);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "bench-common.h"
+
+gint64
+bench_timer_start (void)
+{
+	return g_get_monotonic_time ();
+}
+
+gdouble
+bench_timer_elapsed_ms (gint64 start)
+{
+	return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+static gint
+bench_compare_doubles (gconstpointer a,
+                       gconstpointer b)
+{
+	gdouble da = *((const gdouble *) a), db = *((const gdouble *) b);
+
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+/* Nearest-rank percentile of sorted values */
+static gdouble
+bench_percentile (const gdouble *sorted,
+                  guint n_values,
+                  guint percent)
+{
+	guint rank;
+
+	if (!n_values)
+		return 0.0;
+
+	rank = (n_values * percent + 99) / 100;
+	rank = CLAMP (rank, 1, n_values);
+
+	return sorted[rank - 1];
+}
+
+/* Sorts the @samples_ms and fills the @summary from them */
+void
+bench_summarize (gdouble *samples_ms,
+                 guint n_samples,
+                 BenchSummary *summary)
+{
+	guint ii;
+
+	memset (summary, 0, sizeof (BenchSummary));
+
+	if (!n_samples)
+		return;
+
+	qsort (samples_ms, n_samples, sizeof (gdouble), bench_compare_doubles);
+
+	for (ii = 0; ii < n_samples; ii++)
+		summary->total_ms += samples_ms[ii];
+
+	summary->n_samples = n_samples;
+	summary->min_ms = samples_ms[0];
+	summary->max_ms = samples_ms[n_samples - 1];
+	summary->p50_ms = bench_percentile (samples_ms, n_samples, 50);
+	summary->p99_ms = bench_percentile (samples_ms, n_samples, 99);
+}
+
+/* The peak resident set size of this process, in kilobytes,
+ * or -1 when it cannot be determined */
+gint64
+bench_peak_rss_kb (void)
+{
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return -1;
+
+#ifdef __APPLE__
+	/* reported in bytes there */
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+/* The results are printed as one JSON object per line,
+ * built by these and printed by bench_json_end() */
+GString *
+bench_json_begin (void)
+{
+	return g_string_new ("{");
+}
+
+static void
+bench_json_add_key (GString *json,
+                    const gchar *key)
+{
+	if (json->len > 1)
+		g_string_append (json, ", ");
+
+	g_string_append_printf (json, "\"%s\": ", key);
+}
+
+void
+bench_json_add_string (GString *json,
+                       const gchar *key,
+                       const gchar *value)
+{
+	gchar *escaped;
+
+	escaped = g_strescape (value ? value : "", NULL);
+
+	bench_json_add_key (json, key);
+	g_string_append_printf (json, "\"%s\"", escaped);
+
+	g_free (escaped);
+}
+
+void
+bench_json_add_int (GString *json,
+                    const gchar *key,
+                    gint64 value)
+{
+	bench_json_add_key (json, key);
+	g_string_append_printf (json, "%" G_GINT64_FORMAT, value);
+}
+
+void
+bench_json_add_double (GString *json,
+                       const gchar *key,
+                       gdouble value)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	/* always a dot as the decimal separator, the output is parsed */
+	bench_json_add_key (json, key);
+	g_string_append (json, g_ascii_formatd (buffer, sizeof (buffer), "%.3f", value));
+}
+
+/* Prints the object and frees the @json */
+void
+bench_json_end (GString *json)
+{
+	g_string_append (json, "}\n");
+
+	fputs (json->str, stdout);
+	fflush (stdout);
+
+	g_string_free (json, TRUE);
+}
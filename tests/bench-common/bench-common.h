@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The measuring and reporting shared by the camel benchmarks
+ * and the address book and calendar benchmarks */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Latencies of a set of measured runs, in milliseconds */
+typedef struct _BenchSummary {
+	guint n_samples;
+	gdouble total_ms;
+	gdouble min_ms;
+	gdouble max_ms;
+	gdouble p50_ms;
+	gdouble p99_ms;
+} BenchSummary;
+
+gint64		bench_timer_start		(void);
+gdouble		bench_timer_elapsed_ms		(gint64 start);
+
+void		bench_summarize			(gdouble *samples_ms,
+						 guint n_samples,
+						 BenchSummary *summary);
+
+gint64		bench_peak_rss_kb		(void);
+
+GString *	bench_json_begin		(void);
+void		bench_json_add_string		(GString *json,
+						 const gchar *key,
+						 const gchar *value);
+void		bench_json_add_int		(GString *json,
+						 const gchar *key,
+						 gint64 value);
+void		bench_json_add_double		(GString *json,
+						 const gchar *key,
+						 gdouble value);
+void		bench_json_end			(GString *json);
+
+G_END_DECLS
+
+#endif /* BENCH_COMMON_H */
@@ -0,0 +1,528 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Measures the address book factory with a synthetic book: opening it,
+ * populating a view, stepping a cursor and autocompletion queries, also
+ * from more concurrent clients.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <libebook/libebook.h>
+
+#include "e-test-server-utils.h"
+#include "bench-utils.h"
+
+#define DEFAULT_CONTACTS 10000
+#define ADD_BATCH_SIZE   1000
+#define CURSOR_STEP      50
+#define PHOTO_SIZE       4096
+
+typedef struct {
+	ETestServerClosure parent;
+	const gchar *config;
+	gboolean direct;
+} BookClosure;
+
+static const gchar *given_names[] = {
+	"Anna", "Bernard", "Charlotte", "Daniel", "Eva", "Frank", "Grace", "Henry",
+	"Irene", "James", "Katherine", "Lucas", "Maria", "Nathan", "Olivia", "Peter",
+	"Quinn", "Rachel", "Samuel", "Teresa", "Victor", "Wendy", "Xavier", "Zoe"
+};
+
+static const gchar *family_names[] = {
+	"Adams", "Baker", "Clark", "Davis", "Evans", "Fischer", "Garcia", "Harris",
+	"Ivanov", "Jensen", "King", "Lopez", "Miller", "Novak", "Owens", "Parker",
+	"Quintero", "Roberts", "Smith", "Turner", "Underwood", "Vargas", "Walker",
+	"Young", "Zimmermann", "Nakamura", "Kowalski", "Svoboda", "Dubois", "Rossi"
+};
+
+/* prefixes typed into a composer, from short and common to specific */
+static const gchar *autocomplete_prefixes[] = {
+	"a", "ma", "ch", "dan", "kat", "zim", "rob", "oli", "nak", "sv"
+};
+
+static void
+setup_custom_book (ESource *scratch,
+                   ETestServerClosure *closure)
+{
+	ESourceBackendSummarySetup *setup;
+
+	g_type_ensure (E_TYPE_SOURCE_BACKEND_SUMMARY_SETUP);
+	setup = e_source_get_extension (scratch, E_SOURCE_EXTENSION_BACKEND_SUMMARY_SETUP);
+	e_source_backend_summary_setup_set_summary_fields (
+		setup,
+		E_CONTACT_FULL_NAME,
+		E_CONTACT_GIVEN_NAME,
+		E_CONTACT_FAMILY_NAME,
+		E_CONTACT_NICKNAME,
+		E_CONTACT_EMAIL,
+		E_CONTACT_TEL,
+		0);
+	e_source_backend_summary_setup_set_indexed_fields (
+		setup,
+		E_CONTACT_FULL_NAME, E_BOOK_INDEX_PREFIX,
+		E_CONTACT_NICKNAME, E_BOOK_INDEX_PREFIX,
+		E_CONTACT_EMAIL, E_BOOK_INDEX_PREFIX,
+		E_CONTACT_TEL, E_BOOK_INDEX_PHONE,
+		0);
+}
+
+static BookClosure book_closures[] = {
+	{ { E_TEST_SERVER_ADDRESS_BOOK, NULL, 0 }, "default", FALSE },
+	{ { E_TEST_SERVER_ADDRESS_BOOK, setup_custom_book, 0 }, "custom", FALSE },
+	{ { E_TEST_SERVER_DIRECT_ADDRESS_BOOK, setup_custom_book, 0 }, "direct", TRUE }
+};
+
+static EContact *
+bench_contact_new (gint index,
+                   const guchar *photo_data)
+{
+	EContact *contact;
+	const gchar *given, *family;
+	gchar *value, *lower;
+
+	given = given_names[index % G_N_ELEMENTS (given_names)];
+	family = family_names[(index / G_N_ELEMENTS (given_names)) % G_N_ELEMENTS (family_names)];
+
+	contact = e_contact_new ();
+	e_contact_set (contact, E_CONTACT_GIVEN_NAME, given);
+	e_contact_set (contact, E_CONTACT_FAMILY_NAME, family);
+
+	value = g_strdup_printf ("%s %s %d", given, family, index);
+	e_contact_set (contact, E_CONTACT_FULL_NAME, value);
+	g_free (value);
+
+	value = g_strdup_printf ("%.3s%d", family, index);
+	e_contact_set (contact, E_CONTACT_NICKNAME, value);
+	g_free (value);
+
+	value = g_strdup_printf ("%s.%s%d@example.com", given, family, index);
+	lower = g_ascii_strdown (value, -1);
+	e_contact_set (contact, E_CONTACT_EMAIL_1, lower);
+	g_free (lower);
+	g_free (value);
+
+	if (index % 3 == 0) {
+		value = g_strdup_printf ("%s@%s.example.org", given, family);
+		lower = g_ascii_strdown (value, -1);
+		e_contact_set (contact, E_CONTACT_EMAIL_2, lower);
+		g_free (lower);
+		g_free (value);
+	}
+
+	value = g_strdup_printf ("+1 555 %07d", index);
+	e_contact_set (contact, E_CONTACT_PHONE_HOME, value);
+	g_free (value);
+
+	value = g_strdup_printf ("+44 20 %08d", index * 7);
+	e_contact_set (contact, E_CONTACT_PHONE_MOBILE, value);
+	g_free (value);
+
+	if (photo_data) {
+		EContactPhoto photo;
+
+		photo.type = E_CONTACT_PHOTO_TYPE_INLINED;
+		photo.data.inlined.mime_type = (gchar *) "image/jpeg";
+		photo.data.inlined.data = (guchar *) photo_data;
+		photo.data.inlined.length = PHOTO_SIZE;
+
+		e_contact_set (contact, E_CONTACT_PHOTO, &photo);
+	}
+
+	return contact;
+}
+
+static void
+bench_book_populate (EBookClient *book_client,
+                     const BookClosure *closure)
+{
+	BenchStats *stats;
+	guchar *photo_data = NULL;
+	gint ii;
+
+	if (bench_options.photos) {
+		photo_data = g_malloc (PHOTO_SIZE);
+		for (ii = 0; ii < PHOTO_SIZE; ii++) {
+			photo_data[ii] = g_random_int_range (0, 256);
+		}
+	}
+
+	stats = bench_stats_new (closure->config, "add-contacts", "contacts");
+
+	for (ii = 0; ii < bench_options.objects; ii += ADD_BATCH_SIZE) {
+		GSList *contacts = NULL;
+		GError *error = NULL;
+		gint64 start;
+		gint jj;
+
+		for (jj = MIN (ii + ADD_BATCH_SIZE, bench_options.objects) - 1; jj >= ii; jj--) {
+			contacts = g_slist_prepend (contacts, bench_contact_new (jj, photo_data));
+		}
+
+		start = bench_timer_start ();
+
+		if (!e_book_client_add_contacts_sync (book_client, contacts, NULL, NULL, &error))
+			g_error ("add contacts sync: %s", error->message);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), g_slist_length (contacts));
+
+		g_slist_free_full (contacts, g_object_unref);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+	g_free (photo_data);
+}
+
+static EBookClient *
+bench_book_connect (ESourceRegistry *registry,
+                    ESource *source,
+                    gboolean direct)
+{
+	EClient *client;
+	GError *error = NULL;
+
+	if (direct)
+		client = e_book_client_connect_direct_sync (registry, source, (guint32) -1, NULL, &error);
+	else
+		client = e_book_client_connect_sync (source, (guint32) -1, NULL, &error);
+
+	if (!client)
+		g_error ("connect sync: %s", error->message);
+
+	return E_BOOK_CLIENT (client);
+}
+
+static void
+bench_book_open (ESourceRegistry *registry,
+                 ESource *source,
+                 const BookClosure *closure)
+{
+	BenchStats *stats;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "open", "opens");
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		EBookClient *book_client;
+		gint64 start;
+
+		start = bench_timer_start ();
+		book_client = bench_book_connect (registry, source, closure->direct);
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), 1);
+
+		g_object_unref (book_client);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+typedef struct {
+	GMainLoop *loop;
+	gint64 n_contacts;
+} ViewData;
+
+static void
+view_objects_added_cb (EBookClientView *view,
+                       const GSList *contacts,
+                       gpointer user_data)
+{
+	ViewData *data = user_data;
+
+	data->n_contacts += g_slist_length ((GSList *) contacts);
+}
+
+static void
+view_complete_cb (EBookClientView *view,
+                  const GError *error,
+                  gpointer user_data)
+{
+	ViewData *data = user_data;
+
+	if (error)
+		g_error ("view complete: %s", error->message);
+
+	g_main_loop_quit (data->loop);
+}
+
+static void
+bench_book_view (EBookClient *book_client,
+                 const BookClosure *closure)
+{
+	EBookQuery *query;
+	BenchStats *stats;
+	gchar *sexp;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "view-populate", "contacts");
+
+	query = e_book_query_any_field_contains ("");
+	sexp = e_book_query_to_string (query);
+	e_book_query_unref (query);
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		EBookClientView *view;
+		ViewData data;
+		GError *error = NULL;
+		gint64 start;
+
+		data.loop = g_main_loop_new (NULL, FALSE);
+		data.n_contacts = 0;
+
+		start = bench_timer_start ();
+
+		if (!e_book_client_get_view_sync (book_client, sexp, &view, NULL, &error))
+			g_error ("get book view sync: %s", error->message);
+
+		g_signal_connect (view, "objects-added", G_CALLBACK (view_objects_added_cb), &data);
+		g_signal_connect (view, "complete", G_CALLBACK (view_complete_cb), &data);
+
+		e_book_client_view_start (view, &error);
+		if (error)
+			g_error ("start book view: %s", error->message);
+
+		g_main_loop_run (data.loop);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), data.n_contacts);
+
+		e_book_client_view_stop (view, NULL);
+		g_object_unref (view);
+		g_main_loop_unref (data.loop);
+	}
+
+	g_free (sexp);
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+static void
+bench_book_cursor (EBookClient *book_client,
+                   const BookClosure *closure)
+{
+	EContactField sort_fields[] = { E_CONTACT_FAMILY_NAME, E_CONTACT_GIVEN_NAME };
+	EBookCursorSortType sort_types[] = { E_BOOK_CURSOR_SORT_ASCENDING, E_BOOK_CURSOR_SORT_ASCENDING };
+	EBookClientCursor *cursor = NULL;
+	BenchStats *stats;
+	GError *error = NULL;
+	gint ii;
+
+	if (!e_book_client_get_cursor_sync (book_client, NULL, sort_fields, sort_types, 2, &cursor, NULL, &error))
+		g_error ("get cursor sync: %s", error->message);
+
+	/* Each sample is one step, a page of an address book list */
+	stats = bench_stats_new (closure->config, "cursor-step", "contacts");
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		EBookCursorOrigin origin = E_BOOK_CURSOR_ORIGIN_BEGIN;
+		gint n_results;
+
+		do {
+			GSList *contacts = NULL;
+			gint64 start;
+
+			start = bench_timer_start ();
+
+			n_results = e_book_client_cursor_step_sync (
+				cursor, E_BOOK_CURSOR_STEP_MOVE | E_BOOK_CURSOR_STEP_FETCH,
+				origin, CURSOR_STEP, &contacts, NULL, &error);
+			if (n_results < 0)
+				g_error ("cursor step sync: %s", error->message);
+
+			bench_stats_add (stats, bench_timer_elapsed_ms (start), n_results);
+
+			g_slist_free_full (contacts, g_object_unref);
+			origin = E_BOOK_CURSOR_ORIGIN_CURRENT;
+		} while (n_results == CURSOR_STEP);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+	g_object_unref (cursor);
+}
+
+static gchar *
+autocomplete_sexp (const gchar *prefix)
+{
+	EBookQuery *queries[3], *query;
+	gchar *sexp;
+
+	queries[0] = e_book_query_field_test (E_CONTACT_FULL_NAME, E_BOOK_QUERY_BEGINS_WITH, prefix);
+	queries[1] = e_book_query_field_test (E_CONTACT_NICKNAME, E_BOOK_QUERY_BEGINS_WITH, prefix);
+	queries[2] = e_book_query_field_test (E_CONTACT_EMAIL, E_BOOK_QUERY_BEGINS_WITH, prefix);
+
+	query = e_book_query_or (G_N_ELEMENTS (queries), queries, TRUE);
+	sexp = e_book_query_to_string (query);
+	e_book_query_unref (query);
+
+	return sexp;
+}
+
+static void
+autocomplete_run (EBookClient *book_client,
+                  BenchStats *stats)
+{
+	gint ii;
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		const gchar *prefix;
+		GSList *contacts = NULL;
+		GError *error = NULL;
+		gchar *sexp;
+		gint64 start;
+
+		prefix = autocomplete_prefixes[ii % G_N_ELEMENTS (autocomplete_prefixes)];
+		sexp = autocomplete_sexp (prefix);
+
+		start = bench_timer_start ();
+
+		if (!e_book_client_get_contacts_sync (book_client, sexp, &contacts, NULL, &error))
+			g_error ("get contacts sync: %s", error->message);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), 1);
+
+		g_slist_free_full (contacts, g_object_unref);
+		g_free (sexp);
+	}
+}
+
+static void
+bench_book_autocomplete (EBookClient *book_client,
+                         const BookClosure *closure)
+{
+	BenchStats *stats;
+
+	stats = bench_stats_new (closure->config, "autocomplete", "queries");
+	autocomplete_run (book_client, stats);
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+typedef struct {
+	EBookClient *book_client;
+	BenchStats *stats;
+} ConcurrentData;
+
+static gpointer
+concurrent_thread (gpointer user_data)
+{
+	ConcurrentData *data = user_data;
+
+	autocomplete_run (data->book_client, data->stats);
+
+	return NULL;
+}
+
+static void
+bench_book_concurrent (ESourceRegistry *registry,
+                       ESource *source,
+                       const BookClosure *closure)
+{
+	ConcurrentData *data;
+	GThread **threads;
+	BenchStats *stats;
+	gint64 start;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "autocomplete-mt", "queries");
+
+	data = g_new0 (ConcurrentData, bench_options.clients);
+	threads = g_new0 (GThread *, bench_options.clients);
+
+	/* Each thread is a separate client, as separate applications are */
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		data[ii].book_client = bench_book_connect (registry, source, closure->direct);
+		data[ii].stats = stats;
+	}
+
+	start = bench_timer_start ();
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		threads[ii] = g_thread_new ("bench-book-client", concurrent_thread, &data[ii]);
+	}
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		g_thread_join (threads[ii]);
+	}
+
+	bench_stats_set_wall_time (stats, bench_timer_elapsed_ms (start));
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		g_object_unref (data[ii].book_client);
+	}
+
+	g_free (threads);
+	g_free (data);
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+static void
+bench_book (ETestServerFixture *fixture,
+            gconstpointer user_data)
+{
+	const BookClosure *closure = user_data;
+	EBookClient *book_client;
+	ESource *source;
+
+	book_client = E_TEST_SERVER_UTILS_SERVICE (fixture, EBookClient);
+	source = e_client_get_source (E_CLIENT (book_client));
+
+	bench_book_populate (book_client, closure);
+	bench_book_open (fixture->registry, source, closure);
+	bench_book_view (book_client, closure);
+	bench_book_cursor (book_client, closure);
+	bench_book_autocomplete (book_client, closure);
+	bench_book_concurrent (fixture->registry, source, closure);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	GOptionContext *context;
+	gint ii;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, bench_option_entries (), GETTEXT_PACKAGE);
+	g_option_context_parse (context, &argc, &argv, NULL);
+	g_option_context_free (context);
+
+	if (bench_options.objects <= 0)
+		bench_options.objects = DEFAULT_CONTACTS;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* Change environment so that the addressbook factory inherits this setting */
+	g_setenv ("LC_ALL", "en_US.UTF-8", TRUE);
+	setlocale (LC_ALL, "");
+
+	for (ii = 0; ii < G_N_ELEMENTS (book_closures); ii++) {
+		gchar *path;
+
+		path = g_strdup_printf ("/EBookClient/Benchmark/%s", book_closures[ii].config);
+		g_test_add (
+			path, ETestServerFixture, &book_closures[ii],
+			e_test_server_utils_setup, bench_book, e_test_server_utils_teardown);
+		g_free (path);
+	}
+
+	return e_test_server_utils_run ();
+}
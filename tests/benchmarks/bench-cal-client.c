@@ -0,0 +1,551 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Measures the calendar factory with a synthetic calendar: opening it,
+ * populating a view, object lists by time range and free/busy queries,
+ * also from more concurrent clients.
+ */
+
+#include <stdlib.h>
+#include <libecal/libecal.h>
+#include <libical/ical.h>
+
+#include "e-test-server-utils.h"
+#include "bench-utils.h"
+
+#define DEFAULT_EVENTS     2000
+#define CREATE_BATCH_SIZE  250
+#define CALENDAR_DAYS      365
+
+#define MAIL_ACCOUNT_UID   "bench-email-account"
+#define MAIL_IDENTITY_UID  "bench-email-identity"
+#define USER_EMAIL         "user@example.com"
+
+typedef struct {
+	ETestServerClosure parent;
+	const gchar *config;
+
+	/* every n-th event recurs */
+	gint recurring_every;
+	/* spread the events over all the zones below, instead of UTC */
+	gboolean many_zones;
+} CalClosure;
+
+static CalClosure cal_closures[] = {
+	{ { E_TEST_SERVER_CALENDAR, NULL, E_CAL_CLIENT_SOURCE_TYPE_EVENTS }, "simple", 10, FALSE },
+	{ { E_TEST_SERVER_CALENDAR, NULL, E_CAL_CLIENT_SOURCE_TYPE_EVENTS }, "recurring", 1, FALSE },
+	{ { E_TEST_SERVER_CALENDAR, NULL, E_CAL_CLIENT_SOURCE_TYPE_EVENTS }, "timezones", 3, TRUE }
+};
+
+static const gchar *zone_locations[] = {
+	"Europe/Prague", "Europe/London", "America/New_York", "America/Los_Angeles",
+	"America/Sao_Paulo", "Asia/Tokyo", "Asia/Kolkata", "Australia/Sydney",
+	"Africa/Johannesburg", "Pacific/Auckland", "America/Denver", "Asia/Shanghai"
+};
+
+static const gchar *recurrences[] = {
+	"FREQ=DAILY;COUNT=30",
+	"FREQ=WEEKLY;BYDAY=MO,WE,FR",
+	"FREQ=WEEKLY;INTERVAL=2;BYDAY=TU;COUNT=26",
+	"FREQ=MONTHLY;BYMONTHDAY=15",
+	"FREQ=YEARLY"
+};
+
+static void
+setup_fixture (ETestServerFixture *fixture,
+               gconstpointer user_data)
+{
+	GError *error = NULL;
+	ESource *scratch;
+	ESourceMailAccount *mail_account;
+	ESourceMailIdentity *mail_identity;
+
+	e_test_server_utils_setup (fixture, user_data);
+
+	/* The free/busy information is for the user of the mail identity */
+	scratch = e_source_new_with_uid (MAIL_IDENTITY_UID, NULL, &error);
+	if (!scratch)
+		g_error ("Failed to create scratch source for an email user: %s", error->message);
+
+	mail_identity = e_source_get_extension (scratch, E_SOURCE_EXTENSION_MAIL_IDENTITY);
+	e_source_mail_identity_set_address (mail_identity, USER_EMAIL);
+
+	if (!e_source_registry_commit_source_sync (fixture->registry, scratch, NULL, &error))
+		g_error ("Unable to add new mail identity source to the registry: %s", error->message);
+
+	g_object_unref (scratch);
+
+	scratch = e_source_new_with_uid (MAIL_ACCOUNT_UID, NULL, &error);
+	if (!scratch)
+		g_error ("Failed to create scratch source for an email user: %s", error->message);
+
+	mail_account = e_source_get_extension (scratch, E_SOURCE_EXTENSION_MAIL_ACCOUNT);
+	e_source_mail_account_set_identity_uid (mail_account, MAIL_IDENTITY_UID);
+
+	if (!e_source_registry_commit_source_sync (fixture->registry, scratch, NULL, &error))
+		g_error ("Unable to add new mail account source to the registry: %s", error->message);
+
+	g_object_unref (scratch);
+}
+
+static void
+teardown_fixture (ETestServerFixture *fixture,
+                  gconstpointer user_data)
+{
+	const gchar *uids[] = { MAIL_ACCOUNT_UID, MAIL_IDENTITY_UID };
+	gint ii;
+
+	for (ii = 0; ii < G_N_ELEMENTS (uids); ii++) {
+		ESource *source;
+		GError *error = NULL;
+
+		source = e_source_registry_ref_source (fixture->registry, uids[ii]);
+		if (!source)
+			g_error ("Unable to fetch source '%s'", uids[ii]);
+
+		if (!e_source_remove_sync (source, NULL, &error))
+			g_error ("Unable to remove source '%s': %s", uids[ii], error->message);
+
+		g_object_unref (source);
+	}
+
+	e_test_server_utils_teardown (fixture, user_data);
+}
+
+/* The first day of the calendar, a Monday */
+static time_t
+calendar_start (void)
+{
+	return time_from_isodate ("20150105T000000Z");
+}
+
+static icalcomponent *
+bench_event_new (gint index,
+                 const CalClosure *closure)
+{
+	icalcomponent *icalcomp;
+	icaltimezone *zone;
+	struct icaltimetype dtstart, dtend;
+	gint zone_index;
+	gchar *uid, *summary;
+
+	if (closure->many_zones) {
+		zone_index = index % G_N_ELEMENTS (zone_locations);
+		zone = icaltimezone_get_builtin_timezone (zone_locations[zone_index]);
+	} else {
+		zone = icaltimezone_get_utc_timezone ();
+	}
+
+	dtstart = icaltime_from_timet_with_zone (
+		calendar_start () + (index % CALENDAR_DAYS) * 24 * 60 * 60, FALSE, zone);
+	dtstart.hour = 8 + index % 10;
+	dtstart.minute = (index % 4) * 15;
+	dtstart.second = 0;
+	dtstart = icaltime_set_timezone (&dtstart, zone);
+
+	dtend = dtstart;
+	icaltime_adjust (&dtend, 0, 0, 30 + (index % 3) * 30, 0);
+
+	uid = g_strdup_printf ("bench-event-%d", index);
+	summary = g_strdup_printf ("Meeting %d", index);
+
+	icalcomp = icalcomponent_new (ICAL_VEVENT_COMPONENT);
+	icalcomponent_set_uid (icalcomp, uid);
+	icalcomponent_set_summary (icalcomp, summary);
+	icalcomponent_set_dtstart (icalcomp, dtstart);
+	icalcomponent_set_dtend (icalcomp, dtend);
+
+	if (index % closure->recurring_every == 0) {
+		struct icalrecurrencetype rrule;
+		icalproperty *prop;
+
+		rrule = icalrecurrencetype_from_string (
+			recurrences[(index / closure->recurring_every) % G_N_ELEMENTS (recurrences)]);
+		icalcomponent_add_property (icalcomp, icalproperty_new_rrule (rrule));
+
+		/* some instances are cancelled, as in real calendars */
+		if (index % 2 == 0) {
+			struct icaltimetype exdate = dtstart;
+
+			icaltime_adjust (&exdate, 7, 0, 0, 0);
+			prop = icalproperty_new_exdate (exdate);
+			if (!icaltime_is_utc (exdate))
+				icalproperty_add_parameter (prop, icalparameter_new_tzid (icaltimezone_get_tzid (zone)));
+			icalcomponent_add_property (icalcomp, prop);
+		}
+	}
+
+	g_free (summary);
+	g_free (uid);
+
+	return icalcomp;
+}
+
+static void
+bench_cal_populate (ECalClient *cal_client,
+                    const CalClosure *closure)
+{
+	BenchStats *stats;
+	gint ii;
+
+	if (closure->many_zones) {
+		for (ii = 0; ii < G_N_ELEMENTS (zone_locations); ii++) {
+			icaltimezone *zone;
+			GError *error = NULL;
+
+			zone = icaltimezone_get_builtin_timezone (zone_locations[ii]);
+			if (!e_cal_client_add_timezone_sync (cal_client, zone, NULL, &error))
+				g_error ("add timezone sync: %s", error->message);
+		}
+	}
+
+	stats = bench_stats_new (closure->config, "create-objects", "events");
+
+	for (ii = 0; ii < bench_options.objects; ii += CREATE_BATCH_SIZE) {
+		GSList *icalcomps = NULL, *uids = NULL;
+		GError *error = NULL;
+		gint64 start;
+		gint jj;
+
+		for (jj = MIN (ii + CREATE_BATCH_SIZE, bench_options.objects) - 1; jj >= ii; jj--) {
+			icalcomps = g_slist_prepend (icalcomps, bench_event_new (jj, closure));
+		}
+
+		start = bench_timer_start ();
+
+		if (!e_cal_client_create_objects_sync (cal_client, icalcomps, &uids, NULL, &error))
+			g_error ("create objects sync: %s", error->message);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), g_slist_length (icalcomps));
+
+		g_slist_free_full (icalcomps, (GDestroyNotify) icalcomponent_free);
+		g_slist_free_full (uids, g_free);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+static ECalClient *
+bench_cal_connect (ESource *source)
+{
+	EClient *client;
+	GError *error = NULL;
+
+	client = e_cal_client_connect_sync (
+		source, E_CAL_CLIENT_SOURCE_TYPE_EVENTS, (guint32) -1, NULL, &error);
+	if (!client)
+		g_error ("connect sync: %s", error->message);
+
+	return E_CAL_CLIENT (client);
+}
+
+static void
+bench_cal_open (ESource *source,
+                const CalClosure *closure)
+{
+	BenchStats *stats;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "open", "opens");
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		ECalClient *cal_client;
+		gint64 start;
+
+		start = bench_timer_start ();
+		cal_client = bench_cal_connect (source);
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), 1);
+
+		g_object_unref (cal_client);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+typedef struct {
+	GMainLoop *loop;
+	gint64 n_objects;
+} ViewData;
+
+static void
+view_objects_added_cb (ECalClientView *view,
+                       const GSList *objects,
+                       gpointer user_data)
+{
+	ViewData *data = user_data;
+
+	data->n_objects += g_slist_length ((GSList *) objects);
+}
+
+static void
+view_complete_cb (ECalClientView *view,
+                  const GError *error,
+                  gpointer user_data)
+{
+	ViewData *data = user_data;
+
+	if (error)
+		g_error ("view complete: %s", error->message);
+
+	g_main_loop_quit (data->loop);
+}
+
+static void
+bench_cal_view (ECalClient *cal_client,
+                const CalClosure *closure)
+{
+	BenchStats *stats;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "view-populate", "events");
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		ECalClientView *view;
+		ViewData data;
+		GError *error = NULL;
+		gint64 start;
+
+		data.loop = g_main_loop_new (NULL, FALSE);
+		data.n_objects = 0;
+
+		start = bench_timer_start ();
+
+		if (!e_cal_client_get_view_sync (cal_client, "#t", &view, NULL, &error))
+			g_error ("get view sync: %s", error->message);
+
+		g_signal_connect (view, "objects-added", G_CALLBACK (view_objects_added_cb), &data);
+		g_signal_connect (view, "complete", G_CALLBACK (view_complete_cb), &data);
+
+		e_cal_client_view_start (view, &error);
+		if (error)
+			g_error ("start view: %s", error->message);
+
+		g_main_loop_run (data.loop);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), data.n_objects);
+
+		e_cal_client_view_stop (view, NULL);
+		g_object_unref (view);
+		g_main_loop_unref (data.loop);
+	}
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+/* One week of the calendar, as the week view of a calendar
+ * application asks for; the weeks cycle over the year */
+static void
+week_range (gint iteration,
+            time_t *start,
+            time_t *end)
+{
+	icaltimezone *utc = icaltimezone_get_utc_timezone ();
+
+	*start = time_add_week_with_zone (calendar_start (), iteration % (CALENDAR_DAYS / 7), utc);
+	*end = time_add_week_with_zone (*start, 1, utc);
+}
+
+static void
+object_list_run (ECalClient *cal_client,
+                 BenchStats *stats)
+{
+	gint ii;
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		GSList *icalcomps = NULL;
+		GError *error = NULL;
+		gchar *sexp, *start_str, *end_str;
+		time_t range_start, range_end;
+		gint64 start;
+
+		week_range (ii, &range_start, &range_end);
+		start_str = isodate_from_time_t (range_start);
+		end_str = isodate_from_time_t (range_end);
+		sexp = g_strdup_printf (
+			"(occur-in-time-range? (make-time \"%s\") (make-time \"%s\"))",
+			start_str, end_str);
+
+		start = bench_timer_start ();
+
+		if (!e_cal_client_get_object_list_sync (cal_client, sexp, &icalcomps, NULL, &error))
+			g_error ("get object list sync: %s", error->message);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), 1);
+
+		e_cal_client_free_icalcomp_slist (icalcomps);
+		g_free (sexp);
+		g_free (start_str);
+		g_free (end_str);
+	}
+}
+
+static void
+bench_cal_object_list (ECalClient *cal_client,
+                       const CalClosure *closure)
+{
+	BenchStats *stats;
+
+	stats = bench_stats_new (closure->config, "object-list-range", "queries");
+	object_list_run (cal_client, stats);
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+static void
+bench_cal_free_busy (ECalClient *cal_client,
+                     const CalClosure *closure)
+{
+	BenchStats *stats;
+	GSList *users;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "free-busy", "queries");
+	users = g_slist_append (NULL, (gpointer) USER_EMAIL);
+
+	for (ii = 0; ii < bench_options.iterations; ii++) {
+		GSList *freebusy_data = NULL;
+		GError *error = NULL;
+		time_t range_start, range_end;
+		gint64 start;
+
+		week_range (ii, &range_start, &range_end);
+
+		start = bench_timer_start ();
+
+		if (!e_cal_client_get_free_busy_sync (cal_client, range_start, range_end, users, &freebusy_data, NULL, &error))
+			g_error ("get free busy sync: %s", error->message);
+
+		bench_stats_add (stats, bench_timer_elapsed_ms (start), 1);
+
+		g_slist_free_full (freebusy_data, g_object_unref);
+	}
+
+	g_slist_free (users);
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+typedef struct {
+	ECalClient *cal_client;
+	BenchStats *stats;
+} ConcurrentData;
+
+static gpointer
+concurrent_thread (gpointer user_data)
+{
+	ConcurrentData *data = user_data;
+
+	object_list_run (data->cal_client, data->stats);
+
+	return NULL;
+}
+
+static void
+bench_cal_concurrent (ESource *source,
+                      const CalClosure *closure)
+{
+	ConcurrentData *data;
+	GThread **threads;
+	BenchStats *stats;
+	gint64 start;
+	gint ii;
+
+	stats = bench_stats_new (closure->config, "object-list-mt", "queries");
+
+	data = g_new0 (ConcurrentData, bench_options.clients);
+	threads = g_new0 (GThread *, bench_options.clients);
+
+	/* Each thread is a separate client, as separate applications are */
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		data[ii].cal_client = bench_cal_connect (source);
+		data[ii].stats = stats;
+	}
+
+	start = bench_timer_start ();
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		threads[ii] = g_thread_new ("bench-cal-client", concurrent_thread, &data[ii]);
+	}
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		g_thread_join (threads[ii]);
+	}
+
+	bench_stats_set_wall_time (stats, bench_timer_elapsed_ms (start));
+
+	for (ii = 0; ii < bench_options.clients; ii++) {
+		g_object_unref (data[ii].cal_client);
+	}
+
+	g_free (threads);
+	g_free (data);
+
+	bench_stats_report (stats);
+	bench_stats_free (stats);
+}
+
+static void
+bench_cal (ETestServerFixture *fixture,
+           gconstpointer user_data)
+{
+	const CalClosure *closure = user_data;
+	ECalClient *cal_client;
+	ESource *source;
+
+	cal_client = E_TEST_SERVER_UTILS_SERVICE (fixture, ECalClient);
+	source = e_client_get_source (E_CLIENT (cal_client));
+
+	bench_cal_populate (cal_client, closure);
+	bench_cal_open (source, closure);
+	bench_cal_view (cal_client, closure);
+	bench_cal_object_list (cal_client, closure);
+	bench_cal_free_busy (cal_client, closure);
+	bench_cal_concurrent (source, closure);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	GOptionContext *context;
+	gint ii;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, bench_option_entries (), GETTEXT_PACKAGE);
+	g_option_context_parse (context, &argc, &argv, NULL);
+	g_option_context_free (context);
+
+	if (bench_options.objects <= 0)
+		bench_options.objects = DEFAULT_EVENTS;
+
+	g_test_init (&argc, &argv, NULL);
+
+	for (ii = 0; ii < G_N_ELEMENTS (cal_closures); ii++) {
+		gchar *path;
+
+		path = g_strdup_printf ("/ECalClient/Benchmark/%s", cal_closures[ii].config);
+		g_test_add (
+			path, ETestServerFixture, &cal_closures[ii],
+			setup_fixture, bench_cal, teardown_fixture);
+		g_free (path);
+	}
+
+	return e_test_server_utils_run ();
+}
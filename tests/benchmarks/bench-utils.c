@@ -0,0 +1,211 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench-utils.h"
+
+BenchOptions bench_options = { 0, 4, 20, FALSE, FALSE };
+
+static GOptionEntry entries[] = {
+	{ "objects", 'n', 0, G_OPTION_ARG_INT, &bench_options.objects,
+	  "Number of contacts or events to populate the data source with", "COUNT" },
+	{ "clients", 'c', 0, G_OPTION_ARG_INT, &bench_options.clients,
+	  "Number of concurrent clients (default: 4)", "COUNT" },
+	{ "iterations", 'i', 0, G_OPTION_ARG_INT, &bench_options.iterations,
+	  "Number of measured iterations of each operation (default: 20)", "COUNT" },
+	{ "photos", 'p', 0, G_OPTION_ARG_NONE, &bench_options.photos,
+	  "Add an inline photo to each contact", NULL },
+	{ "json", 'j', 0, G_OPTION_ARG_NONE, &bench_options.json,
+	  "Print the results as JSON lines", NULL },
+	{ NULL }
+};
+
+struct _BenchStats {
+	gchar *config;
+	gchar *operation;
+	gchar *unit;
+
+	GMutex lock;
+	GArray *samples;
+	gint64 units;
+	gdouble wall_ms;
+};
+
+GOptionEntry *
+bench_option_entries (void)
+{
+	return entries;
+}
+
+BenchStats *
+bench_stats_new (const gchar *config,
+                 const gchar *operation,
+                 const gchar *unit)
+{
+	BenchStats *stats;
+
+	stats = g_new0 (BenchStats, 1);
+	stats->config = g_strdup (config);
+	stats->operation = g_strdup (operation);
+	stats->unit = g_strdup (unit);
+	stats->samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	g_mutex_init (&stats->lock);
+
+	return stats;
+}
+
+void
+bench_stats_free (BenchStats *stats)
+{
+	if (!stats)
+		return;
+
+	g_array_free (stats->samples, TRUE);
+	g_mutex_clear (&stats->lock);
+	g_free (stats->config);
+	g_free (stats->operation);
+	g_free (stats->unit);
+	g_free (stats);
+}
+
+/* Safe to call from more threads, the concurrent runs share one stats */
+void
+bench_stats_add (BenchStats *stats,
+                 gdouble ms,
+                 gint64 units)
+{
+	g_mutex_lock (&stats->lock);
+	g_array_append_val (stats->samples, ms);
+	stats->units += units;
+	g_mutex_unlock (&stats->lock);
+}
+
+/* The samples of concurrent runs overlap, thus the throughput
+ * is computed from the wall time instead of from their sum */
+void
+bench_stats_set_wall_time (BenchStats *stats,
+                           gdouble ms)
+{
+	stats->wall_ms = ms;
+}
+
+void
+bench_stats_report (BenchStats *stats)
+{
+	BenchSummary summary;
+	gdouble total_ms, rate;
+	gint64 client_rss;
+	gsize services_rss;
+
+	g_mutex_lock (&stats->lock);
+
+	bench_summarize ((gdouble *) stats->samples->data, stats->samples->len, &summary);
+
+	total_ms = stats->wall_ms > 0.0 ? stats->wall_ms : summary.total_ms;
+	rate = total_ms > 0.0 ? stats->units * 1000.0 / total_ms : 0.0;
+
+	g_mutex_unlock (&stats->lock);
+
+	client_rss = bench_peak_rss_kb ();
+	services_rss = bench_services_peak_rss_kb ();
+
+	if (bench_options.json) {
+		GString *json;
+
+		json = bench_json_begin ();
+		bench_json_add_string (json, "config", stats->config);
+		bench_json_add_string (json, "operation", stats->operation);
+		bench_json_add_string (json, "unit", stats->unit);
+		bench_json_add_int (json, "samples", summary.n_samples);
+		bench_json_add_int (json, "units", stats->units);
+		bench_json_add_double (json, "per_second", rate);
+		bench_json_add_double (json, "p50_ms", summary.p50_ms);
+		bench_json_add_double (json, "p99_ms", summary.p99_ms);
+		bench_json_add_double (json, "max_ms", summary.max_ms);
+		bench_json_add_int (json, "client_rss_kb", client_rss);
+		bench_json_add_int (json, "services_rss_kb", services_rss);
+		bench_json_end (json);
+	} else {
+		g_print (
+			"\n%-14s %-18s %10.1f %-9s/s  p50 %9.3f ms  p99 %9.3f ms  max %9.3f ms  "
+			"rss client %" G_GINT64_FORMAT " kB, services %" G_GSIZE_FORMAT " kB\n",
+			stats->config, stats->operation, rate, stats->unit,
+			summary.p50_ms, summary.p99_ms, summary.max_ms, client_rss, services_rss);
+	}
+
+	g_test_minimized_result (summary.p50_ms, "%s %s p50 %.3f ms", stats->config, stats->operation, summary.p50_ms);
+}
+
+static gsize
+read_peak_rss_kb (const gchar *pid)
+{
+	gchar *filename, *contents = NULL, *line;
+	gsize peak = 0;
+
+	filename = g_build_filename ("/proc", pid, "status", NULL);
+
+	if (g_file_get_contents (filename, &contents, NULL, NULL)) {
+		line = strstr (contents, "VmHWM:");
+		if (line)
+			peak = strtoul (line + 6, NULL, 10);
+	}
+
+	g_free (contents);
+	g_free (filename);
+
+	return peak;
+}
+
+/* Sums the peak RSS of the in-tree services, the registry and
+ * the factories, which is where the data sources live */
+gsize
+bench_services_peak_rss_kb (void)
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *self;
+	gsize total = 0;
+
+	dir = g_dir_open ("/proc", 0, NULL);
+	if (!dir)
+		return 0;
+
+	self = g_strdup_printf ("%d", (gint) getpid ());
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename, *cmdline = NULL;
+
+		if (!g_ascii_isdigit (*name) || g_str_equal (name, self))
+			continue;
+
+		filename = g_build_filename ("/proc", name, "cmdline", NULL);
+
+		if (g_file_get_contents (filename, &cmdline, NULL, NULL) &&
+		    g_str_has_prefix (cmdline, EDS_TEST_TOP_BUILD_DIR))
+			total += read_peak_rss_kb (name);
+
+		g_free (cmdline);
+		g_free (filename);
+	}
+
+	g_free (self);
+	g_dir_close (dir);
+
+	return total;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <glib.h>
+
+#include "bench-common.h"
+
+G_BEGIN_DECLS
+
+typedef struct _BenchStats BenchStats;
+
+/* Options shared by all the benchmark programs */
+typedef struct _BenchOptions {
+	gint objects;
+	gint clients;
+	gint iterations;
+	gboolean photos;
+	gboolean json;
+} BenchOptions;
+
+extern BenchOptions bench_options;
+
+GOptionEntry *	bench_option_entries		(void);
+
+BenchStats *	bench_stats_new			(const gchar *config,
+						 const gchar *operation,
+						 const gchar *unit);
+void		bench_stats_free		(BenchStats *stats);
+void		bench_stats_add			(BenchStats *stats,
+						 gdouble ms,
+						 gint64 units);
+void		bench_stats_set_wall_time	(BenchStats *stats,
+						 gdouble ms);
+void		bench_stats_report		(BenchStats *stats);
+
+gsize		bench_services_peak_rss_kb	(void);
+
+G_END_DECLS
+
+#endif /* BENCH_UTILS_H */
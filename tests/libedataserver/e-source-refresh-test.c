@@ -0,0 +1,252 @@
+/*
+ * e-source-refresh-test.c
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <libedataserver/libedataserver.h>
+
+/* The scheduler runs this many refreshes at once, in total and per host */
+#define MAX_RUNNING 4
+#define MAX_RUNNING_PER_HOST 2
+
+/* The slot of a refresh which never reported it finished
+ * is freed after 10 seconds, give it some more time */
+#define UNREPORTED_WAIT_SECONDS 15
+
+typedef struct _TestSources {
+	GPtrArray *sources; /* ESource * */
+	guint *n_calls;
+} TestSources;
+
+static void
+test_refresh_cb (ESource *source,
+                 gpointer user_data)
+{
+	guint *n_calls = user_data;
+
+	(*n_calls)++;
+}
+
+static TestSources *
+test_sources_new (guint n_sources,
+                  const gchar *host)
+{
+	TestSources *ts;
+	guint ii;
+
+	ts = g_new0 (TestSources, 1);
+	ts->sources = g_ptr_array_new_with_free_func (g_object_unref);
+	ts->n_calls = g_new0 (guint, n_sources);
+
+	for (ii = 0; ii < n_sources; ii++) {
+		ESource *source;
+		ESourceRefresh *extension;
+		GError *local_error = NULL;
+
+		source = e_source_new (NULL, NULL, &local_error);
+		g_assert_no_error (local_error);
+
+		extension = e_source_get_extension (source, E_SOURCE_EXTENSION_REFRESH);
+		e_source_refresh_set_enabled (extension, TRUE);
+		e_source_refresh_set_interval_minutes (extension, 60);
+
+		if (host != NULL) {
+			ESourceAuthentication *auth_extension;
+
+			auth_extension = e_source_get_extension (source, E_SOURCE_EXTENSION_AUTHENTICATION);
+			e_source_authentication_set_host (auth_extension, host);
+		}
+
+		e_source_refresh_add_timeout (source, NULL, test_refresh_cb, &ts->n_calls[ii], NULL);
+
+		g_ptr_array_add (ts->sources, source);
+	}
+
+	return ts;
+}
+
+static void
+test_sources_free (TestSources *ts)
+{
+	guint ii;
+
+	/* Free the slots for the other tests */
+	for (ii = 0; ii < ts->sources->len; ii++)
+		e_source_refresh_finished (g_ptr_array_index (ts->sources, ii), NULL);
+
+	g_ptr_array_unref (ts->sources);
+	g_free (ts->n_calls);
+	g_free (ts);
+}
+
+static void
+test_sources_schedule (TestSources *ts)
+{
+	guint ii;
+
+	for (ii = 0; ii < ts->sources->len; ii++)
+		e_source_refresh_schedule_timeout (g_ptr_array_index (ts->sources, ii));
+}
+
+static guint
+test_sources_count_calls (TestSources *ts)
+{
+	guint ii, n_calls = 0;
+
+	for (ii = 0; ii < ts->sources->len; ii++)
+		n_calls += ts->n_calls[ii];
+
+	return n_calls;
+}
+
+/* Returns the first source whose refresh was called */
+static ESource *
+test_sources_get_called (TestSources *ts)
+{
+	guint ii;
+
+	for (ii = 0; ii < ts->sources->len; ii++) {
+		if (ts->n_calls[ii] > 0)
+			return g_ptr_array_index (ts->sources, ii);
+	}
+
+	return NULL;
+}
+
+static gboolean
+quit_main_loop_cb (gpointer user_data)
+{
+	g_main_loop_quit (user_data);
+
+	return FALSE;
+}
+
+static void
+run_main_loop (guint timeout_ms)
+{
+	GMainLoop *main_loop;
+
+	main_loop = g_main_loop_new (NULL, FALSE);
+	g_timeout_add (timeout_ms, quit_main_loop_cb, main_loop);
+	g_main_loop_run (main_loop);
+	g_main_loop_unref (main_loop);
+}
+
+static void
+test_limit_running (void)
+{
+	TestSources *ts;
+
+	ts = test_sources_new (MAX_RUNNING + 2, NULL);
+
+	test_sources_schedule (ts);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING);
+
+	/* Scheduling again does not run anything more */
+	test_sources_schedule (ts);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING);
+
+	/* A finished refresh frees a slot for a waiting one */
+	e_source_refresh_finished (test_sources_get_called (ts), NULL);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING + 1);
+
+	test_sources_free (ts);
+}
+
+static void
+test_finished_not_started (void)
+{
+	TestSources *ts;
+	guint ii;
+
+	ts = test_sources_new (MAX_RUNNING + 2, NULL);
+
+	test_sources_schedule (ts);
+
+	/* The slots are handed out, but no refresh was called yet,
+	 * thus these are not the refreshes the slots are for */
+	for (ii = 0; ii < ts->sources->len; ii++)
+		e_source_refresh_finished (g_ptr_array_index (ts->sources, ii), NULL);
+
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING);
+
+	test_sources_free (ts);
+}
+
+static void
+test_limit_per_host (void)
+{
+	TestSources *ts;
+
+	ts = test_sources_new (MAX_RUNNING_PER_HOST + 1, "example.com");
+
+	test_sources_schedule (ts);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING_PER_HOST);
+
+	e_source_refresh_finished (test_sources_get_called (ts), NULL);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING_PER_HOST + 1);
+
+	test_sources_free (ts);
+}
+
+static void
+test_unreported_expire (void)
+{
+	TestSources *ts;
+	gint64 deadline;
+
+	ts = test_sources_new (MAX_RUNNING + 1, NULL);
+
+	test_sources_schedule (ts);
+	run_main_loop (100);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING);
+
+	/* Nothing else happens, the expired slot alone lets the last one run */
+	deadline = g_get_monotonic_time () + UNREPORTED_WAIT_SECONDS * G_USEC_PER_SEC;
+
+	while (test_sources_count_calls (ts) == MAX_RUNNING && g_get_monotonic_time () < deadline)
+		run_main_loop (500);
+
+	g_assert_cmpuint (test_sources_count_calls (ts), ==, MAX_RUNNING + 1);
+
+	test_sources_free (ts);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/e-source-refresh-test/LimitRunning", test_limit_running);
+	g_test_add_func ("/e-source-refresh-test/FinishedNotStarted", test_finished_not_started);
+	g_test_add_func ("/e-source-refresh-test/LimitPerHost", test_limit_per_host);
+	g_test_add_func ("/e-source-refresh-test/UnreportedExpire", test_unreported_expire);
+
+	return g_test_run ();
+}